@@ -0,0 +1,193 @@
+#include "AffineKernels.h"
+#include "cpu_raytracing/Simd.h"
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		//m[row * 4 + column], T is float or Float8, the cofactor rows are r1 x r2, r2 x r0 and r0 x r1
+		template<typename T>
+		void Cofactors(const T m[12], T cofactors[9], T& inverseDeterminant)
+		{
+			cofactors[0] = m[5] * m[10] - m[6] * m[9];
+			cofactors[1] = m[6] * m[8] - m[4] * m[10];
+			cofactors[2] = m[4] * m[9] - m[5] * m[8];
+			cofactors[3] = m[9] * m[2] - m[10] * m[1];
+			cofactors[4] = m[10] * m[0] - m[8] * m[2];
+			cofactors[5] = m[8] * m[1] - m[9] * m[0];
+			cofactors[6] = m[1] * m[6] - m[2] * m[5];
+			cofactors[7] = m[2] * m[4] - m[0] * m[6];
+			cofactors[8] = m[0] * m[5] - m[1] * m[4];
+			inverseDeterminant = T(1.f) / (m[0] * cofactors[0] + m[1] * cofactors[1] + m[2] * cofactors[2]);
+		}
+
+		//the inverse of the 3x3 is the transposed cofactor matrix over the determinant, the translation is undone afterwards
+		template<typename T>
+		void InverseKernel(const T m[12], T inverse[12])
+		{
+			T cofactors[9];
+			T inverseDeterminant;
+			Cofactors(m, cofactors, inverseDeterminant);
+			for (int row = 0; row < 3; row++)
+			{
+				inverse[row * 4 + 0] = cofactors[row] * inverseDeterminant;
+				inverse[row * 4 + 1] = cofactors[3 + row] * inverseDeterminant;
+				inverse[row * 4 + 2] = cofactors[6 + row] * inverseDeterminant;
+			}
+			for (int row = 0; row < 3; row++)
+			{
+				inverse[row * 4 + 3] = -(inverse[row * 4 + 0] * m[3] + inverse[row * 4 + 1] * m[7] + inverse[row * 4 + 2] * m[11]);
+			}
+		}
+
+		template<typename T>
+		void NormalMatrixKernel(const T m[12], T normalMatrix[12])
+		{
+			T cofactors[9];
+			T inverseDeterminant;
+			Cofactors(m, cofactors, inverseDeterminant);
+			for (int row = 0; row < 3; row++)
+			{
+				normalMatrix[row * 4 + 0] = cofactors[row * 3 + 0] * inverseDeterminant;
+				normalMatrix[row * 4 + 1] = cofactors[row * 3 + 1] * inverseDeterminant;
+				normalMatrix[row * 4 + 2] = cofactors[row * 3 + 2] * inverseDeterminant;
+				normalMatrix[row * 4 + 3] = T(0.f);
+			}
+		}
+
+		//transposes 8 transforms into 12 registers and back
+		struct AffineTransform8
+		{
+			alignas(32) float m_values[12][8];
+
+			//each row of four transforms is one 4x4 transpose
+			void Load(const AffineTransform* transforms)
+			{
+				for (int group = 0; group < 8; group += 4)
+				{
+					for (int row = 0; row < 3; row++)
+					{
+						__m128 lane0 = _mm_loadu_ps(glm::value_ptr(transforms[group + 0].m_rows[row]));
+						__m128 lane1 = _mm_loadu_ps(glm::value_ptr(transforms[group + 1].m_rows[row]));
+						__m128 lane2 = _mm_loadu_ps(glm::value_ptr(transforms[group + 2].m_rows[row]));
+						__m128 lane3 = _mm_loadu_ps(glm::value_ptr(transforms[group + 3].m_rows[row]));
+						_MM_TRANSPOSE4_PS(lane0, lane1, lane2, lane3);
+						_mm_store_ps(m_values[row * 4 + 0] + group, lane0);
+						_mm_store_ps(m_values[row * 4 + 1] + group, lane1);
+						_mm_store_ps(m_values[row * 4 + 2] + group, lane2);
+						_mm_store_ps(m_values[row * 4 + 3] + group, lane3);
+					}
+				}
+			}
+
+			void Store(AffineTransform* transforms) const
+			{
+				for (int group = 0; group < 8; group += 4)
+				{
+					for (int row = 0; row < 3; row++)
+					{
+						__m128 column0 = _mm_load_ps(m_values[row * 4 + 0] + group);
+						__m128 column1 = _mm_load_ps(m_values[row * 4 + 1] + group);
+						__m128 column2 = _mm_load_ps(m_values[row * 4 + 2] + group);
+						__m128 column3 = _mm_load_ps(m_values[row * 4 + 3] + group);
+						_MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+						_mm_storeu_ps(glm::value_ptr(transforms[group + 0].m_rows[row]), column0);
+						_mm_storeu_ps(glm::value_ptr(transforms[group + 1].m_rows[row]), column1);
+						_mm_storeu_ps(glm::value_ptr(transforms[group + 2].m_rows[row]), column2);
+						_mm_storeu_ps(glm::value_ptr(transforms[group + 3].m_rows[row]), column3);
+					}
+				}
+			}
+
+			void ToRegisters(Float8 registers[12]) const
+			{
+				for (int element = 0; element < 12; element++)
+				{
+					registers[element] = Float8::Load(m_values[element]);
+				}
+			}
+
+			void FromRegisters(const Float8 registers[12])
+			{
+				for (int element = 0; element < 12; element++)
+				{
+					registers[element].Store(m_values[element]);
+				}
+			}
+		};
+
+		template<typename Kernel>
+		void UnaryBatch(const AffineTransform* transforms, AffineTransform* results, size_t count, Kernel kernel)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				AffineTransform8 batch;
+				Float8 input[12], output[12];
+				batch.Load(transforms + i);
+				batch.ToRegisters(input);
+				kernel(input, output);
+				batch.FromRegisters(output);
+				batch.Store(results + i);
+			}
+			for (; i < count; i++)
+			{
+				kernel(glm::value_ptr(transforms[i].m_rows[0]), glm::value_ptr(results[i].m_rows[0]));
+			}
+		}
+	}
+
+	AffineTransform Compose(const AffineTransform& a, const AffineTransform& b)
+	{
+		//the missing fourth row of b is 0 0 0 1, so it only adds a's translation to the last column
+		const __m128 b0 = _mm_loadu_ps(glm::value_ptr(b.m_rows[0]));
+		const __m128 b1 = _mm_loadu_ps(glm::value_ptr(b.m_rows[1]));
+		const __m128 b2 = _mm_loadu_ps(glm::value_ptr(b.m_rows[2]));
+		const __m128 translationMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+		AffineTransform result;
+		for (int row = 0; row < 3; row++)
+		{
+			const __m128 aRow = _mm_loadu_ps(glm::value_ptr(a.m_rows[row]));
+			__m128 sum = _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(aRow, aRow, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+			sum = _mm_add_ps(sum, _mm_and_ps(aRow, translationMask));
+			_mm_storeu_ps(glm::value_ptr(result.m_rows[row]), sum);
+		}
+		return result;
+	}
+
+	AffineTransform Inverse(const AffineTransform& transform)
+	{
+		AffineTransform inverse;
+		InverseKernel(glm::value_ptr(transform.m_rows[0]), glm::value_ptr(inverse.m_rows[0]));
+		return inverse;
+	}
+
+	AffineTransform NormalMatrix(const AffineTransform& transform)
+	{
+		AffineTransform normalMatrix;
+		NormalMatrixKernel(glm::value_ptr(transform.m_rows[0]), glm::value_ptr(normalMatrix.m_rows[0]));
+		return normalMatrix;
+	}
+
+	void ComposeBatch(const AffineTransform* a, const AffineTransform* b, AffineTransform* result, size_t count)
+	{
+		//a row already fills a register, transposing to structure of arrays would cost more than it saves
+		for (size_t i = 0; i < count; i++)
+		{
+			result[i] = Compose(a[i], b[i]);
+		}
+	}
+
+	void InverseBatch(const AffineTransform* transforms, AffineTransform* inverses, size_t count)
+	{
+		UnaryBatch(transforms, inverses, count, [](const auto* input, auto* output) { InverseKernel(input, output); });
+	}
+
+	void NormalMatrixBatch(const AffineTransform* transforms, AffineTransform* normalMatrices, size_t count)
+	{
+		UnaryBatch(transforms, normalMatrices, count, [](const auto* input, auto* output) { NormalMatrixKernel(input, output); });
+	}
+}
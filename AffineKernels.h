@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Basics.h"
+
+namespace MelonRenderer
+{
+	//a * b, applying b first, one SSE row at a time
+	AffineTransform Compose(const AffineTransform& a, const AffineTransform& b);
+	//only valid for invertible transforms
+	AffineTransform Inverse(const AffineTransform& transform);
+	//inverse transpose of the upper 3x3 without translation, TransformVector with it moves normals
+	AffineTransform NormalMatrix(const AffineTransform& transform);
+
+	void ComposeBatch(const AffineTransform* a, const AffineTransform* b, AffineTransform* result, size_t count);
+	//8 transforms at a time in structure of arrays, the rest one by one, the output may not alias the input
+	void InverseBatch(const AffineTransform* transforms, AffineTransform* inverses, size_t count);
+	void NormalMatrixBatch(const AffineTransform* transforms, AffineTransform* normalMatrices, size_t count);
+}
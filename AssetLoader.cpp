@@ -0,0 +1,159 @@
+#include "AssetLoader.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		float MsSince(const std::chrono::steady_clock::time_point& start)
+		{
+			return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	bool LoadAssets(const AssetManifest& manifest, DeviceMemoryManager& memoryManager, ThreadPool& threadPool,
+		std::vector<Drawable>& drawables, AssetLoadTimings& timings)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint32_t meshCount = static_cast<uint32_t>(manifest.m_meshes.size());
+		timings = AssetLoadTimings();
+		timings.m_threadCount = threadPool.GetThreadCount();
+		timings.m_meshMs.assign(meshCount, 0.f);
+
+		std::vector<Drawable> loaded(meshCount);
+		//logs are written after the cpu stage, so they stay in manifest order
+		std::vector<std::string> logs(meshCount);
+		//textures decoded by the first mesh referencing them, with their ms
+		std::vector<std::vector<DecodedTexture>> decodedTextures(meshCount);
+		std::vector<std::vector<float>> decodeMs(meshCount);
+
+		//the memory manager's textures are not changed until the upload stage
+		const std::unordered_map<std::string, uint32_t>& existingTextures = memoryManager.GetTextureIDs();
+		std::unordered_set<std::string> claimedTextures;
+		std::mutex claimMutex;
+
+		//every mesh is a task followed by the decoding of the textures it claimed, which only knows its index count once the mesh is parsed
+		TaskGraph graph;
+		for (uint32_t i = 0; i < meshCount; i++)
+		{
+			const uint32_t decode = graph.AddParallelTask("decode texture", 0, [&, i](uint32_t t)
+			{
+				const auto decodeStart = std::chrono::steady_clock::now();
+				//failures are left to CreateTextureID, which logs them and falls back to texture 0
+				DeviceMemoryManager::DecodeTexture(decodedTextures[i][t].m_fileName.c_str(), decodedTextures[i][t]);
+				decodeMs[i][t] = MsSince(decodeStart);
+			});
+
+			const uint32_t parse = graph.AddTask("parse mesh", [&, i, decode]()
+			{
+				const auto meshStart = std::chrono::steady_clock::now();
+				Drawable& drawable = loaded[i];
+				if (manifest.m_meshes[i].empty())
+					drawable.LoadCubeData();
+				else
+					drawable.LoadMeshData(manifest.m_meshes[i], logs[i]);
+
+				std::vector<DecodedTexture>& textures = decodedTextures[i];
+				{
+					std::lock_guard<std::mutex> lock(claimMutex);
+					for (const std::string& textureName : drawable.GetTextureNames())
+					{
+						if (textureName.empty() || existingTextures.count(textureName) || !claimedTextures.insert(textureName).second)
+							continue;
+
+						DecodedTexture texture;
+						texture.m_fileName = textureName;
+						textures.emplace_back(texture);
+					}
+				}
+
+				decodeMs[i].assign(textures.size(), 0.f);
+				graph.SetIndexCount(decode, static_cast<uint32_t>(textures.size()));
+				timings.m_meshMs[i] = MsSince(meshStart);
+			});
+			graph.AddDependency(parse, decode);
+		}
+		threadPool.Run(graph);
+		timings.m_cpuMs = MsSince(start);
+
+		std::unordered_map<std::string, DecodedTexture*> decodedByName;
+		for (uint32_t i = 0; i < meshCount; i++)
+		{
+			for (size_t t = 0; t < decodedTextures[i].size(); t++)
+			{
+				DecodedTexture& texture = decodedTextures[i][t];
+				decodedByName.emplace(texture.m_fileName, &texture);
+				timings.m_textureNames.emplace_back(texture.m_fileName);
+				timings.m_textureMs.emplace_back(decodeMs[i][t]);
+			}
+		}
+
+		const auto uploadStart = std::chrono::steady_clock::now();
+		bool success = memoryManager.BeginUploadBatch();
+		for (uint32_t i = 0; success && i < meshCount; i++)
+		{
+			if (!logs[i].empty())
+				Logger::Log(logs[i]);
+
+			Drawable& drawable = loaded[i];
+			for (const std::string& textureName : drawable.GetTextureNames())
+			{
+				auto decoded = decodedByName.find(textureName);
+				if (decoded == decodedByName.end() || decoded->second->m_pixelData == nullptr)
+					continue;
+
+				if (!memoryManager.CreateTexture(*decoded->second))
+				{
+					Logger::Log("Could not create texture of asset manifest.");
+					success = false;
+					break;
+				}
+			}
+
+			if (success && !drawable.Upload(memoryManager))
+			{
+				Logger::Log("Could not upload mesh of asset manifest.");
+				success = false;
+			}
+		}
+		if (success && !memoryManager.EndUploadBatch())
+		{
+			Logger::Log("Could not submit upload batch of asset manifest.");
+			success = false;
+		}
+
+		for (std::vector<DecodedTexture>& textures : decodedTextures)
+		{
+			for (DecodedTexture& texture : textures)
+			{
+				DeviceMemoryManager::FreeDecodedTexture(texture);
+			}
+		}
+
+		if (!success)
+			return false;
+
+		drawables.insert(drawables.end(), loaded.begin(), loaded.end());
+		timings.m_uploadMs = MsSince(uploadStart);
+		timings.m_totalMs = MsSince(start);
+
+		return true;
+	}
+
+	void LogAssetLoadTimings(const AssetManifest& manifest, const AssetLoadTimings& timings)
+	{
+		Logger::Log("Assets loaded in " + std::to_string(timings.m_totalMs) + " ms on " + std::to_string(timings.m_threadCount) + " threads: cpu "
+			+ std::to_string(timings.m_cpuMs) + " ms, upload " + std::to_string(timings.m_uploadMs) + " ms.");
+		for (size_t i = 0; i < timings.m_meshMs.size(); i++)
+		{
+			Logger::Log("  " + (manifest.m_meshes[i].empty() ? std::string("cube") : manifest.m_meshes[i]) + ": " + std::to_string(timings.m_meshMs[i]) + " ms");
+		}
+		for (size_t t = 0; t < timings.m_textureMs.size(); t++)
+		{
+			Logger::Log("  textures/" + timings.m_textureNames[t] + ": " + std::to_string(timings.m_textureMs[t]) + " ms");
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Drawable.h"
+#include "cpu_raytracing/ThreadPool.h"
+
+#include <string>
+#include <vector>
+
+namespace MelonRenderer
+{
+	//every asset a scene needs before its first frame, loaded by LoadAssets in one go
+	struct AssetManifest
+	{
+		//obj paths, an empty path is the cube, drawables are appended in this order
+		std::vector<std::string> m_meshes;
+	};
+
+	//in ms
+	struct AssetLoadTimings
+	{
+		//parsing and vertex deduplication of each mesh, its textures are timed on their own
+		std::vector<float> m_meshMs;
+		std::vector<std::string> m_textureNames;
+		std::vector<float> m_textureMs;
+		//wall time of the cpu stage, the slowest mesh if there are enough threads
+		float m_cpuMs = 0.f;
+		float m_uploadMs = 0.f;
+		float m_totalMs = 0.f;
+		uint32_t m_threadCount = 0;
+	};
+
+	//parses the meshes and decodes their new textures as a task graph on the pool, then creates textures and buffers on the calling thread
+	//in one upload batch, texture ids are handed out in manifest order like loading the meshes one by one would
+	bool LoadAssets(const AssetManifest& manifest, DeviceMemoryManager& memoryManager, ThreadPool& threadPool,
+		std::vector<Drawable>& drawables, AssetLoadTimings& timings);
+	void LogAssetLoadTimings(const AssetManifest& manifest, const AssetLoadTimings& timings);
+}
@@ -4,9 +4,9 @@ bool MelonRenderer::Camera::Init(DeviceMemoryManager& memoryManager)
 {
 	m_memoryManager = &memoryManager;
 
-	uint32_t uniformBufferSize = sizeof(CameraMatrices);
-	if (!memoryManager.CreateBuffer(uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffer, m_uniformBufferMemory))
+	m_uniformBuffer.m_numberOfElements = maxFramesInFlight;
+	m_uniformBuffer.m_alignment = sizeof(CameraMatrices);
+	if (!memoryManager.CreateDynamicUBO(m_uniformBuffer))
 	{
 		Logger::Log("Could not create uniform buffer.");
 		return false;
@@ -18,6 +18,7 @@ bool MelonRenderer::Camera::Init(DeviceMemoryManager& memoryManager)
 		vec3(0, -1, 0));
 	m_cameraMatrices.projectionInverse = glm::inverse(m_cameraMatrices.projection);
 	m_cameraMatrices.viewInverse = glm::inverse(m_cameraMatrices.view);
+	m_cameraMatrices.previousViewProjection = m_cameraMatrices.projection * m_cameraMatrices.view;
 
 
 	// Vulkan clip space has inverted Y and half Z.
@@ -28,27 +29,21 @@ bool MelonRenderer::Camera::Init(DeviceMemoryManager& memoryManager)
 
 	Tick(m_cameraMatrices);
 
-	m_uniformBufferDescriptor.buffer = m_uniformBuffer;
-	m_uniformBufferDescriptor.offset = 0;
-	m_uniformBufferDescriptor.range = VK_WHOLE_SIZE;
-
 	return true;
 }
 
 bool MelonRenderer::Camera::Tick(CameraMatrices& cameraMatrices)
 {
-	m_cameraMatrices = cameraMatrices;
-
-	if (!m_memoryManager->CopyDataToMemory(m_uniformBufferMemory, &m_cameraMatrices, sizeof(m_cameraMatrices)))
+	for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
 	{
-		Logger::Log("Could not copy camera data to uniform buffer.");
-		return false;
+		if (!Upload(cameraMatrices, frame))
+			return false;
 	}
 
 	return true;
 }
 
-bool MelonRenderer::Camera::Tick(GLFWwindow* glfwWindow)
+bool MelonRenderer::Camera::Tick()
 {
 	ImGui::Begin("Camera");
 	static float cameraPosition[3] = { m_cameraPosition.x, m_cameraPosition.y, m_cameraPosition.z };
@@ -67,24 +62,36 @@ bool MelonRenderer::Camera::Tick(GLFWwindow* glfwWindow)
 	m_cameraDirection = glm::normalize(m_cameraDirection);
 	ImGui::End();
 
+	m_cameraMatrices.previousViewProjection = m_cameraMatrices.projection * m_cameraMatrices.view;
+
 	//https://learnopengl.com/Getting-started/Camera
 	vec3 cameraUp = glm::cross(glm::normalize(glm::cross(m_cameraDirection, worldUp)), m_cameraDirection);
 
+	//filled by the key callback on the main thread, glfwGetKey may only be called there
+	const ImGuiIO& io = ImGui::GetIO();
 	const float cameraSpeed = 0.05f; // adjust accordingly
-	if (glfwGetKey(glfwWindow, GLFW_KEY_W) == GLFW_PRESS)
+	if (io.KeysDown[GLFW_KEY_W])
 		m_cameraPosition += cameraSpeed * m_cameraDirection;
-	if (glfwGetKey(glfwWindow, GLFW_KEY_S) == GLFW_PRESS)
+	if (io.KeysDown[GLFW_KEY_S])
 		m_cameraPosition -= cameraSpeed * m_cameraDirection;
-	if (glfwGetKey(glfwWindow, GLFW_KEY_A) == GLFW_PRESS)
+	if (io.KeysDown[GLFW_KEY_A])
 		m_cameraPosition -= glm::normalize(glm::cross(m_cameraDirection, cameraUp)) * cameraSpeed;
-	if (glfwGetKey(glfwWindow, GLFW_KEY_D) == GLFW_PRESS)
+	if (io.KeysDown[GLFW_KEY_D])
 		m_cameraPosition += glm::normalize(glm::cross(m_cameraDirection, cameraUp)) * cameraSpeed;
 
 
 	m_cameraMatrices.view = glm::lookAt(m_cameraPosition, m_cameraPosition + m_cameraDirection, cameraUp); 
 	m_cameraMatrices.viewInverse = glm::inverse(m_cameraMatrices.view);
-	
-	if (!m_memoryManager->CopyDataToMemory(m_uniformBufferMemory, &m_cameraMatrices, sizeof(m_cameraMatrices)))
+
+	return true;
+}
+
+bool MelonRenderer::Camera::Upload(const CameraMatrices& cameraMatrices, uint32_t frame)
+{
+	m_frameMatrices = cameraMatrices;
+
+	memcpy(static_cast<uint8_t*>(m_uniformBuffer.m_uploadBuffer) + frame * m_uniformBuffer.m_alignment, &cameraMatrices, sizeof(CameraMatrices));
+	if (!m_memoryManager->UpdateDynamicUBO(m_uniformBuffer, { frame }))
 	{
 		Logger::Log("Could not copy camera data to uniform buffer.");
 		return false;
@@ -93,7 +100,24 @@ bool MelonRenderer::Camera::Tick(GLFWwindow* glfwWindow)
 	return true;
 }
 
-VkDescriptorBufferInfo* MelonRenderer::Camera::GetCameraDescriptor()
+VkDescriptorBufferInfo MelonRenderer::Camera::GetCameraDescriptor(uint32_t frame) const
+{
+	VkDescriptorBufferInfo descriptor = m_uniformBuffer.m_descriptorBufferInfo;
+	descriptor.offset = GetDynamicOffset(frame);
+	return descriptor;
+}
+
+uint32_t MelonRenderer::Camera::GetDynamicOffset(uint32_t frame) const
+{
+	return static_cast<uint32_t>(frame * m_uniformBuffer.m_alignment);
+}
+
+const MelonRenderer::CameraMatrices& MelonRenderer::Camera::GetCameraMatrices() const
+{
+	return m_cameraMatrices;
+}
+
+const MelonRenderer::CameraMatrices& MelonRenderer::Camera::GetFrameMatrices() const
 {
-	return &m_uniformBufferDescriptor;
+	return m_frameMatrices;
 }
@@ -2,6 +2,7 @@
 
 #include "Basics.h"
 #include "DeviceMemoryManager.h"
+#include "Swapchain.h"
 #include "imgui/imgui.h"
 #include <glfw3.h>
 
@@ -13,27 +14,38 @@ namespace MelonRenderer
 		mat4 projection;
 		mat4 viewInverse;
 		mat4 projectionInverse;
+		mat4 previousViewProjection; //for motion vectors
 	};
 
 	class Camera
 	{
 	public:
 		bool Init(DeviceMemoryManager& memoryManager);
+		//uploads the matrices for every frame slot
 		bool Tick(CameraMatrices& cameraMatrices);
-		bool Tick(GLFWwindow* glfwWindow);
-
-		VkDescriptorBufferInfo* GetCameraDescriptor();
+		//moves the camera by the keys ImGui was given, so it does not have to run on the main thread, the matrices are only uploaded by Upload
+		bool Tick();
+		//sets the matrices the frame's culling uses and copies them to the frame's part of the uniform buffer, which no submitted frame may read anymore
+		bool Upload(const CameraMatrices& cameraMatrices, uint32_t frame);
+
+		//one frame's matrices, either at the frame's offset or bound as a dynamic uniform buffer with GetDynamicOffset
+		VkDescriptorBufferInfo GetCameraDescriptor(uint32_t frame) const;
+		uint32_t GetDynamicOffset(uint32_t frame) const;
+		//moved by Tick
+		const CameraMatrices& GetCameraMatrices() const;
+		//of the last Upload
+		const CameraMatrices& GetFrameMatrices() const;
 
 	protected:
 
 		CameraMatrices m_cameraMatrices;
+		CameraMatrices m_frameMatrices;
 		const vec3 worldUp = glm::vec3(0.0f, -1.0f, 0.0f);
 		vec3 m_cameraPosition = vec3(33.f, 34.f, 33.f);
 		vec3 m_cameraDirection;
 
-		VkBuffer m_uniformBuffer;
-		VkDeviceMemory m_uniformBufferMemory;
-		VkDescriptorBufferInfo m_uniformBufferDescriptor;
+		//one element per frame in flight
+		DynamicUniformBuffer m_uniformBuffer;
 
 		DeviceMemoryManager* m_memoryManager;
 	};
@@ -4,8 +4,10 @@
 
 namespace MelonRenderer
 {
-	bool DeviceMemoryManager::Init(VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, VkPhysicalDeviceProperties& physicalDeviceProperties)
+	bool DeviceMemoryManager::Init(VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, VkPhysicalDeviceProperties& physicalDeviceProperties, bool raytracingSupport)
 	{
+		m_raytracingSupport = raytracingSupport;
+
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		cmdPoolInfo.pNext = NULL;
@@ -57,6 +59,22 @@ namespace MelonRenderer
 		return true;
 	}
 
+	bool DeviceMemoryManager::CopyDataFromMemory(VkDeviceMemory& memory, void* data, VkDeviceSize dataSize) const
+	{
+		void* mappedData;
+		VkResult result = vkMapMemory(Device::Get().m_device, memory, 0, dataSize, 0, (void**)&mappedData);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not map memory for reading.");
+			return false;
+		}
+		memcpy(data, mappedData, dataSize);
+
+		vkUnmapMemory(Device::Get().m_device, memory);
+
+		return true;
+	}
+
 	bool DeviceMemoryManager::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) const
 	{
 		VkBufferCreateInfo bufferInfo = {};
@@ -74,8 +92,14 @@ namespace MelonRenderer
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(Device::Get().m_device, buffer, &memRequirements);
 
+		//buffers used through device addresses need their memory allocated with the matching flag
+		VkMemoryAllocateFlagsInfo allocFlagsInfo = {};
+		allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+		allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
 		VkMemoryAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.pNext = (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? &allocFlagsInfo : nullptr;
 		allocInfo.allocationSize = memRequirements.size;
 		FindMemoryTypeFromProperties(memRequirements.memoryTypeBits, properties, &allocInfo.memoryTypeIndex);
 
@@ -95,6 +119,23 @@ namespace MelonRenderer
 		return true;
 	}
 
+	VkDeviceAddress DeviceMemoryManager::GetBufferDeviceAddress(VkBuffer buffer) const
+	{
+		VkBufferDeviceAddressInfo addressInfo = {};
+		addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = buffer;
+
+		return vkGetBufferDeviceAddress(Device::Get().m_device, &addressInfo);
+	}
+
+	VkBufferUsageFlags DeviceMemoryManager::GetAccelerationStructureInputUsage() const
+	{
+		if (!m_raytracingSupport)
+			return 0;
+
+		return VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	}
+
 	bool DeviceMemoryManager::CreateOptimalBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory, const void* data, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage) const
 	{
 		if (!CreateBuffer(bufferSize, bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -138,8 +179,68 @@ namespace MelonRenderer
 
 		CopyStagingBufferToBuffer(stagingBuffer, buffer, bufferSize);
 
-		vkDestroyBuffer(Device::Get().m_device, stagingBuffer, nullptr);
-		vkFreeMemory(Device::Get().m_device, stagingBufferMemory, nullptr);
+		DestroyStagingBuffer(stagingBuffer, stagingBufferMemory);
+
+		return true;
+	}
+
+	bool DeviceMemoryManager::UpdateOptimalBuffer(VkBuffer& buffer, const void* data, VkDeviceSize elementSize, const std::vector<uint32_t>& elements) const
+	{
+		if (elements.empty())
+			return true;
+
+		VkDeviceSize stagingSize = elements.size() * elementSize;
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		if (!CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingBufferMemory))
+		{
+			Logger::Log("Could not create staging buffer.");
+			return false;
+		}
+
+		char* pData;
+		VkResult result = vkMapMemory(Device::Get().m_device, stagingBufferMemory, 0, stagingSize, 0, (void**)&pData);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not bind staging buffer to memory.");
+			return false;
+		}
+
+		//consecutive elements are packed into one copy region
+		std::vector<VkBufferCopy> copyRegions;
+		VkDeviceSize stagingOffset = 0;
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			VkDeviceSize offset = elements[i] * elementSize;
+			memcpy(pData + stagingOffset, static_cast<const char*>(data) + offset, elementSize);
+			if (i && elements[i] == elements[i - 1] + 1)
+			{
+				copyRegions.back().size += elementSize;
+			}
+			else
+			{
+				VkBufferCopy copyRegion = {};
+				copyRegion.srcOffset = stagingOffset;
+				copyRegion.dstOffset = offset;
+				copyRegion.size = elementSize;
+				copyRegions.emplace_back(copyRegion);
+			}
+			stagingOffset += elementSize;
+		}
+
+		vkUnmapMemory(Device::Get().m_device, stagingBufferMemory);
+
+		VkCommandBuffer copyCommandBuffer;
+		if (!CreateSingleUseCommand(copyCommandBuffer))
+		{
+			Logger::Log("Could not wait for idle queue for copying staging buffer.");
+			return false;
+		}
+		vkCmdCopyBuffer(copyCommandBuffer, stagingBuffer, buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		EndSingleUseCommand(copyCommandBuffer);
+
+		DestroyStagingBuffer(stagingBuffer, stagingBufferMemory);
 
 		return true;
 	}
@@ -154,14 +255,14 @@ namespace MelonRenderer
 		return m_textureIDs[fileName];
 	}
 
-	bool DeviceMemoryManager::CreateImage(VkImage& image, VkDeviceMemory& imageMemory, VkExtent2D& extent, VkImageUsageFlags usage)
+	bool DeviceMemoryManager::CreateImage(VkImage& image, VkDeviceMemory& imageMemory, VkExtent2D& extent, VkImageUsageFlags usage, VkFormat format)
 	{
 		VkImageCreateInfo imageInfo = {};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.pNext = nullptr;
 		imageInfo.flags = 0;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageInfo.format = format;
 		imageInfo.extent.width = static_cast<uint32_t>(extent.width);
 		imageInfo.extent.height = static_cast<uint32_t>(extent.height);
 		imageInfo.extent.depth = 1;
@@ -280,13 +381,12 @@ namespace MelonRenderer
 			return false;
 		}
 
-		vkDestroyBuffer(Device::Get().m_device, stagingBuffer, nullptr);
-		vkFreeMemory(Device::Get().m_device, stagingBufferMemory, nullptr);
+		DestroyStagingBuffer(stagingBuffer, stagingBufferMemory);
 
 		return true;
 	}
 
-	bool DeviceMemoryManager::CreateImageView(VkImageView& imageView, VkImage image)
+	bool DeviceMemoryManager::CreateImageView(VkImageView& imageView, VkImage image, VkFormat format)
 	{
 		VkImageViewCreateInfo viewInfo = {};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -294,7 +394,7 @@ namespace MelonRenderer
 		viewInfo.flags = 0;
 		viewInfo.image = image;
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
 		viewInfo.subresourceRange.levelCount = 1;
@@ -313,20 +413,43 @@ namespace MelonRenderer
 
 	bool DeviceMemoryManager::CreateTexture(const char* fileName)
 	{
-		Texture texture;
-
-		std::string path = "textures/";
-		path += fileName;
-
-		int width, height, channels;
-		unsigned char* pixelData = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-		if (pixelData == nullptr)
+		DecodedTexture decodedTexture;
+		if (!DecodeTexture(fileName, decodedTexture))
 		{
 			Logger::Log("Could not load texture from file path.");
 			return false;
 		}
 
-		if (!CreateTextureImage(texture.m_textureImage, texture.m_textureMemory, pixelData, width, height))
+		return CreateTexture(decodedTexture);
+	}
+
+	bool DeviceMemoryManager::DecodeTexture(const char* fileName, DecodedTexture& decodedTexture)
+	{
+		decodedTexture.m_fileName = fileName;
+
+		std::string path = "textures/";
+		path += fileName;
+
+		int channels;
+		decodedTexture.m_pixelData = stbi_load(path.c_str(), &decodedTexture.m_width, &decodedTexture.m_height, &channels, STBI_rgb_alpha);
+
+		return decodedTexture.m_pixelData != nullptr;
+	}
+
+	void DeviceMemoryManager::FreeDecodedTexture(DecodedTexture& decodedTexture)
+	{
+		if (decodedTexture.m_pixelData != nullptr)
+			stbi_image_free(decodedTexture.m_pixelData);
+		decodedTexture.m_pixelData = nullptr;
+	}
+
+	bool DeviceMemoryManager::CreateTexture(DecodedTexture& decodedTexture)
+	{
+		Texture texture;
+
+		unsigned char* pixelData = decodedTexture.m_pixelData;
+		decodedTexture.m_pixelData = nullptr;
+		if (!CreateTextureImage(texture.m_textureImage, texture.m_textureMemory, pixelData, decodedTexture.m_width, decodedTexture.m_height))
 		{
 			Logger::Log("Could not create texture image and memory.");
 			return false;
@@ -345,7 +468,7 @@ namespace MelonRenderer
 		textureInfo.imageView = texture.m_textureImageView;
 		m_textureInfos.emplace_back(textureInfo);
 		m_textures.emplace_back(texture);
-		m_textureIDs.emplace(fileName, m_textures.size()-1);
+		m_textureIDs.emplace(decodedTexture.m_fileName, m_textures.size()-1);
 
 		return true;
 	}
@@ -533,6 +656,61 @@ namespace MelonRenderer
 		return true;
 	}
 
+	bool DeviceMemoryManager::ReadImage(VkImage image, VkExtent2D extent, VkDeviceSize pixelSize, void* data) const
+	{
+		vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+
+		VkDeviceSize imageSize = extent.width * extent.height * pixelSize;
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackBufferMemory;
+		if (!CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			readbackBuffer, readbackBufferMemory))
+		{
+			Logger::Log("Could not create readback buffer for image.");
+			return false;
+		}
+
+		VkCommandBuffer copyCmdBuffer;
+		if (!CreateSingleUseCommand(copyCmdBuffer))
+		{
+			Logger::Log("Could not create single use cmd buffer for reading an image.");
+			return false;
+		}
+
+		VkMemoryBarrier memoryBarrier;
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.pNext = nullptr;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(copyCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &memoryBarrier, 0, 0, 0, 0);
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(copyCmdBuffer, image, VK_IMAGE_LAYOUT_GENERAL, readbackBuffer, 1, &region);
+
+		if (!EndSingleUseCommand(copyCmdBuffer))
+		{
+			Logger::Log("Could not end single use cmd buffer for reading an image.");
+			return false;
+		}
+
+		bool success = CopyDataFromMemory(readbackBufferMemory, data, imageSize);
+
+		vkDestroyBuffer(Device::Get().m_device, readbackBuffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, readbackBufferMemory, nullptr);
+
+		return success;
+	}
+
 	bool DeviceMemoryManager::CopyStagingBufferToBuffer(VkBuffer cpuVisibleBuffer, VkBuffer gpuOnlyBuffer, VkDeviceSize size) const
 	{
 		VkCommandBuffer copyCommandBuffer;
@@ -556,6 +734,12 @@ namespace MelonRenderer
 
 	bool DeviceMemoryManager::CreateSingleUseCommand(VkCommandBuffer& commandBuffer) const
 	{
+		if (m_uploadBatchCommandBuffer != VK_NULL_HANDLE)
+		{
+			commandBuffer = m_uploadBatchCommandBuffer;
+			return true;
+		}
+
 		VkCommandBufferAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.pNext = nullptr;
@@ -586,6 +770,10 @@ namespace MelonRenderer
 
 	bool DeviceMemoryManager::EndSingleUseCommand(VkCommandBuffer& commandBuffer) const
 	{
+		//submitted by EndUploadBatch
+		if (commandBuffer == m_uploadBatchCommandBuffer)
+			return true;
+
 		VkResult result = vkEndCommandBuffer(commandBuffer);
 		if (result != VK_SUCCESS)
 		{
@@ -621,6 +809,46 @@ namespace MelonRenderer
 		return true;
 	}
 
+	bool DeviceMemoryManager::BeginUploadBatch()
+	{
+		VkCommandBuffer commandBuffer;
+		if (!CreateSingleUseCommand(commandBuffer))
+		{
+			Logger::Log("Could not create command buffer for upload batch.");
+			return false;
+		}
+		m_uploadBatchCommandBuffer = commandBuffer;
+
+		return true;
+	}
+
+	bool DeviceMemoryManager::EndUploadBatch()
+	{
+		VkCommandBuffer commandBuffer = m_uploadBatchCommandBuffer;
+		m_uploadBatchCommandBuffer = VK_NULL_HANDLE;
+		bool success = EndSingleUseCommand(commandBuffer);
+
+		for (const std::pair<VkBuffer, VkDeviceMemory>& stagingBuffer : m_uploadBatchStagingBuffers)
+		{
+			DestroyStagingBuffer(stagingBuffer.first, stagingBuffer.second);
+		}
+		m_uploadBatchStagingBuffers.clear();
+
+		return success;
+	}
+
+	void DeviceMemoryManager::DestroyStagingBuffer(VkBuffer buffer, VkDeviceMemory bufferMemory) const
+	{
+		if (m_uploadBatchCommandBuffer != VK_NULL_HANDLE)
+		{
+			m_uploadBatchStagingBuffers.emplace_back(buffer, bufferMemory);
+			return;
+		}
+
+		vkDestroyBuffer(Device::Get().m_device, buffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, bufferMemory, nullptr);
+	}
+
 	//helper function from Vulkan Samples
 	bool DeviceMemoryManager::FindMemoryTypeFromProperties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex) const
 	{
@@ -637,10 +865,19 @@ namespace MelonRenderer
 		// No memory types matched, return failure
 		return false;
 	}
+	const VkPhysicalDeviceProperties& DeviceMemoryManager::GetPhysicalDeviceProperties() const
+	{
+		return m_physicalDeviceProperties;
+	}
+
 	uint32_t DeviceMemoryManager::GetNumberTextures()
 	{
 		return static_cast<uint32_t>(m_textures.size());
 	}
+	const std::unordered_map<std::string, uint32_t>& DeviceMemoryManager::GetTextureIDs() const
+	{
+		return m_textureIDs;
+	}
 	VkDescriptorImageInfo* DeviceMemoryManager::GetDescriptorImageInfo()
 	{
 		return m_textureInfos.data();
@@ -665,9 +902,7 @@ namespace MelonRenderer
 			return false;
 		}
 
-		dynamicUniformBuffer.m_uploadBuffer = malloc(dynamicUniformBuffer.m_size);
-
-		//keep this buffer mapped to speed up updates
+		//keep this buffer mapped to speed up updates, the mapping is the upload buffer
 		VkResult result = vkMapMemory(Device::Get().m_device, dynamicUniformBuffer.m_bufferMemory, 0, 
 			dynamicUniformBuffer.m_size, 0, &dynamicUniformBuffer.m_uploadBuffer);
 		if (result != VK_SUCCESS)
@@ -678,7 +913,8 @@ namespace MelonRenderer
 
 		dynamicUniformBuffer.m_descriptorBufferInfo.buffer = dynamicUniformBuffer.m_buffer;
 		dynamicUniformBuffer.m_descriptorBufferInfo.offset = 0;
-		dynamicUniformBuffer.m_descriptorBufferInfo.range = VK_WHOLE_SIZE;
+		//a dynamic descriptor sees one element at its offset, the whole buffer would run past its end and exceed maxUniformBufferRange
+		dynamicUniformBuffer.m_descriptorBufferInfo.range = dynamicUniformBuffer.m_alignment;
 
 		return true;
 	}
@@ -701,4 +937,46 @@ namespace MelonRenderer
 
 		return true;
 	}
+
+	bool DeviceMemoryManager::UpdateDynamicUBO(DynamicUniformBuffer& dynamicUniformBuffer, const std::vector<uint32_t>& elements)
+	{
+		if (elements.empty())
+			return true;
+
+		//ranges have to be multiples of nonCoherentAtomSize, unless they end with the memory
+		const VkDeviceSize atomSize = m_physicalDeviceProperties.limits.nonCoherentAtomSize;
+		std::vector<VkMappedMemoryRange> memoryRanges;
+		for (uint32_t element : elements)
+		{
+			VkDeviceSize begin = element * dynamicUniformBuffer.m_alignment;
+			begin -= begin % atomSize;
+			VkDeviceSize end = (element + 1) * dynamicUniformBuffer.m_alignment;
+			end = (end + atomSize - 1) / atomSize * atomSize;
+
+			if (!memoryRanges.empty() && begin <= memoryRanges.back().offset + memoryRanges.back().size)
+			{
+				memoryRanges.back().size = end - memoryRanges.back().offset;
+				continue;
+			}
+
+			VkMappedMemoryRange memoryRange = {};
+			memoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			memoryRange.pNext = nullptr;
+			memoryRange.memory = dynamicUniformBuffer.m_bufferMemory;
+			memoryRange.offset = begin;
+			memoryRange.size = end - begin;
+			memoryRanges.emplace_back(memoryRange);
+		}
+		if (memoryRanges.back().offset + memoryRanges.back().size > dynamicUniformBuffer.m_size)
+			memoryRanges.back().size = VK_WHOLE_SIZE;
+
+		VkResult result = vkFlushMappedMemoryRanges(Device::Get().m_device, static_cast<uint32_t>(memoryRanges.size()), memoryRanges.data());
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not flush memory ranges for dynamic transform matrices.");
+			return false;
+		}
+
+		return true;
+	}
 }
\ No newline at end of file
@@ -8,6 +8,11 @@
 
 namespace MelonRenderer
 {
+	inline VkDeviceSize AlignUp(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
 	struct DynamicUniformBuffer
 	{
 		VkBuffer m_buffer = VK_NULL_HANDLE;
@@ -19,6 +24,22 @@ namespace MelonRenderer
 		void* m_uploadBuffer = nullptr;
 	};
 
+	//a buffer replaced while frames in flight may still read it, destroyed by its owner once they finished
+	struct RetiredBuffer
+	{
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_bufferMemory = VK_NULL_HANDLE;
+	};
+
+	//pixels of a texture file, decoded on any thread and handed to CreateTexture on the loading thread, which frees them
+	struct DecodedTexture
+	{
+		std::string m_fileName;
+		unsigned char* m_pixelData = nullptr;
+		int m_width = 0;
+		int m_height = 0;
+	};
+
 
 	class DeviceMemoryManager
 	{
@@ -33,38 +54,68 @@ namespace MelonRenderer
 		VkPhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties;
 		VkPhysicalDeviceProperties m_physicalDeviceProperties;
 
+		bool m_raytracingSupport = false;
+
+		//while an upload batch is open, single use commands record into one command buffer and staging buffers are kept until it finished
+		mutable VkCommandBuffer m_uploadBatchCommandBuffer = VK_NULL_HANDLE;
+		mutable std::vector<std::pair<VkBuffer, VkDeviceMemory>> m_uploadBatchStagingBuffers;
+
+		void DestroyStagingBuffer(VkBuffer buffer, VkDeviceMemory bufferMemory) const;
+
 	public:
-		bool Init(VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, VkPhysicalDeviceProperties& physicalDeviceProperties);
+		bool Init(VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, VkPhysicalDeviceProperties& physicalDeviceProperties, bool raytracingSupport = false);
 		~DeviceMemoryManager();
 
 		bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) const;
 		bool CreateOptimalBuffer(VkBuffer& buffer, VkDeviceMemory& bufferMemory, const void* data, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage) const;
 		bool UpdateOptimalBuffer(VkBuffer& buffer, const void* data, VkDeviceSize bufferSize) const;
+		//copies only the given elements of data, sorted ascending, through one staging buffer
+		bool UpdateOptimalBuffer(VkBuffer& buffer, const void* data, VkDeviceSize elementSize, const std::vector<uint32_t>& elements) const;
 		bool CopyDataToMemory(VkDeviceMemory& memory, void* data, VkDeviceSize dataSize) const;
+		bool CopyDataFromMemory(VkDeviceMemory& memory, void* data, VkDeviceSize dataSize) const;
+		VkDeviceAddress GetBufferDeviceAddress(VkBuffer buffer) const;
+		//usage flags needed for geometry buffers that are read by acceleration structure builds, 0 without raytracing support
+		VkBufferUsageFlags GetAccelerationStructureInputUsage() const;
 
 		uint32_t CreateTextureID(const char* fileName);
-		bool CreateImage(VkImage& image, VkDeviceMemory& imageMemory, VkExtent2D& extent, VkImageUsageFlags usage);
-		bool CreateImageView(VkImageView& imageView, VkImage image);
+		bool CreateImage(VkImage& image, VkDeviceMemory& imageMemory, VkExtent2D& extent, VkImageUsageFlags usage, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+		bool CreateImageView(VkImageView& imageView, VkImage image, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
 		bool CreateTextureImage(VkImage& texture, VkDeviceMemory& textureMemory, unsigned char* pixelData, int width, int height);
 		bool CreateTexture(const char* fileName);
+		//thread safe, no textures are created
+		static bool DecodeTexture(const char* fileName, DecodedTexture& decodedTexture);
+		bool CreateTexture(DecodedTexture& decodedTexture);
+		//for pixels that are not handed to CreateTexture
+		static void FreeDecodedTexture(DecodedTexture& decodedTexture);
 		bool CreateTextureSampler();
 		bool TransitionImageLayout(VkCommandBuffer& commandBuffer, VkImage image, VkImageLayout previousLayout, VkImageLayout desiredLayout, 
 			VkPipelineStageFlags srcStageFlags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkPipelineStageFlags dstStageFlags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 		
 		bool CopyStagingBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const;
+		//waits for the queue, image has to be in general layout and created with transfer src usage
+		bool ReadImage(VkImage image, VkExtent2D extent, VkDeviceSize pixelSize, void* data) const;
 		bool CopyStagingBufferToBuffer(VkBuffer cpuVisibleBuffer, VkBuffer gpuOnlyBuffer, VkDeviceSize size) const;
 
 		bool CreateSingleUseCommand(VkCommandBuffer& commandBuffer) const;
 		bool EndSingleUseCommand(VkCommandBuffer& commandBuffer) const;
+		//buffer and texture uploads until EndUploadBatch are submitted together and waited for once,
+		//nothing may read back or use the uploaded data before
+		bool BeginUploadBatch();
+		bool EndUploadBatch();
 
 		bool FindMemoryTypeFromProperties(uint32_t typeBits, VkFlags requirements_mask, uint32_t* typeIndex) const;
 
+		const VkPhysicalDeviceProperties& GetPhysicalDeviceProperties() const;
 		uint32_t GetNumberTextures();
+		//file names in the textures folder by texture id
+		const std::unordered_map<std::string, uint32_t>& GetTextureIDs() const;
 		VkDescriptorImageInfo* GetDescriptorImageInfo();
 
 		//TODO: finish rework
 		bool CreateDynamicUBO(DynamicUniformBuffer& dynamicUniformBuffer);
 		bool UpdateDynamicUBO(DynamicUniformBuffer& dynamicUniformBuffer);
+		//flushes only the given elements, sorted ascending, neighbouring elements are flushed as one range
+		bool UpdateDynamicUBO(DynamicUniformBuffer& dynamicUniformBuffer, const std::vector<uint32_t>& elements);
 	};
 
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <tiny_obj_loader.h>
 
 namespace MelonRenderer {
-	bool Drawable::LoadMeshData(DeviceMemoryManager& memoryManager, const std::string& path)
+	bool Drawable::LoadMeshData(const std::string& path, std::string& log)
 	{
+		m_path = path;
+
 		tinyobj::attrib_t attributes;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -12,7 +14,7 @@ namespace MelonRenderer {
 
 		if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warnings, &errors, path.c_str(), "models/")) 
 		{
-			Logger::Log(warnings + errors);
+			log = warnings + errors;
 			//return false;
 		}
 
@@ -33,12 +35,11 @@ namespace MelonRenderer {
 
 				if (materials[i].diffuse_texname.empty())
 				{
- 					material.textureId = memoryManager.CreateTextureID("textureDefault.jpg");
+					m_textureNames.emplace_back("textureDefault.jpg");
 				}
 				else
 				{
-					//lookup if texture already exists, create if not, return texture id
-					material.textureId = memoryManager.CreateTextureID(materials[i].diffuse_texname.c_str());
+					m_textureNames.emplace_back(materials[i].diffuse_texname);
 				}
 
 				m_materials.emplace_back(material);
@@ -48,8 +49,8 @@ namespace MelonRenderer {
 		{
 			//default material
 			WaveFrontMaterial material = {};
-			material.textureId = memoryManager.CreateTextureID("textureDefault.jpg");
 			m_materials.emplace_back(material);
+			m_textureNames.emplace_back("textureDefault.jpg");
 		}
 
 		//to make use of indices, we need to ignore duplicates
@@ -132,48 +133,62 @@ namespace MelonRenderer {
 		return true;
 	}
 
-	bool Drawable::Init(DeviceMemoryManager& memoryManager)
+	void Drawable::LoadCubeData()
 	{
-		uint32_t vertexBufferSize = sizeof(cube_vertex_data);
-		if (!memoryManager.CreateOptimalBuffer(m_vertexBuffer, m_vertexBufferMemory, cube_vertex_data, vertexBufferSize, 
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
-		{
-			Logger::Log("Could not create vertex buffer.");
-			return false;
-		}
+		m_vertices.assign(cube_vertex_data, cube_vertex_data + sizeof(cube_vertex_data) / sizeof(Vertex));
+		m_indices.assign(cube_index_data, cube_index_data + sizeof(cube_index_data) / sizeof(uint32_t));
 
-		uint32_t indexBufferSize = sizeof(cube_index_data);
-		if (!memoryManager.CreateOptimalBuffer(m_indexBuffer, m_indexBufferMemory, cube_index_data, indexBufferSize, 
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
-		{
-			Logger::Log("Could not create index buffer.");
-			return false;
-		}
-
-		//default cube material
+		//default cube material, keeps texture 0
 		WaveFrontMaterial material = {};
 		m_materials.emplace_back(material);
-		uint32_t materialBuffersize = m_materials.size() * sizeof(WaveFrontMaterial);
-		if (!memoryManager.CreateOptimalBuffer(m_materialBuffer, m_materialBufferMemory, m_materials.data(), materialBuffersize,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		m_textureNames.emplace_back();
+	}
+
+	bool Drawable::Upload(DeviceMemoryManager& memoryManager)
+	{
+		for (size_t i = 0; i < m_materials.size(); i++)
 		{
-			Logger::Log("Could not create material buffer.");
-			return false;
+			//lookup if texture already exists, create if not, return texture id
+			if (!m_textureNames[i].empty())
+				m_materials[i].textureId = memoryManager.CreateTextureID(m_textureNames[i].c_str());
 		}
 
-		m_vertexCount = sizeof(cube_vertex_data) / sizeof(Vertex);
-		m_indexCount = sizeof(cube_index_data) / sizeof(uint32_t);
+		return CreateBuffers(memoryManager);
+	}
 
-		return true;
+	bool Drawable::Init(DeviceMemoryManager& memoryManager)
+	{
+		LoadCubeData();
+
+		return Upload(memoryManager);
 	}
 
 	bool Drawable::Init(DeviceMemoryManager& memoryManager, const std::string& path)
 	{
-		LoadMeshData(memoryManager, path);
+		std::string log;
+		LoadMeshData(path, log);
+		if (!log.empty())
+			Logger::Log(log);
+
+		return Upload(memoryManager);
+	}
+
+	bool Drawable::Init(DeviceMemoryManager& memoryManager, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const WaveFrontMaterial* materials, const std::vector<std::string>& textureNames)
+	{
+		m_vertices.assign(vertices, vertices + vertexCount);
+		m_indices.assign(indices, indices + indexCount);
+		m_materials.assign(materials, materials + textureNames.size());
+		m_textureNames = textureNames;
+
+		return Upload(memoryManager);
+	}
 
+	bool Drawable::CreateBuffers(DeviceMemoryManager& memoryManager)
+	{
 		uint32_t vertexBufferSize = sizeof(Vertex) * m_vertices.size();
 		if (!memoryManager.CreateOptimalBuffer(m_vertexBuffer, m_vertexBufferMemory, m_vertices.data(), vertexBufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | memoryManager.GetAccelerationStructureInputUsage()))
 		{
 			Logger::Log("Could not create vertex buffer.");
 			return false;
@@ -181,7 +196,7 @@ namespace MelonRenderer {
 
 		uint32_t indexBufferSize = sizeof(uint32_t) * m_indices.size();
 		if (!memoryManager.CreateOptimalBuffer(m_indexBuffer, m_indexBufferMemory, m_indices.data(), indexBufferSize,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | memoryManager.GetAccelerationStructureInputUsage()))
 		{
 			Logger::Log("Could not create index buffer.");
 			return false;
@@ -198,9 +213,44 @@ namespace MelonRenderer {
 		m_vertexCount = m_vertices.size();
 		m_indexCount = m_indices.size();
 
+		for (const auto& vertex : m_vertices)
+		{
+			m_boundingBox.Expand(vec3(vertex.posX, vertex.posY, vertex.posZ));
+		}
+
 		return true;
 	}
 
+	const AABB& Drawable::GetBoundingBox() const
+	{
+		return m_boundingBox;
+	}
+
+	const std::vector<Vertex>& Drawable::GetVertices() const
+	{
+		return m_vertices;
+	}
+
+	const std::vector<uint32_t>& Drawable::GetIndices() const
+	{
+		return m_indices;
+	}
+
+	const std::vector<WaveFrontMaterial>& Drawable::GetMaterials() const
+	{
+		return m_materials;
+	}
+
+	const std::vector<std::string>& Drawable::GetTextureNames() const
+	{
+		return m_textureNames;
+	}
+
+	const std::string& Drawable::GetPath() const
+	{
+		return m_path;
+	}
+
 	void Drawable::Fini()
 	{
 		vkFreeMemory(Device::Get().m_device, m_indexBufferMemory, nullptr);
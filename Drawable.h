@@ -11,11 +11,11 @@ namespace MelonRenderer {
 
 	struct DrawableInstance
 	{
-		mat4 m_transformation;
-		mat4 m_transformationInverseTranspose;
+		//normals are transformed with NormalMatrix on the cpu and the cofactor matrix in the shaders
+		AffineTransform m_transformation;
 		uint32_t m_drawableIndex;
 		uint32_t m_textureOffset;
-		//uint8_t alignmentPadding[8];
+		uint32_t m_alignmentPadding[2]; //explicit, vec4 is 16 byte aligned
 	};
 
 	struct WaveFrontMaterial
@@ -35,14 +35,33 @@ namespace MelonRenderer {
 	class Drawable
 	{
 	public:
-		bool LoadMeshData(DeviceMemoryManager& memoryManager, const std::string& path);
+		//cpu work only and thread safe, the log is filled instead of written, textures are resolved by Upload
+		bool LoadMeshData(const std::string& path, std::string& log);
+		void LoadCubeData();
+		//creates the textures not yet known to the memory manager and the buffers
+		bool Upload(DeviceMemoryManager& memoryManager);
 
 		bool Init(DeviceMemoryManager& memoryManager);
 		bool Init(DeviceMemoryManager& memoryManager, const std::string& path);
+		//geometry already in memory, e.g. a mapped scene file, with one texture name per material, an empty name keeps its textureId
+		bool Init(DeviceMemoryManager& memoryManager, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+			const WaveFrontMaterial* materials, const std::vector<std::string>& textureNames);
 		//void Tick(PipelineData& pipelineData);
 		void Fini();
 
+		const AABB& GetBoundingBox() const;
+		//cpu copies of the geometry
+		const std::vector<Vertex>& GetVertices() const;
+		const std::vector<uint32_t>& GetIndices() const;
+		const std::vector<WaveFrontMaterial>& GetMaterials() const;
+		const std::vector<std::string>& GetTextureNames() const;
+		//obj the drawable was loaded from, empty for the cube and geometry from memory
+		const std::string& GetPath() const;
+
 	protected:
+		bool CreateBuffers(DeviceMemoryManager& memoryManager);
+
+		std::string m_path;
 		std::vector<Vertex> m_vertices;
 		VkBuffer m_vertexBuffer;
 		VkDeviceMemory m_vertexBufferMemory;
@@ -54,11 +73,16 @@ namespace MelonRenderer {
 		uint32_t m_indexCount;
 
 		std::vector<WaveFrontMaterial> m_materials;
+		std::vector<std::string> m_textureNames;
 		VkBuffer m_materialBuffer;
 		VkDeviceMemory m_materialBufferMemory;
 
+		AABB m_boundingBox;
+
 		friend class Pipeline;
 		friend class PipelineRasterization;
 		friend class PipelineRaytracing;
+		friend class CpuScene;
+		friend class CpuRaytracer;
 	};
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ namespace MelonRenderer
 	void MelonRenderer::Logger::Log(std::string input)
 	{
 		input.append("\n");
+		std::lock_guard<std::mutex> lock(Get().m_mutex);
 		if (Get().m_modeImmediate)
 			std::cout << input << "\n";
 		else
@@ -20,12 +21,14 @@ namespace MelonRenderer
 
 	void MelonRenderer::Logger::Print()
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 		std::cout << m_log;
-		Clear();
+		m_log = "";
 	}
 
 	void Logger::Clear()
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 		m_log = "";
 	}
 
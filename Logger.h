@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <mutex>
 #include <string>
 
 namespace MelonRenderer
@@ -23,6 +24,8 @@ namespace MelonRenderer
 	private:
 		std::string m_log;
 		bool m_modeImmediate = false;
+		//the simulation logs from the pool while the main thread prints
+		std::mutex m_mutex;
 
 		Logger();
 		~Logger();
@@ -14,8 +14,146 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp>
 
+#include <cfloat>
+
 typedef glm::vec4 vec4;
 typedef glm::vec3 vec3;
 typedef glm::mat4x4 mat4x4;
 typedef glm::mat4 mat4;
-typedef glm::mat3x4 mat3x4;
\ No newline at end of file
+typedef glm::mat3x4 mat3x4;
+
+//affine transform as the first three rows of its matrix, the last one is always 0 0 0 1,
+//the layout of VkTransformMatrixKHR and of mat3x4 in glsl, where vec4(p, 1) * transform transforms a point
+struct AffineTransform
+{
+	vec4 m_rows[3] = { vec4(1.f, 0.f, 0.f, 0.f), vec4(0.f, 1.f, 0.f, 0.f), vec4(0.f, 0.f, 1.f, 0.f) };
+
+	AffineTransform() {}
+	explicit AffineTransform(const mat4& matrix)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			m_rows[row] = vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+		}
+	}
+
+	mat4 ToMat4() const
+	{
+		return glm::transpose(mat4(m_rows[0], m_rows[1], m_rows[2], vec4(0.f, 0.f, 0.f, 1.f)));
+	}
+
+	//the rows as columns, what the raytracing instances expect
+	mat3x4 ToMat3x4() const
+	{
+		return mat3x4(m_rows[0], m_rows[1], m_rows[2]);
+	}
+
+	vec3 TransformPoint(const vec3& point) const
+	{
+		vec4 homogeneous = vec4(point, 1.f);
+		return vec3(glm::dot(m_rows[0], homogeneous), glm::dot(m_rows[1], homogeneous), glm::dot(m_rows[2], homogeneous));
+	}
+
+	vec3 TransformVector(const vec3& vector) const
+	{
+		return vec3(glm::dot(vec3(m_rows[0]), vector), glm::dot(vec3(m_rows[1]), vector), glm::dot(vec3(m_rows[2]), vector));
+	}
+
+	bool operator==(const AffineTransform& other) const
+	{
+		return m_rows[0] == other.m_rows[0] && m_rows[1] == other.m_rows[1] && m_rows[2] == other.m_rows[2];
+	}
+
+	bool operator!=(const AffineTransform& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+//axis aligned bounding box, empty until the first point is added
+struct AABB
+{
+	vec3 m_min = vec3(FLT_MAX);
+	vec3 m_max = vec3(-FLT_MAX);
+
+	void Expand(const vec3& point)
+	{
+		m_min = glm::min(m_min, point);
+		m_max = glm::max(m_max, point);
+	}
+
+	void Expand(const AABB& other)
+	{
+		m_min = glm::min(m_min, other.m_min);
+		m_max = glm::max(m_max, other.m_max);
+	}
+
+	float SurfaceArea() const
+	{
+		if (m_min.x > m_max.x)
+			return 0.f;
+
+		vec3 extent = m_max - m_min;
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	//bounds of the transformed box, not the tightest bounds of the transformed geometry
+	AABB Transform(const mat4& transformation) const
+	{
+		vec3 center = vec3(transformation * vec4((m_min + m_max) * 0.5f, 1.f));
+		vec3 halfExtent = (m_max - m_min) * 0.5f;
+		vec3 transformedHalfExtent = glm::abs(vec3(transformation[0])) * halfExtent.x + glm::abs(vec3(transformation[1])) * halfExtent.y +
+			glm::abs(vec3(transformation[2])) * halfExtent.z;
+
+		AABB transformed;
+		transformed.m_min = center - transformedHalfExtent;
+		transformed.m_max = center + transformedHalfExtent;
+		return transformed;
+	}
+
+	AABB Transform(const AffineTransform& transformation) const
+	{
+		vec3 center = transformation.TransformPoint((m_min + m_max) * 0.5f);
+		vec3 halfExtent = (m_max - m_min) * 0.5f;
+		vec3 transformedHalfExtent = vec3(glm::dot(glm::abs(vec3(transformation.m_rows[0])), halfExtent), glm::dot(glm::abs(vec3(transformation.m_rows[1])), halfExtent),
+			glm::dot(glm::abs(vec3(transformation.m_rows[2])), halfExtent));
+
+		AABB transformed;
+		transformed.m_min = center - transformedHalfExtent;
+		transformed.m_max = center + transformedHalfExtent;
+		return transformed;
+	}
+};
+
+//planes as (normal, distance), pointing inwards, a point p is inside if dot(normal, p) + distance >= 0 for every plane
+struct Frustum
+{
+	vec4 m_planes[6];
+
+	Frustum() {}
+	//from the clip space bounds -w <= x, y <= w and 0 <= z <= w of a vulkan projection
+	explicit Frustum(const mat4& viewProjection)
+	{
+		mat4 rows = glm::transpose(viewProjection);
+		m_planes[0] = rows[3] + rows[0];
+		m_planes[1] = rows[3] - rows[0];
+		m_planes[2] = rows[3] + rows[1];
+		m_planes[3] = rows[3] - rows[1];
+		m_planes[4] = rows[2];
+		m_planes[5] = rows[3] - rows[2];
+	}
+
+	//conservative, boxes near the corners can pass without touching the frustum
+	bool Intersects(const AABB& box) const
+	{
+		vec3 center = (box.m_min + box.m_max) * 0.5f;
+		vec3 halfExtent = (box.m_max - box.m_min) * 0.5f;
+		for (const vec4& plane : m_planes)
+		{
+			vec3 normal = vec3(plane);
+			if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), halfExtent) < 0.f)
+				return false;
+		}
+		return true;
+	}
+};
\ No newline at end of file
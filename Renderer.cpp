@@ -3,11 +3,13 @@
 namespace MelonRenderer
 {
 
-	void MelonRenderer::Renderer::Init()
+	void MelonRenderer::Renderer::Init(bool windowVisible)
 	{
+		m_initStart = std::chrono::steady_clock::now();
+		m_windowVisible = windowVisible;
 		CreateGLFWWindow();
 
-		timeLast = timeNow = std::chrono::high_resolution_clock::now();
+		timeLast = timeNow = m_initStart;
 
 		LoadVulkanLibrary();
 		LoadExportedFunctions();
@@ -35,7 +37,7 @@ namespace MelonRenderer
 		}
 		CreateLogicalDeviceAndQueue(m_physicalDevices[m_currentPhysicalDeviceIndex]);
 
-		m_memoryManager.Init(m_physicalDeviceMemoryProperties, m_currentPhysicalDeviceProperties);
+		m_memoryManager.Init(m_physicalDeviceMemoryProperties, m_currentPhysicalDeviceProperties, m_hasRaytracingCapabilities);
 
 		OutputSurface outputSurface;
 		outputSurface.capabilites = m_currentSurfaceCapabilities;
@@ -53,90 +55,232 @@ namespace MelonRenderer
 		m_rasterizationPipeline.FillRenderpassInfo(m_renderpass);
 		m_imguiPipeline.FillRenderpassInfo(m_renderpass);
 		m_renderpass->CreateRenderpass();
+		const auto sceneStart = std::chrono::steady_clock::now();
+		m_deviceInitMs = std::chrono::duration<float, std::milli>(sceneStart - m_initStart).count();
 
 		//-----------------------------------------
-		Drawable cube, dragon, mirror, bunny, teapot, scene;
-		cube.Init(m_memoryManager);
-		m_scene.m_drawables.emplace_back(cube);
-		dragon.Init(m_memoryManager, "models/dragon.obj");
-		m_scene.m_drawables.emplace_back(dragon);
-		mirror.Init(m_memoryManager, "models/mirror.obj");
-		m_scene.m_drawables.emplace_back(mirror);
-		bunny.Init(m_memoryManager, "models/bunny.obj");
-		m_scene.m_drawables.emplace_back(bunny);
-		teapot.Init(m_memoryManager, "models/teapot.obj");
-		m_scene.m_drawables.emplace_back(teapot); //test if unused geometry causes problems
-		scene.Init(m_memoryManager, "models/scene.obj");
-		m_scene.m_drawables.emplace_back(scene);
+		m_scene.SetThreadPool(m_threadPool);
+		if (m_sceneFile.empty() || !LoadScene(m_scene, m_memoryManager, m_sceneFile))
+			CreateDefaultScene();
+
+		m_scene.UpdateInstanceTransforms();
+		//culls the rasterized instances
+		m_scene.EnableSpatialIndex();
+		//-----------------------------------------
+		const auto pipelineStart = std::chrono::steady_clock::now();
+		m_sceneInitMs = std::chrono::duration<float, std::milli>(pipelineStart - sceneStart).count();
+
+		m_pipelineCache.Init(m_currentPhysicalDeviceProperties, "pipeline_cache.bin", m_threadPool);
+		m_imguiPipeline.SetPipelineCache(&m_pipelineCache);
+		m_rasterizationPipeline.SetPipelineCache(&m_pipelineCache);
+		m_raytracingPipeline.SetPipelineCache(&m_pipelineCache);
+		m_denoiserPipeline.SetPipelineCache(&m_pipelineCache);
+
+		//TODO: move to simple scene graph, when a camera node is constructed
+		m_camera.Init(m_memoryManager);
+		m_imguiPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
+
+		m_rasterizationPipeline.SetScene(&m_scene);
+		m_rasterizationPipeline.SetCamera(&m_camera);
+		m_rasterizationPipeline.SetThreadPool(m_threadPool);
+		m_rasterizationPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
+		m_rasterizationPipeline.FillAttachmentInfo(&m_swapchain);
+
+		m_swapchain.CreateSwapchain(m_physicalDevices[m_currentPhysicalDeviceIndex], m_renderpass->GetVkRenderpass(), outputSurface, m_extent);
+
+
+		if (m_hasRaytracingCapabilities)
+		{
+			m_raytracingPipeline.SetRaytracingProperties(&m_raytracingProperties, &m_accelerationStructureProperties);
+			m_raytracingPipeline.SetScene(&m_scene);
+			m_raytracingPipeline.SetCamera(&m_camera);
+			m_raytracingPipeline.SetGBuffer(m_rasterizationPipeline.GetGBuffer());
+			m_raytracingPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
+
+			m_denoiserPipeline.SetInputs(m_raytracingPipeline.GetOutputs());
+			m_denoiserPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
+		}
+		const auto compileStart = std::chrono::steady_clock::now();
+		CompilePipelines(true);
+		const auto pipelineEnd = std::chrono::steady_clock::now();
+		m_pipelineCompileMs = std::chrono::duration<float, std::milli>(pipelineEnd - compileStart).count();
+		m_pipelineInitMs = std::chrono::duration<float, std::milli>(pipelineEnd - pipelineStart).count();
+		m_pipelineCache.Save();
+		
+		Logger::Log("Loading complete.");
+		Logger::Log("Startup: device " + std::to_string(m_deviceInitMs) + " ms, scene " + std::to_string(m_sceneInitMs) + " ms, pipelines "
+			+ std::to_string(m_pipelineInitMs) + " ms of which " + std::to_string(m_pipelineCompileMs) + " ms compiling with a "
+			+ (m_pipelineCache.IsWarm() ? "warm" : "cold") + " pipeline cache.");
+	}
+
+	bool Renderer::CompilePipelines(bool concurrent)
+	{
+		std::vector<Pipeline*> pipelines = { &m_imguiPipeline, &m_rasterizationPipeline };
+		if (m_hasRaytracingCapabilities)
+		{
+			pipelines.emplace_back(&m_raytracingPipeline);
+			pipelines.emplace_back(&m_denoiserPipeline);
+		}
+
+		//a task per pipeline, whose own compilations are split further on the pool
+		std::atomic<uint32_t> failedPipelines{ 0 };
+		TaskGraph graph;
+		uint32_t previousTask = 0;
+		for (size_t i = 0; i < pipelines.size(); i++)
+		{
+			Pipeline* pipeline = pipelines[i];
+			const uint32_t task = graph.AddTask("compile pipeline", [pipeline, &failedPipelines]()
+				{
+					if (!pipeline->Compile())
+						failedPipelines++;
+				});
+			if (!concurrent && i > 0)
+				graph.AddDependency(previousTask, task);
+			previousTask = task;
+		}
+		m_threadPool.Run(graph);
+
+		if (failedPipelines)
+		{
+			Logger::Log("Could not compile " + std::to_string(failedPipelines) + " pipelines.");
+			return false;
+		}
+
+		return true;
+	}
+
+	AssetManifest Renderer::CreateDefaultManifest() const
+	{
+		AssetManifest manifest;
+		//drawable indices used by CreateDefaultScene
+		manifest.m_meshes = { "", "models/dragon.obj", "models/mirror.obj", "models/bunny.obj",
+			"models/teapot.obj", //test if unused geometry causes problems
+			"models/scene.obj" };
+		return manifest;
+	}
+
+	void Renderer::CreateDefaultScene()
+	{
+		AssetManifest manifest = CreateDefaultManifest();
+		AssetLoadTimings timings;
+		if (!LoadAssets(manifest, m_memoryManager, m_threadPool, m_scene.m_drawables, timings))
+		{
+			Logger::Log("Could not load the default scene's assets.");
+			return;
+		}
+		LogAssetLoadTimings(manifest, timings);
 
 		// random order of models to test correct uploading
+		SceneHierarchy& hierarchy = m_scene.m_hierarchy;
 		m_drawableNodes.resize(7);
 		//scene
-		*m_drawableNodes[0].GetTransformMat() = glm::scale(mat4(1.f), vec3(50.f, 50.f, 50.f));
-		m_drawableNodes[0].SetDrawableInstance(m_scene.CreateDrawableInstance(5, false));
-		m_scene.m_rootChildren.emplace_back(&m_drawableNodes[0]);
+		m_drawableNodes[0] = hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::scale(mat4(1.f), vec3(50.f, 50.f, 50.f)),
+			m_scene.CreateDrawableInstance(5, false));
 		//mirror 1 
-		*m_drawableNodes[1].GetTransformMat() = glm::translate(mat4(1.f), vec3(-40.f, 20.f, -80.f));
-		m_drawableNodes[1].SetDrawableInstance(m_scene.CreateDrawableInstance(2, false));
-		m_scene.m_rootChildren.emplace_back(&m_drawableNodes[1]);
+		m_drawableNodes[1] = hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), vec3(-40.f, 20.f, -80.f)),
+			m_scene.CreateDrawableInstance(2, false));
 		//mirror 2
-		*m_drawableNodes[2].GetTransformMat() = glm::rotate(mat4(1.f), glm::radians(180.f), vec3(0.f, 1.f, 0.f));
-		*m_drawableNodes[2].GetTransformMat() = glm::translate(*m_drawableNodes[2].GetTransformMat(), vec3(-40.f, 20.f, -80.f));
-		m_drawableNodes[2].SetDrawableInstance(m_scene.CreateDrawableInstance(2, false));
-		m_scene.m_rootChildren.emplace_back(&m_drawableNodes[2]);
+		m_drawableNodes[2] = hierarchy.CreateNode(SceneHierarchy::m_noParent,
+			glm::translate(glm::rotate(mat4(1.f), glm::radians(180.f), vec3(0.f, 1.f, 0.f)), vec3(-40.f, 20.f, -80.f)),
+			m_scene.CreateDrawableInstance(2, false));
 		
 		//object node
-		*m_objectNode.GetTransformMat() = glm::translate(mat4(1.f), vec3(-50.f, 10.f, -50.f));
-		*m_objectNode.GetTransformMat() = glm::scale(*m_objectNode.GetTransformMat(), vec3(10.f, 10.f, 10.f));
+		m_objectNode = hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::scale(glm::translate(mat4(1.f), vec3(-50.f, 10.f, -50.f)), vec3(10.f, 10.f, 10.f)));
 		
 		//cube
-		*m_drawableNodes[3].GetTransformMat() = glm::translate(mat4(1.f), vec3(-2.f, 2.f, -2.f));
-		*m_drawableNodes[3].GetTransformMat() = glm::scale(*m_drawableNodes[3].GetTransformMat(), vec3(0.1f, 0.1f, 0.1f));
-		m_drawableNodes[3].SetDrawableInstance(m_scene.CreateDrawableInstance(0, false));
-		m_objectNode.m_children.emplace_back(&m_drawableNodes[3]);
+		m_drawableNodes[3] = hierarchy.CreateNode(m_objectNode, glm::scale(glm::translate(mat4(1.f), vec3(-2.f, 2.f, -2.f)), vec3(0.1f, 0.1f, 0.1f)),
+			m_scene.CreateDrawableInstance(0, false));
 		//bunny
-		*m_drawableNodes[4].GetTransformMat() = glm::translate(mat4(1.f), vec3(-2.f, -2.f, 0.f));
-		*m_drawableNodes[4].GetTransformMat() = glm::scale(*m_drawableNodes[4].GetTransformMat(), vec3(2.f, 2.f, 2.f));
-		m_drawableNodes[4].SetDrawableInstance(m_scene.CreateDrawableInstance(3, false));
-		m_objectNode.m_children.emplace_back(&m_drawableNodes[4]);
+		m_drawableNodes[4] = hierarchy.CreateNode(m_objectNode, glm::scale(glm::translate(mat4(1.f), vec3(-2.f, -2.f, 0.f)), vec3(2.f, 2.f, 2.f)),
+			m_scene.CreateDrawableInstance(3, false));
 		//dragon 1
-		*m_drawableNodes[5].GetTransformMat() = glm::translate(mat4(1.f), vec3(-2.f, -2.f, 0.f));
-		m_drawableNodes[5].SetDrawableInstance(m_scene.CreateDrawableInstance(1, false));
-		m_objectNode.m_children.emplace_back(&m_drawableNodes[5]);
+		m_drawableNodes[5] = hierarchy.CreateNode(m_objectNode, glm::translate(mat4(1.f), vec3(-2.f, -2.f, 0.f)),
+			m_scene.CreateDrawableInstance(1, false));
 		// dragon 2
-		*m_drawableNodes[6].GetTransformMat() = mat4(1.f);
-		m_drawableNodes[6].SetDrawableInstance(m_scene.CreateDrawableInstance(1, false));
-		m_objectNode.m_children.emplace_back(&m_drawableNodes[6]);
+		m_drawableNodes[6] = hierarchy.CreateNode(m_objectNode, mat4(1.f), m_scene.CreateDrawableInstance(1, false));
+	}
 
-		m_scene.m_rootChildren.emplace_back(&m_objectNode);
-		
+	void Renderer::SetSceneFile(const std::string& path)
+	{
+		m_sceneFile = path;
+	}
 
-		m_scene.UpdateInstanceTransforms();
-		//-----------------------------------------
+	bool Renderer::ExportScene(const std::string& path, bool embedGeometry)
+	{
+		return MelonRenderer::ExportScene(m_scene, path, embedGeometry);
+	}
 
-		//TODO: move to simple scene graph, when a camera node is constructed
-		m_camera.Init(m_memoryManager);
-		m_imguiPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
+	bool Renderer::Tick()
+	{
+		if (!m_hasPendingSnapshot)
+		{
+			//without pipelining, input is read once the gpu finished the previous frame
+			if (m_pipelineDepth == 1 && !WaitForSubmittedFrame())
+				return false;
 
-		m_rasterizationPipeline.SetScene(&m_scene);
-		m_rasterizationPipeline.SetCamera(&m_camera);
-		m_rasterizationPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);
-		m_rasterizationPipeline.FillAttachmentInfo(&m_swapchain);
+			CopySimulationState();
+			if (!Simulate(m_snapshots[m_pendingSnapshot]))
+				return false;
+		}
+		const FrameSnapshot& snapshot = m_snapshots[m_pendingSnapshot];
+		m_hasPendingSnapshot = false;
+		if (!PrepareFrame(snapshot))
+			return false;
 
-		m_swapchain.CreateSwapchain(m_physicalDevices[m_currentPhysicalDeviceIndex], m_renderpass->GetVkRenderpass(), outputSurface, m_extent);
+		//the next frame is simulated on the pool while this one is recorded, the snapshot is not touched by it
+		const bool simulateNext = m_pipelineDepth > 1;
+		if (simulateNext)
+		{
+			if (m_simulationGraph.IsEmpty())
+			{
+				m_simulationGraph.AddTask("simulate", [this]()
+					{
+						m_simulationSucceeded = Simulate(m_snapshots[m_pendingSnapshot]);
+					});
+			}
+			CopySimulationState();
+			m_pendingSnapshot = 1 - m_pendingSnapshot;
+			m_threadPool.Submit(m_simulationGraph);
+		}
 
+		bool success = RecordFrame(snapshot);
+		if (simulateNext)
+		{
+			//glfw and the ImGui io are only touched between Ticks
+			m_threadPool.Wait(m_simulationGraph);
+			m_hasPendingSnapshot = m_simulationSucceeded;
+			success = success && m_simulationSucceeded;
+		}
 
-		/*m_raytracingPipeline.SetRaytracingProperties(&m_raytracingProperties);
-		m_raytracingPipeline.SetScene(&m_scene);
-		m_raytracingPipeline.SetCamera(&m_camera);
-		m_raytracingPipeline.Init(m_physicalDevices[m_currentPhysicalDeviceIndex], m_memoryManager, *m_renderpass->GetVkRenderpass(), m_extent);*/
-		
-		Logger::Log("Loading complete.");
+		return success;
 	}
 
-	bool Renderer::Tick()
+	void Renderer::CopySimulationState()
 	{
-		timeNow = std::chrono::high_resolution_clock::now();
+		m_simulationState.m_rasterizationSettings = m_rasterizationPipeline.GetSettings();
+		m_simulationState.m_rasterizationStats = m_rasterizationPipeline.GetStats();
+		if (m_hasRaytracingCapabilities)
+		{
+			m_simulationState.m_raytracingSettings = m_raytracingPipeline.GetSettings();
+			m_simulationState.m_raytracingStats = m_raytracingPipeline.GetStats();
+			m_simulationState.m_denoiserSettings = m_denoiserPipeline.GetSettings();
+			m_simulationState.m_denoiserStats = m_denoiserPipeline.GetStats();
+		}
+		m_simulationState.m_pipelineDepth = m_pipelineDepth;
+		m_simulationState.m_latencyMs = m_latencyMs;
+	}
+
+	bool Renderer::Simulate(FrameSnapshot& snapshot)
+	{
+		ImGui::NewFrame();
+		SimulationState& state = m_simulationState;
+		snapshot.m_rasterizationSettingsChanged = false;
+		snapshot.m_raytracingSettingsChanged = false;
+		snapshot.m_denoiserSettingsChanged = false;
+		snapshot.m_recordingThreadCount = 0;
+		snapshot.m_pipelineDepth = 0;
+
+		timeNow = std::chrono::steady_clock::now();
 		float timeDelta = static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(timeNow - timeLast).count());
 		float fps = 1000000000.f / timeDelta;
 		std::string logMessage = "FPS: ";
@@ -158,37 +302,201 @@ namespace MelonRenderer
 
 		ImGui::Begin("FPS Counter");
 		ImGui::Text(std::to_string(fpsAverage).c_str());
+		if (m_hasRaytracingCapabilities)
+		{
+			ImGui::Checkbox("raytracing", &m_useRaytracing);
+			//the denoiser accumulates over time itself and needs a new sample pattern every frame
+			if (m_useRaytracing && ImGui::Checkbox("denoise", &m_useDenoiser))
+			{
+				state.m_raytracingSettings.m_accumulate = !m_useDenoiser;
+				state.m_denoiserSettings.m_resetHistory = true;
+				snapshot.m_raytracingSettingsChanged = true;
+				snapshot.m_denoiserSettingsChanged = true;
+			}
+			//primary visibility from the rasterizer, only shadow and reflection rays are traced
+			if (m_useRaytracing)
+				ImGui::Checkbox("hybrid", &m_useHybrid);
+		}
+		ImGui::Checkbox("rotate objects", &m_rotateObjects);
+		//changed before the renderpass begins, which depends on it
+		static int recordingThreads = 1;
+		if (ImGui::SliderInt("recording threads", &recordingThreads, 1, static_cast<int>(std::thread::hardware_concurrency())))
+		{
+			snapshot.m_recordingThreadCount = static_cast<uint32_t>(recordingThreads);
+		}
+		ImGui::Text("recording ms: %.3f", state.m_rasterizationStats.m_recordingMs);
+		int pipelineDepth = static_cast<int>(state.m_pipelineDepth);
+		if (ImGui::SliderInt("pipeline depth", &pipelineDepth, 1, static_cast<int>(m_maxPipelineDepth)))
+		{
+			snapshot.m_pipelineDepth = static_cast<uint32_t>(pipelineDepth);
+		}
+		ImGui::Text("latency ms: %.3f", state.m_latencyMs);
 		ImGui::End();
 
+		//the windows of the pipelines that draw the frame
+		if (m_useRaytracing)
+		{
+			snapshot.m_raytracingSettingsChanged |= PipelineRaytracing::DrawSettings(state.m_raytracingSettings, state.m_raytracingStats);
+			if (m_useDenoiser)
+				snapshot.m_denoiserSettingsChanged |= PipelineDenoiser::DrawSettings(state.m_denoiserSettings, state.m_denoiserStats);
+		}
+		else
+		{
+			snapshot.m_rasterizationSettingsChanged = PipelineRasterization::DrawSettings(state.m_rasterizationSettings, state.m_rasterizationStats);
+		}
+
 		frameIndex++;
 		if (frameIndex == FPS_AVERAGE_RANGE)
 			frameIndex = 0;
 		//--------------------------------------------------------------------
 
+		m_camera.Tick();
+
+		if (m_rotateObjects && m_objectNode != SceneHierarchy::m_noParent)
+		{
+			m_scene.m_hierarchy.SetLocalTransform(m_objectNode,
+				glm::rotate(m_scene.m_hierarchy.GetLocalTransform(m_objectNode).ToMat4(), timeDelta / 1000000000.f, vec3(0.f, 1.f, 0.f)));
+		}
+		m_scene.UpdateInstanceTransforms();
+
+		ImGui::Render();
+		PipelineImGui::CaptureDrawData(snapshot.m_imgui);
+
+		snapshot.m_frame = ++m_frameCount;
+		snapshot.m_deltaSeconds = timeDelta / 1000000000.f;
+		snapshot.m_camera = m_camera.GetCameraMatrices();
+		snapshot.m_useRaytracing = m_useRaytracing;
+		snapshot.m_useHybrid = m_useHybrid;
+		snapshot.m_useDenoiser = m_useDenoiser;
+		snapshot.m_rasterizationSettings = state.m_rasterizationSettings;
+		snapshot.m_raytracingSettings = state.m_raytracingSettings;
+		snapshot.m_denoiserSettings = state.m_denoiserSettings;
+		snapshot.m_simulationStart = timeNow;
+		snapshot.m_simulationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - timeNow).count();
+
+		return true;
+	}
+
+	bool Renderer::PrepareFrame(const FrameSnapshot& snapshot)
+	{
+		//the buffers of the slot are written below, the frame that used them last has to be done
+		if (!m_swapchain.WaitForFrame())
+			return false;
+		const uint32_t frameIndex = m_swapchain.GetFrameIndex();
+		SubmittedFrame& slotFrame = m_submittedFrames[frameIndex];
+		if (slotFrame.m_inFlight)
+		{
+			m_latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - slotFrame.m_simulationStart).count();
+			slotFrame.m_inFlight = false;
+		}
+
+		m_rasterizationPipeline.SetFrameIndex(frameIndex);
+		m_raytracingPipeline.SetFrameIndex(frameIndex);
+		m_denoiserPipeline.SetFrameIndex(frameIndex);
+		m_imguiPipeline.SetFrameIndex(frameIndex);
+		m_camera.Upload(snapshot.m_camera, frameIndex);
+
+		if (snapshot.m_rasterizationSettingsChanged)
+			m_rasterizationPipeline.SetSettings(snapshot.m_rasterizationSettings);
+		if (snapshot.m_raytracingSettingsChanged)
+			m_raytracingPipeline.SetSettings(snapshot.m_raytracingSettings);
+		if (snapshot.m_denoiserSettingsChanged)
+			m_denoiserPipeline.SetSettings(snapshot.m_denoiserSettings);
+		if (snapshot.m_recordingThreadCount)
+			m_rasterizationPipeline.SetRecordingThreadCount(snapshot.m_recordingThreadCount);
+		if (snapshot.m_pipelineDepth)
+			SetPipelineDepth(snapshot.m_pipelineDepth);
+		if (m_hasRaytracingCapabilities)
+			m_raytracingPipeline.SetHybrid(snapshot.m_useHybrid);
+
+		//the scene is read here, the next simulation changes it once this returns
+		bool success = true;
+		if (!snapshot.m_useRaytracing || snapshot.m_useHybrid)
+			success = m_rasterizationPipeline.PrepareFrame();
+		if (snapshot.m_useRaytracing)
+			success = m_raytracingPipeline.UpdateTransformations() && success;
+		//nothing to draw is not an error
+		m_imguiPipeline.SetDrawData(snapshot.m_imgui);
+
+		return success;
+	}
 
-		m_swapchain.AquireNextImage();
+	bool Renderer::RecordFrame(const FrameSnapshot& snapshot)
+	{
+		if (!m_swapchain.AquireNextImage())
+			return false;
+
+		auto recordStart = std::chrono::steady_clock::now();
+		const uint32_t frameIndex = m_swapchain.GetFrameIndex();
 		VkCommandBuffer& commandBuffer = m_swapchain.GetCommandBuffer();
 		BeginCommandBuffer(commandBuffer);
 
-		m_camera.Tick(m_window);
-
-		//m_raytracingPipeline.Tick(commandBuffer);
-		//CopyOutputToSwapchain(commandBuffer, m_raytracingPipeline.GetStorageImage());
+		//the renderpass loads the swapchain image, either with the raytraced output or cleared by the rasterization subpass
+		if (snapshot.m_useRaytracing)
+		{
+			if (snapshot.m_useHybrid)
+			{
+				m_rasterizationPipeline.DrawGBuffer(commandBuffer);
+			}
+			m_raytracingPipeline.Tick(commandBuffer);
+			if (snapshot.m_useDenoiser)
+			{
+				m_denoiserPipeline.Tick(commandBuffer);
+			}
+			CopyOutputToSwapchain(commandBuffer, m_raytracingPipeline.GetStorageImage());
+		}
+		else
+		{
+			m_memoryManager.TransitionImageLayout(commandBuffer, m_swapchain.GetImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
+		m_rasterizationPipeline.SetRasterizeScene(!snapshot.m_useRaytracing);
 		
-		m_renderpass->BeginRenderpass(commandBuffer);
+		m_renderpass->BeginRenderpass(commandBuffer, m_rasterizationPipeline.GetSubpassContents());
 		m_rasterizationPipeline.Tick(commandBuffer);
 
-		ImGui::Render();
 		m_imguiPipeline.Tick(commandBuffer);
 		m_renderpass->EndRenderpass(commandBuffer);
 		
 		EndCommandBuffer(commandBuffer);
+		m_recordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 		
-		m_swapchain.PresentImage();
+		if (!m_swapchain.PresentImage())
+			return false;
+		SubmittedFrame& submittedFrame = m_submittedFrames[frameIndex];
+		submittedFrame.m_frame = snapshot.m_frame;
+		submittedFrame.m_simulationStart = snapshot.m_simulationStart;
+		submittedFrame.m_simulationMs = snapshot.m_simulationMs;
+		submittedFrame.m_inFlight = true;
+		m_submittedSlot = frameIndex;
+
+		if (snapshot.m_frame == 1)
+		{
+			Logger::Log("First frame submitted " + std::to_string(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_initStart).count())
+				+ " ms after startup.");
+		}
 
 		return true;
 	}
 
+	bool Renderer::WaitForSubmittedFrame()
+	{
+		SubmittedFrame& submittedFrame = m_submittedFrames[m_submittedSlot];
+		if (!submittedFrame.m_inFlight)
+			return true;
+
+		if (!m_swapchain.WaitForSubmittedFrame())
+			return false;
+		m_latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submittedFrame.m_simulationStart).count();
+		submittedFrame.m_inFlight = false;
+
+		return true;
+	}
+
+	void Renderer::SetPipelineDepth(uint32_t depth)
+	{
+		m_pipelineDepth = depth < 1 ? 1 : (depth > m_maxPipelineDepth ? m_maxPipelineDepth : depth);
+	}
+
 	void Renderer::Loop()
 	{
 		while (!glfwWindowShouldClose(m_window))
@@ -212,7 +520,6 @@ namespace MelonRenderer
 			}
 			
 			GlfwInputTick();
-			ImGui::NewFrame();
 			Tick();
 		}
 	}
@@ -222,6 +529,7 @@ namespace MelonRenderer
 		ImGui::DestroyContext();
 		
 		vkDestroySurfaceKHR(m_vulkanInstance, m_presentationSurface, nullptr);
+		m_pipelineCache.Fini();
 		vkDestroyDevice(Device::Get().m_device, nullptr);
 		vkDestroyInstance(m_vulkanInstance, nullptr);
 
@@ -241,6 +549,7 @@ namespace MelonRenderer
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+		glfwWindowHint(GLFW_VISIBLE, m_windowVisible ? GLFW_TRUE : GLFW_FALSE);
 		m_window = glfwCreateWindow(defaultWidth, defaultHeight, "Vulkan Renderer", nullptr, nullptr);
 		m_extent.width = defaultWidth;
 		m_extent.height = defaultHeight;
@@ -477,15 +786,25 @@ for(auto & requiredExtension : m_requiredInstanceExtensions){ if(std::string(req
 		}
 
 		//check raytracing capabilities at this point because its convenient
-		m_hasRaytracingCapabilities = false;
-		for (auto& deviceExtension : deviceExtensions)
+		const std::vector<const char*> raytracingExtensions = { VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, 
+			VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME };
+		m_hasRaytracingCapabilities = true;
+		for (auto& raytracingExtension : raytracingExtensions)
 		{
-			if (!strcmp(deviceExtension.extensionName, VK_NV_RAY_TRACING_EXTENSION_NAME))
+			bool extensionSupported = false;
+			for (auto& deviceExtension : deviceExtensions)
 			{
-				Logger::Log("Device supports raytracing!");
-				m_hasRaytracingCapabilities = true;
-				break;
+				if (!strcmp(deviceExtension.extensionName, raytracingExtension))
+				{
+					extensionSupported = true;
+					break;
+				}
 			}
+			m_hasRaytracingCapabilities &= extensionSupported;
+		}
+		if (m_hasRaytracingCapabilities)
+		{
+			Logger::Log("Device supports raytracing!");
 		}
 
 		return true;
@@ -511,7 +830,11 @@ for(auto & requiredExtension : m_requiredInstanceExtensions){ if(std::string(req
 	{
 		vkGetPhysicalDeviceProperties(device, &m_currentPhysicalDeviceProperties);
 
-		m_raytracingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PROPERTIES_NV;
+		m_accelerationStructureProperties = {};
+		m_accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+		m_raytracingProperties = {};
+		m_raytracingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+		m_raytracingProperties.pNext = &m_accelerationStructureProperties;
 		m_currentPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
 		m_currentPhysicalDeviceProperties2.pNext = &m_raytracingProperties;
 
@@ -617,23 +940,44 @@ for(auto & requiredExtension : m_requiredInstanceExtensions){ if(std::string(req
 		deviceExtensionsToActivate.emplace_back(&glfwExtensions);
 		*/
 
+		//buffer device address and spirv 1.4 are core in vulkan 1.2
+		VkPhysicalDeviceRayTracingPipelineFeaturesKHR raytracingPipelineFeatures{};
+		raytracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+		raytracingPipelineFeatures.pNext = nullptr;
+
+		VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+		accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+		accelerationStructureFeatures.pNext = &raytracingPipelineFeatures;
+
+		VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+		bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+		bufferDeviceAddressFeatures.pNext = &accelerationStructureFeatures;
+
 		if (m_hasRaytracingCapabilities)
 		{
-			deviceExtensionsToActivate.emplace_back("VK_KHR_get_memory_requirements2");
-			deviceExtensionsToActivate.emplace_back("VK_NV_ray_tracing");
-			deviceExtensionsToActivate.emplace_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			deviceExtensionsToActivate.emplace_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+			deviceExtensionsToActivate.emplace_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+			deviceExtensionsToActivate.emplace_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
 		}
 
-
 		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
 		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
-		indexingFeatures.pNext = nullptr;
+		indexingFeatures.pNext = m_hasRaytracingCapabilities ? &bufferDeviceAddressFeatures : nullptr;
 
 		VkPhysicalDeviceFeatures2 features2 = {};
 		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 		features2.pNext = &indexingFeatures;
 		vkGetPhysicalDeviceFeatures2(device, &features2);
 
+		if (m_hasRaytracingCapabilities && !(bufferDeviceAddressFeatures.bufferDeviceAddress && accelerationStructureFeatures.accelerationStructure &&
+			raytracingPipelineFeatures.rayTracingPipeline))
+		{
+			Logger::Log("Device exposes raytracing extensions without the required features, raytracing is disabled.");
+			m_hasRaytracingCapabilities = false;
+			deviceExtensionsToActivate.resize(m_requiredDeviceExtensions.size());
+			indexingFeatures.pNext = nullptr;
+		}
+
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		deviceCreateInfo.pNext = &features2;
@@ -753,7 +1097,12 @@ for(auto & requiredExtension : m_requiredInstanceExtensions){ if(std::string(req
 
 		m_imguiPipeline.RecreateOutput(m_extent);
 		m_rasterizationPipeline.RecreateOutput(m_extent);
-		//m_raytracingPipeline.RecreateOutput(m_extent);
+		if (m_hasRaytracingCapabilities)
+		{
+			m_raytracingPipeline.SetGBuffer(m_rasterizationPipeline.GetGBuffer());
+			m_raytracingPipeline.RecreateOutput(m_extent);
+			m_denoiserPipeline.RecreateOutput(m_extent, m_raytracingPipeline.GetOutputs());
+		}
 		m_swapchain.CleanupSwapchain(true);
 		//m_rasterizationPipeline.FillAttachments(m_swapchain.GetAttachmentPointer());
 		m_swapchain.CreateSwapchain(m_physicalDevices[m_currentPhysicalDeviceIndex], m_renderpass->GetVkRenderpass(), outputSurface, m_extent);
@@ -1077,4 +1426,34 @@ for(auto & requiredExtension : m_requiredInstanceExtensions){ if(std::string(req
 
 		return true;
 	}
+
+	bool Renderer::RenderCpu(const std::string& path, uint32_t samplesPerPixel)
+	{
+		//one frame, so camera and instance transforms are up to date
+		BenchmarkFrame();
+
+		CpuRaytracer cpuRaytracer;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!cpuRaytracer.Init(m_scene, m_memoryManager, m_threadPool))
+		{
+			Logger::Log("Could not initialize cpu raytracer.");
+			return false;
+		}
+		auto built = std::chrono::high_resolution_clock::now();
+
+		CpuRenderSettings settings;
+		settings.m_samplesPerPixel = samplesPerPixel;
+		std::vector<vec4> pixels;
+		if (!cpuRaytracer.Render(m_camera.GetCameraMatrices(), m_extent, settings, pixels))
+		{
+			return false;
+		}
+		auto rendered = std::chrono::high_resolution_clock::now();
+
+		Logger::Log("Cpu render with " + std::to_string(cpuRaytracer.GetThreadCount()) + " threads, " + std::to_string(samplesPerPixel) + " spp: build "
+			+ std::to_string(std::chrono::duration<float, std::milli>(built - start).count()) + " ms, render " 
+			+ std::to_string(std::chrono::duration<float, std::milli>(rendered - built).count()) + " ms.");
+
+		return CpuRaytracer::WriteImage(path, m_extent, pixels);
+	}
 }
\ No newline at end of file
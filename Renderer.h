@@ -4,9 +4,13 @@
 #include "DeviceMemoryManager.h"
 #include "pipelines/PipelineRasterization.h"
 #include "pipelines/PipelineRaytracing.h"
+#include "pipelines/PipelineDenoiser.h"
 #include "pipelines/PipelineImGui.h"
+#include "cpu_raytracing/CpuRaytracer.h"
 #include "Swapchain.h"
 #include "simple_scene_graph/Scene.h"
+#include "simple_scene_graph/SceneFile.h"
+#include "AssetLoader.h"
 
 #include <glfw3.h>
 #include "imgui/imgui.h"
@@ -14,6 +18,7 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <string>
 
 //TODO: change version numbers
 constexpr VkApplicationInfo applicationInfo =
@@ -72,16 +77,77 @@ namespace MelonRenderer
 		GLFWcharfun m_prevUserCallbackChar = nullptr;
 	};
 
+	//what the recording of a frame takes from its simulation, recording reads the snapshot instead of the ui state
+	struct FrameSnapshot
+	{
+		uint64_t m_frame = 0;
+		float m_deltaSeconds = 0.f;
+		CameraMatrices m_camera;
+		bool m_useRaytracing = false;
+		bool m_useHybrid = false;
+		bool m_useDenoiser = false;
+		//applied to the pipelines before the frame is prepared if the ui changed them
+		RasterizationSettings m_rasterizationSettings;
+		RaytracingSettings m_raytracingSettings;
+		DenoiserSettings m_denoiserSettings;
+		bool m_rasterizationSettingsChanged = false;
+		bool m_raytracingSettingsChanged = false;
+		bool m_denoiserSettingsChanged = false;
+		//0 leaves them unchanged
+		uint32_t m_recordingThreadCount = 0;
+		uint32_t m_pipelineDepth = 0;
+		ImGuiFrameData m_imgui;
+		//input was read at the start of the simulation, which the latency is measured from
+		std::chrono::time_point<std::chrono::steady_clock> m_simulationStart;
+		float m_simulationMs = 0.f;
+	};
+
+	//everything the simulation reads of the pipelines, copied on the main thread before it starts so it never touches them
+	struct SimulationState
+	{
+		RasterizationSettings m_rasterizationSettings;
+		RasterizationStats m_rasterizationStats;
+		RaytracingSettings m_raytracingSettings;
+		RaytracingStats m_raytracingStats;
+		DenoiserSettings m_denoiserSettings;
+		DenoiserStats m_denoiserStats;
+		uint32_t m_pipelineDepth = 1;
+		float m_latencyMs = 0.f;
+	};
+
+	//a submitted frame, its latency is known once the gpu finished it
+	struct SubmittedFrame
+	{
+		uint64_t m_frame = 0;
+		std::chrono::time_point<std::chrono::steady_clock> m_simulationStart;
+		float m_simulationMs = 0.f;
+		bool m_inFlight = false;
+	};
+
 	class Renderer 
 	{
 	public:
-		void Init();
+		void Init(bool windowVisible = true);
 		bool Tick();
 		void Loop();
 		void Fini();
 
+		//runs a benchmark by name instead of the interactive loop, results are logged
+		bool RunBenchmark(const std::string& name);
+		//renders the scene with the cpu raytracer and writes it to a png, needs no raytracing support
+		bool RenderCpu(const std::string& path, uint32_t samplesPerPixel = 64);
+
+		//loaded by Init instead of the default scene, which is used if loading fails
+		void SetSceneFile(const std::string& path);
+		//writes m_scene to a binary scene file, see SceneFile.h
+		bool ExportScene(const std::string& path, bool embedGeometry = true);
+
 	private:
 		bool CreateGLFWWindow();
+		AssetManifest CreateDefaultManifest() const;
+		void CreateDefaultScene();
+		//after every pipeline's Init, all at once or one after another to compare
+		bool CompilePipelines(bool concurrent);
 
 		bool LoadVulkanLibrary();
 		bool LoadExportedFunctions();
@@ -122,6 +188,42 @@ namespace MelonRenderer
 
 		bool Resize();
 
+		//a frame is simulated, prepared and then recorded and submitted, see m_pipelineDepth
+		void CopySimulationState();
+		//only touches the ui, the camera, the scene and the snapshot, so it can run on the pool
+		bool Simulate(FrameSnapshot& snapshot);
+		//waits for the frame slot and writes its buffers on the main thread, the scene is read here and not while recording
+		bool PrepareFrame(const FrameSnapshot& snapshot);
+		bool RecordFrame(const FrameSnapshot& snapshot);
+		//measures the latency of the submitted frame once it is done
+		bool WaitForSubmittedFrame();
+		//1 simulates a frame after the previous one finished on the gpu, 2 simulates the next frame on the pool while this one is recorded
+		//and the one before executes, every buffer written per frame exists once per frame in flight
+		void SetPipelineDepth(uint32_t depth);
+
+		//benchmarks, see RendererBenchmarks.cpp
+		//-------------------------------------
+		bool BenchmarkFrame();
+		bool BenchmarkSampling();
+		bool BenchmarkDenoiser();
+		bool BenchmarkHybrid();
+		bool BenchmarkAdaptive();
+		bool BenchmarkCpu();
+		bool BenchmarkBVH8();
+		bool BenchmarkHierarchy();
+		bool BenchmarkTransformThreads();
+		bool BenchmarkAffine();
+		bool BenchmarkInstances();
+		bool BenchmarkSpawn();
+		bool BenchmarkStaticBatching();
+		bool BenchmarkInstanceStreams();
+		bool BenchmarkRecording();
+		bool BenchmarkJobs();
+		bool BenchmarkLatency();
+		bool BenchmarkLoading();
+		bool BenchmarkPipelines();
+		//-------------------------------------
+
 		//input
 		//-------------------------------------
 		bool GlfwInputInit();
@@ -139,7 +241,12 @@ namespace MelonRenderer
 
 		Swapchain m_swapchain;
 
+		//every hardware thread, the only pool of the renderer, shared by the scene, recording, pipeline creation, loading and the cpu raytracer
+		ThreadPool m_threadPool;
+		//kept in the working directory between runs, see PipelineCache
+		PipelineCache m_pipelineCache;
 		PipelineRaytracing m_raytracingPipeline;
+		PipelineDenoiser m_denoiserPipeline;
 		PipelineRasterization m_rasterizationPipeline;
 		PipelineImGui m_imguiPipeline;
 
@@ -150,13 +257,44 @@ namespace MelonRenderer
 
 		std::vector<mat3x4> m_transformMats;
 
-		std::vector<NodeDrawable> m_drawableNodes;
-		Node m_objectNode;
+		//handles into m_scene.m_hierarchy
+		std::vector<uint32_t> m_drawableNodes;
+		//rotated by the ui, only exists in the default scene
+		uint32_t m_objectNode = SceneHierarchy::m_noParent;
+		bool m_rotateObjects = false;
+		std::string m_sceneFile;
 
 		//time logic
 		//---------------------------------------
 		std::chrono::time_point<std::chrono::steady_clock> timeLast;
 		std::chrono::time_point<std::chrono::steady_clock> timeNow;
+		//startup breakdown, logged by Init, the first frame logs the time since m_initStart
+		std::chrono::time_point<std::chrono::steady_clock> m_initStart;
+		float m_deviceInitMs = 0.f;
+		float m_sceneInitMs = 0.f;
+		float m_pipelineInitMs = 0.f;
+		float m_pipelineCompileMs = 0.f;
+		//---------------------------------------
+
+		//frame pipeline
+		//---------------------------------------
+		static constexpr uint32_t m_maxPipelineDepth = maxFramesInFlight;
+		uint32_t m_pipelineDepth = 2;
+		uint64_t m_frameCount = 0;
+		//one is prepared and recorded while the next frame is simulated into the other
+		FrameSnapshot m_snapshots[2];
+		uint32_t m_pendingSnapshot = 0;
+		bool m_hasPendingSnapshot = false;
+		SimulationState m_simulationState;
+		//runs Simulate on the pending snapshot
+		TaskGraph m_simulationGraph;
+		bool m_simulationSucceeded = true;
+		//per frame slot
+		SubmittedFrame m_submittedFrames[maxFramesInFlight];
+		uint32_t m_submittedSlot = 0;
+		//from the start of a frame's simulation until the renderer saw the gpu finish it, which may be later with a depth of 2
+		float m_latencyMs = 0.f;
+		float m_recordMs = 0.f;
 		//---------------------------------------
 
 		std::vector<char const*> m_requiredInstanceExtensions;
@@ -171,10 +309,15 @@ namespace MelonRenderer
 		std::vector<VkPresentModeKHR> m_currentPhysicalDevicePresentModes;
 		std::vector<VkQueueFamilyProperties> m_currentQueueFamilyProperties;
 
-		VkPhysicalDeviceRayTracingPropertiesNV m_raytracingProperties;
+		VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_raytracingProperties;
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR m_accelerationStructureProperties;
 		bool m_hasRaytracingCapabilities;
+		bool m_useRaytracing = false;
+		bool m_useDenoiser = false;
+		bool m_useHybrid = false;
 
 		GLFWwindow* m_window;
+		bool m_windowVisible = true;
 		VkSurfaceKHR m_presentationSurface;
 		VkPhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties;
 		VkInstance m_vulkanInstance;
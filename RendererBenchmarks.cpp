@@ -0,0 +1,1702 @@
+#include "Renderer.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stack>
+
+namespace MelonRenderer
+{
+	bool Renderer::RunBenchmark(const std::string& name)
+	{
+		Logger::Log("Running benchmark " + name + ".");
+		//benchmarks change the renderer between frames, which a frame simulated ahead would not see, latency sets its own depth
+		SetPipelineDepth(1);
+
+		if (name == "sampling")
+			return BenchmarkSampling();
+		if (name == "denoiser")
+			return BenchmarkDenoiser();
+		if (name == "hybrid")
+			return BenchmarkHybrid();
+		if (name == "adaptive")
+			return BenchmarkAdaptive();
+		if (name == "cpu")
+			return BenchmarkCpu();
+		if (name == "bvh8")
+			return BenchmarkBVH8();
+		if (name == "hierarchy")
+			return BenchmarkHierarchy();
+		if (name == "transforms")
+			return BenchmarkTransformThreads();
+		if (name == "affine")
+			return BenchmarkAffine();
+		if (name == "instances")
+			return BenchmarkInstances();
+		if (name == "spawn")
+			return BenchmarkSpawn();
+		if (name == "batching")
+			return BenchmarkStaticBatching();
+		if (name == "streams")
+			return BenchmarkInstanceStreams();
+		if (name == "recording")
+			return BenchmarkRecording();
+		if (name == "jobs")
+			return BenchmarkJobs();
+		if (name == "latency")
+			return BenchmarkLatency();
+		if (name == "loading")
+			return BenchmarkLoading();
+		if (name == "pipelines")
+			return BenchmarkPipelines();
+
+		Logger::Log("Unknown benchmark " + name + ".");
+		return false;
+	}
+
+	bool Renderer::BenchmarkFrame()
+	{
+		Logger::Get().Print();
+		glfwPollEvents();
+		GlfwInputTick();
+
+		return Tick();
+	}
+
+	//RMSE of every sampler against a high sample count reference, per accumulated sample count
+	bool Renderer::BenchmarkSampling()
+	{
+		if (!m_hasRaytracingCapabilities)
+		{
+			Logger::Log("Sampling benchmark needs raytracing support.");
+			return false;
+		}
+		m_useRaytracing = true;
+		//soft shadows, so closest hit sampling is measured as well
+		m_raytracingPipeline.SetLightRadius(5.f);
+
+		constexpr uint32_t referenceFrames = 256;
+		constexpr int referenceSamplesPerFrame = 16;
+		m_raytracingPipeline.SetSampler(SAMPLER_RANDOM);
+		m_raytracingPipeline.SetSamplesPerFrame(referenceSamplesPerFrame);
+		m_raytracingPipeline.ResetAccumulation();
+		for (uint32_t i = 0; i < referenceFrames; i++)
+		{
+			BenchmarkFrame();
+		}
+
+		std::vector<vec4> reference;
+		if (!m_raytracingPipeline.ReadAccumulationImage(reference))
+		{
+			Logger::Log("Could not read sampling benchmark reference.");
+			return false;
+		}
+		Logger::Log("Reference: " + std::to_string(referenceFrames * referenceSamplesPerFrame) + " spp, random sampler.");
+
+		constexpr uint32_t maxSamples = 256;
+		m_raytracingPipeline.SetSamplesPerFrame(1);
+		std::vector<vec4> pixels;
+		Logger::Log("sampler, spp, rmse, ms");
+		for (int sampler = 0; sampler < SAMPLER_COUNT; sampler++)
+		{
+			m_raytracingPipeline.SetSampler(static_cast<SamplerType>(sampler));
+			m_raytracingPipeline.ResetAccumulation();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t samples = 1; samples <= maxSamples; samples++)
+			{
+				BenchmarkFrame();
+
+				//only power of two sample counts, where sobol is best stratified
+				if (samples & (samples - 1))
+					continue;
+
+				if (!m_raytracingPipeline.ReadAccumulationImage(pixels) || pixels.size() != reference.size())
+				{
+					Logger::Log("Could not read sampling benchmark image.");
+					return false;
+				}
+				float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+				double squaredError = 0.0;
+				for (size_t i = 0; i < pixels.size(); i++)
+				{
+					vec3 difference = vec3(pixels[i]) - vec3(reference[i]);
+					squaredError += glm::dot(difference, difference);
+				}
+				double rmse = std::sqrt(squaredError / (pixels.size() * 3));
+
+				Logger::Log(std::string(samplerNames[sampler]) + ", " + std::to_string(samples) + ", " + std::to_string(rmse) + ", " 
+					+ std::to_string(elapsed));
+			}
+		}
+
+		return true;
+	}
+
+	//RMSE of the raw and the denoised 1 spp output against an accumulated reference, plus gpu time per denoiser stage
+	bool Renderer::BenchmarkDenoiser()
+	{
+		if (!m_hasRaytracingCapabilities)
+		{
+			Logger::Log("Denoiser benchmark needs raytracing support.");
+			return false;
+		}
+		m_useRaytracing = true;
+		m_useDenoiser = false;
+		m_raytracingPipeline.SetLightRadius(5.f);
+
+		constexpr uint32_t referenceFrames = 256;
+		constexpr int referenceSamplesPerFrame = 16;
+		m_raytracingPipeline.SetAccumulate(true);
+		m_raytracingPipeline.SetSamplesPerFrame(referenceSamplesPerFrame);
+		m_raytracingPipeline.ResetAccumulation();
+		for (uint32_t i = 0; i < referenceFrames; i++)
+		{
+			BenchmarkFrame();
+		}
+
+		std::vector<vec4> reference;
+		if (!m_raytracingPipeline.ReadAccumulationImage(reference))
+		{
+			Logger::Log("Could not read denoiser benchmark reference.");
+			return false;
+		}
+		Logger::Log("Reference: " + std::to_string(referenceFrames * referenceSamplesPerFrame) + " spp.");
+
+		//both outputs are compared as displayed, clamped and quantized to 8 bit
+		auto outputRMSE = [&](const std::vector<uint32_t>& pixels) 
+		{
+			double squaredError = 0.0;
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				//the output is stored in swapchain channel order
+				vec3 color = vec3((pixels[i] >> 16) & 0xff, (pixels[i] >> 8) & 0xff, pixels[i] & 0xff) / 255.f;
+				vec3 difference = color - glm::clamp(vec3(reference[i]), 0.f, 1.f);
+				squaredError += glm::dot(difference, difference);
+			}
+			return std::sqrt(squaredError / (pixels.size() * 3));
+		};
+
+		m_raytracingPipeline.SetAccumulate(false);
+		m_raytracingPipeline.SetSamplesPerFrame(1);
+		BenchmarkFrame();
+		std::vector<uint32_t> pixels;
+		if (!m_raytracingPipeline.ReadStorageImage(pixels) || pixels.size() != reference.size())
+		{
+			Logger::Log("Could not read denoiser benchmark image.");
+			return false;
+		}
+		Logger::Log("noisy 1 spp, rmse " + std::to_string(outputRMSE(pixels)));
+
+		constexpr uint32_t denoisedFrames = 64;
+		m_useDenoiser = true;
+		m_denoiserPipeline.ResetHistory();
+		Logger::Log("frame, rmse");
+		for (uint32_t frame = 1; frame <= denoisedFrames; frame++)
+		{
+			BenchmarkFrame();
+
+			//temporal history converges over the first frames
+			if (frame & (frame - 1))
+				continue;
+
+			if (!m_raytracingPipeline.ReadStorageImage(pixels) || pixels.size() != reference.size())
+			{
+				Logger::Log("Could not read denoiser benchmark image.");
+				return false;
+			}
+			Logger::Log(std::to_string(frame) + ", " + std::to_string(outputRMSE(pixels)));
+		}
+
+		for (int stage = 0; stage < PipelineDenoiser::STAGE_COUNT; stage++)
+		{
+			Logger::Log(std::string(PipelineDenoiser::stageNames[stage]) + ": " 
+				+ std::to_string(m_denoiserPipeline.GetStageTime(static_cast<PipelineDenoiser::DenoiserStage>(stage))) + " ms");
+		}
+
+		return true;
+	}
+	//rays per pixel and frame of the fully traced and the hybrid mode, and the difference between their converged images
+	bool Renderer::BenchmarkHybrid()
+	{
+		if (!m_hasRaytracingCapabilities)
+		{
+			Logger::Log("Hybrid benchmark needs raytracing support.");
+			return false;
+		}
+		m_useRaytracing = true;
+		m_useDenoiser = false;
+		m_raytracingPipeline.SetLightRadius(5.f);
+		m_raytracingPipeline.SetAccumulate(true);
+		m_raytracingPipeline.SetSamplesPerFrame(1);
+		m_raytracingPipeline.SetCountRays(true);
+
+		constexpr uint32_t frames = 64;
+		const char* modeNames[2] = { "full", "hybrid" };
+		std::vector<vec4> images[2];
+		float raysPerPixel[2];
+		Logger::Log("mode, primary, shadow, reflection, rays per pixel, ms per frame");
+		for (int mode = 0; mode < 2; mode++)
+		{
+			m_useHybrid = mode == 1;
+			m_raytracingPipeline.SetHybrid(m_useHybrid);
+			m_raytracingPipeline.ResetAccumulation();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < frames; i++)
+			{
+				BenchmarkFrame();
+			}
+			vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+			float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			//counters of the last frame, every frame traces the same rays
+			RayCounts rayCounts;
+			if (!m_raytracingPipeline.ReadRayCounts(rayCounts) || !m_raytracingPipeline.ReadAccumulationImage(images[mode]))
+			{
+				Logger::Log("Could not read hybrid benchmark results.");
+				return false;
+			}
+
+			float pixels = static_cast<float>(m_extent.width * m_extent.height);
+			raysPerPixel[mode] = (rayCounts.m_primary + rayCounts.m_shadow + rayCounts.m_reflection) / pixels;
+			Logger::Log(std::string(modeNames[mode]) + ", " + std::to_string(rayCounts.m_primary / pixels) + ", " + std::to_string(rayCounts.m_shadow / pixels)
+				+ ", " + std::to_string(rayCounts.m_reflection / pixels) + ", " + std::to_string(raysPerPixel[mode]) + ", " + std::to_string(elapsed / frames));
+		}
+		m_raytracingPipeline.SetCountRays(false);
+
+		if (images[0].size() != images[1].size())
+		{
+			Logger::Log("Hybrid benchmark images differ in size.");
+			return false;
+		}
+		double squaredError = 0.0;
+		for (size_t i = 0; i < images[0].size(); i++)
+		{
+			vec3 difference = vec3(images[1][i]) - vec3(images[0][i]);
+			squaredError += glm::dot(difference, difference);
+		}
+		double rmse = std::sqrt(squaredError / (images[0].size() * 3));
+
+		Logger::Log("hybrid traces " + std::to_string(raysPerPixel[1] / raysPerPixel[0]) + " of the rays, rmse to full " + std::to_string(rmse));
+
+		return true;
+	}
+	//rays per pixel uniform and adaptive sampling need to reach the same RMSE against an accumulated reference
+	bool Renderer::BenchmarkAdaptive()
+	{
+		if (!m_hasRaytracingCapabilities)
+		{
+			Logger::Log("Adaptive sampling benchmark needs raytracing support.");
+			return false;
+		}
+		m_useRaytracing = true;
+		m_useDenoiser = false;
+		m_raytracingPipeline.SetLightRadius(5.f);
+		m_raytracingPipeline.SetAccumulate(true);
+		m_raytracingPipeline.SetAdaptiveSampling(false);
+
+		constexpr uint32_t referenceFrames = 256;
+		constexpr int referenceSamplesPerFrame = 16;
+		m_raytracingPipeline.SetSamplesPerFrame(referenceSamplesPerFrame);
+		m_raytracingPipeline.ResetAccumulation();
+		for (uint32_t i = 0; i < referenceFrames; i++)
+		{
+			BenchmarkFrame();
+		}
+
+		std::vector<vec4> reference;
+		if (!m_raytracingPipeline.ReadAccumulationImage(reference))
+		{
+			Logger::Log("Could not read adaptive sampling benchmark reference.");
+			return false;
+		}
+		Logger::Log("Reference: " + std::to_string(referenceFrames * referenceSamplesPerFrame) + " spp.");
+
+		std::vector<vec4> pixels;
+		auto accumulationRMSE = [&]()
+		{
+			if (!m_raytracingPipeline.ReadAccumulationImage(pixels) || pixels.size() != reference.size())
+				return -1.0;
+
+			double squaredError = 0.0;
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				vec3 difference = vec3(pixels[i]) - vec3(reference[i]);
+				squaredError += glm::dot(difference, difference);
+			}
+			return std::sqrt(squaredError / (pixels.size() * 3));
+		};
+
+		//1 spp per frame, the adaptive mode adds up to one more sample per pixel on average where it is needed
+		const float pixelCount = static_cast<float>(m_extent.width * m_extent.height);
+		constexpr uint32_t uniformFrames = 64;
+		constexpr uint32_t maxAdaptiveFrames = 256;
+		m_raytracingPipeline.SetSamplesPerFrame(1);
+		m_raytracingPipeline.SetCountRays(true);
+
+		double targetRMSE = 0.0;
+		float raysPerPixel[2] = {};
+		uint32_t framesNeeded[2] = {};
+		Logger::Log("mode, frames, rays per pixel, rmse");
+		for (int mode = 0; mode < 2; mode++)
+		{
+			m_raytracingPipeline.SetAdaptiveSampling(mode == 1, 0.05f, 8, 1.f);
+			m_raytracingPipeline.ResetAccumulation();
+
+			uint64_t rays = 0;
+			double rmse = 0.0;
+			uint32_t frames = mode == 0 ? uniformFrames : maxAdaptiveFrames;
+			for (uint32_t frame = 1; frame <= frames; frame++)
+			{
+				BenchmarkFrame();
+
+				RayCounts rayCounts;
+				if (!m_raytracingPipeline.ReadRayCounts(rayCounts))
+				{
+					return false;
+				}
+				rays += rayCounts.m_primary + rayCounts.m_shadow + rayCounts.m_reflection;
+
+				//the uniform run sets the error the adaptive run has to reach
+				if (mode == 1 || frame == frames || !(frame & (frame - 1)))
+				{
+					rmse = accumulationRMSE();
+					if (rmse < 0.0)
+					{
+						Logger::Log("Could not read adaptive sampling benchmark image.");
+						return false;
+					}
+					framesNeeded[mode] = frame;
+					raysPerPixel[mode] = rays / pixelCount;
+					if (mode == 0 || !(frame & (frame - 1)))
+						Logger::Log(std::string(mode == 0 ? "uniform" : "adaptive") + ", " + std::to_string(frame) + ", " 
+							+ std::to_string(raysPerPixel[mode]) + ", " + std::to_string(rmse));
+					if (mode == 1 && rmse <= targetRMSE)
+						break;
+				}
+			}
+			if (mode == 0)
+				targetRMSE = rmse;
+		}
+		m_raytracingPipeline.SetAdaptiveSampling(false);
+		m_raytracingPipeline.SetCountRays(false);
+
+		Logger::Log("rmse " + std::to_string(targetRMSE) + ": uniform " + std::to_string(raysPerPixel[0]) + " rays per pixel in " 
+			+ std::to_string(framesNeeded[0]) + " frames, adaptive " + std::to_string(raysPerPixel[1]) + " rays per pixel in " 
+			+ std::to_string(framesNeeded[1]) + " frames");
+
+		return true;
+	}
+
+	//scaling of the cpu raytracer over thread counts, then its RMSE next to the gpu's at the same sample count
+	bool Renderer::BenchmarkCpu()
+	{
+		m_useDenoiser = false;
+		BenchmarkFrame();
+
+		CpuRaytracer cpuRaytracer;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!cpuRaytracer.Init(m_scene, m_memoryManager, m_threadPool))
+		{
+			Logger::Log("Could not initialize cpu raytracer.");
+			return false;
+		}
+		Logger::Log("BVH build: " + std::to_string(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count()) + " ms.");
+
+		CpuRenderSettings settings;
+		settings.m_lightRadius = 5.f;
+		settings.m_samplesPerPixel = 4;
+		std::vector<vec4> pixels;
+
+		//powers of two up to every hardware thread
+		const uint32_t maxThreads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+		{
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		float singleThreadTime = 0.f;
+		Logger::Log("threads, ms, speedup, efficiency");
+		for (uint32_t threads : threadCounts)
+		{
+			//a pool per thread count, the comparison below renders on the renderer's
+			ThreadPool pool(threads);
+			cpuRaytracer.SetThreadPool(pool);
+			start = std::chrono::high_resolution_clock::now();
+			if (!cpuRaytracer.Render(m_camera.GetCameraMatrices(), m_extent, settings, pixels))
+			{
+				return false;
+			}
+			float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			singleThreadTime = threads == 1 ? time : singleThreadTime;
+
+			float speedup = singleThreadTime / time;
+			Logger::Log(std::to_string(threads) + ", " + std::to_string(time) + ", " + std::to_string(speedup) + ", " + std::to_string(speedup / threads));
+		}
+		cpuRaytracer.SetThreadPool(m_threadPool);
+
+		if (!m_hasRaytracingCapabilities)
+		{
+			Logger::Log("No raytracing support, skipping the comparison to the gpu.");
+			return true;
+		}
+
+		//both sides use the random sampler, so the error of the cpu has to match the one of the gpu
+		m_useRaytracing = true;
+		m_raytracingPipeline.SetLightRadius(settings.m_lightRadius);
+		m_raytracingPipeline.SetSampler(SAMPLER_RANDOM);
+		m_raytracingPipeline.SetAccumulate(true);
+		m_raytracingPipeline.SetAdaptiveSampling(false);
+
+		constexpr uint32_t referenceFrames = 256;
+		constexpr int referenceSamplesPerFrame = 16;
+		m_raytracingPipeline.SetSamplesPerFrame(referenceSamplesPerFrame);
+		m_raytracingPipeline.ResetAccumulation();
+		for (uint32_t i = 0; i < referenceFrames; i++)
+		{
+			BenchmarkFrame();
+		}
+
+		std::vector<vec4> reference;
+		if (!m_raytracingPipeline.ReadAccumulationImage(reference))
+		{
+			Logger::Log("Could not read cpu benchmark reference.");
+			return false;
+		}
+		Logger::Log("Reference: " + std::to_string(referenceFrames * referenceSamplesPerFrame) + " spp.");
+
+		auto rmse = [&](const std::vector<vec4>& image)
+		{
+			double squaredError = 0.0;
+			for (size_t i = 0; i < image.size(); i++)
+			{
+				vec3 difference = vec3(image[i]) - vec3(reference[i]);
+				squaredError += glm::dot(difference, difference);
+			}
+			return std::sqrt(squaredError / (image.size() * 3));
+		};
+
+		constexpr uint32_t comparisonSamples = 64;
+		m_raytracingPipeline.SetSamplesPerFrame(1);
+		m_raytracingPipeline.ResetAccumulation();
+		for (uint32_t i = 0; i < comparisonSamples; i++)
+		{
+			BenchmarkFrame();
+		}
+		std::vector<vec4> gpuPixels;
+		if (!m_raytracingPipeline.ReadAccumulationImage(gpuPixels) || gpuPixels.size() != reference.size())
+		{
+			Logger::Log("Could not read cpu benchmark gpu image.");
+			return false;
+		}
+
+		settings.m_samplesPerPixel = comparisonSamples;
+		if (!cpuRaytracer.Render(m_camera.GetCameraMatrices(), m_extent, settings, pixels) || pixels.size() != reference.size())
+		{
+			return false;
+		}
+
+		Logger::Log(std::to_string(comparisonSamples) + " spp rmse: gpu " + std::to_string(rmse(gpuPixels)) + ", cpu " + std::to_string(rmse(pixels)));
+
+		return true;
+	}
+
+	//single threaded Mrays/s of the binary BVH, the BVH8 with single rays and with 8 ray packets on the dragon
+	bool Renderer::BenchmarkBVH8()
+	{
+		const Drawable& dragon = m_scene.m_drawables[1]; //see Init
+		const std::vector<Vertex>& vertices = dragon.GetVertices();
+		const std::vector<uint32_t>& indices = dragon.GetIndices();
+		auto position = [&](uint32_t index)
+		{
+			return vec3(vertices[index].posX, vertices[index].posY, vertices[index].posZ);
+		};
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<AABB> triangleBounds(indices.size() / 3);
+		for (size_t i = 0; i < triangleBounds.size(); i++)
+		{
+			triangleBounds[i].Expand(position(indices[i * 3 + 0]));
+			triangleBounds[i].Expand(position(indices[i * 3 + 1]));
+			triangleBounds[i].Expand(position(indices[i * 3 + 2]));
+		}
+		BVH bvh;
+		bvh.Build(triangleBounds);
+		auto binaryBuilt = std::chrono::high_resolution_clock::now();
+		BVH8 bvh8;
+		bvh8.Build(vertices, indices);
+		auto wideBuilt = std::chrono::high_resolution_clock::now();
+		Logger::Log(std::to_string(triangleBounds.size()) + " triangles, " + simdName + ". Binary build " 
+			+ std::to_string(std::chrono::duration<float, std::milli>(binaryBuilt - start).count()) + " ms, " + std::to_string(bvh.GetNodeCount()) + " nodes. BVH8 build "
+			+ std::to_string(std::chrono::duration<float, std::milli>(wideBuilt - binaryBuilt).count()) + " ms, " + std::to_string(bvh8.GetNodeCount()) + " nodes.");
+
+		const AABB& bounds = bvh8.GetBounds();
+		const vec3 center = (bounds.m_min + bounds.m_max) * 0.5f;
+		const float radius = glm::length(bounds.m_max - bounds.m_min) * 0.5f;
+
+		//coherent: a pinhole camera in front of the dragon, packets of 4x2 pixels
+		constexpr uint32_t resolution = 1024;
+		std::vector<Ray> coherentRays(resolution * resolution);
+		const vec3 eye = center + vec3(0.f, 0.f, 2.f * radius);
+		for (uint32_t tile = 0; tile < coherentRays.size() / 8; tile++)
+		{
+			uint32_t tileX = (tile % (resolution / 4)) * 4;
+			uint32_t tileY = (tile / (resolution / 4)) * 2;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				float x = ((tileX + lane % 4 + 0.5f) / resolution * 2.f - 1.f) * 0.6f;
+				float y = ((tileY + lane / 4 + 0.5f) / resolution * 2.f - 1.f) * 0.6f;
+				coherentRays[tile * 8 + lane].m_origin = eye;
+				coherentRays[tile * 8 + lane].m_direction = glm::normalize(vec3(x, y, -1.f));
+			}
+		}
+
+		//incoherent: from random points around the dragon to random points inside its bounds
+		std::vector<Ray> incoherentRays(coherentRays.size());
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> distribution(0.f, 1.f);
+		for (auto& ray : incoherentRays)
+		{
+			float z = 1.f - 2.f * distribution(generator);
+			float phi = 2.f * 3.14159265f * distribution(generator);
+			float xy = std::sqrt(1.f - z * z);
+			ray.m_origin = center + 2.f * radius * vec3(xy * std::cos(phi), xy * std::sin(phi), z);
+			vec3 target = bounds.m_min + (bounds.m_max - bounds.m_min) * vec3(distribution(generator), distribution(generator), distribution(generator));
+			ray.m_direction = glm::normalize(target - ray.m_origin);
+		}
+
+		Logger::Log("rays, traversal, Mrays/s, hits");
+		for (int set = 0; set < 2; set++)
+		{
+			const std::vector<Ray>& rays = set == 0 ? coherentRays : incoherentRays;
+			const std::string setName = set == 0 ? "coherent" : "incoherent";
+			auto log = [&](const std::string& traversal, std::chrono::high_resolution_clock::time_point begin, uint32_t hits)
+			{
+				float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - begin).count();
+				Logger::Log(setName + ", " + traversal + ", " + std::to_string(rays.size() / seconds / 1000000.f) + ", " + std::to_string(hits));
+			};
+
+			uint32_t hits = 0;
+			start = std::chrono::high_resolution_clock::now();
+			for (Ray ray : rays)
+			{
+				hits += bvh.Traverse(ray, [&](uint32_t primitive, Ray& triangleRay)
+					{
+						float u, v;
+						return IntersectTriangle(position(indices[primitive * 3 + 0]), position(indices[primitive * 3 + 1]), position(indices[primitive * 3 + 2]), triangleRay, u, v);
+					}, false) ? 1 : 0;
+			}
+			log("binary", start, hits);
+
+			hits = 0;
+			start = std::chrono::high_resolution_clock::now();
+			for (Ray ray : rays)
+			{
+				TriangleHit hit;
+				hits += bvh8.Intersect(ray, hit) ? 1 : 0;
+			}
+			log("bvh8", start, hits);
+
+			hits = 0;
+			start = std::chrono::high_resolution_clock::now();
+			RayPacket8 packet;
+			TriangleHit8 packetHits;
+			for (size_t first = 0; first < rays.size(); first += 8)
+			{
+				for (uint32_t lane = 0; lane < 8; lane++)
+				{
+					const Ray& ray = rays[first + lane];
+					packet.m_originX[lane] = ray.m_origin.x;
+					packet.m_originY[lane] = ray.m_origin.y;
+					packet.m_originZ[lane] = ray.m_origin.z;
+					packet.m_directionX[lane] = ray.m_direction.x;
+					packet.m_directionY[lane] = ray.m_direction.y;
+					packet.m_directionZ[lane] = ray.m_direction.z;
+					packet.m_tMin[lane] = ray.m_tMin;
+					packet.m_tMax[lane] = ray.m_tMax;
+				}
+				bvh8.Intersect8(packet, packetHits);
+				for (uint32_t lane = 0; lane < 8; lane++)
+				{
+					hits += packetHits.m_primitive[lane] != BVH8::m_invalid ? 1 : 0;
+				}
+			}
+			log("bvh8 packet", start, hits);
+		}
+
+		return true;
+	}
+
+	//transform update of the pointer based Node graph against the flattened SceneHierarchy, both for random trees of the same shape,
+	//then the flattened update with a single moved leaf and with nothing moved
+	bool Renderer::BenchmarkHierarchy()
+	{
+		Logger::Log("nodes, node graph ms, flattened ms, speedup, max difference, one node moved ms, static ms");
+		for (uint32_t nodeCount : { 1000u, 100000u, 1000000u })
+		{
+			//parents precede their children in both, the first nodes are roots
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+			std::vector<NodeDrawable> nodes(nodeCount);
+			std::vector<Node*> rootChildren;
+			Scene scene;
+			scene.m_hierarchy.Reserve(nodeCount);
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				mat4 localTransform = glm::rotate(glm::translate(mat4(1.f), vec3(distribution(generator), distribution(generator), distribution(generator))),
+					distribution(generator), vec3(0.f, 1.f, 0.f));
+				uint32_t parent = i < 16 ? SceneHierarchy::m_noParent : static_cast<uint32_t>(generator() % i);
+
+				*nodes[i].GetTransformMat() = localTransform;
+				nodes[i].SetDrawableInstance(i);
+				if (parent == SceneHierarchy::m_noParent)
+					rootChildren.emplace_back(&nodes[i]);
+				else
+					nodes[parent].m_children.emplace_back(&nodes[i]);
+
+				scene.m_hierarchy.CreateNode(parent, localTransform, scene.CreateDrawableInstance(0, false));
+			}
+
+			//the traversal Scene::UpdateInstanceTransforms used before the hierarchy was flattened, with the instance layout of then
+			struct NodeInstance
+			{
+				mat4 m_transformation;
+				mat4 m_transformationInverseTranspose;
+			};
+			std::vector<NodeInstance> nodeInstances(nodeCount);
+			auto updateNodes = [&]()
+			{
+				typedef std::pair<Node*, mat4> NodeCall;
+
+				std::stack<NodeCall> nodeCallStack;
+
+				for (auto rootChild : rootChildren)
+				{
+					nodeCallStack.emplace(std::make_pair(rootChild, mat4(1.f)));
+				}
+
+				while (!nodeCallStack.empty())
+				{
+					NodeCall nodeCall = nodeCallStack.top();
+					nodeCallStack.pop();
+
+					uint32_t* drawableHandle = nullptr;
+					auto parentMat = nodeCall.first->CalculateWorldTransform(nodeCall.second, &drawableHandle);
+					if (drawableHandle != nullptr)
+					{
+						nodeInstances[*drawableHandle].m_transformation = parentMat;
+						nodeInstances[*drawableHandle].m_transformationInverseTranspose = glm::inverse(glm::transpose(parentMat));
+					}
+					for (auto child : nodeCall.first->m_children)
+					{
+						nodeCallStack.emplace(std::make_pair(child, parentMat));
+					}
+				}
+			};
+
+			const uint32_t iterations = 4000000 / nodeCount;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				updateNodes();
+			}
+			auto nodesUpdated = std::chrono::high_resolution_clock::now();
+			//dirty roots, so every node is updated like in the node graph
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				for (uint32_t root = 0; root < 16; root++)
+				{
+					scene.m_hierarchy.SetLocalTransform(root, scene.m_hierarchy.GetLocalTransform(root));
+				}
+				scene.UpdateInstanceTransforms();
+			}
+			auto flattenedUpdated = std::chrono::high_resolution_clock::now();
+			//the last node has no children
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				scene.m_hierarchy.SetLocalTransform(nodeCount - 1, scene.m_hierarchy.GetLocalTransform(nodeCount - 1));
+				scene.UpdateInstanceTransforms();
+			}
+			auto oneMovedUpdated = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				scene.UpdateInstanceTransforms();
+			}
+			auto staticUpdated = std::chrono::high_resolution_clock::now();
+
+			float maxDifference = 0.f;
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				AffineTransform nodeTransform = AffineTransform(nodeInstances[i].m_transformation);
+				for (int row = 0; row < 3; row++)
+				{
+					vec4 difference = glm::abs(nodeTransform.m_rows[row] - scene.m_drawableInstances[i].m_transformation.m_rows[row]);
+					maxDifference = glm::max(maxDifference, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+				}
+			}
+
+			float nodesMs = std::chrono::duration<float, std::milli>(nodesUpdated - start).count() / iterations;
+			float flattenedMs = std::chrono::duration<float, std::milli>(flattenedUpdated - nodesUpdated).count() / iterations;
+			float oneMovedMs = std::chrono::duration<float, std::milli>(oneMovedUpdated - flattenedUpdated).count() / iterations;
+			float staticMs = std::chrono::duration<float, std::milli>(staticUpdated - oneMovedUpdated).count() / iterations;
+			Logger::Log(std::to_string(nodeCount) + ", " + std::to_string(nodesMs) + ", " + std::to_string(flattenedMs) + ", "
+				+ std::to_string(nodesMs / flattenedMs) + ", " + std::to_string(maxDifference) + ", " + std::to_string(oneMovedMs) + ", " + std::to_string(staticMs));
+		}
+
+		return true;
+	}
+
+	//full transform updates of random hierarchies per thread count, compared bit for bit with the serial update
+	bool Renderer::BenchmarkTransformThreads()
+	{
+		Logger::Log(std::to_string(std::thread::hardware_concurrency()) + " hardware threads.");
+		Logger::Log("nodes, threads, ms, speedup, identical");
+		for (uint32_t nodeCount : { 100000u, 1000000u })
+		{
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+			Scene scene;
+			scene.m_hierarchy.Reserve(nodeCount);
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				mat4 localTransform = glm::rotate(glm::translate(mat4(1.f), vec3(distribution(generator), distribution(generator), distribution(generator))),
+					distribution(generator), vec3(0.f, 1.f, 0.f));
+				uint32_t parent = i < 16 ? SceneHierarchy::m_noParent : static_cast<uint32_t>(generator() % i);
+				scene.m_hierarchy.CreateNode(parent, localTransform, scene.CreateDrawableInstance(0, false));
+			}
+
+			std::vector<DrawableInstance> serialInstances;
+			float serialMs = 0.f;
+			const uint32_t iterations = 10000000 / nodeCount;
+			for (uint32_t threadCount : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+			{
+				ThreadPool pool(threadCount);
+				scene.SetThreadPool(pool);
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					//every node below the roots is updated
+					for (uint32_t root = 0; root < 16; root++)
+					{
+						scene.m_hierarchy.SetLocalTransform(root, scene.m_hierarchy.GetLocalTransform(root));
+					}
+					scene.UpdateInstanceTransforms();
+				}
+				float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+				if (threadCount == 1)
+				{
+					serialInstances = scene.m_drawableInstances;
+					serialMs = ms;
+				}
+				bool identical = memcmp(serialInstances.data(), scene.m_drawableInstances.data(), serialInstances.size() * sizeof(DrawableInstance)) == 0;
+				Logger::Log(std::to_string(nodeCount) + ", " + std::to_string(threadCount) + ", " + std::to_string(ms) + ", "
+					+ std::to_string(serialMs / ms) + ", " + (identical ? "yes" : "no"));
+			}
+		}
+
+		return true;
+	}
+
+	//compose, inverse and normal matrix of 1M random transforms as mat4 with glm and as affine 3x4 with the SIMD kernels
+	bool Renderer::BenchmarkAffine()
+	{
+		constexpr uint32_t transformCount = 1000000;
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+		std::vector<mat4> matrices(transformCount), parentMatrices(transformCount), resultMatrices(transformCount);
+		std::vector<AffineTransform> transforms(transformCount), parentTransforms(transformCount), resultTransforms(transformCount);
+		for (uint32_t i = 0; i < transformCount; i++)
+		{
+			vec3 axis = glm::normalize(vec3(distribution(generator), distribution(generator), distribution(generator)) + vec3(0.f, 0.01f, 0.f));
+			matrices[i] = glm::scale(glm::rotate(glm::translate(mat4(1.f), 10.f * vec3(distribution(generator), distribution(generator), distribution(generator))),
+				3.f * distribution(generator), axis), vec3(1.5f) + vec3(distribution(generator), distribution(generator), distribution(generator)));
+			parentMatrices[i] = glm::rotate(glm::translate(mat4(1.f), vec3(distribution(generator), distribution(generator), distribution(generator))),
+				3.f * distribution(generator), axis);
+			transforms[i] = AffineTransform(matrices[i]);
+			parentTransforms[i] = AffineTransform(parentMatrices[i]);
+		}
+
+		//largest difference between the mat4 results and the affine ones
+		auto maxDifference = [&]()
+		{
+			float difference = 0.f;
+			for (uint32_t i = 0; i < transformCount; i++)
+			{
+				AffineTransform reference = AffineTransform(resultMatrices[i]);
+				for (int row = 0; row < 3; row++)
+				{
+					vec4 rowDifference = glm::abs(reference.m_rows[row] - resultTransforms[i].m_rows[row]);
+					difference = glm::max(difference, glm::max(glm::max(rowDifference.x, rowDifference.y), glm::max(rowDifference.z, rowDifference.w)));
+				}
+			}
+			return difference;
+		};
+
+		Logger::Log("instance size, mat4 bytes " + std::to_string(2 * sizeof(mat4) + 4 * sizeof(uint32_t)) + ", affine bytes " + std::to_string(sizeof(DrawableInstance)));
+		Logger::Log(std::string(simdName) + ", operation, mat4 ms, affine ms, speedup, max difference");
+		auto log = [&](const char* operation, auto runMatrices, auto runTransforms)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			runMatrices();
+			auto matricesDone = std::chrono::high_resolution_clock::now();
+			runTransforms();
+			auto transformsDone = std::chrono::high_resolution_clock::now();
+
+			float matricesMs = std::chrono::duration<float, std::milli>(matricesDone - start).count();
+			float transformsMs = std::chrono::duration<float, std::milli>(transformsDone - matricesDone).count();
+			Logger::Log(std::string(operation) + ", " + std::to_string(matricesMs) + ", " + std::to_string(transformsMs) + ", "
+				+ std::to_string(matricesMs / transformsMs) + ", " + std::to_string(maxDifference()));
+		};
+
+		log("compose", [&]()
+			{
+				for (uint32_t i = 0; i < transformCount; i++)
+				{
+					resultMatrices[i] = parentMatrices[i] * matrices[i];
+				}
+			}, [&]()
+			{
+				ComposeBatch(parentTransforms.data(), transforms.data(), resultTransforms.data(), transformCount);
+			});
+		log("inverse", [&]()
+			{
+				for (uint32_t i = 0; i < transformCount; i++)
+				{
+					resultMatrices[i] = glm::inverse(matrices[i]);
+				}
+			}, [&]()
+			{
+				InverseBatch(transforms.data(), resultTransforms.data(), transformCount);
+			});
+		//what Scene::UpdateInstanceTransforms computed for every instance before
+		log("normal matrix", [&]()
+			{
+				for (uint32_t i = 0; i < transformCount; i++)
+				{
+					resultMatrices[i] = glm::inverse(glm::transpose(matrices[i]));
+				}
+			}, [&]()
+			{
+				NormalMatrixBatch(transforms.data(), resultTransforms.data(), transformCount);
+			});
+
+		return true;
+	}
+
+	//spatial index update per frame while a share of the instances moves, then frustum, sphere and ray queries against linear scans,
+	//for cubes scattered in a volume that grows with their count
+	bool Renderer::BenchmarkInstances()
+	{
+		Logger::Log("instances, moved per frame, update ms, rebuilds, frustum ms, linear frustum ms, sphere us, linear sphere us, ray us, linear ray us, identical");
+		for (uint32_t instanceCount : { 10000u, 100000u, 1000000u })
+		{
+			for (float movedShare : { 0.01f, 0.1f, 1.f })
+			{
+				std::mt19937 generator(0);
+				std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+				const float extent = 4.f * std::cbrt(static_cast<float>(instanceCount));
+
+				Scene scene;
+				Drawable cube;
+				cube.Init(m_memoryManager);
+				scene.m_drawables.emplace_back(cube);
+				scene.m_hierarchy.Reserve(instanceCount);
+				std::vector<vec3> positions(instanceCount), velocities(instanceCount);
+				std::vector<uint32_t> nodes(instanceCount);
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					positions[i] = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+					velocities[i] = 0.1f * vec3(distribution(generator), distribution(generator), distribution(generator));
+					nodes[i] = scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), positions[i]), scene.CreateDrawableInstance(0, false));
+				}
+				scene.UpdateInstanceTransforms();
+
+				InstanceIndex index;
+				index.Build(scene);
+
+				//every frame another slice of the instances moves along its velocity
+				constexpr uint32_t frameCount = 30;
+				const uint32_t movedCount = static_cast<uint32_t>(instanceCount * movedShare);
+				float updateMs = 0.f;
+				for (uint32_t frame = 0; frame < frameCount; frame++)
+				{
+					for (uint32_t i = 0; i < movedCount; i++)
+					{
+						uint32_t instance = static_cast<uint32_t>((static_cast<uint64_t>(frame) * movedCount + i) % instanceCount);
+						positions[instance] += velocities[instance];
+						scene.m_hierarchy.SetLocalTransform(nodes[instance], glm::translate(mat4(1.f), positions[instance]));
+					}
+					scene.UpdateInstanceTransforms();
+
+					auto start = std::chrono::high_resolution_clock::now();
+					index.Update(scene.GetChangedInstances());
+					updateMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				}
+
+				//both sides have to find the same instances
+				bool identical = true;
+				std::vector<uint32_t> found, linearFound;
+				auto compare = [&]()
+				{
+					std::sort(found.begin(), found.end());
+					identical = identical && found == linearFound;
+				};
+
+				//a 60 degree camera in the middle, looking along +z
+				mat4 viewProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, extent) *
+					glm::lookAt(vec3(0.f), vec3(0.f, 0.f, 1.f), vec3(0.f, 1.f, 0.f));
+				Frustum frustum(viewProjection);
+				auto start = std::chrono::high_resolution_clock::now();
+				index.QueryFrustum(frustum, found);
+				auto indexed = std::chrono::high_resolution_clock::now();
+				linearFound.clear();
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					if (frustum.Intersects(index.GetBounds(i)))
+						linearFound.emplace_back(i);
+				}
+				auto linear = std::chrono::high_resolution_clock::now();
+				compare();
+				float frustumMs = std::chrono::duration<float, std::milli>(indexed - start).count();
+				float linearFrustumMs = std::chrono::duration<float, std::milli>(linear - indexed).count();
+
+				constexpr uint32_t queryCount = 100;
+				float sphereUs = 0.f, linearSphereUs = 0.f, rayUs = 0.f, linearRayUs = 0.f;
+				for (uint32_t query = 0; query < queryCount; query++)
+				{
+					vec3 center = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+					constexpr float radius = 8.f;
+					start = std::chrono::high_resolution_clock::now();
+					index.QuerySphere(center, radius, found);
+					indexed = std::chrono::high_resolution_clock::now();
+					linearFound.clear();
+					for (uint32_t i = 0; i < instanceCount; i++)
+					{
+						if (SquaredDistance(index.GetBounds(i), center) <= radius * radius)
+							linearFound.emplace_back(i);
+					}
+					linear = std::chrono::high_resolution_clock::now();
+					compare();
+					sphereUs += std::chrono::duration<float, std::micro>(indexed - start).count();
+					linearSphereUs += std::chrono::duration<float, std::micro>(linear - indexed).count();
+
+					Ray ray;
+					ray.m_origin = center;
+					ray.m_direction = glm::normalize(vec3(distribution(generator), distribution(generator), distribution(generator)) + vec3(0.f, 0.f, 0.01f));
+					const vec3 inverseDirection = 1.f / ray.m_direction;
+					start = std::chrono::high_resolution_clock::now();
+					index.QueryRay(ray, found);
+					indexed = std::chrono::high_resolution_clock::now();
+					linearFound.clear();
+					for (uint32_t i = 0; i < instanceCount; i++)
+					{
+						if (IntersectAABB(index.GetBounds(i), ray, inverseDirection) != FLT_MAX)
+							linearFound.emplace_back(i);
+					}
+					linear = std::chrono::high_resolution_clock::now();
+					compare();
+					rayUs += std::chrono::duration<float, std::micro>(indexed - start).count();
+					linearRayUs += std::chrono::duration<float, std::micro>(linear - indexed).count();
+				}
+
+				Logger::Log(std::to_string(instanceCount) + ", " + std::to_string(movedCount) + ", " + std::to_string(updateMs / frameCount) + ", "
+					+ std::to_string(index.GetRebuildCount()) + ", " + std::to_string(frustumMs) + ", " + std::to_string(linearFrustumMs) + ", "
+					+ std::to_string(sphereUs / queryCount) + ", " + std::to_string(linearSphereUs / queryCount) + ", " + std::to_string(rayUs / queryCount) + ", "
+					+ std::to_string(linearRayUs / queryCount) + ", " + (identical ? "yes" : "no"));
+			}
+		}
+
+		return true;
+	}
+
+	//objects of a root and a child node with a cube each, every frame a number of them is despawned by removing the root and as many are spawned,
+	//the pools have to stay dense, stale handles invalid and the instances of the remaining objects at their world transforms
+	bool Renderer::BenchmarkSpawn()
+	{
+		Logger::Log("objects, spawned and despawned per frame, frame ms, nodes, instances, handles valid, transforms identical");
+		for (uint32_t objectCount : { 10000u, 100000u })
+		{
+			for (uint32_t spawnCount : { 100u, 1000u, 10000u })
+			{
+				std::mt19937 generator(0);
+				std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+				const float extent = 4.f * std::cbrt(static_cast<float>(objectCount));
+
+				Scene scene;
+				Drawable cube;
+				cube.Init(m_memoryManager);
+				scene.m_drawables.emplace_back(cube);
+				scene.m_hierarchy.Reserve(2 * objectCount);
+				scene.ReserveDrawableInstances(2 * objectCount);
+
+				struct Object
+				{
+					uint32_t m_root;
+					uint32_t m_child;
+				};
+				std::vector<Object> objects(objectCount);
+				auto spawn = [&](Object& object)
+				{
+					vec3 position = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+					object.m_root = scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), position), scene.CreateDrawableInstance(0, false));
+					object.m_child = scene.m_hierarchy.CreateNode(object.m_root, glm::translate(mat4(1.f), vec3(0.f, 2.f, 0.f)), scene.CreateDrawableInstance(0, false));
+				};
+				for (Object& object : objects)
+				{
+					spawn(object);
+				}
+				scene.UpdateInstanceTransforms();
+
+				//without spatial index or ray queries, only the pools and the transform update are measured
+				constexpr uint32_t frameCount = 30;
+				std::vector<Object> despawned;
+				float frameMs = 0.f;
+				for (uint32_t frame = 0; frame < frameCount; frame++)
+				{
+					auto start = std::chrono::high_resolution_clock::now();
+					for (uint32_t i = 0; i < spawnCount; i++)
+					{
+						Object& object = objects[generator() % objectCount];
+						despawned.emplace_back(object);
+						scene.m_hierarchy.RemoveNode(object.m_root);
+						spawn(object);
+					}
+					scene.UpdateInstanceTransforms();
+					frameMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				}
+
+				bool valid = scene.m_hierarchy.GetNodeCount() == 2 * objectCount && scene.m_drawableInstances.size() == 2 * objectCount;
+				for (const Object& object : despawned)
+				{
+					valid = valid && !scene.m_hierarchy.IsValid(object.m_root) && !scene.m_hierarchy.IsValid(object.m_child);
+				}
+				bool identical = true;
+				for (const Object& object : objects)
+				{
+					for (uint32_t node : { object.m_root, object.m_child })
+					{
+						valid = valid && scene.m_hierarchy.IsValid(node) && scene.IsValidDrawableInstance(scene.m_hierarchy.GetDrawableInstance(node));
+						if (!valid)
+							break;
+						const DrawableInstance& instance = scene.m_drawableInstances[scene.GetDrawableInstanceIndex(scene.m_hierarchy.GetDrawableInstance(node))];
+						identical = identical && instance.m_transformation == scene.m_hierarchy.GetWorldTransform(node);
+					}
+				}
+
+				Logger::Log(std::to_string(objectCount) + ", " + std::to_string(spawnCount) + ", " + std::to_string(frameMs / frameCount) + ", "
+					+ std::to_string(scene.m_hierarchy.GetNodeCount()) + ", " + std::to_string(scene.m_drawableInstances.size()) + ", "
+					+ (valid ? "yes" : "no") + ", " + (identical ? "yes" : "no"));
+			}
+		}
+
+		return true;
+	}
+
+	//draw calls and build time of static batches for scattered cubes, then the per frame outdated check while dynamic cubes move and respawn
+	bool Renderer::BenchmarkStaticBatching()
+	{
+		Logger::Log("static objects, draw calls unbatched, draw calls batched, build ms, merged vertices, check ms with dynamic churn, rebuilds from churn, static move detected");
+		for (uint32_t staticCount : { 1000u, 10000u, 100000u })
+		{
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+			const float extent = 4.f * std::cbrt(static_cast<float>(staticCount));
+			const uint32_t dynamicCount = staticCount / 10;
+
+			Scene scene;
+			Drawable cube;
+			cube.Init(m_memoryManager);
+			scene.m_drawables.emplace_back(cube);
+			scene.m_hierarchy.Reserve(staticCount + dynamicCount);
+			scene.ReserveDrawableInstances(staticCount + dynamicCount);
+
+			auto createObject = [&](bool isStatic)
+			{
+				vec3 position = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+				return scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), position), scene.CreateDrawableInstance(0, isStatic));
+			};
+			std::vector<uint32_t> staticNodes(staticCount);
+			std::vector<uint32_t> dynamicNodes(dynamicCount);
+			//interleaved, so removing dynamic objects moves static instances to other indices
+			for (uint32_t i = 0; i < staticCount; i++)
+			{
+				staticNodes[i] = createObject(true);
+				if (i % 10 == 0)
+					dynamicNodes[i / 10] = createObject(false);
+			}
+			scene.UpdateInstanceTransforms();
+
+			StaticBatcher batcher;
+			auto start = std::chrono::high_resolution_clock::now();
+			batcher.Build(scene);
+			float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			//every frame a tenth of the dynamic objects move and a hundredth is despawned and spawned again
+			constexpr uint32_t frameCount = 30;
+			uint32_t rebuilds = 0;
+			float checkMs = 0.f;
+			for (uint32_t frame = 0; frame < frameCount; frame++)
+			{
+				for (uint32_t i = 0; i < dynamicCount / 10; i++)
+				{
+					uint32_t node = dynamicNodes[generator() % dynamicCount];
+					vec3 position = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+					scene.m_hierarchy.SetLocalTransform(node, glm::translate(mat4(1.f), position));
+				}
+				for (uint32_t i = 0; i < dynamicCount / 100; i++)
+				{
+					uint32_t& node = dynamicNodes[generator() % dynamicCount];
+					scene.m_hierarchy.RemoveNode(node);
+					node = createObject(false);
+				}
+				scene.UpdateInstanceTransforms();
+
+				start = std::chrono::high_resolution_clock::now();
+				if (batcher.IsOutdated(scene))
+				{
+					rebuilds++;
+					batcher.Build(scene);
+				}
+				checkMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+
+			scene.m_hierarchy.SetLocalTransform(staticNodes[generator() % staticCount], glm::translate(mat4(1.f), vec3(0.f)));
+			scene.UpdateInstanceTransforms();
+			bool detected = batcher.IsOutdated(scene);
+
+			Logger::Log(std::to_string(staticCount) + ", " + std::to_string(staticCount + dynamicCount) + ", "
+				+ std::to_string(batcher.GetBatches().size() + dynamicCount) + ", " + std::to_string(buildMs) + ", "
+				+ std::to_string(batcher.GetBatchedVertexCount()) + ", " + std::to_string(checkMs / frameCount) + ", "
+				+ std::to_string(rebuilds) + ", " + (detected ? "yes" : "no"));
+			batcher.Fini();
+		}
+
+		return true;
+	}
+
+	//memory and creation time of 1M copies as nodes against one bulk inserted instance stream, the unpack error, then upload and frame time
+	bool Renderer::BenchmarkInstanceStreams()
+	{
+		if (m_scene.m_drawables.empty())
+		{
+			Logger::Log("Instance stream benchmark needs a loaded drawable.");
+			return false;
+		}
+
+		constexpr uint32_t copyCount = 1000000;
+		const float extent = 4.f * std::cbrt(static_cast<float>(copyCount));
+
+		//the smallest drawable, the descriptor arrays of the pipelines are sized for the loaded ones
+		uint32_t drawableIndex = 0;
+		for (uint32_t i = 1; i < m_scene.m_drawables.size(); i++)
+		{
+			if (m_scene.m_drawables[i].GetVertices().size() < m_scene.m_drawables[drawableIndex].GetVertices().size())
+				drawableIndex = i;
+		}
+		const uint32_t materialCount = static_cast<uint32_t>(m_scene.m_drawables[drawableIndex].GetMaterials().size());
+
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+		std::vector<vec3> positions(copyCount);
+		std::vector<vec3> axes(copyCount);
+		std::vector<float> angles(copyCount);
+		std::vector<float> scales(copyCount);
+		for (uint32_t i = 0; i < copyCount; i++)
+		{
+			positions[i] = extent * vec3(distribution(generator), distribution(generator), distribution(generator));
+			axes[i] = glm::normalize(vec3(distribution(generator), distribution(generator), distribution(generator)) + vec3(0.f, 0.f, 1e-3f));
+			angles[i] = 3.14159265f * distribution(generator);
+			scales[i] = 0.75f + 0.25f * distribution(generator);
+		}
+		auto rotation = [&](uint32_t i)
+		{
+			return vec4(axes[i] * std::sin(angles[i] * 0.5f), std::cos(angles[i] * 0.5f));
+		};
+
+		//the same copies as nodes with drawable instances
+		auto start = std::chrono::high_resolution_clock::now();
+		{
+			Scene scene;
+			scene.m_drawables.emplace_back(m_scene.m_drawables[drawableIndex]);
+			scene.m_hierarchy.Reserve(copyCount);
+			scene.ReserveDrawableInstances(copyCount);
+			for (uint32_t i = 0; i < copyCount; i++)
+			{
+				CompactInstance compactInstance = PackCompactInstance(positions[i], rotation(i), scales[i]);
+				scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, UnpackTransform(compactInstance), scene.CreateDrawableInstance(0, true));
+			}
+			scene.UpdateInstanceTransforms();
+			//the copied drawable's buffers belong to m_scene
+			scene.m_drawables.clear();
+		}
+		float nodeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		const size_t nodeBytes = sizeof(DrawableInstance) + 2 * sizeof(AffineTransform) + 4 * sizeof(uint32_t);
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<CompactInstance> compactInstances(copyCount);
+		for (uint32_t i = 0; i < copyCount; i++)
+		{
+			//every fourth copy shows another material of the drawable
+			uint32_t materialOverride = materialCount && i % 4 == 0 ? i % materialCount : CompactInstance::m_noMaterialOverride;
+			compactInstances[i] = PackCompactInstance(positions[i], rotation(i), scales[i], materialOverride);
+		}
+		const uint32_t stream = m_scene.CreateInstanceStream(drawableIndex);
+		m_scene.AddStreamInstances(stream, compactInstances.data(), compactInstances.size());
+		float streamMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		//largest difference between the unpacked transforms and the exact ones, as a distance at the drawable's bounds
+		const AABB& bounds = m_scene.m_drawables[drawableIndex].GetBoundingBox();
+		const vec3 corner = glm::max(glm::abs(bounds.m_min), glm::abs(bounds.m_max));
+		float maxError = 0.f;
+		for (uint32_t i = 0; i < copyCount; i++)
+		{
+			AffineTransform exact(glm::translate(mat4(1.f), positions[i]) * glm::rotate(mat4(1.f), angles[i], axes[i]) * glm::scale(mat4(1.f), vec3(scales[i])));
+			vec3 difference = UnpackTransform(compactInstances[i]).TransformPoint(corner) - exact.TransformPoint(corner);
+			float error = glm::length(difference);
+			maxError = error > maxError ? error : maxError;
+		}
+
+		Logger::Log("copies, bytes per copy as nodes, as compact instances, create ms as nodes, bulk insert ms, max unpack error");
+		Logger::Log(std::to_string(copyCount) + ", " + std::to_string(nodeBytes) + ", " + std::to_string(sizeof(CompactInstance)) + ", "
+			+ std::to_string(nodeMs) + ", " + std::to_string(streamMs) + ", " + std::to_string(maxError));
+
+		//the first frame uploads the stream, raytracing adds every copy to the TLAS
+		Logger::Log("mode, upload ms, ms per frame");
+		for (int mode = 0; mode < (m_hasRaytracingCapabilities ? 2 : 1); mode++)
+		{
+			m_useRaytracing = mode == 1;
+			m_scene.ClearInstanceStream(stream);
+			m_scene.AddStreamInstances(stream, compactInstances.data(), compactInstances.size());
+
+			start = std::chrono::high_resolution_clock::now();
+			BenchmarkFrame();
+			vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+			float uploadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			constexpr uint32_t frames = 30;
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < frames; i++)
+			{
+				BenchmarkFrame();
+			}
+			vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+			float frameMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+
+			Logger::Log(std::string(mode ? "raytraced" : "rasterized") + ", " + std::to_string(uploadMs) + ", " + std::to_string(frameMs));
+		}
+
+		m_useRaytracing = false;
+		m_scene.ClearInstanceStream(stream);
+		BenchmarkFrame();
+
+		return true;
+	}
+
+	//recording and frame time of 10k and 100k objects in the view frustum per number of recording threads
+	bool Renderer::BenchmarkRecording()
+	{
+		if (m_scene.m_drawables.empty())
+		{
+			Logger::Log("Recording benchmark needs a loaded drawable.");
+			return false;
+		}
+
+		std::vector<uint32_t> threadCounts;
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2)
+		{
+			threadCounts.emplace_back(threads);
+		}
+		threadCounts.emplace_back(hardwareThreads > 1 ? hardwareThreads : 1);
+
+		//the smallest drawable, so the gpu keeps up with the draw calls
+		uint32_t drawableIndex = 0;
+		for (uint32_t i = 1; i < m_scene.m_drawables.size(); i++)
+		{
+			if (m_scene.m_drawables[i].GetIndices().size() < m_scene.m_drawables[drawableIndex].GetIndices().size())
+				drawableIndex = i;
+		}
+
+		m_useRaytracing = false;
+		Logger::Log("objects, draw calls, recording threads, recording ms, frame ms");
+		for (uint32_t objectCount : { 10000u, 100000u })
+		{
+			//spread through the view frustum of the camera, so culling keeps every object
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> distribution(0.f, 1.f);
+			const mat4 viewInverse = m_camera.GetCameraMatrices().viewInverse;
+			std::vector<uint32_t> nodes(objectCount);
+			for (uint32_t& node : nodes)
+			{
+				float distance = 10.f + 190.f * distribution(generator);
+				vec3 viewPosition = vec3(0.7f * distance * (distribution(generator) - 0.5f), 0.7f * distance * (distribution(generator) - 0.5f), -distance);
+				vec3 position = vec3(viewInverse * vec4(viewPosition, 1.f));
+				node = m_scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), position), m_scene.CreateDrawableInstance(drawableIndex, false));
+			}
+
+			for (uint32_t threads : threadCounts)
+			{
+				m_rasterizationPipeline.SetRecordingThreadCount(threads);
+				//the first frames upload the transforms and create the secondary command buffers
+				BenchmarkFrame();
+				BenchmarkFrame();
+				vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+
+				constexpr uint32_t frameCount = 30;
+				float recordingMs = 0.f;
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t frame = 0; frame < frameCount; frame++)
+				{
+					BenchmarkFrame();
+					recordingMs += m_rasterizationPipeline.GetRecordingMs();
+				}
+				vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+				float frameMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+				Logger::Log(std::to_string(objectCount) + ", " + std::to_string(m_rasterizationPipeline.GetDrawCallCount()) + ", "
+					+ std::to_string(threads) + ", " + std::to_string(recordingMs / frameCount) + ", " + std::to_string(frameMs));
+			}
+
+			for (uint32_t node : nodes)
+			{
+				m_scene.m_hierarchy.RemoveNode(node);
+			}
+		}
+
+		m_rasterizationPipeline.SetRecordingThreadCount(1);
+		BenchmarkFrame();
+
+		return true;
+	}
+
+	//scheduling cost of tiny tasks, speedup of heavy parallel loops, a layered task graph and the scene's transform update, and where the
+	//heavy loop's tasks ran according to the pool's instrumentation
+	bool Renderer::BenchmarkJobs()
+	{
+		std::vector<uint32_t> threadCounts;
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2)
+		{
+			threadCounts.emplace_back(threads);
+		}
+		threadCounts.emplace_back(hardwareThreads > 1 ? hardwareThreads : 1);
+
+		//some float work per task, its result is kept so it is not optimized away
+		auto work = [](uint32_t index, uint32_t iterations)
+		{
+			float value = static_cast<float>(index);
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				value = value * 0.9999f + 0.5f;
+			}
+			return value;
+		};
+
+		//16 layers of 64 tasks, each waiting for 4 tasks of the layer before
+		constexpr uint32_t layerCount = 16;
+		constexpr uint32_t layerWidth = 64;
+		std::vector<uint32_t> layerDone(layerCount * layerWidth);
+		std::vector<float> graphResults(layerCount * layerWidth);
+		std::atomic<bool> ordered{ true };
+		TaskGraph graph;
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			for (uint32_t i = 0; i < layerWidth; i++)
+			{
+				const uint32_t task = graph.AddTask("graph task", [&, layer, i]()
+					{
+						for (uint32_t j = 0; layer > 0 && j < 4; j++)
+						{
+							if (!layerDone[(layer - 1) * layerWidth + (i + j) % layerWidth])
+								ordered = false;
+						}
+						graphResults[layer * layerWidth + i] = work(i, 20000);
+						layerDone[layer * layerWidth + i] = 1;
+					});
+				for (uint32_t j = 0; layer > 0 && j < 4; j++)
+				{
+					graph.AddDependency((layer - 1) * layerWidth + (i + j) % layerWidth, task);
+				}
+			}
+		}
+
+		//100k cubes moving every frame, refit for ray queries and updated in the spatial index
+		constexpr uint32_t instanceCount = 100000;
+		std::mt19937 generator(0);
+		std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+		Scene scene;
+		Drawable cube;
+		cube.Init(m_memoryManager);
+		scene.m_drawables.emplace_back(cube);
+		scene.m_hierarchy.Reserve(instanceCount);
+		std::vector<vec3> positions(instanceCount);
+		std::vector<uint32_t> nodes(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			positions[i] = 200.f * vec3(distribution(generator), distribution(generator), distribution(generator));
+			nodes[i] = scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, glm::translate(mat4(1.f), positions[i]), scene.CreateDrawableInstance(0, false));
+		}
+		scene.UpdateInstanceTransforms();
+		scene.SetThreadPool(m_threadPool);
+		scene.EnableRayQueries();
+		scene.EnableSpatialIndex();
+
+		Logger::Log(std::to_string(hardwareThreads) + " hardware threads.");
+		Logger::Log("threads, tiny task ns, heavy ms, heavy speedup, graph ms, graph speedup, scene update ms, scene speedup, ordered");
+		float serialHeavyMs = 0.f, serialGraphMs = 0.f, serialSceneMs = 0.f;
+		std::vector<std::string> placements;
+		for (uint32_t threads : threadCounts)
+		{
+			ThreadPool pool(threads);
+
+			constexpr uint32_t tinyCount = 1000000;
+			std::vector<uint32_t> tinyResults(tinyCount);
+			auto start = std::chrono::high_resolution_clock::now();
+			pool.ParallelFor(tinyCount, [&](uint32_t i) { tinyResults[i] = i; });
+			float tinyNs = std::chrono::duration<float, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / tinyCount;
+
+			constexpr uint32_t heavyCount = 4096;
+			std::vector<float> heavyResults(heavyCount);
+			pool.SetInstrumentation(true);
+			start = std::chrono::high_resolution_clock::now();
+			pool.ParallelFor(heavyCount, [&](uint32_t i) { heavyResults[i] = work(i, 20000); }, "heavy");
+			float heavyMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			pool.SetInstrumentation(false);
+			std::vector<TaskRecord> records = pool.TakeRecords();
+
+			std::fill(layerDone.begin(), layerDone.end(), 0);
+			start = std::chrono::high_resolution_clock::now();
+			pool.Run(graph);
+			float graphMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			scene.SetThreadPool(pool);
+			constexpr uint32_t frameCount = 10;
+			float sceneMs = 0.f;
+			for (uint32_t frame = 0; frame < frameCount; frame++)
+			{
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					positions[i].y += 0.01f;
+					scene.m_hierarchy.SetLocalTransform(nodes[i], glm::translate(mat4(1.f), positions[i]));
+				}
+				start = std::chrono::high_resolution_clock::now();
+				scene.UpdateInstanceTransforms();
+				sceneMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+			}
+
+			if (threads == 1)
+			{
+				serialHeavyMs = heavyMs;
+				serialGraphMs = graphMs;
+				serialSceneMs = sceneMs;
+			}
+			Logger::Log(std::to_string(threads) + ", " + std::to_string(tinyNs) + ", " + std::to_string(heavyMs) + ", " + std::to_string(serialHeavyMs / heavyMs) + ", "
+				+ std::to_string(graphMs) + ", " + std::to_string(serialGraphMs / graphMs) + ", " + std::to_string(sceneMs) + ", "
+				+ std::to_string(serialSceneMs / sceneMs) + ", " + (ordered ? "yes" : "no"));
+
+			std::vector<uint32_t> threadTasks(threads);
+			std::vector<float> threadBusyMs(threads);
+			for (const TaskRecord& record : records)
+			{
+				threadTasks[record.m_thread]++;
+				threadBusyMs[record.m_thread] += record.m_endMs - record.m_startMs;
+			}
+			std::string placement = std::to_string(threads) + ":";
+			for (uint32_t thread = 0; thread < threads; thread++)
+			{
+				placement += " " + std::to_string(threadTasks[thread]) + " tasks/" + std::to_string(threadBusyMs[thread]) + " ms";
+			}
+			placements.emplace_back(placement);
+		}
+
+		Logger::Log("threads: heavy tasks and busy ms per thread, the calling thread last");
+		for (const std::string& placement : placements)
+		{
+			Logger::Log(placement);
+		}
+
+		return true;
+	}
+
+	//frame time and latency with the simulation after the previous frame finished on the gpu and while it executes,
+	//for an idle simulation and one updating 50k moving objects, rasterized and raytraced
+	bool Renderer::BenchmarkLatency()
+	{
+		if (m_scene.m_drawables.empty())
+		{
+			Logger::Log("Latency benchmark needs a loaded drawable.");
+			return false;
+		}
+
+		//the smallest drawable, so the frame time is not only the gpu's
+		uint32_t drawableIndex = 0;
+		for (uint32_t i = 1; i < m_scene.m_drawables.size(); i++)
+		{
+			if (m_scene.m_drawables[i].GetIndices().size() < m_scene.m_drawables[drawableIndex].GetIndices().size())
+				drawableIndex = i;
+		}
+
+		//children of a root rotated by the simulation, so every frame updates all of their transforms
+		const uint32_t objectNode = m_objectNode;
+		m_objectNode = m_scene.m_hierarchy.CreateNode(SceneHierarchy::m_noParent, mat4(1.f));
+		m_rotateObjects = true;
+
+		Logger::Log("moving objects, raytraced, pipeline depth, frame ms, simulation ms, record ms, latency ms");
+		for (uint32_t objectCount : { 0u, 50000u })
+		{
+			std::mt19937 generator(0);
+			std::uniform_real_distribution<float> distribution(-100.f, 100.f);
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				vec3 position = vec3(distribution(generator), distribution(generator), distribution(generator));
+				m_scene.m_hierarchy.CreateNode(m_objectNode, glm::translate(mat4(1.f), position), m_scene.CreateDrawableInstance(drawableIndex, false));
+			}
+
+			for (bool raytraced : { false, true })
+			{
+				if (raytraced && !m_hasRaytracingCapabilities)
+					continue;
+				m_useRaytracing = raytraced;
+
+				for (uint32_t depth = 1; depth <= m_maxPipelineDepth; depth++)
+				{
+					SetPipelineDepth(depth);
+					//the first frames upload the new instances and build the acceleration structures
+					BenchmarkFrame();
+					BenchmarkFrame();
+					vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+
+					//the latency after a frame is the one of the frame before, which the frame waited for
+					constexpr uint32_t frameCount = 60;
+					float simulationMs = 0.f, recordMs = 0.f, latencyMs = 0.f;
+					auto start = std::chrono::high_resolution_clock::now();
+					for (uint32_t frame = 0; frame < frameCount; frame++)
+					{
+						BenchmarkFrame();
+						simulationMs += m_submittedFrames[m_submittedSlot].m_simulationMs;
+						recordMs += m_recordMs;
+						latencyMs += m_latencyMs;
+					}
+					vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+					float frameMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frameCount;
+
+					Logger::Log(std::to_string(objectCount) + ", " + (raytraced ? "yes" : "no") + ", " + std::to_string(depth) + ", "
+						+ std::to_string(frameMs) + ", " + std::to_string(simulationMs / frameCount) + ", " + std::to_string(recordMs / frameCount) + ", "
+						+ std::to_string(latencyMs / frameCount));
+				}
+			}
+		}
+
+		m_scene.m_hierarchy.RemoveNode(m_objectNode);
+		m_objectNode = objectNode;
+		m_rotateObjects = false;
+		m_useRaytracing = false;
+		SetPipelineDepth(1);
+		BenchmarkFrame();
+
+		return true;
+	}
+
+	//the default manifest loaded one drawable after another like before and by LoadAssets on 1 thread and every hardware thread,
+	//the textures already exist, so their decoding is timed on its own
+	bool Renderer::BenchmarkLoading()
+	{
+		const AssetManifest manifest = CreateDefaultManifest();
+		//against the renderer's pool with every hardware thread
+		ThreadPool serialPool(1);
+
+		Logger::Log("loader, threads, total ms, cpu ms, upload ms, slowest mesh ms");
+		for (uint32_t run = 0; run < 3; run++)
+		{
+			std::vector<Drawable> drawables;
+			AssetLoadTimings timings;
+			if (run == 0)
+			{
+				auto start = std::chrono::steady_clock::now();
+				for (const std::string& path : manifest.m_meshes)
+				{
+					Drawable drawable;
+					if (path.empty() ? !drawable.Init(m_memoryManager) : !drawable.Init(m_memoryManager, path))
+						return false;
+					drawables.emplace_back(drawable);
+				}
+				timings.m_totalMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+				timings.m_threadCount = 1;
+			}
+			else
+			{
+				if (!LoadAssets(manifest, m_memoryManager, run == 1 ? serialPool : m_threadPool, drawables, timings))
+					return false;
+			}
+
+			float slowestMeshMs = 0.f;
+			for (float meshMs : timings.m_meshMs)
+			{
+				slowestMeshMs = meshMs > slowestMeshMs ? meshMs : slowestMeshMs;
+			}
+			Logger::Log(std::string(run == 0 ? "serial" : "manifest") + ", " + std::to_string(timings.m_threadCount) + ", " + std::to_string(timings.m_totalMs) + ", "
+				+ std::to_string(timings.m_cpuMs) + ", " + std::to_string(timings.m_uploadMs) + ", " + std::to_string(slowestMeshMs));
+
+			for (Drawable& drawable : drawables)
+			{
+				drawable.Fini();
+			}
+		}
+
+		std::vector<std::string> textureNames;
+		for (const auto& texture : m_memoryManager.GetTextureIDs())
+		{
+			textureNames.emplace_back(texture.first);
+		}
+		std::vector<DecodedTexture> decodedTextures(textureNames.size());
+		Logger::Log("texture decode, threads, ms");
+		for (ThreadPool* pool : { &serialPool, &m_threadPool })
+		{
+			auto start = std::chrono::steady_clock::now();
+			pool->ParallelFor(static_cast<uint32_t>(textureNames.size()), [&](uint32_t t)
+				{
+					DeviceMemoryManager::DecodeTexture(textureNames[t].c_str(), decodedTextures[t]);
+				}, "decode texture");
+			float decodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			for (DecodedTexture& texture : decodedTextures)
+			{
+				DeviceMemoryManager::FreeDecodedTexture(texture);
+			}
+			Logger::Log(std::to_string(textureNames.size()) + " textures, " + std::to_string(pool->GetThreadCount()) + ", " + std::to_string(decodeMs));
+		}
+
+		return true;
+	}
+
+	//the startup compilation of every pipeline with an emptied and then a filled cache, one pipeline after another and all at once,
+	//the driver may keep its own shader cache, which the cold runs do not clear
+	bool Renderer::BenchmarkPipelines()
+	{
+		vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+
+		Logger::Log("pipelines, cold ms, warm ms");
+		for (bool concurrent : { false, true })
+		{
+			float compileMs[2];
+			for (uint32_t warm = 0; warm < 2; warm++)
+			{
+				if (!warm && !m_pipelineCache.Clear())
+					return false;
+
+				auto start = std::chrono::steady_clock::now();
+				if (!CompilePipelines(concurrent))
+					return false;
+				compileMs[warm] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+			Logger::Log(std::string(concurrent ? "concurrent" : "one after another") + ", " + std::to_string(compileMs[0]) + ", " + std::to_string(compileMs[1]));
+		}
+
+		//the recompiled pipelines still have to draw
+		return BenchmarkFrame();
+	}
+}
\ No newline at end of file
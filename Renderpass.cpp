@@ -46,7 +46,7 @@ namespace MelonRenderer
 		return true;
 	}
 
-	bool Renderpass::BeginRenderpass(VkCommandBuffer& commandBuffer)
+	bool Renderpass::BeginRenderpass(VkCommandBuffer& commandBuffer, VkSubpassContents contents)
 	{
 		VkRenderPassBeginInfo renderPassBegin = {};
 		renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -58,7 +58,7 @@ namespace MelonRenderer
 		renderPassBegin.renderArea.extent = m_swapchain->GetExtent();
 		renderPassBegin.clearValueCount = m_clearValues.size();
 		renderPassBegin.pClearValues = m_clearValues.data();
-		vkCmdBeginRenderPass(commandBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBegin, contents);
 
 		return true;
 	}
@@ -98,4 +98,9 @@ namespace MelonRenderer
 	{
 		return &m_attachments[0];
 	}
+
+	VkClearValue* Renderpass::GetColorClearValuePointer()
+	{
+		return &m_clearValues[0];
+	}
 }
\ No newline at end of file
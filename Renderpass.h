@@ -13,7 +13,8 @@ namespace MelonRenderer
 		Renderpass(Swapchain* swapchain);
 
 		bool CreateRenderpass();
-		bool BeginRenderpass(VkCommandBuffer& commandBuffer);
+		//contents of the first subpass, later ones are advanced to by the pipelines
+		bool BeginRenderpass(VkCommandBuffer& commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		bool EndRenderpass(VkCommandBuffer& commandBuffer);
 
 		uint32_t AddAttachment(VkAttachmentDescription& attachment, VkClearValue& clearValue);
@@ -22,6 +23,7 @@ namespace MelonRenderer
 
 		VkRenderPass* GetVkRenderpass();
 		VkAttachmentDescription* GetColorAttachmentPointer();
+		VkClearValue* GetColorClearValuePointer();
 
 	protected:
 		std::vector<VkAttachmentDescription> m_attachments;
@@ -0,0 +1,133 @@
+#include "Sampling.h"
+
+#include <random>
+
+namespace MelonRenderer
+{
+	bool GenerateBlueNoise(uint32_t size, std::vector<float>& values)
+	{
+		const uint32_t pixelCount = size * size;
+		if (!pixelCount)
+		{
+			Logger::Log("Could not generate blue noise of size 0.");
+			return false;
+		}
+
+		//energy falloff for every toroidal offset
+		constexpr float sigma = 1.5f;
+		std::vector<float> gaussian(pixelCount);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float dx = static_cast<float>(x < size - x ? x : size - x);
+				float dy = static_cast<float>(y < size - y ? y : size - y);
+				gaussian[y * size + x] = exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+			}
+		}
+
+		std::vector<float> energy(pixelCount, 0.f);
+		std::vector<bool> pattern(pixelCount, false);
+		auto splat = [&](uint32_t pixel, float sign)
+		{
+			uint32_t px = pixel % size;
+			uint32_t py = pixel / size;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				const float* row = &gaussian[((y + size - py) % size) * size];
+				for (uint32_t x = 0; x < size; x++)
+				{
+					energy[y * size + x] += sign * row[(x + size - px) % size];
+				}
+			}
+		};
+		auto tightestCluster = [&]()
+		{
+			uint32_t result = 0;
+			float maxEnergy = -FLT_MAX;
+			for (uint32_t i = 0; i < pixelCount; i++)
+			{
+				if (pattern[i] && energy[i] > maxEnergy)
+				{
+					maxEnergy = energy[i];
+					result = i;
+				}
+			}
+			return result;
+		};
+		auto largestVoid = [&]()
+		{
+			uint32_t result = 0;
+			float minEnergy = FLT_MAX;
+			for (uint32_t i = 0; i < pixelCount; i++)
+			{
+				if (!pattern[i] && energy[i] < minEnergy)
+				{
+					minEnergy = energy[i];
+					result = i;
+				}
+			}
+			return result;
+		};
+
+		//fixed seed, the tile is the same on every run
+		std::mt19937 generator(628);
+		std::uniform_int_distribution<uint32_t> distribution(0, pixelCount - 1);
+		uint32_t initialCount = pixelCount / 10 > 0 ? pixelCount / 10 : 1;
+		for (uint32_t placed = 0; placed < initialCount;)
+		{
+			uint32_t pixel = distribution(generator);
+			if (pattern[pixel])
+				continue;
+			pattern[pixel] = true;
+			splat(pixel, 1.f);
+			placed++;
+		}
+
+		//move points from clusters into voids until the initial pattern is evenly spread
+		for (uint32_t iteration = 0; iteration < pixelCount; iteration++)
+		{
+			uint32_t cluster = tightestCluster();
+			pattern[cluster] = false;
+			splat(cluster, -1.f);
+
+			uint32_t emptiest = largestVoid();
+			pattern[emptiest] = true;
+			splat(emptiest, 1.f);
+			if (emptiest == cluster)
+				break;
+		}
+
+		std::vector<uint32_t> ranks(pixelCount);
+		std::vector<float> initialEnergy = energy;
+		std::vector<bool> initialPattern = pattern;
+
+		//ranks of the initial points, removing the tightest clusters first
+		for (uint32_t rank = initialCount; rank > 0; rank--)
+		{
+			uint32_t cluster = tightestCluster();
+			pattern[cluster] = false;
+			splat(cluster, -1.f);
+			ranks[cluster] = rank - 1;
+		}
+
+		//remaining ranks fill the largest voids
+		energy = initialEnergy;
+		pattern = initialPattern;
+		for (uint32_t rank = initialCount; rank < pixelCount; rank++)
+		{
+			uint32_t emptiest = largestVoid();
+			pattern[emptiest] = true;
+			splat(emptiest, 1.f);
+			ranks[emptiest] = rank;
+		}
+
+		values.resize(pixelCount);
+		for (uint32_t i = 0; i < pixelCount; i++)
+		{
+			values[i] = (ranks[i] + 0.5f) / pixelCount;
+		}
+
+		return true;
+	}
+}
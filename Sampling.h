@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Basics.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	//has to match the defines in shaders/sampler.glsl
+	enum SamplerType
+	{
+		SAMPLER_RANDOM = 0,
+		SAMPLER_SOBOL = 1,
+		SAMPLER_BLUE_NOISE = 2,
+		SAMPLER_COUNT
+	};
+
+	const char* const samplerNames[SAMPLER_COUNT] = { "random", "sobol (owen scrambled)", "blue noise" };
+
+	constexpr uint32_t blueNoiseSize = 64;
+
+	//void and cluster, ranks of a toroidal size x size tile mapped to (0, 1)
+	bool GenerateBlueNoise(uint32_t size, std::vector<float>& values);
+}
@@ -4,7 +4,7 @@ namespace MelonRenderer
 {
 	VkCommandBuffer& Swapchain::GetCommandBuffer()
 	{
-		return m_commandBuffers[m_imageIndex];
+		return m_commandBuffers[m_frameIndex];
 	}
 
 	VkFramebuffer& Swapchain::GetFramebuffer()
@@ -17,6 +17,21 @@ namespace MelonRenderer
 		return m_outputImages[m_imageIndex];
 	}
 
+	uint32_t Swapchain::GetImageIndex() const
+	{
+		return m_imageIndex;
+	}
+
+	uint32_t Swapchain::GetImageCount() const
+	{
+		return m_swapchainSize;
+	}
+
+	uint32_t Swapchain::GetFrameIndex() const
+	{
+		return m_frameIndex;
+	}
+
 	void Swapchain::AddAttachment(VkImageView attachment)
 	{
 		m_attachments.emplace_back(attachment);
@@ -27,25 +42,34 @@ namespace MelonRenderer
 		return m_extent;
 	}
 
-	bool Swapchain::AquireNextImage()
+	bool Swapchain::WaitForFrame()
 	{
-		VkResult result;
-		for (;;)
+		VkResult result = vkWaitForFences(Device::Get().m_device, 1, &m_fences[m_frameIndex], VK_TRUE, UINT64_MAX);
+		if (result != VK_SUCCESS)
 		{
-			result = vkWaitForFences(Device::Get().m_device, 1, &m_fences[m_imageIndex], VK_TRUE, 100);
-			if (result == VK_SUCCESS)
-			{
-				break;
-			}
-			else if (result == VK_TIMEOUT)
-			{
-				continue;
-			}
-			Logger::Log("Could not wait for fences before acquiring image.");
+			Logger::Log("Could not wait for the fence of the frame slot.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool Swapchain::WaitForSubmittedFrame()
+	{
+		const uint32_t submittedFrame = (m_frameIndex + maxFramesInFlight - 1) % maxFramesInFlight;
+		VkResult result = vkWaitForFences(Device::Get().m_device, 1, &m_fences[submittedFrame], VK_TRUE, UINT64_MAX);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not wait for the fence of the submitted frame.");
 			return false;
 		}
 
-		result = vkAcquireNextImageKHR(Device::Get().m_device, m_swapchain, UINT64_MAX, m_presentCompleteSemaphores[(m_imageIndex+1)%m_swapchainSize], 
+		return true;
+	}
+
+	bool Swapchain::AquireNextImage()
+	{
+		VkResult result = vkAcquireNextImageKHR(Device::Get().m_device, m_swapchain, UINT64_MAX, m_presentCompleteSemaphores[m_frameIndex], 
 			nullptr, &m_imageIndex);
 		if ((result != VK_SUCCESS) && (result != VK_SUBOPTIMAL_KHR))
 		{
@@ -59,7 +83,7 @@ namespace MelonRenderer
 
 	bool Swapchain::PresentImage(VkFence* drawFence)
 	{
-		VkResult result = vkResetFences(Device::Get().m_device, 1, &m_fences[m_imageIndex]);
+		VkResult result = vkResetFences(Device::Get().m_device, 1, &m_fences[m_frameIndex]);
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not reset fences before submitting cmd buffer to queue.");
@@ -71,19 +95,20 @@ namespace MelonRenderer
 		submitInfo[0].pNext = nullptr;
 		submitInfo[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo[0].waitSemaphoreCount = 1;
-		submitInfo[0].pWaitSemaphores = &m_presentCompleteSemaphores[m_imageIndex];
+		submitInfo[0].pWaitSemaphores = &m_presentCompleteSemaphores[m_frameIndex];
 		submitInfo[0].pWaitDstStageMask = &pipelineStageFlags;
 		submitInfo[0].commandBufferCount = 1;
-		const VkCommandBuffer cmd[] = { m_commandBuffers[m_imageIndex] };
+		const VkCommandBuffer cmd[] = { m_commandBuffers[m_frameIndex] };
 		submitInfo[0].pCommandBuffers = cmd;
 		submitInfo[0].signalSemaphoreCount = 1;
 		submitInfo[0].pSignalSemaphores = &m_renderCompleteSemaphores[m_imageIndex];
-		result = vkQueueSubmit(Device::Get().m_multipurposeQueue, 1, submitInfo, m_fences[m_imageIndex]);
+		result = vkQueueSubmit(Device::Get().m_multipurposeQueue, 1, submitInfo, m_fences[m_frameIndex]);
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not submit draw queue.");
 			return false;
 		}
+		m_frameIndex = (m_frameIndex + 1) % maxFramesInFlight;
 
 		VkPresentInfoKHR presentInfo;
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -183,7 +208,7 @@ namespace MelonRenderer
 
 	bool Swapchain::CreateCommandPoolsAndBuffers()
 	{
-		for (int i = 0; i < m_swapchainSize; i++)
+		for (int i = 0; i < maxFramesInFlight; i++)
 		{
 			CreateCommandBufferPool(m_commandPools[i], VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 			CreateCommandBuffer(m_commandPools[i], m_commandBuffers[i]);
@@ -206,11 +231,14 @@ namespace MelonRenderer
 				Logger::Log("Could not create render complete semaphore.");
 				return false;
 			}
+		}
 
-			result = vkCreateSemaphore(Device::Get().m_device, &info, nullptr, &m_presentCompleteSemaphores[i]);
+		for (int i = 0; i < maxFramesInFlight; i++)
+		{
+			VkResult result = vkCreateSemaphore(Device::Get().m_device, &info, nullptr, &m_presentCompleteSemaphores[i]);
 			if (result != VK_SUCCESS)
 			{
-				Logger::Log("Could not create render complete semaphore.");
+				Logger::Log("Could not create present complete semaphore.");
 				return false;
 			}
 		}
@@ -226,7 +254,7 @@ namespace MelonRenderer
 		fenceInfo.pNext = nullptr;
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		for (int i = 0; i < m_swapchainSize; i++)
+		for (int i = 0; i < maxFramesInFlight; i++)
 		{
 			VkResult result = vkCreateFence(Device::Get().m_device, &fenceInfo, nullptr, &m_fences[i]);
 			if (result != VK_SUCCESS)
@@ -367,11 +395,7 @@ namespace MelonRenderer
 		m_outputImages.resize(m_swapchainSize);
 		m_outputImageViews.resize(m_swapchainSize);
 		m_framebuffers.resize(m_swapchainSize);
-		m_commandPools.resize(m_swapchainSize);
-		m_commandBuffers.resize(m_swapchainSize);
 		m_renderCompleteSemaphores.resize(m_swapchainSize);
-		m_presentCompleteSemaphores.resize(m_swapchainSize);
-		m_fences.resize(m_swapchainSize);
 
 		result = vkGetSwapchainImagesKHR(Device::Get().m_device, m_swapchain, &m_swapchainSize, &m_outputImages[0]);
 		if (result != VK_SUCCESS)
@@ -424,11 +448,16 @@ namespace MelonRenderer
 			vkDestroyImageView(Device::Get().m_device, m_outputImageViews[i], nullptr);
 			vkDestroyImage(Device::Get().m_device, m_outputImages[i], nullptr);
 			vkDestroyFramebuffer(Device::Get().m_device, m_framebuffers[i], nullptr);
+			vkDestroySemaphore(Device::Get().m_device, m_renderCompleteSemaphores[i], nullptr);
+		}
+		for (int i = 0; i < maxFramesInFlight; i++) {
+			if (m_commandPools[i] == VK_NULL_HANDLE)
+				continue;
 			vkFreeCommandBuffers(Device::Get().m_device, m_commandPools[i], 1, &m_commandBuffers[i]);
 			vkDestroyCommandPool(Device::Get().m_device, m_commandPools[i], nullptr);
-			vkDestroySemaphore(Device::Get().m_device, m_renderCompleteSemaphores[i], nullptr);
 			vkDestroySemaphore(Device::Get().m_device, m_presentCompleteSemaphores[i], nullptr);
 			vkDestroyFence(Device::Get().m_device, m_fences[i], nullptr);
+			m_commandPools[i] = VK_NULL_HANDLE;
 		}
 
 		if (preserveSwapchain)
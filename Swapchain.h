@@ -4,6 +4,8 @@
 
 namespace MelonRenderer
 {
+	//frames recorded while earlier ones execute, every resource the host writes per frame exists this often
+	constexpr uint32_t maxFramesInFlight = 2;
 
 	struct OutputSurface
 	{
@@ -14,13 +16,25 @@ namespace MelonRenderer
 	class Swapchain
 	{
 	public:
+		//of the frame slot
 		VkCommandBuffer& GetCommandBuffer();
+		//of the acquired image
 		VkFramebuffer& GetFramebuffer();
 		VkImage GetImage();
+		uint32_t GetImageIndex() const;
+		uint32_t GetImageCount() const;
+		//slot of the frame recorded next, < maxFramesInFlight, resources written per frame are indexed by it
+		uint32_t GetFrameIndex() const;
 		void AddAttachment(VkImageView attachment);
 		VkExtent2D GetExtent();
 
+		//waits until the last frame recorded in the current slot is done, its resources may be written afterwards
+		bool WaitForFrame();
+		//waits for the commands of the last submitted frame
+		bool WaitForSubmittedFrame();
+		//call WaitForFrame first
 		bool AquireNextImage();
+		//submits the slot's command buffer and moves on to the next slot
 		bool PresentImage(VkFence* drawFence = nullptr);
 
 		bool CreateSwapchain(VkPhysicalDevice& device, VkRenderPass* renderPass, const OutputSurface& outputSurface, VkExtent2D& extent);
@@ -32,11 +46,13 @@ namespace MelonRenderer
 		std::vector<VkImage> m_outputImages;
 		std::vector<VkImageView> m_outputImageViews;
 		std::vector<VkFramebuffer> m_framebuffers;
-		std::vector<VkCommandPool> m_commandPools;
-		std::vector<VkCommandBuffer> m_commandBuffers;
+		//per image, presenting waits for them
 		std::vector<VkSemaphore> m_renderCompleteSemaphores;
-		std::vector<VkSemaphore> m_presentCompleteSemaphores;
-		std::vector<VkFence> m_fences;
+		//per frame slot
+		VkCommandPool m_commandPools[maxFramesInFlight] = {};
+		VkCommandBuffer m_commandBuffers[maxFramesInFlight] = {};
+		VkSemaphore m_presentCompleteSemaphores[maxFramesInFlight] = {};
+		VkFence m_fences[maxFramesInFlight] = {};
 
 		bool CreateFramebuffers();
 		bool CreateCommandBufferPool(VkCommandPool& commandPool, VkCommandPoolCreateFlags flags);
@@ -46,6 +62,7 @@ namespace MelonRenderer
 		bool CreateFences();
 
 		uint32_t m_imageIndex;
+		uint32_t m_frameIndex = 0;
 		uint32_t m_swapchainSize = 0;
 		VkSwapchainKHR m_swapchain;
 		VkSwapchainKHR m_oldSwapchain;
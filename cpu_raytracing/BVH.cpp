@@ -0,0 +1,236 @@
+#include "BVH.h"
+
+#include <algorithm>
+
+namespace MelonRenderer
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		m_nodes.clear();
+		m_parents.clear();
+		m_primitiveLeaves.clear();
+		m_surfaceAreaSum = 0.f;
+		m_primitiveIndices.resize(primitiveBounds.size());
+		if (primitiveBounds.empty())
+			return;
+
+		std::vector<vec3> centroids(primitiveBounds.size());
+		for (uint32_t i = 0; i < primitiveBounds.size(); i++)
+		{
+			m_primitiveIndices[i] = i;
+			centroids[i] = (primitiveBounds[i].m_min + primitiveBounds[i].m_max) * 0.5f;
+		}
+
+		m_nodes.reserve(primitiveBounds.size() * 2);
+		BuildNode(primitiveBounds, centroids, 0, static_cast<uint32_t>(primitiveBounds.size()), 0);
+		UpdateSurfaceAreaSum();
+	}
+
+	uint32_t BVH::BuildNode(const std::vector<AABB>& primitiveBounds, const std::vector<vec3>& centroids, uint32_t first, uint32_t count, uint32_t depth)
+	{
+		uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+
+		AABB bounds, centroidBounds;
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			bounds.Expand(primitiveBounds[m_primitiveIndices[i]]);
+			centroidBounds.Expand(centroids[m_primitiveIndices[i]]);
+		}
+		m_nodes[nodeIndex].m_bounds = bounds;
+		m_nodes[nodeIndex].m_offset = first;
+		m_nodes[nodeIndex].m_count = count;
+
+		if (count <= m_maxLeafSize || depth + 1 >= m_maxDepth)
+			return nodeIndex;
+
+		//bin the centroids along every axis and sweep the bins for the cheapest split plane
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float axisMin = centroidBounds.m_min[axis];
+			float axisExtent = centroidBounds.m_max[axis] - axisMin;
+			if (axisExtent <= 0.f)
+				continue;
+
+			AABB binBounds[m_binCount];
+			uint32_t binCounts[m_binCount] = {};
+			float binScale = m_binCount / axisExtent;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				uint32_t bin = static_cast<uint32_t>((centroids[m_primitiveIndices[i]][axis] - axisMin) * binScale);
+				bin = bin < m_binCount - 1 ? bin : m_binCount - 1;
+				binBounds[bin].Expand(primitiveBounds[m_primitiveIndices[i]]);
+				binCounts[bin]++;
+			}
+
+			float rightAreas[m_binCount];
+			uint32_t rightCounts[m_binCount];
+			AABB rightBounds;
+			uint32_t rightCount = 0;
+			for (uint32_t bin = m_binCount - 1; bin > 0; bin--)
+			{
+				rightBounds.Expand(binBounds[bin]);
+				rightCount += binCounts[bin];
+				rightAreas[bin] = rightBounds.SurfaceArea();
+				rightCounts[bin] = rightCount;
+			}
+
+			AABB leftBounds;
+			uint32_t leftCount = 0;
+			for (uint32_t split = 1; split < m_binCount; split++)
+			{
+				leftBounds.Expand(binBounds[split - 1]);
+				leftCount += binCounts[split - 1];
+				if (!leftCount || !rightCounts[split])
+					continue;
+
+				float cost = leftBounds.SurfaceArea() * leftCount + rightAreas[split] * rightCounts[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		//traversing a node costs about as much as testing one primitive
+		bool sahSplit = bestAxis >= 0 && bestCost + bounds.SurfaceArea() < bounds.SurfaceArea() * count;
+		//primitives with identical centroids can not be binned, large groups of them are split in the middle instead
+		if (!sahSplit && (bestAxis >= 0 || count <= m_maxLeafSize * 4))
+			return nodeIndex;
+
+		uint32_t leftCount = count / 2;
+		if (sahSplit)
+		{
+			float axisMin = centroidBounds.m_min[bestAxis];
+			float binScale = m_binCount / (centroidBounds.m_max[bestAxis] - axisMin);
+			auto middle = std::partition(m_primitiveIndices.begin() + first, m_primitiveIndices.begin() + first + count, [&](uint32_t primitive)
+				{
+					uint32_t bin = static_cast<uint32_t>((centroids[primitive][bestAxis] - axisMin) * binScale);
+					return (bin < m_binCount - 1 ? bin : m_binCount - 1) < bestSplit;
+				});
+			leftCount = static_cast<uint32_t>(middle - (m_primitiveIndices.begin() + first));
+		}
+
+		BuildNode(primitiveBounds, centroids, first, leftCount, depth + 1);
+		uint32_t right = BuildNode(primitiveBounds, centroids, first + leftCount, count - leftCount, depth + 1);
+		m_nodes[nodeIndex].m_offset = right;
+		m_nodes[nodeIndex].m_count = 0;
+
+		return nodeIndex;
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		//children are stored after their parent
+		for (size_t i = m_nodes.size(); i > 0; i--)
+		{
+			BVHNode& node = m_nodes[i - 1];
+			AABB bounds;
+			if (node.m_count)
+			{
+				for (uint32_t j = node.m_offset; j < node.m_offset + node.m_count; j++)
+				{
+					bounds.Expand(primitiveBounds[m_primitiveIndices[j]]);
+				}
+			}
+			else
+			{
+				bounds = m_nodes[i].m_bounds;
+				bounds.Expand(m_nodes[node.m_offset].m_bounds);
+			}
+			node.m_bounds = bounds;
+		}
+		UpdateSurfaceAreaSum();
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& changedPrimitives)
+	{
+		if (m_nodes.empty())
+			return;
+
+		if (m_parents.size() != m_nodes.size())
+			BuildParents();
+
+		//walks up from every changed leaf until a node keeps its bounds, paths shared by several primitives are walked again
+		for (uint32_t primitive : changedPrimitives)
+		{
+			uint32_t nodeIndex = m_primitiveLeaves[primitive];
+			while (nodeIndex != UINT32_MAX)
+			{
+				BVHNode& node = m_nodes[nodeIndex];
+				AABB bounds;
+				if (node.m_count)
+				{
+					for (uint32_t i = node.m_offset; i < node.m_offset + node.m_count; i++)
+					{
+						bounds.Expand(primitiveBounds[m_primitiveIndices[i]]);
+					}
+				}
+				else
+				{
+					bounds = m_nodes[nodeIndex + 1].m_bounds;
+					bounds.Expand(m_nodes[node.m_offset].m_bounds);
+				}
+
+				if (bounds.m_min == node.m_bounds.m_min && bounds.m_max == node.m_bounds.m_max)
+					break;
+
+				m_surfaceAreaSum += bounds.SurfaceArea() - node.m_bounds.SurfaceArea();
+				node.m_bounds = bounds;
+				nodeIndex = m_parents[nodeIndex];
+			}
+		}
+	}
+
+	void BVH::UpdateSurfaceAreaSum()
+	{
+		m_surfaceAreaSum = 0.f;
+		for (const BVHNode& node : m_nodes)
+		{
+			m_surfaceAreaSum += node.m_bounds.SurfaceArea();
+		}
+	}
+
+	void BVH::BuildParents()
+	{
+		m_parents.assign(m_nodes.size(), UINT32_MAX);
+		m_primitiveLeaves.resize(m_primitiveIndices.size());
+		for (uint32_t nodeIndex = 0; nodeIndex < m_nodes.size(); nodeIndex++)
+		{
+			const BVHNode& node = m_nodes[nodeIndex];
+			if (node.m_count)
+			{
+				for (uint32_t i = node.m_offset; i < node.m_offset + node.m_count; i++)
+				{
+					m_primitiveLeaves[m_primitiveIndices[i]] = nodeIndex;
+				}
+			}
+			else
+			{
+				m_parents[nodeIndex + 1] = nodeIndex;
+				m_parents[node.m_offset] = nodeIndex;
+			}
+		}
+	}
+
+	const AABB& BVH::GetBounds() const
+	{
+		static const AABB empty;
+		return m_nodes.empty() ? empty : m_nodes[0].m_bounds;
+	}
+
+	size_t BVH::GetNodeCount() const
+	{
+		return m_nodes.size();
+	}
+
+	float BVH::GetSurfaceAreaSum() const
+	{
+		return m_surfaceAreaSum;
+	}
+}
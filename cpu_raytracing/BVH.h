@@ -0,0 +1,306 @@
+#pragma once
+
+#include "../Basics.h"
+
+#include <vector>
+#include <utility>
+
+namespace MelonRenderer
+{
+	struct Ray
+	{
+		vec3 m_origin;
+		vec3 m_direction;
+		float m_tMin = 0.001f;
+		float m_tMax = 100000.f;
+	};
+
+	//nodes are stored depth first, the left child of an inner node directly follows it
+	struct BVHNode
+	{
+		AABB m_bounds;
+		uint32_t m_offset; //first primitive index for leaves, right child for inner nodes
+		uint32_t m_count; //0 for inner nodes
+	};
+
+	//binned SAH hierarchy over primitive bounds, the primitives themselves are only referenced by index
+	class BVH
+	{
+	public:
+		void Build(const std::vector<AABB>& primitiveBounds);
+
+		//intersect(primitiveIndex, ray) returns true on a hit and shortens ray.m_tMax to it,
+		//with anyHit traversal ends at the first hit, used for shadow rays
+		template<typename IntersectPrimitive>
+		bool Traverse(Ray& ray, IntersectPrimitive intersect, bool anyHit) const;
+		//visit(primitiveIndex, radius) for every primitive whose leaf is within radius of center, visit may shrink radius
+		template<typename VisitPrimitive>
+		void QuerySphere(const vec3& center, float& radius, VisitPrimitive visit) const;
+		//visit(primitiveIndex) for every primitive whose leaf passes overlaps(bounds), as do all nodes above it
+		template<typename OverlapsBounds, typename VisitPrimitive>
+		void Query(OverlapsBounds overlaps, VisitPrimitive visit) const;
+		//new bounds for the same primitives, the topology is kept, so the quality drops with the distance moved
+		void Refit(const std::vector<AABB>& primitiveBounds);
+		//same for a few changed primitives, only the nodes above them are visited
+		void Refit(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& changedPrimitives);
+
+		const AABB& GetBounds() const;
+		size_t GetNodeCount() const;
+		//summed surface area of all nodes, proportional to the expected traversal cost, grows as refits degrade the tree
+		float GetSurfaceAreaSum() const;
+
+	protected:
+		static constexpr uint32_t m_binCount = 16;
+		static constexpr uint32_t m_maxLeafSize = 4;
+		static constexpr uint32_t m_maxDepth = 64;
+
+		uint32_t BuildNode(const std::vector<AABB>& primitiveBounds, const std::vector<vec3>& centroids, uint32_t first, uint32_t count, uint32_t depth);
+		void UpdateSurfaceAreaSum();
+		void BuildParents();
+
+		std::vector<BVHNode> m_nodes;
+		std::vector<uint32_t> m_primitiveIndices;
+		float m_surfaceAreaSum = 0.f;
+		//filled by the first partial refit after a build
+		std::vector<uint32_t> m_parents;
+		std::vector<uint32_t> m_primitiveLeaves;
+
+		friend class BVH8;
+	};
+
+	//slab test, returns the entry distance or FLT_MAX on a miss
+	inline float IntersectAABB(const AABB& box, const Ray& ray, const vec3& inverseDirection)
+	{
+		vec3 t0 = (box.m_min - ray.m_origin) * inverseDirection;
+		vec3 t1 = (box.m_max - ray.m_origin) * inverseDirection;
+		vec3 tNear = glm::min(t0, t1);
+		vec3 tFar = glm::max(t0, t1);
+		float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, ray.m_tMin));
+		float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, ray.m_tMax));
+		return entry <= exit ? entry : FLT_MAX;
+	}
+
+	inline float SquaredDistance(const AABB& box, const vec3& point)
+	{
+		vec3 outside = glm::max(glm::max(box.m_min - point, point - box.m_max), vec3(0.f));
+		return glm::dot(outside, outside);
+	}
+
+	//Moeller-Trumbore, both faces are hit like with the opaque ray flag on the gpu
+	inline bool IntersectTriangle(const vec3& p0, const vec3& p1, const vec3& p2, Ray& ray, float& u, float& v)
+	{
+		vec3 edge1 = p1 - p0;
+		vec3 edge2 = p2 - p0;
+
+		vec3 p = glm::cross(ray.m_direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (determinant > -1e-12f && determinant < 1e-12f)
+			return false;
+
+		float inverseDeterminant = 1.f / determinant;
+		vec3 s = ray.m_origin - p0;
+		u = glm::dot(s, p) * inverseDeterminant;
+		if (u < 0.f || u > 1.f)
+			return false;
+
+		vec3 q = glm::cross(s, edge1);
+		v = glm::dot(ray.m_direction, q) * inverseDeterminant;
+		if (v < 0.f || u + v > 1.f)
+			return false;
+
+		float t = glm::dot(edge2, q) * inverseDeterminant;
+		if (t <= ray.m_tMin || t >= ray.m_tMax)
+			return false;
+
+		ray.m_tMax = t;
+		return true;
+	}
+
+	//closest point on the triangle by its voronoi regions, from Ericson's Real-Time Collision Detection,
+	//u and v are the barycentrics of p1 and p2 like for IntersectTriangle
+	inline vec3 ClosestPointOnTriangle(const vec3& point, const vec3& p0, const vec3& p1, const vec3& p2, float& u, float& v)
+	{
+		vec3 edge1 = p1 - p0;
+		vec3 edge2 = p2 - p0;
+		vec3 toPoint = point - p0;
+		float d1 = glm::dot(edge1, toPoint);
+		float d2 = glm::dot(edge2, toPoint);
+		if (d1 <= 0.f && d2 <= 0.f)
+		{
+			u = 0.f; v = 0.f;
+			return p0;
+		}
+
+		vec3 toPoint1 = point - p1;
+		float d3 = glm::dot(edge1, toPoint1);
+		float d4 = glm::dot(edge2, toPoint1);
+		if (d3 >= 0.f && d4 <= d3)
+		{
+			u = 1.f; v = 0.f;
+			return p1;
+		}
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+		{
+			u = d1 / (d1 - d3); v = 0.f;
+			return p0 + u * edge1;
+		}
+
+		vec3 toPoint2 = point - p2;
+		float d5 = glm::dot(edge1, toPoint2);
+		float d6 = glm::dot(edge2, toPoint2);
+		if (d6 >= 0.f && d5 <= d6)
+		{
+			u = 0.f; v = 1.f;
+			return p2;
+		}
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+		{
+			u = 0.f; v = d2 / (d2 - d6);
+			return p0 + v * edge2;
+		}
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+		{
+			v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			u = 1.f - v;
+			return p1 + v * (p2 - p1);
+		}
+
+		float denominator = 1.f / (va + vb + vc);
+		u = vb * denominator;
+		v = vc * denominator;
+		return p0 + u * edge1 + v * edge2;
+	}
+
+	template<typename IntersectPrimitive>
+	bool BVH::Traverse(Ray& ray, IntersectPrimitive intersect, bool anyHit) const
+	{
+		if (m_nodes.empty())
+			return false;
+
+		vec3 inverseDirection = 1.f / ray.m_direction;
+		if (IntersectAABB(m_nodes[0].m_bounds, ray, inverseDirection) == FLT_MAX)
+			return false;
+
+		bool hit = false;
+		uint32_t stack[m_maxDepth * 2];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const BVHNode& node = m_nodes[nodeIndex];
+			if (node.m_count)
+			{
+				for (uint32_t i = node.m_offset; i < node.m_offset + node.m_count; i++)
+				{
+					if (intersect(m_primitiveIndices[i], ray))
+					{
+						hit = true;
+						if (anyHit)
+							return true;
+					}
+				}
+			}
+			else
+			{
+				//visit the closer child first, the farther one is culled later if a hit moved m_tMax in front of it
+				uint32_t left = nodeIndex + 1;
+				uint32_t right = node.m_offset;
+				float leftEntry = IntersectAABB(m_nodes[left].m_bounds, ray, inverseDirection);
+				float rightEntry = IntersectAABB(m_nodes[right].m_bounds, ray, inverseDirection);
+				if (leftEntry > rightEntry)
+				{
+					std::swap(left, right);
+					std::swap(leftEntry, rightEntry);
+				}
+				if (leftEntry != FLT_MAX)
+				{
+					if (rightEntry != FLT_MAX)
+						stack[stackSize++] = right;
+					nodeIndex = left;
+					continue;
+				}
+			}
+
+			//pop until a node is found that is still in front of the closest hit
+			bool found = false;
+			while (stackSize && !found)
+			{
+				nodeIndex = stack[--stackSize];
+				found = IntersectAABB(m_nodes[nodeIndex].m_bounds, ray, inverseDirection) != FLT_MAX;
+			}
+			if (!found)
+				return hit;
+		}
+	}
+
+	template<typename VisitPrimitive>
+	void BVH::QuerySphere(const vec3& center, float& radius, VisitPrimitive visit) const
+	{
+		if (m_nodes.empty())
+			return;
+
+		uint32_t stack[m_maxDepth * 2];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const uint32_t nodeIndex = stack[--stackSize];
+			const BVHNode& node = m_nodes[nodeIndex];
+			if (SquaredDistance(node.m_bounds, center) > radius * radius)
+				continue;
+
+			if (node.m_count)
+			{
+				for (uint32_t i = node.m_offset; i < node.m_offset + node.m_count; i++)
+				{
+					visit(m_primitiveIndices[i], radius);
+				}
+				continue;
+			}
+
+			//the closer child on top
+			uint32_t left = nodeIndex + 1;
+			uint32_t right = node.m_offset;
+			if (SquaredDistance(m_nodes[left].m_bounds, center) > SquaredDistance(m_nodes[right].m_bounds, center))
+				std::swap(left, right);
+			stack[stackSize++] = right;
+			stack[stackSize++] = left;
+		}
+	}
+
+	template<typename OverlapsBounds, typename VisitPrimitive>
+	void BVH::Query(OverlapsBounds overlaps, VisitPrimitive visit) const
+	{
+		if (m_nodes.empty())
+			return;
+
+		uint32_t stack[m_maxDepth * 2];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const uint32_t nodeIndex = stack[--stackSize];
+			const BVHNode& node = m_nodes[nodeIndex];
+			if (!overlaps(node.m_bounds))
+				continue;
+
+			if (node.m_count)
+			{
+				for (uint32_t i = node.m_offset; i < node.m_offset + node.m_count; i++)
+				{
+					visit(m_primitiveIndices[i]);
+				}
+				continue;
+			}
+
+			stack[stackSize++] = node.m_offset;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+}
@@ -0,0 +1,418 @@
+#include "BVH8.h"
+
+#include <cmath>
+
+namespace MelonRenderer
+{
+	static inline vec3 Position(const Vertex& vertex)
+	{
+		return vec3(vertex.posX, vertex.posY, vertex.posZ);
+	}
+
+	void BVH8::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		m_nodes.clear();
+		m_blocks.clear();
+		m_bounds = AABB();
+
+		std::vector<AABB> triangleBounds(indices.size() / 3);
+		for (size_t i = 0; i < triangleBounds.size(); i++)
+		{
+			triangleBounds[i].Expand(Position(vertices[indices[i * 3 + 0]]));
+			triangleBounds[i].Expand(Position(vertices[indices[i * 3 + 1]]));
+			triangleBounds[i].Expand(Position(vertices[indices[i * 3 + 2]]));
+		}
+		if (triangleBounds.empty())
+			return;
+
+		BVH bvh;
+		bvh.Build(triangleBounds);
+		m_bounds = bvh.GetBounds();
+
+		//primitive range of every binary subtree, children come after their parent
+		const uint32_t binaryNodeCount = static_cast<uint32_t>(bvh.m_nodes.size());
+		std::vector<uint32_t> subtreeFirst(binaryNodeCount), subtreeCount(binaryNodeCount);
+		for (uint32_t i = binaryNodeCount; i > 0; i--)
+		{
+			const BVHNode& node = bvh.m_nodes[i - 1];
+			if (node.m_count)
+			{
+				subtreeFirst[i - 1] = node.m_offset;
+				subtreeCount[i - 1] = node.m_count;
+			}
+			else
+			{
+				subtreeFirst[i - 1] = subtreeFirst[i];
+				subtreeCount[i - 1] = subtreeCount[i] + subtreeCount[node.m_offset];
+			}
+		}
+
+		m_nodes.reserve(binaryNodeCount / 4 + 1);
+		m_blocks.reserve(triangleBounds.size() / 4 + 1);
+		CollapseNode(bvh, 0, subtreeFirst, subtreeCount, vertices, indices);
+	}
+
+	uint32_t BVH8::CollapseNode(const BVH& bvh, uint32_t binaryNode, const std::vector<uint32_t>& subtreeFirst, const std::vector<uint32_t>& subtreeCount,
+		const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		//keep opening the largest child until there are 8, leaves and small subtrees stay closed
+		uint32_t children[8];
+		uint32_t childCount = 0;
+		if (bvh.m_nodes[binaryNode].m_count)
+		{
+			children[childCount++] = binaryNode;
+		}
+		else
+		{
+			children[childCount++] = binaryNode + 1;
+			children[childCount++] = bvh.m_nodes[binaryNode].m_offset;
+		}
+
+		while (childCount < 8)
+		{
+			int largest = -1;
+			float largestArea = -1.f;
+			for (uint32_t i = 0; i < childCount; i++)
+			{
+				const BVHNode& child = bvh.m_nodes[children[i]];
+				float area = child.m_bounds.SurfaceArea();
+				if (!child.m_count && subtreeCount[children[i]] > m_leafPrimitives && area > largestArea)
+				{
+					largest = i;
+					largestArea = area;
+				}
+			}
+			if (largest < 0)
+				break;
+
+			uint32_t opened = children[largest];
+			children[largest] = opened + 1;
+			children[childCount++] = bvh.m_nodes[opened].m_offset;
+		}
+
+		uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			//inverted bounds, the slab test never hits them
+			m_nodes[nodeIndex].m_minX[i] = m_nodes[nodeIndex].m_minY[i] = m_nodes[nodeIndex].m_minZ[i] = FLT_MAX;
+			m_nodes[nodeIndex].m_maxX[i] = m_nodes[nodeIndex].m_maxY[i] = m_nodes[nodeIndex].m_maxZ[i] = -FLT_MAX;
+			m_nodes[nodeIndex].m_children[i] = m_invalid;
+			m_nodes[nodeIndex].m_blockCounts[i] = 0;
+		}
+
+		for (uint32_t i = 0; i < childCount; i++)
+		{
+			const BVHNode& child = bvh.m_nodes[children[i]];
+			uint32_t childIndex, blockCount = 0;
+			if (child.m_count || subtreeCount[children[i]] <= m_leafPrimitives)
+			{
+				blockCount = (subtreeCount[children[i]] + 7) / 8;
+				childIndex = CreateBlocks(bvh, subtreeFirst[children[i]], subtreeCount[children[i]], vertices, indices);
+			}
+			else
+			{
+				childIndex = CollapseNode(bvh, children[i], subtreeFirst, subtreeCount, vertices, indices);
+			}
+
+			//the recursion may have moved m_nodes
+			Node& node = m_nodes[nodeIndex];
+			node.m_minX[i] = child.m_bounds.m_min.x;
+			node.m_minY[i] = child.m_bounds.m_min.y;
+			node.m_minZ[i] = child.m_bounds.m_min.z;
+			node.m_maxX[i] = child.m_bounds.m_max.x;
+			node.m_maxY[i] = child.m_bounds.m_max.y;
+			node.m_maxZ[i] = child.m_bounds.m_max.z;
+			node.m_children[i] = childIndex;
+			node.m_blockCounts[i] = blockCount;
+		}
+
+		return nodeIndex;
+	}
+
+	uint32_t BVH8::CreateBlocks(const BVH& bvh, uint32_t first, uint32_t count, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		uint32_t firstBlock = static_cast<uint32_t>(m_blocks.size());
+		for (uint32_t blockStart = 0; blockStart < count; blockStart += 8)
+		{
+			TriangleBlock block;
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				if (blockStart + lane >= count)
+				{
+					block.m_v0X[lane] = block.m_v0Y[lane] = block.m_v0Z[lane] = NAN;
+					block.m_edge1X[lane] = block.m_edge1Y[lane] = block.m_edge1Z[lane] = NAN;
+					block.m_edge2X[lane] = block.m_edge2Y[lane] = block.m_edge2Z[lane] = NAN;
+					block.m_primitives[lane] = m_invalid;
+					continue;
+				}
+
+				uint32_t primitive = bvh.m_primitiveIndices[first + blockStart + lane];
+				vec3 p0 = Position(vertices[indices[primitive * 3 + 0]]);
+				vec3 edge1 = Position(vertices[indices[primitive * 3 + 1]]) - p0;
+				vec3 edge2 = Position(vertices[indices[primitive * 3 + 2]]) - p0;
+				block.m_v0X[lane] = p0.x;
+				block.m_v0Y[lane] = p0.y;
+				block.m_v0Z[lane] = p0.z;
+				block.m_edge1X[lane] = edge1.x;
+				block.m_edge1Y[lane] = edge1.y;
+				block.m_edge1Z[lane] = edge1.z;
+				block.m_edge2X[lane] = edge2.x;
+				block.m_edge2Y[lane] = edge2.y;
+				block.m_edge2Z[lane] = edge2.z;
+				block.m_primitives[lane] = primitive;
+			}
+			m_blocks.emplace_back(block);
+		}
+
+		return firstBlock;
+	}
+
+	bool BVH8::Intersect(Ray& ray, TriangleHit& hit) const
+	{
+		return TraverseSingle<false>(ray, &hit);
+	}
+
+	bool BVH8::Occluded(Ray ray) const
+	{
+		return TraverseSingle<true>(ray, nullptr);
+	}
+
+	//one ray against 8 boxes or 8 triangles at a time
+	template<bool anyHit>
+	bool BVH8::TraverseSingle(Ray& ray, TriangleHit* hit) const
+	{
+		if (m_nodes.empty())
+			return false;
+
+		const Float8 originX(ray.m_origin.x), originY(ray.m_origin.y), originZ(ray.m_origin.z);
+		const Float8 directionX(ray.m_direction.x), directionY(ray.m_direction.y), directionZ(ray.m_direction.z);
+		const Float8 inverseX(1.f / ray.m_direction.x), inverseY(1.f / ray.m_direction.y), inverseZ(1.f / ray.m_direction.z);
+		const Float8 tMin(ray.m_tMin);
+		const Float8 zero(0.f), one(1.f);
+		//the near plane per axis only depends on the sign of the direction
+		const bool negativeX = ray.m_direction.x < 0.f, negativeY = ray.m_direction.y < 0.f, negativeZ = ray.m_direction.z < 0.f;
+
+		bool found = false;
+		StackEntry stack[m_stackSize];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0, ray.m_tMin };
+		while (stackSize)
+		{
+			StackEntry entry = stack[--stackSize];
+			if (entry.m_distance > ray.m_tMax)
+				continue;
+
+			if (entry.m_blockCount)
+			{
+				for (uint32_t b = entry.m_child; b < entry.m_child + entry.m_blockCount; b++)
+				{
+					const TriangleBlock& block = m_blocks[b];
+					const Float8 edge1X = Float8::Load(block.m_edge1X), edge1Y = Float8::Load(block.m_edge1Y), edge1Z = Float8::Load(block.m_edge1Z);
+					const Float8 edge2X = Float8::Load(block.m_edge2X), edge2Y = Float8::Load(block.m_edge2Y), edge2Z = Float8::Load(block.m_edge2Z);
+
+					Float8 pX = FusedMultiplySubtract(directionY, edge2Z, directionZ * edge2Y);
+					Float8 pY = FusedMultiplySubtract(directionZ, edge2X, directionX * edge2Z);
+					Float8 pZ = FusedMultiplySubtract(directionX, edge2Y, directionY * edge2X);
+					Float8 inverseDeterminant = one / (edge1X * pX + edge1Y * pY + edge1Z * pZ);
+
+					Float8 sX = originX - Float8::Load(block.m_v0X), sY = originY - Float8::Load(block.m_v0Y), sZ = originZ - Float8::Load(block.m_v0Z);
+					Float8 u = (sX * pX + sY * pY + sZ * pZ) * inverseDeterminant;
+
+					Float8 qX = FusedMultiplySubtract(sY, edge1Z, sZ * edge1Y);
+					Float8 qY = FusedMultiplySubtract(sZ, edge1X, sX * edge1Z);
+					Float8 qZ = FusedMultiplySubtract(sX, edge1Y, sY * edge1X);
+					Float8 v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+					Float8 t = (edge2X * qX + edge2Y * qY + edge2Z * qZ) * inverseDeterminant;
+
+					//NaN from padding lanes and parallel rays fails every ordered comparison
+					uint32_t mask = MoveMask((u >= zero) & (v >= zero) & (u + v <= one) & (t > tMin) & (t < Float8(ray.m_tMax)));
+					if (!mask)
+						continue;
+					if (anyHit)
+						return true;
+
+					alignas(32) float ts[8], us[8], vs[8];
+					t.Store(ts);
+					u.Store(us);
+					v.Store(vs);
+					for (uint32_t lane = 0; lane < 8; lane++)
+					{
+						if ((mask & (1u << lane)) && ts[lane] < ray.m_tMax)
+						{
+							ray.m_tMax = ts[lane];
+							hit->m_t = ts[lane];
+							hit->m_u = us[lane];
+							hit->m_v = vs[lane];
+							hit->m_primitive = block.m_primitives[lane];
+							found = true;
+						}
+					}
+				}
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.m_child];
+			Float8 nearX = (Float8::Load(negativeX ? node.m_maxX : node.m_minX) - originX) * inverseX;
+			Float8 nearY = (Float8::Load(negativeY ? node.m_maxY : node.m_minY) - originY) * inverseY;
+			Float8 nearZ = (Float8::Load(negativeZ ? node.m_maxZ : node.m_minZ) - originZ) * inverseZ;
+			Float8 farX = (Float8::Load(negativeX ? node.m_minX : node.m_maxX) - originX) * inverseX;
+			Float8 farY = (Float8::Load(negativeY ? node.m_minY : node.m_maxY) - originY) * inverseY;
+			Float8 farZ = (Float8::Load(negativeZ ? node.m_minZ : node.m_maxZ) - originZ) * inverseZ;
+			Float8 entryDistance = Max(Max(nearX, nearY), Max(nearZ, tMin));
+			Float8 exitDistance = Min(Min(farX, farY), Min(farZ, Float8(ray.m_tMax)));
+			uint32_t mask = MoveMask(entryDistance <= exitDistance);
+			if (!mask)
+				continue;
+
+			//push far to near, so the nearest child is popped first
+			alignas(32) float distances[8];
+			entryDistance.Store(distances);
+			StackEntry hits[8];
+			uint32_t hitCount = 0;
+			for (uint32_t i = 0; i < 8; i++)
+			{
+				if (!(mask & (1u << i)))
+					continue;
+
+				StackEntry child = { node.m_children[i], node.m_blockCounts[i], distances[i] };
+				uint32_t position = hitCount++;
+				while (position > 0 && hits[position - 1].m_distance < child.m_distance)
+				{
+					hits[position] = hits[position - 1];
+					position--;
+				}
+				hits[position] = child;
+			}
+			for (uint32_t i = 0; i < hitCount; i++)
+			{
+				stack[stackSize++] = hits[i];
+			}
+		}
+
+		return found;
+	}
+
+	//8 rays against one box or one triangle at a time, children are visited if any active ray enters them
+	void BVH8::Intersect8(RayPacket8& rays, TriangleHit8& hits) const
+	{
+		for (uint32_t lane = 0; lane < 8; lane++)
+		{
+			hits.m_primitive[lane] = m_invalid;
+		}
+		if (m_nodes.empty())
+			return;
+
+		const Float8 originX = Float8::Load(rays.m_originX), originY = Float8::Load(rays.m_originY), originZ = Float8::Load(rays.m_originZ);
+		const Float8 directionX = Float8::Load(rays.m_directionX), directionY = Float8::Load(rays.m_directionY), directionZ = Float8::Load(rays.m_directionZ);
+		const Float8 one(1.f), zero(0.f);
+		const Float8 inverseX = one / directionX, inverseY = one / directionY, inverseZ = one / directionZ;
+		const Float8 tMin = Float8::Load(rays.m_tMin);
+		Float8 tMax = Float8::Load(rays.m_tMax);
+
+		StackEntry stack[m_stackSize];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0, 0.f };
+		while (stackSize)
+		{
+			StackEntry entry = stack[--stackSize];
+
+			if (entry.m_blockCount)
+			{
+				for (uint32_t b = entry.m_child; b < entry.m_child + entry.m_blockCount; b++)
+				{
+					const TriangleBlock& block = m_blocks[b];
+					for (uint32_t triangle = 0; triangle < 8 && block.m_primitives[triangle] != m_invalid; triangle++)
+					{
+						const Float8 edge1X(block.m_edge1X[triangle]), edge1Y(block.m_edge1Y[triangle]), edge1Z(block.m_edge1Z[triangle]);
+						const Float8 edge2X(block.m_edge2X[triangle]), edge2Y(block.m_edge2Y[triangle]), edge2Z(block.m_edge2Z[triangle]);
+
+						Float8 pX = FusedMultiplySubtract(directionY, edge2Z, directionZ * edge2Y);
+						Float8 pY = FusedMultiplySubtract(directionZ, edge2X, directionX * edge2Z);
+						Float8 pZ = FusedMultiplySubtract(directionX, edge2Y, directionY * edge2X);
+						Float8 inverseDeterminant = one / (edge1X * pX + edge1Y * pY + edge1Z * pZ);
+
+						Float8 sX = originX - Float8(block.m_v0X[triangle]), sY = originY - Float8(block.m_v0Y[triangle]), sZ = originZ - Float8(block.m_v0Z[triangle]);
+						Float8 u = (sX * pX + sY * pY + sZ * pZ) * inverseDeterminant;
+
+						Float8 qX = FusedMultiplySubtract(sY, edge1Z, sZ * edge1Y);
+						Float8 qY = FusedMultiplySubtract(sZ, edge1X, sX * edge1Z);
+						Float8 qZ = FusedMultiplySubtract(sX, edge1Y, sY * edge1X);
+						Float8 v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+						Float8 t = (edge2X * qX + edge2Y * qY + edge2Z * qZ) * inverseDeterminant;
+
+						Float8 hitMask = (u >= zero) & (v >= zero) & (u + v <= one) & (t > tMin) & (t < tMax);
+						uint32_t mask = MoveMask(hitMask);
+						if (!mask)
+							continue;
+
+						tMax = Select(hitMask, t, tMax);
+						alignas(32) float us[8], vs[8];
+						u.Store(us);
+						v.Store(vs);
+						for (uint32_t lane = 0; lane < 8; lane++)
+						{
+							if (mask & (1u << lane))
+							{
+								hits.m_u[lane] = us[lane];
+								hits.m_v[lane] = vs[lane];
+								hits.m_primitive[lane] = block.m_primitives[triangle];
+							}
+						}
+					}
+				}
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.m_child];
+			StackEntry children[8];
+			uint32_t childCount = 0;
+			for (uint32_t i = 0; i < 8 && node.m_children[i] != m_invalid; i++)
+			{
+				Float8 x0 = (Float8(node.m_minX[i]) - originX) * inverseX, x1 = (Float8(node.m_maxX[i]) - originX) * inverseX;
+				Float8 y0 = (Float8(node.m_minY[i]) - originY) * inverseY, y1 = (Float8(node.m_maxY[i]) - originY) * inverseY;
+				Float8 z0 = (Float8(node.m_minZ[i]) - originZ) * inverseZ, z1 = (Float8(node.m_maxZ[i]) - originZ) * inverseZ;
+				Float8 entryDistance = Max(Max(Min(x0, x1), Min(y0, y1)), Max(Min(z0, z1), tMin));
+				Float8 exitDistance = Min(Min(Max(x0, x1), Max(y0, y1)), Min(Max(z0, z1), tMax));
+				Float8 enterMask = entryDistance <= exitDistance;
+				uint32_t mask = MoveMask(enterMask);
+				if (!mask)
+					continue;
+
+				//ordered by the closest entry of any ray
+				alignas(32) float distances[8];
+				Select(enterMask, entryDistance, Float8(FLT_MAX)).Store(distances);
+				float closest = FLT_MAX;
+				for (uint32_t lane = 0; lane < 8; lane++)
+				{
+					closest = distances[lane] < closest ? distances[lane] : closest;
+				}
+
+				StackEntry child = { node.m_children[i], node.m_blockCounts[i], closest };
+				uint32_t position = childCount++;
+				while (position > 0 && children[position - 1].m_distance < child.m_distance)
+				{
+					children[position] = children[position - 1];
+					position--;
+				}
+				children[position] = child;
+			}
+			for (uint32_t i = 0; i < childCount; i++)
+			{
+				stack[stackSize++] = children[i];
+			}
+		}
+
+		tMax.Store(rays.m_tMax);
+	}
+
+	const AABB& BVH8::GetBounds() const
+	{
+		return m_bounds;
+	}
+
+	size_t BVH8::GetNodeCount() const
+	{
+		return m_nodes.size();
+	}
+}
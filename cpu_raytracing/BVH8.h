@@ -0,0 +1,178 @@
+#pragma once
+
+#include "BVH.h"
+#include "Simd.h"
+#include "../Vertex.h"
+
+namespace MelonRenderer
+{
+	struct TriangleHit
+	{
+		float m_t;
+		//barycentrics of the second and third vertex
+		float m_u;
+		float m_v;
+		uint32_t m_primitive;
+	};
+
+	//8 rays in SoA layout, lanes with m_tMax < m_tMin are inactive
+	struct alignas(32) RayPacket8
+	{
+		float m_originX[8];
+		float m_originY[8];
+		float m_originZ[8];
+		float m_directionX[8];
+		float m_directionY[8];
+		float m_directionZ[8];
+		float m_tMin[8];
+		//shortened to the closest hit
+		float m_tMax[8];
+	};
+
+	struct alignas(32) TriangleHit8
+	{
+		float m_u[8];
+		float m_v[8];
+		//UINT32_MAX for lanes without a hit
+		uint32_t m_primitive[8];
+	};
+
+	//8 children per node, collapsed from the binary SAH build, with triangles in blocks of 8
+	class BVH8
+	{
+	public:
+		static constexpr uint32_t m_invalid = UINT32_MAX;
+
+		void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		bool Intersect(Ray& ray, TriangleHit& hit) const;
+		bool Occluded(Ray ray) const;
+		void Intersect8(RayPacket8& rays, TriangleHit8& hits) const;
+		//visit(primitive, p0, p1, p2, radius) for every triangle in a leaf within radius of center, visit may shrink radius
+		template<typename VisitTriangle>
+		void QuerySphere(const vec3& center, float& radius, VisitTriangle visit) const;
+
+		const AABB& GetBounds() const;
+		size_t GetNodeCount() const;
+
+	protected:
+		struct alignas(32) Node
+		{
+			float m_minX[8];
+			float m_minY[8];
+			float m_minZ[8];
+			float m_maxX[8];
+			float m_maxY[8];
+			float m_maxZ[8];
+			//inner children index m_nodes, leaves the first of their m_blockCounts triangle blocks
+			uint32_t m_children[8];
+			uint32_t m_blockCounts[8]; //0 for inner children
+		};
+
+		//first vertex and both edges, padding lanes are NaN and never hit
+		struct alignas(32) TriangleBlock
+		{
+			float m_v0X[8];
+			float m_v0Y[8];
+			float m_v0Z[8];
+			float m_edge1X[8];
+			float m_edge1Y[8];
+			float m_edge1Z[8];
+			float m_edge2X[8];
+			float m_edge2Y[8];
+			float m_edge2Z[8];
+			uint32_t m_primitives[8];
+		};
+
+		struct StackEntry
+		{
+			uint32_t m_child;
+			uint32_t m_blockCount;
+			float m_distance;
+		};
+
+		uint32_t CollapseNode(const BVH& bvh, uint32_t binaryNode, const std::vector<uint32_t>& subtreeFirst, const std::vector<uint32_t>& subtreeCount,
+			const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		uint32_t CreateBlocks(const BVH& bvh, uint32_t first, uint32_t count, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		template<bool anyHit>
+		bool TraverseSingle(Ray& ray, TriangleHit* hit) const;
+
+		//a leaf of at most one block is made from every binary subtree small enough
+		static constexpr uint32_t m_leafPrimitives = 8;
+		static constexpr uint32_t m_stackSize = 512;
+
+		std::vector<Node> m_nodes;
+		std::vector<TriangleBlock> m_blocks;
+		AABB m_bounds;
+	};
+
+	template<typename VisitTriangle>
+	void BVH8::QuerySphere(const vec3& center, float& radius, VisitTriangle visit) const
+	{
+		if (m_nodes.empty())
+			return;
+
+		const Float8 centerX(center.x), centerY(center.y), centerZ(center.z);
+		const Float8 zero(0.f);
+
+		//distances are squared
+		StackEntry stack[m_stackSize];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0, 0.f };
+		while (stackSize)
+		{
+			StackEntry entry = stack[--stackSize];
+			if (entry.m_distance > radius * radius)
+				continue;
+
+			if (entry.m_blockCount)
+			{
+				for (uint32_t b = entry.m_child; b < entry.m_child + entry.m_blockCount; b++)
+				{
+					const TriangleBlock& block = m_blocks[b];
+					for (uint32_t lane = 0; lane < 8 && block.m_primitives[lane] != m_invalid; lane++)
+					{
+						vec3 p0 = vec3(block.m_v0X[lane], block.m_v0Y[lane], block.m_v0Z[lane]);
+						vec3 p1 = p0 + vec3(block.m_edge1X[lane], block.m_edge1Y[lane], block.m_edge1Z[lane]);
+						vec3 p2 = p0 + vec3(block.m_edge2X[lane], block.m_edge2Y[lane], block.m_edge2Z[lane]);
+						visit(block.m_primitives[lane], p0, p1, p2, radius);
+					}
+				}
+				continue;
+			}
+
+			const Node& node = m_nodes[entry.m_child];
+			Float8 outsideX = Max(Max(Float8::Load(node.m_minX) - centerX, centerX - Float8::Load(node.m_maxX)), zero);
+			Float8 outsideY = Max(Max(Float8::Load(node.m_minY) - centerY, centerY - Float8::Load(node.m_maxY)), zero);
+			Float8 outsideZ = Max(Max(Float8::Load(node.m_minZ) - centerZ, centerZ - Float8::Load(node.m_maxZ)), zero);
+			Float8 squaredDistance = outsideX * outsideX + outsideY * outsideY + outsideZ * outsideZ;
+			uint32_t mask = MoveMask(squaredDistance <= Float8(radius * radius));
+			if (!mask)
+				continue;
+
+			alignas(32) float distances[8];
+			squaredDistance.Store(distances);
+			StackEntry children[8];
+			uint32_t childCount = 0;
+			for (uint32_t i = 0; i < 8 && node.m_children[i] != m_invalid; i++)
+			{
+				if (!(mask & (1u << i)))
+					continue;
+
+				StackEntry child = { node.m_children[i], node.m_blockCounts[i], distances[i] };
+				uint32_t position = childCount++;
+				while (position > 0 && children[position - 1].m_distance < child.m_distance)
+				{
+					children[position] = children[position - 1];
+					position--;
+				}
+				children[position] = child;
+			}
+			for (uint32_t i = 0; i < childCount; i++)
+			{
+				stack[stackSize++] = children[i];
+			}
+		}
+	}
+}
@@ -0,0 +1,303 @@
+#include "CpuRaytracer.h"
+
+#include <cmath>
+#include <stb_image.h>
+#define STBI_MSC_SECURE_CRT
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace MelonRenderer
+{
+	//random.glsl, so the random sampler draws the same sequence on both sides
+	static uint32_t Tea(uint32_t val0, uint32_t val1)
+	{
+		uint32_t v0 = val0;
+		uint32_t v1 = val1;
+		uint32_t s0 = 0;
+
+		for (uint32_t n = 0; n < 16; n++)
+		{
+			s0 += 0x9e3779b9;
+			v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+			v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+		}
+
+		return v0;
+	}
+
+	static float Rnd(uint32_t& previous)
+	{
+		previous = 1664525u * previous + 1013904223u;
+		return static_cast<float>(previous & 0x00FFFFFF) / static_cast<float>(0x01000000);
+	}
+
+	//wavefront.glsl
+	static vec3 ComputeSpecular(const WaveFrontMaterial& material, const vec3& viewDirection, const vec3& lightDirection, const vec3& normal)
+	{
+		if (material.illum < 2)
+			return vec3(0.f);
+
+		const float pi = 3.14159265f;
+		const float shininess = material.shininess > 4.f ? material.shininess : 4.f;
+		const float energyConservation = (2.f + shininess) / (2.f * pi);
+		vec3 v = glm::normalize(-viewDirection);
+		vec3 r = glm::reflect(-lightDirection, normal);
+		float vDotR = glm::dot(v, r);
+		return material.specular * energyConservation * std::pow(vDotR > 0.f ? vDotR : 0.f, shininess);
+	}
+
+	bool CpuRaytracer::Init(const Scene& scene, const DeviceMemoryManager& memoryManager, ThreadPool& threadPool)
+	{
+		m_threadPool = &threadPool;
+
+		const auto& textureIDs = memoryManager.GetTextureIDs();
+		m_textures.clear();
+		m_textures.resize(textureIDs.size());
+		for (const auto& texture : textureIDs)
+		{
+			std::string path = "textures/" + texture.first;
+			CpuTexture& cpuTexture = m_textures[texture.second];
+			int channels;
+			unsigned char* pixelData = stbi_load(path.c_str(), &cpuTexture.m_width, &cpuTexture.m_height, &channels, STBI_rgb_alpha);
+			if (pixelData == nullptr)
+			{
+				Logger::Log("Could not load texture " + path + " for the cpu raytracer.");
+				return false;
+			}
+			cpuTexture.m_pixels.assign(pixelData, pixelData + static_cast<size_t>(cpuTexture.m_width) * cpuTexture.m_height * 4);
+			stbi_image_free(pixelData);
+		}
+
+		m_scene.Build(scene, *m_threadPool);
+
+		return true;
+	}
+
+	void CpuRaytracer::UpdateInstances()
+	{
+		m_scene.UpdateInstances();
+	}
+
+	void CpuRaytracer::SetThreadPool(ThreadPool& threadPool)
+	{
+		m_threadPool = &threadPool;
+		m_scene.SetThreadPool(threadPool);
+	}
+
+	uint32_t CpuRaytracer::GetThreadCount() const
+	{
+		return m_threadPool ? m_threadPool->GetThreadCount() : 0;
+	}
+
+	bool CpuRaytracer::Render(const CameraMatrices& camera, VkExtent2D extent, const CpuRenderSettings& settings, std::vector<vec4>& pixels)
+	{
+		if (!m_threadPool)
+		{
+			Logger::Log("Could not render on the cpu, the raytracer is not initialized.");
+			return false;
+		}
+		if (!settings.m_samplesPerPixel)
+		{
+			Logger::Log("Could not render on the cpu with 0 samples per pixel.");
+			return false;
+		}
+
+		//instances stay in place for the whole image
+		std::shared_lock<std::shared_mutex> lock(m_scene.m_mutex);
+		m_settings = settings;
+		pixels.resize(extent.width * extent.height);
+
+		const uint32_t tilesX = (extent.width + m_tileSize - 1) / m_tileSize;
+		const uint32_t tilesY = (extent.height + m_tileSize - 1) / m_tileSize;
+		const vec3 origin = vec3(camera.viewInverse * vec4(0.f, 0.f, 0.f, 1.f));
+		const glm::vec2 size = glm::vec2(extent.width, extent.height);
+
+		m_threadPool->ParallelFor(tilesX * tilesY, [&](uint32_t tile)
+			{
+				uint32_t tileX = (tile % tilesX) * m_tileSize;
+				uint32_t tileY = (tile / tilesX) * m_tileSize;
+				uint32_t endX = tileX + m_tileSize < extent.width ? tileX + m_tileSize : extent.width;
+				uint32_t endY = tileY + m_tileSize < extent.height ? tileY + m_tileSize : extent.height;
+
+				for (uint32_t y = tileY; y < endY; y++)
+				{
+					for (uint32_t x = tileX; x < endX; x++)
+					{
+						uint32_t pixelIndex = y * extent.width + x;
+						uint32_t seed = Tea(pixelIndex, 0);
+						vec3 color = vec3(0.f);
+						for (uint32_t sample = 0; sample < m_settings.m_samplesPerPixel; sample++)
+						{
+							//the first sample goes through the pixel center, like on the gpu
+							glm::vec2 jitter;
+							jitter.x = Rnd(seed);
+							jitter.y = Rnd(seed);
+							if (!sample)
+								jitter = glm::vec2(0.5f);
+
+							glm::vec2 d = (glm::vec2(x, y) + jitter) / size * 2.f - 1.f;
+							vec4 target = camera.projectionInverse * vec4(d.x, d.y, 1.f, 1.f);
+
+							Ray ray;
+							ray.m_origin = origin;
+							ray.m_direction = vec3(camera.viewInverse * vec4(glm::normalize(vec3(target)), 0.f));
+							color += TracePath(ray, seed);
+						}
+
+						//sample count in w, like the accumulation image
+						pixels[pixelIndex] = vec4(color / static_cast<float>(m_settings.m_samplesPerPixel), static_cast<float>(m_settings.m_samplesPerPixel));
+					}
+				}
+			});
+
+		return true;
+	}
+
+	bool CpuRaytracer::WriteImage(const std::string& path, VkExtent2D extent, const std::vector<vec4>& pixels)
+	{
+		if (pixels.size() != extent.width * extent.height)
+		{
+			Logger::Log("Could not write image, the pixel count does not match the extent.");
+			return false;
+		}
+
+		std::vector<unsigned char> data(pixels.size() * 3);
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			vec3 color = glm::clamp(vec3(pixels[i]), vec3(0.f), vec3(1.f));
+			data[i * 3 + 0] = static_cast<unsigned char>(color.r * 255.f + 0.5f);
+			data[i * 3 + 1] = static_cast<unsigned char>(color.g * 255.f + 0.5f);
+			data[i * 3 + 2] = static_cast<unsigned char>(color.b * 255.f + 0.5f);
+		}
+
+		if (!stbi_write_png(path.c_str(), extent.width, extent.height, 3, data.data(), extent.width * 3))
+		{
+			Logger::Log("Could not write image to " + path + ".");
+			return false;
+		}
+
+		return true;
+	}
+
+	//raygen loop and closest hit shader in one, reflections continue until a non mirror is hit
+	vec3 CpuRaytracer::TracePath(Ray ray, uint32_t& seed) const
+	{
+		const Scene& scene = m_scene.GetScene();
+		vec3 hitValue = vec3(0.f);
+		vec3 attenuation = vec3(1.f);
+
+		for (uint32_t depth = 0; depth < m_maxDepth; depth++)
+		{
+			RayHit hit;
+			if (!m_scene.IntersectInternal(ray, hit))
+			{
+				hitValue += m_settings.m_clearColor * 0.8f * attenuation;
+				break;
+			}
+
+			const Drawable& drawable = scene.m_drawables[hit.m_drawable];
+			const Vertex& v0 = drawable.m_vertices[drawable.m_indices[hit.m_primitive * 3 + 0]];
+			const Vertex& v1 = drawable.m_vertices[drawable.m_indices[hit.m_primitive * 3 + 1]];
+			const Vertex& v2 = drawable.m_vertices[drawable.m_indices[hit.m_primitive * 3 + 2]];
+			const vec3 barycentrics = vec3(1.f - hit.m_u - hit.m_v, hit.m_u, hit.m_v);
+
+			vec3 normal = vec3(v0.normalX, v0.normalY, v0.normalZ) * barycentrics.x + vec3(v1.normalX, v1.normalY, v1.normalZ) * barycentrics.y +
+				vec3(v2.normalX, v2.normalY, v2.normalZ) * barycentrics.z;
+			normal = glm::normalize(m_scene.m_normalMatrices[hit.m_instance].TransformVector(normal));
+			vec3 position = ray.m_origin + ray.m_direction * hit.m_t;
+
+			const WaveFrontMaterial& material = drawable.m_materials[v0.matID < drawable.m_materials.size() ? v0.matID : 0];
+			vec3 texel = vec3(1.f);
+			if (material.textureId >= 0)
+			{
+				texel = SampleTexture(material.textureId, v0.u * barycentrics.x + v1.u * barycentrics.y + v2.u * barycentrics.z,
+					v0.v * barycentrics.x + v1.v * barycentrics.y + v2.v * barycentrics.z);
+			}
+
+			vec3 direct = ShadeDirect(material, texel, position, normal, ray.m_direction, seed);
+
+			//the closest hit shader applies the mirror attenuation before its own light is added
+			bool reflective = material.illum == 3;
+			if (reflective)
+				attenuation *= material.specular;
+			hitValue += direct * attenuation;
+			if (!reflective)
+				break;
+
+			ray.m_origin = position;
+			ray.m_direction = glm::reflect(ray.m_direction, normal);
+			ray.m_tMin = 0.001f;
+			ray.m_tMax = 100000.f;
+		}
+
+		return hitValue;
+	}
+
+	//shading.glsl
+	vec3 CpuRaytracer::ShadeDirect(const WaveFrontMaterial& material, const vec3& texel, const vec3& position, const vec3& normal, const vec3& viewDirection, uint32_t& seed) const
+	{
+		float lightSampleX = Rnd(seed);
+		float lightSampleY = Rnd(seed);
+		float lightZ = 1.f - 2.f * lightSampleX;
+		float lightPhi = 2.f * 3.14159265f * lightSampleY;
+		float lightXY = 1.f - lightZ * lightZ;
+		lightXY = std::sqrt(lightXY > 0.f ? lightXY : 0.f);
+		vec3 lightOffset = vec3(lightXY * std::cos(lightPhi), lightXY * std::sin(lightPhi), lightZ);
+		vec3 lightDirection = m_settings.m_lightPosition + m_settings.m_lightRadius * lightOffset - position;
+		float lightDistance = glm::length(lightDirection);
+		vec3 l = lightDirection / lightDistance;
+
+		vec3 diffuse = vec3(0.f);
+		float nDotL = glm::dot(normal, l);
+		if (material.illum >= 1)
+		{
+			diffuse = material.diffuse * (nDotL > 0.f ? nDotL : 0.f) + material.ambient;
+		}
+		diffuse *= texel;
+
+		vec3 specular = vec3(0.f);
+		float attenuation = 0.3f;
+		if (nDotL > 0.f)
+		{
+			Ray shadowRay;
+			shadowRay.m_origin = position;
+			shadowRay.m_direction = l;
+			shadowRay.m_tMax = lightDistance;
+			if (!m_scene.OccludedInternal(shadowRay))
+			{
+				attenuation = 1.f;
+				specular = ComputeSpecular(material, viewDirection, l, normal);
+			}
+		}
+
+		return m_settings.m_lightIntensity * attenuation * (diffuse + specular);
+	}
+
+	vec3 CpuRaytracer::SampleTexture(int textureId, float u, float v) const
+	{
+		if (textureId >= static_cast<int>(m_textures.size()) || m_textures[textureId].m_pixels.empty())
+			return vec3(1.f);
+
+		const CpuTexture& texture = m_textures[textureId];
+		float x = u * texture.m_width - 0.5f;
+		float y = v * texture.m_height - 0.5f;
+		float x0 = std::floor(x);
+		float y0 = std::floor(y);
+		float fractionX = x - x0;
+		float fractionY = y - y0;
+
+		auto texel = [&](int tx, int ty)
+		{
+			tx = ((tx % texture.m_width) + texture.m_width) % texture.m_width;
+			ty = ((ty % texture.m_height) + texture.m_height) % texture.m_height;
+			const unsigned char* pixel = &texture.m_pixels[(static_cast<size_t>(ty) * texture.m_width + tx) * 4];
+			return vec3(pixel[0], pixel[1], pixel[2]) / 255.f;
+		};
+
+		int ix = static_cast<int>(x0);
+		int iy = static_cast<int>(y0);
+		vec3 top = glm::mix(texel(ix, iy), texel(ix + 1, iy), fractionX);
+		vec3 bottom = glm::mix(texel(ix, iy + 1), texel(ix + 1, iy + 1), fractionX);
+		return glm::mix(top, bottom, fractionY);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CpuScene.h"
+#include "../Camera.h"
+
+#include <memory>
+#include <string>
+
+namespace MelonRenderer
+{
+	//same defaults as the raytracing pipeline
+	struct CpuRenderSettings
+	{
+		vec3 m_clearColor = vec3(0.f, 0.4531f, 0.78125f);
+		vec3 m_lightPosition = vec3(-50.f, 50.f, -50.f);
+		float m_lightIntensity = 1.f;
+		float m_lightRadius = 0.f;
+		uint32_t m_samplesPerPixel = 16;
+	};
+
+	//headless path tracer on the cpu, shades like the closest hit shader with the random sampler, to be used as a reference for the gpu
+	class CpuRaytracer
+	{
+	public:
+		//builds the hierarchies and loads the textures again, the gpu copies can not be read back,
+		//the thread pool is owned by the caller and has to outlive the raytracer or be replaced
+		bool Init(const Scene& scene, const DeviceMemoryManager& memoryManager, ThreadPool& threadPool);
+		//instances have moved since Init
+		void UpdateInstances();
+		void SetThreadPool(ThreadPool& threadPool);
+		uint32_t GetThreadCount() const;
+
+		//linear colors in rows from top to bottom, like the raytracing output
+		bool Render(const CameraMatrices& camera, VkExtent2D extent, const CpuRenderSettings& settings, std::vector<vec4>& pixels);
+		//png, clamped to [0, 1]
+		static bool WriteImage(const std::string& path, VkExtent2D extent, const std::vector<vec4>& pixels);
+
+	protected:
+		struct CpuTexture
+		{
+			int m_width = 0;
+			int m_height = 0;
+			std::vector<unsigned char> m_pixels;
+		};
+
+		vec3 TracePath(Ray ray, uint32_t& seed) const;
+		vec3 ShadeDirect(const WaveFrontMaterial& material, const vec3& texel, const vec3& position, const vec3& normal, const vec3& viewDirection, uint32_t& seed) const;
+		//bilinear with repeat, like the texture sampler
+		vec3 SampleTexture(int textureId, float u, float v) const;
+
+		static constexpr uint32_t m_tileSize = 16;
+		static constexpr uint32_t m_maxDepth = 10;
+
+		CpuScene m_scene;
+		ThreadPool* m_threadPool = nullptr;
+		std::vector<CpuTexture> m_textures;
+		CpuRenderSettings m_settings;
+	};
+}
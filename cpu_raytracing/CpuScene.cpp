@@ -0,0 +1,275 @@
+#include "CpuScene.h"
+#include "../AffineKernels.h"
+
+#include <mutex>
+
+namespace MelonRenderer
+{
+	void CpuScene::Build(const Scene& scene, ThreadPool& threadPool)
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		m_scene = &scene;
+		m_threadPool = &threadPool;
+		m_drawableBVHs.resize(scene.m_drawables.size());
+
+		threadPool.ParallelFor(static_cast<uint32_t>(scene.m_drawables.size()), [&](uint32_t drawableIndex)
+			{
+				const Drawable& drawable = scene.m_drawables[drawableIndex];
+				m_drawableBVHs[drawableIndex].Build(drawable.m_vertices, drawable.m_indices);
+			});
+
+		//forces a full build of the top level
+		m_objectToWorld.clear();
+		lock.unlock();
+		UpdateInstances();
+	}
+
+	void CpuScene::SetThreadPool(ThreadPool& threadPool)
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		m_threadPool = &threadPool;
+	}
+
+	void CpuScene::UpdateInstances()
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		const auto& instances = m_scene->m_drawableInstances;
+		std::vector<uint32_t> changedInstances;
+		if (m_objectToWorld.size() == instances.size())
+		{
+			for (uint32_t i = 0; i < instances.size(); i++)
+			{
+				if (instances[i].m_transformation != m_objectToWorld[i])
+					changedInstances.emplace_back(i);
+			}
+		}
+		RefitInstances(changedInstances);
+	}
+
+	void CpuScene::UpdateInstances(const std::vector<uint32_t>& changedInstances)
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		RefitInstances(changedInstances);
+	}
+
+	void CpuScene::RefitInstances(const std::vector<uint32_t>& changedInstances)
+	{
+		const auto& instances = m_scene->m_drawableInstances;
+		if (m_objectToWorld.size() != instances.size())
+		{
+			m_objectToWorld.resize(instances.size());
+			m_worldToObject.resize(instances.size());
+			m_normalMatrices.resize(instances.size());
+			m_worldToObjectScale.resize(instances.size());
+			m_instanceDrawables.resize(instances.size());
+			m_instanceBounds.resize(instances.size());
+			for (uint32_t i = 0; i < instances.size(); i++)
+			{
+				UpdateInstance(i);
+			}
+			InverseBatch(m_objectToWorld.data(), m_worldToObject.data(), m_objectToWorld.size());
+			NormalMatrixBatch(m_objectToWorld.data(), m_normalMatrices.data(), m_objectToWorld.size());
+			for (uint32_t i = 0; i < instances.size(); i++)
+			{
+				UpdateInstanceScale(i);
+			}
+
+			m_instanceBVH.Build(m_instanceBounds);
+			m_builtSurfaceArea = m_instanceBVH.GetBounds().SurfaceArea();
+			return;
+		}
+
+		if (changedInstances.empty())
+			return;
+
+		for (uint32_t instance : changedInstances)
+		{
+			UpdateInstance(instance);
+			m_worldToObject[instance] = Inverse(m_objectToWorld[instance]);
+			m_normalMatrices[instance] = NormalMatrix(m_objectToWorld[instance]);
+			UpdateInstanceScale(instance);
+		}
+
+		//walking up from every leaf only pays off while few instances moved
+		if (changedInstances.size() * 8 < m_instanceBounds.size())
+			m_instanceBVH.Refit(m_instanceBounds, changedInstances);
+		else
+			m_instanceBVH.Refit(m_instanceBounds);
+		if (m_instanceBVH.GetBounds().SurfaceArea() > 2.f * m_builtSurfaceArea)
+		{
+			m_instanceBVH.Build(m_instanceBounds);
+			m_builtSurfaceArea = m_instanceBVH.GetBounds().SurfaceArea();
+		}
+	}
+
+	void CpuScene::UpdateInstance(uint32_t instance)
+	{
+		const DrawableInstance& drawableInstance = m_scene->m_drawableInstances[instance];
+		m_objectToWorld[instance] = drawableInstance.m_transformation;
+		m_instanceDrawables[instance] = drawableInstance.m_drawableIndex;
+		m_instanceBounds[instance] = m_drawableBVHs[drawableInstance.m_drawableIndex].GetBounds().Transform(drawableInstance.m_transformation);
+	}
+
+	void CpuScene::UpdateInstanceScale(uint32_t instance)
+	{
+		//the frobenius norm bounds the largest singular value
+		const AffineTransform& worldToObject = m_worldToObject[instance];
+		m_worldToObjectScale[instance] = glm::sqrt(glm::dot(vec3(worldToObject.m_rows[0]), vec3(worldToObject.m_rows[0])) +
+			glm::dot(vec3(worldToObject.m_rows[1]), vec3(worldToObject.m_rows[1])) + glm::dot(vec3(worldToObject.m_rows[2]), vec3(worldToObject.m_rows[2])));
+	}
+
+	bool CpuScene::Intersect(Ray& ray, RayHit& hit) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		return IntersectInternal(ray, hit);
+	}
+
+	bool CpuScene::Occluded(Ray ray) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		return OccludedInternal(ray);
+	}
+
+	bool CpuScene::ClosestPoint(const vec3& point, float maxDistance, PointHit& hit) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		return ClosestPointInternal(point, maxDistance, hit);
+	}
+
+	void CpuScene::Intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const
+	{
+		//the workers rely on this lock, locking again from them could deadlock behind a waiting UpdateInstances
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		hits.resize(rays.size());
+		uint32_t taskCount = static_cast<uint32_t>((rays.size() + m_queriesPerTask - 1) / m_queriesPerTask);
+		m_threadPool->ParallelFor(taskCount, [&](uint32_t task)
+			{
+				size_t end = (task + 1) * static_cast<size_t>(m_queriesPerTask);
+				for (size_t i = task * static_cast<size_t>(m_queriesPerTask); i < end && i < rays.size(); i++)
+				{
+					Ray ray = rays[i];
+					hits[i] = RayHit();
+					IntersectInternal(ray, hits[i]);
+				}
+			});
+	}
+
+	void CpuScene::Occluded(const std::vector<Ray>& rays, std::vector<uint8_t>& occluded) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		occluded.resize(rays.size());
+		uint32_t taskCount = static_cast<uint32_t>((rays.size() + m_queriesPerTask - 1) / m_queriesPerTask);
+		m_threadPool->ParallelFor(taskCount, [&](uint32_t task)
+			{
+				size_t end = (task + 1) * static_cast<size_t>(m_queriesPerTask);
+				for (size_t i = task * static_cast<size_t>(m_queriesPerTask); i < end && i < rays.size(); i++)
+				{
+					occluded[i] = OccludedInternal(rays[i]) ? 1 : 0;
+				}
+			});
+	}
+
+	void CpuScene::ClosestPoint(const std::vector<vec3>& points, float maxDistance, std::vector<PointHit>& hits) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		hits.resize(points.size());
+		uint32_t taskCount = static_cast<uint32_t>((points.size() + m_queriesPerTask - 1) / m_queriesPerTask);
+		m_threadPool->ParallelFor(taskCount, [&](uint32_t task)
+			{
+				size_t end = (task + 1) * static_cast<size_t>(m_queriesPerTask);
+				for (size_t i = task * static_cast<size_t>(m_queriesPerTask); i < end && i < points.size(); i++)
+				{
+					hits[i] = PointHit();
+					ClosestPointInternal(points[i], maxDistance, hits[i]);
+				}
+			});
+	}
+
+	bool CpuScene::IntersectInternal(Ray& ray, RayHit& hit) const
+	{
+		return m_instanceBVH.Traverse(ray, [&](uint32_t instance, Ray& worldRay)
+			{
+				//the direction is not normalized again, so distances are the same in both spaces
+				Ray objectRay = worldRay;
+				objectRay.m_origin = m_worldToObject[instance].TransformPoint(worldRay.m_origin);
+				objectRay.m_direction = m_worldToObject[instance].TransformVector(worldRay.m_direction);
+
+				TriangleHit triangleHit;
+				if (!m_drawableBVHs[m_instanceDrawables[instance]].Intersect(objectRay, triangleHit))
+					return false;
+
+				worldRay.m_tMax = triangleHit.m_t;
+				hit.m_t = triangleHit.m_t;
+				hit.m_u = triangleHit.m_u;
+				hit.m_v = triangleHit.m_v;
+				hit.m_primitive = triangleHit.m_primitive;
+				hit.m_instance = instance;
+				hit.m_drawable = m_instanceDrawables[instance];
+				return true;
+			}, false);
+	}
+
+	bool CpuScene::OccludedInternal(const Ray& ray) const
+	{
+		Ray shadowRay = ray;
+		return m_instanceBVH.Traverse(shadowRay, [&](uint32_t instance, Ray& worldRay)
+			{
+				Ray objectRay = worldRay;
+				objectRay.m_origin = m_worldToObject[instance].TransformPoint(worldRay.m_origin);
+				objectRay.m_direction = m_worldToObject[instance].TransformVector(worldRay.m_direction);
+
+				return m_drawableBVHs[m_instanceDrawables[instance]].Occluded(objectRay);
+			}, true);
+	}
+
+	bool CpuScene::ClosestPointInternal(const vec3& point, float maxDistance, PointHit& hit) const
+	{
+		bool found = false;
+		float radius = maxDistance;
+		m_instanceBVH.QuerySphere(point, radius, [&](uint32_t instance, float& worldRadius)
+			{
+				//the object space sphere encloses the transformed world space sphere, candidates are measured in world space
+				const AffineTransform& objectToWorld = m_objectToWorld[instance];
+				const float scale = m_worldToObjectScale[instance];
+				vec3 objectPoint = m_worldToObject[instance].TransformPoint(point);
+				float objectRadius = worldRadius * scale;
+				m_drawableBVHs[m_instanceDrawables[instance]].QuerySphere(objectPoint, objectRadius,
+					[&](uint32_t primitive, const vec3& p0, const vec3& p1, const vec3& p2, float& triangleRadius)
+					{
+						float u, v;
+						vec3 closest = ClosestPointOnTriangle(point, objectToWorld.TransformPoint(p0), objectToWorld.TransformPoint(p1),
+							objectToWorld.TransformPoint(p2), u, v);
+						float distance = glm::length(closest - point);
+						if (distance > worldRadius)
+							return;
+
+						worldRadius = distance;
+						triangleRadius = distance * scale;
+						hit.m_position = closest;
+						hit.m_distance = distance;
+						hit.m_u = u;
+						hit.m_v = v;
+						hit.m_primitive = primitive;
+						hit.m_instance = instance;
+						hit.m_drawable = m_instanceDrawables[instance];
+						found = true;
+					});
+			});
+		return found;
+	}
+
+	const Scene& CpuScene::GetScene() const
+	{
+		return *m_scene;
+	}
+
+	size_t CpuScene::GetTriangleCount() const
+	{
+		size_t triangles = 0;
+		for (const auto& drawable : m_scene->m_drawables)
+		{
+			triangles += drawable.m_indices.size() / 3;
+		}
+		return triangles;
+	}
+}
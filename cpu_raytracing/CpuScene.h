@@ -0,0 +1,95 @@
+#pragma once
+
+#include "BVH8.h"
+#include "ThreadPool.h"
+#include "../simple_scene_graph/Scene.h"
+
+#include <shared_mutex>
+
+namespace MelonRenderer
+{
+	struct RayHit
+	{
+		float m_t;
+		//barycentrics of the second and third vertex, like the hit attributes of the closest hit shader
+		float m_u;
+		float m_v;
+		uint32_t m_primitive;
+		uint32_t m_instance = UINT32_MAX; //UINT32_MAX without a hit
+		uint32_t m_drawable;
+	};
+
+	struct PointHit
+	{
+		vec3 m_position;
+		float m_distance;
+		float m_u;
+		float m_v;
+		uint32_t m_primitive;
+		uint32_t m_instance = UINT32_MAX;
+		uint32_t m_drawable;
+	};
+
+	//cpu counterpart of the acceleration structures, one BVH8 per drawable and a binary BVH over the instances on top,
+	//queries may run on any thread while UpdateInstances waits for them
+	class CpuScene
+	{
+	public:
+		//bottom level hierarchies of all drawables, built in parallel, followed by the top level,
+		//the thread pool is kept for batched queries and has to outlive the scene or be replaced
+		void Build(const Scene& scene, ThreadPool& threadPool);
+		void SetThreadPool(ThreadPool& threadPool);
+		//refits the top level for instances whose transform changed, rebuilds it if instances were added
+		void UpdateInstances();
+		//same without comparing every transform, changedInstances come from Scene::UpdateInstanceTransforms
+		void UpdateInstances(const std::vector<uint32_t>& changedInstances);
+
+		//closest hit, the ray is shortened to it
+		bool Intersect(Ray& ray, RayHit& hit) const;
+		bool Occluded(Ray ray) const;
+		//closest point on any triangle within maxDistance
+		bool ClosestPoint(const vec3& point, float maxDistance, PointHit& hit) const;
+
+		//batches are split across the threads of the pool
+		void Intersect(const std::vector<Ray>& rays, std::vector<RayHit>& hits) const;
+		void Occluded(const std::vector<Ray>& rays, std::vector<uint8_t>& occluded) const;
+		void ClosestPoint(const std::vector<vec3>& points, float maxDistance, std::vector<PointHit>& hits) const;
+
+		const Scene& GetScene() const;
+		size_t GetTriangleCount() const;
+
+	protected:
+		//without locking, for callers that hold m_mutex for a whole batch
+		bool IntersectInternal(Ray& ray, RayHit& hit) const;
+		bool OccludedInternal(const Ray& ray) const;
+		bool ClosestPointInternal(const vec3& point, float maxDistance, PointHit& hit) const;
+		//copies the transform of the instance, the inverse and normal matrix are computed by the caller
+		void UpdateInstance(uint32_t instance);
+		void UpdateInstanceScale(uint32_t instance);
+		//expects m_mutex to be locked
+		void RefitInstances(const std::vector<uint32_t>& changedInstances);
+
+		static constexpr uint32_t m_queriesPerTask = 64;
+
+		const Scene* m_scene = nullptr;
+		ThreadPool* m_threadPool = nullptr;
+		std::vector<BVH8> m_drawableBVHs;
+
+		//rays are moved into object space instead of transforming the geometry
+		std::vector<AffineTransform> m_objectToWorld;
+		std::vector<AffineTransform> m_worldToObject;
+		std::vector<AffineTransform> m_normalMatrices;
+		//upper bound of how much world distances grow in object space
+		std::vector<float> m_worldToObjectScale;
+		//copied, so queries do not read the scene while instances are added
+		std::vector<uint32_t> m_instanceDrawables;
+		std::vector<AABB> m_instanceBounds;
+		BVH m_instanceBVH;
+		//refits only move bounds, a rebuild restores the quality once the top level grew too much
+		float m_builtSurfaceArea = 0.f;
+
+		mutable std::shared_mutex m_mutex;
+
+		friend class CpuRaytracer;
+	};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstdint>
+
+//8 floats wide, one AVX register when compiled with /arch:AVX2, two SSE registers otherwise
+namespace MelonRenderer
+{
+#if defined(__AVX2__)
+	constexpr const char* simdName = "AVX2";
+
+	struct Float8
+	{
+		__m256 m_value;
+
+		Float8() {}
+		Float8(__m256 value) : m_value(value) {}
+		explicit Float8(float value) : m_value(_mm256_set1_ps(value)) {}
+
+		static Float8 Load(const float* values) { return _mm256_load_ps(values); }
+		void Store(float* values) const { _mm256_store_ps(values, m_value); }
+	};
+
+	inline Float8 operator+(const Float8& a, const Float8& b) { return _mm256_add_ps(a.m_value, b.m_value); }
+	inline Float8 operator-(const Float8& a, const Float8& b) { return _mm256_sub_ps(a.m_value, b.m_value); }
+	inline Float8 operator*(const Float8& a, const Float8& b) { return _mm256_mul_ps(a.m_value, b.m_value); }
+	inline Float8 operator/(const Float8& a, const Float8& b) { return _mm256_div_ps(a.m_value, b.m_value); }
+	inline Float8 operator&(const Float8& a, const Float8& b) { return _mm256_and_ps(a.m_value, b.m_value); }
+	inline Float8 operator|(const Float8& a, const Float8& b) { return _mm256_or_ps(a.m_value, b.m_value); }
+	inline Float8 operator<(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.m_value, b.m_value, _CMP_LT_OQ); }
+	inline Float8 operator<=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.m_value, b.m_value, _CMP_LE_OQ); }
+	inline Float8 operator>(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.m_value, b.m_value, _CMP_GT_OQ); }
+	inline Float8 operator>=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.m_value, b.m_value, _CMP_GE_OQ); }
+	inline Float8 Min(const Float8& a, const Float8& b) { return _mm256_min_ps(a.m_value, b.m_value); }
+	inline Float8 Max(const Float8& a, const Float8& b) { return _mm256_max_ps(a.m_value, b.m_value); }
+	//a * b - c, msvc enables FMA together with AVX2
+#if defined(__FMA__) || defined(_MSC_VER)
+	inline Float8 FusedMultiplySubtract(const Float8& a, const Float8& b, const Float8& c) { return _mm256_fmsub_ps(a.m_value, b.m_value, c.m_value); }
+#else
+	inline Float8 FusedMultiplySubtract(const Float8& a, const Float8& b, const Float8& c) { return _mm256_sub_ps(_mm256_mul_ps(a.m_value, b.m_value), c.m_value); }
+#endif
+	//per lane mask ? a : b
+	inline Float8 Select(const Float8& mask, const Float8& a, const Float8& b) { return _mm256_blendv_ps(b.m_value, a.m_value, mask.m_value); }
+	//one bit per lane of a comparison result
+	inline uint32_t MoveMask(const Float8& mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask.m_value)); }
+#else
+	constexpr const char* simdName = "SSE";
+
+	struct Float8
+	{
+		__m128 m_low;
+		__m128 m_high;
+
+		Float8() {}
+		Float8(__m128 low, __m128 high) : m_low(low), m_high(high) {}
+		explicit Float8(float value) : m_low(_mm_set1_ps(value)), m_high(_mm_set1_ps(value)) {}
+
+		static Float8 Load(const float* values) { return Float8(_mm_load_ps(values), _mm_load_ps(values + 4)); }
+		void Store(float* values) const { _mm_store_ps(values, m_low); _mm_store_ps(values + 4, m_high); }
+	};
+
+	inline Float8 operator+(const Float8& a, const Float8& b) { return Float8(_mm_add_ps(a.m_low, b.m_low), _mm_add_ps(a.m_high, b.m_high)); }
+	inline Float8 operator-(const Float8& a, const Float8& b) { return Float8(_mm_sub_ps(a.m_low, b.m_low), _mm_sub_ps(a.m_high, b.m_high)); }
+	inline Float8 operator*(const Float8& a, const Float8& b) { return Float8(_mm_mul_ps(a.m_low, b.m_low), _mm_mul_ps(a.m_high, b.m_high)); }
+	inline Float8 operator/(const Float8& a, const Float8& b) { return Float8(_mm_div_ps(a.m_low, b.m_low), _mm_div_ps(a.m_high, b.m_high)); }
+	inline Float8 operator&(const Float8& a, const Float8& b) { return Float8(_mm_and_ps(a.m_low, b.m_low), _mm_and_ps(a.m_high, b.m_high)); }
+	inline Float8 operator|(const Float8& a, const Float8& b) { return Float8(_mm_or_ps(a.m_low, b.m_low), _mm_or_ps(a.m_high, b.m_high)); }
+	inline Float8 operator<(const Float8& a, const Float8& b) { return Float8(_mm_cmplt_ps(a.m_low, b.m_low), _mm_cmplt_ps(a.m_high, b.m_high)); }
+	inline Float8 operator<=(const Float8& a, const Float8& b) { return Float8(_mm_cmple_ps(a.m_low, b.m_low), _mm_cmple_ps(a.m_high, b.m_high)); }
+	inline Float8 operator>(const Float8& a, const Float8& b) { return Float8(_mm_cmpgt_ps(a.m_low, b.m_low), _mm_cmpgt_ps(a.m_high, b.m_high)); }
+	inline Float8 operator>=(const Float8& a, const Float8& b) { return Float8(_mm_cmpge_ps(a.m_low, b.m_low), _mm_cmpge_ps(a.m_high, b.m_high)); }
+	inline Float8 Min(const Float8& a, const Float8& b) { return Float8(_mm_min_ps(a.m_low, b.m_low), _mm_min_ps(a.m_high, b.m_high)); }
+	inline Float8 Max(const Float8& a, const Float8& b) { return Float8(_mm_max_ps(a.m_low, b.m_low), _mm_max_ps(a.m_high, b.m_high)); }
+	inline Float8 FusedMultiplySubtract(const Float8& a, const Float8& b, const Float8& c) { return a * b - c; }
+	inline Float8 Select(const Float8& mask, const Float8& a, const Float8& b)
+	{
+		return Float8(_mm_or_ps(_mm_and_ps(mask.m_low, a.m_low), _mm_andnot_ps(mask.m_low, b.m_low)),
+			_mm_or_ps(_mm_and_ps(mask.m_high, a.m_high), _mm_andnot_ps(mask.m_high, b.m_high)));
+	}
+	inline uint32_t MoveMask(const Float8& mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask.m_low) | (_mm_movemask_ps(mask.m_high) << 4)); }
+#endif
+
+	inline Float8 operator-(const Float8& a) { return Float8(0.f) - a; }
+}
@@ -0,0 +1,397 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		//the pool the current thread works for and its deque, threads outside of every pool use the last deque of a pool
+		thread_local const ThreadPool* currentPool = nullptr;
+		thread_local uint32_t currentThread = 0;
+
+		//spins of an idle worker before it sleeps, jobs of the next ParallelFor or task tend to follow soon
+		constexpr uint32_t idleSpins = 64;
+	}
+
+	WorkStealingDeque::Buffer::Buffer(int64_t capacity) : m_mask(capacity - 1), m_jobs(new std::atomic<Job*>[capacity])
+	{
+	}
+
+	WorkStealingDeque::WorkStealingDeque(uint32_t capacity)
+	{
+		//a power of two, so indices wrap with the mask
+		int64_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_buffers.emplace_back(std::make_unique<Buffer>(size));
+		m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	void WorkStealingDeque::Push(Job* job)
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const int64_t top = m_top.load(std::memory_order_acquire);
+		Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+		if (bottom - top > buffer->m_mask)
+		{
+			//only the owner writes, thieves keep reading the old buffer until they see the new one
+			m_buffers.emplace_back(std::make_unique<Buffer>(2 * (buffer->m_mask + 1)));
+			Buffer* grownBuffer = m_buffers.back().get();
+			for (int64_t i = top; i < bottom; i++)
+			{
+				grownBuffer->m_jobs[i & grownBuffer->m_mask].store(buffer->m_jobs[i & buffer->m_mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+			m_buffer.store(grownBuffer, std::memory_order_release);
+			buffer = grownBuffer;
+		}
+
+		buffer->m_jobs[bottom & buffer->m_mask].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	Job* WorkStealingDeque::Pop()
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = buffer->m_jobs[bottom & buffer->m_mask].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			//the last job, thieves race for it
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* WorkStealingDeque::Steal()
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return nullptr;
+
+		Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+		Job* job = buffer->m_jobs[top & buffer->m_mask].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+	bool WorkStealingDeque::IsEmpty() const
+	{
+		return m_bottom.load() <= m_top.load();
+	}
+
+	uint32_t TaskGraph::AddTask(const char* name, std::function<void()> function)
+	{
+		return AddParallelTask(name, 1, [function](uint32_t) { function(); });
+	}
+
+	uint32_t TaskGraph::AddParallelTask(const char* name, uint32_t count, std::function<void(uint32_t)> function)
+	{
+		m_tasks.emplace_back(std::make_unique<Task>());
+		Task& task = *m_tasks.back();
+		task.m_function = std::move(function);
+		task.m_indexCount = count;
+		task.m_batch.m_name = name;
+		task.m_batch.m_function = &task.m_function;
+		return static_cast<uint32_t>(m_tasks.size() - 1);
+	}
+
+	void TaskGraph::SetIndexCount(uint32_t task, uint32_t count)
+	{
+		m_tasks[task]->m_indexCount = count;
+	}
+
+	void TaskGraph::AddDependency(uint32_t before, uint32_t after)
+	{
+		m_tasks[before]->m_successors.emplace_back(after);
+		m_tasks[after]->m_predecessorCount++;
+	}
+
+	void TaskGraph::Clear()
+	{
+		m_tasks.clear();
+	}
+
+	bool TaskGraph::IsEmpty() const
+	{
+		return m_tasks.empty();
+	}
+
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		if (!threadCount)
+		{
+			threadCount = std::thread::hardware_concurrency();
+			threadCount = threadCount ? threadCount : 1;
+		}
+
+		//the calling thread counts as one of them
+		m_deques.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_deques.emplace_back(std::make_unique<WorkStealingDeque>());
+		}
+		m_records.resize(threadCount);
+		m_workers.reserve(threadCount - 1);
+		for (uint32_t i = 0; i < threadCount - 1; i++)
+		{
+			m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stop = true;
+		}
+		m_wakeCondition.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function, const char* name)
+	{
+		if (!count)
+			return;
+
+		const uint32_t thread = GetCurrentThread();
+		JobBatch batch;
+		batch.m_name = name;
+		batch.m_function = &function;
+		StartBatch(thread, batch, count);
+
+		while (batch.m_remaining.load(std::memory_order_acquire))
+		{
+			if (!RunJob(thread))
+				std::this_thread::yield();
+		}
+	}
+
+	void ThreadPool::Submit(TaskGraph& graph)
+	{
+		const uint32_t taskCount = static_cast<uint32_t>(graph.m_tasks.size());
+		graph.m_remainingTasks.store(taskCount, std::memory_order_relaxed);
+		for (uint32_t t = 0; t < taskCount; t++)
+		{
+			TaskGraph::Task& task = *graph.m_tasks[t];
+			task.m_pendingPredecessors.store(task.m_predecessorCount, std::memory_order_relaxed);
+			task.m_batch.m_graph = &graph;
+			task.m_batch.m_task = t;
+		}
+
+		//every counter is set before the first task can complete
+		const uint32_t thread = GetCurrentThread();
+		for (uint32_t t = 0; t < taskCount; t++)
+		{
+			if (!graph.m_tasks[t]->m_predecessorCount)
+				StartTask(thread, graph, t);
+		}
+	}
+
+	void ThreadPool::Wait(TaskGraph& graph)
+	{
+		const uint32_t thread = GetCurrentThread();
+		while (graph.m_remainingTasks.load(std::memory_order_acquire))
+		{
+			if (!RunJob(thread))
+				std::this_thread::yield();
+		}
+	}
+
+	void ThreadPool::Run(TaskGraph& graph)
+	{
+		Submit(graph);
+		Wait(graph);
+	}
+
+	uint32_t ThreadPool::GetThreadCount() const
+	{
+		return static_cast<uint32_t>(m_deques.size());
+	}
+
+	void ThreadPool::SetInstrumentation(bool enabled)
+	{
+		if (enabled && !m_instrumentation.load())
+			m_instrumentationStart = std::chrono::high_resolution_clock::now();
+		m_instrumentation.store(enabled);
+	}
+
+	std::vector<TaskRecord> ThreadPool::TakeRecords()
+	{
+		std::vector<TaskRecord> records;
+		for (std::vector<TaskRecord>& threadRecords : m_records)
+		{
+			records.insert(records.end(), threadRecords.begin(), threadRecords.end());
+			threadRecords.clear();
+		}
+		std::sort(records.begin(), records.end(), [](const TaskRecord& a, const TaskRecord& b) { return a.m_startMs < b.m_startMs; });
+		return records;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t thread)
+	{
+		currentPool = this;
+		currentThread = thread;
+
+		uint32_t spins = 0;
+		while (true)
+		{
+			if (RunJob(thread))
+			{
+				spins = 0;
+				continue;
+			}
+			if (++spins < idleSpins)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			spins = 0;
+
+			//counted before looking at the deques, so a pushing thread either sees the sleeper or the sleeper sees the job
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_sleepingWorkers.fetch_add(1);
+			m_wakeCondition.wait(lock, [&] { return m_stop || HasQueuedJobs(); });
+			m_sleepingWorkers.fetch_sub(1);
+			if (m_stop)
+				return;
+		}
+	}
+
+	uint32_t ThreadPool::GetCurrentThread() const
+	{
+		return currentPool == this ? currentThread : static_cast<uint32_t>(m_deques.size() - 1);
+	}
+
+	void ThreadPool::PushJob(uint32_t thread, Job* job)
+	{
+		m_deques[thread]->Push(job);
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleepingWorkers.load())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_sleepMutex);
+			}
+			m_wakeCondition.notify_one();
+		}
+	}
+
+	bool ThreadPool::HasQueuedJobs() const
+	{
+		for (const std::unique_ptr<WorkStealingDeque>& deque : m_deques)
+		{
+			if (!deque->IsEmpty())
+				return true;
+		}
+		return false;
+	}
+
+	bool ThreadPool::RunJob(uint32_t thread)
+	{
+		Job* job = m_deques[thread]->Pop();
+		//victims from the next thread on, so thieves spread over the deques
+		const uint32_t threadCount = static_cast<uint32_t>(m_deques.size());
+		for (uint32_t i = 1; !job && i < threadCount; i++)
+		{
+			job = m_deques[(thread + i) % threadCount]->Steal();
+		}
+		if (!job)
+			return false;
+
+		ExecuteJob(thread, *job);
+		return true;
+	}
+
+	void ThreadPool::StartBatch(uint32_t thread, JobBatch& batch, uint32_t count)
+	{
+		if (batch.m_jobs.size() != count)
+			batch.m_jobs.resize(count);
+		batch.m_jobCount.store(1, std::memory_order_relaxed);
+		batch.m_remaining.store(count, std::memory_order_relaxed);
+		batch.m_jobs[0] = { &batch, 0, count };
+		PushJob(thread, &batch.m_jobs[0]);
+	}
+
+	void ThreadPool::ExecuteJob(uint32_t thread, Job& job)
+	{
+		JobBatch& batch = *job.m_batch;
+		const uint32_t index = job.m_begin;
+		uint32_t end = job.m_end;
+		//the upper halves are pushed before the index runs, so idle threads find work at once and steal the biggest halves first,
+		//while the owner pops the smallest and works through the range in order
+		while (end - index > 1)
+		{
+			const uint32_t middle = index + (end - index) / 2;
+			Job& half = batch.m_jobs[batch.m_jobCount.fetch_add(1, std::memory_order_relaxed)];
+			half = { &batch, middle, end };
+			PushJob(thread, &half);
+			end = middle;
+		}
+
+		if (m_instrumentation.load(std::memory_order_relaxed))
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			(*batch.m_function)(index);
+			auto stop = std::chrono::high_resolution_clock::now();
+			m_records[thread].push_back({ batch.m_name, index, thread,
+				std::chrono::duration<float, std::milli>(start - m_instrumentationStart).count(),
+				std::chrono::duration<float, std::milli>(stop - m_instrumentationStart).count() });
+		}
+		else
+		{
+			(*batch.m_function)(index);
+		}
+
+		//read before the last index is counted, a finished ParallelFor returns and destroys its batch
+		TaskGraph* graph = batch.m_graph;
+		const uint32_t task = batch.m_task;
+		if (batch.m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && graph)
+			CompleteTask(thread, *graph, task);
+	}
+
+	void ThreadPool::StartTask(uint32_t thread, TaskGraph& graph, uint32_t task)
+	{
+		TaskGraph::Task& graphTask = *graph.m_tasks[task];
+		if (!graphTask.m_indexCount)
+		{
+			CompleteTask(thread, graph, task);
+			return;
+		}
+		StartBatch(thread, graphTask.m_batch, graphTask.m_indexCount);
+	}
+
+	void ThreadPool::CompleteTask(uint32_t thread, TaskGraph& graph, uint32_t task)
+	{
+		//successors are pushed to this thread's deque and continue here unless stolen
+		for (uint32_t successor : graph.m_tasks[task]->m_successors)
+		{
+			if (graph.m_tasks[successor]->m_pendingPredecessors.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				StartTask(thread, graph, successor);
+		}
+
+		//last, once it reaches zero the graph may be destroyed by the waiting thread
+		graph.m_remainingTasks.fetch_sub(1, std::memory_order_release);
+	}
+}
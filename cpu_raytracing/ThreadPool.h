@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MelonRenderer
+{
+	class ThreadPool;
+	class TaskGraph;
+	struct JobBatch;
+
+	//a contiguous range of the indices of one task, split in halves by the thread running it until a single index is left
+	struct Job
+	{
+		JobBatch* m_batch;
+		uint32_t m_begin;
+		uint32_t m_end;
+	};
+
+	//everything one ParallelFor call or one task of a graph runs
+	struct JobBatch
+	{
+		const char* m_name = nullptr;
+		const std::function<void(uint32_t)>* m_function = nullptr;
+		//the root job and every half split off, at most one per index
+		std::vector<Job> m_jobs;
+		std::atomic<uint32_t> m_jobCount{ 0 };
+		std::atomic<uint32_t> m_remaining{ 0 };
+		//the task continued with, nullptr for ParallelFor
+		TaskGraph* m_graph = nullptr;
+		uint32_t m_task = 0;
+	};
+
+	//lock-free deque after Chase and Lev, with the memory orders of Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models",
+	//only the owning thread pushes and pops at the bottom, every other thread steals from the top
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(uint32_t capacity = 256);
+		WorkStealingDeque(WorkStealingDeque const&) = delete;
+		void operator=(WorkStealingDeque const&) = delete;
+
+		void Push(Job* job);
+		Job* Pop();
+		//nullptr if empty or another thread took the job first
+		Job* Steal();
+		bool IsEmpty() const;
+
+	protected:
+		struct Buffer
+		{
+			explicit Buffer(int64_t capacity);
+			int64_t m_mask;
+			std::unique_ptr<std::atomic<Job*>[]> m_jobs;
+		};
+
+		std::atomic<int64_t> m_top{ 0 };
+		std::atomic<int64_t> m_bottom{ 0 };
+		std::atomic<Buffer*> m_buffer;
+		//grown buffers are kept until the deque is destroyed, a thief may still read from them
+		std::vector<std::unique_ptr<Buffer>> m_buffers;
+	};
+
+	//tasks with dependencies, built once and run as often as needed, a task starts as soon as its last predecessor finished,
+	//on the thread that finished it unless another one steals it first
+	class TaskGraph
+	{
+	public:
+		//returns the task, for AddDependency
+		uint32_t AddTask(const char* name, std::function<void()> function);
+		//function(i) for every i in [0, count), split between the threads like ParallelFor
+		uint32_t AddParallelTask(const char* name, uint32_t count, std::function<void(uint32_t)> function);
+		//changes the index count of a parallel task for the next run, or for the current one from a predecessor of the task
+		void SetIndexCount(uint32_t task, uint32_t count);
+		void AddDependency(uint32_t before, uint32_t after);
+		void Clear();
+		bool IsEmpty() const;
+
+	protected:
+		friend class ThreadPool;
+
+		struct Task
+		{
+			std::function<void(uint32_t)> m_function;
+			uint32_t m_indexCount;
+			std::vector<uint32_t> m_successors;
+			uint32_t m_predecessorCount = 0;
+			std::atomic<uint32_t> m_pendingPredecessors{ 0 };
+			JobBatch m_batch;
+		};
+
+		std::vector<std::unique_ptr<Task>> m_tasks;
+		std::atomic<uint32_t> m_remainingTasks{ 0 };
+	};
+
+	//a task index run while instrumentation is enabled, in ms since it was enabled
+	struct TaskRecord
+	{
+		const char* m_name;
+		uint32_t m_index;
+		uint32_t m_thread;
+		float m_startMs;
+		float m_endMs;
+	};
+
+	//every thread owns a lock-free deque it pushes to and takes its newest job from, idle threads steal the oldest job of another deque,
+	//ParallelFor, Submit and Wait may be called from inside tasks or from one thread outside of the pool at a time, which works along while waiting
+	class ThreadPool
+	{
+	public:
+		//threadCount includes the calling thread, 0 uses every hardware thread
+		explicit ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+		ThreadPool(ThreadPool const&) = delete;
+		void operator=(ThreadPool const&) = delete;
+
+		//runs function(i) for every i in [0, count) and returns once all of them are done
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function, const char* name = "parallel for");
+		//starts the tasks without predecessors, the graph may not be changed or submitted again before Wait returned
+		void Submit(TaskGraph& graph);
+		//runs jobs until every task of the graph is done
+		void Wait(TaskGraph& graph);
+		void Run(TaskGraph& graph);
+		uint32_t GetThreadCount() const;
+
+		//records every task index run from now on, which costs two clock reads per index
+		void SetInstrumentation(bool enabled);
+		//records of every thread since the last call, only while no jobs are running
+		std::vector<TaskRecord> TakeRecords();
+
+	protected:
+		void WorkerLoop(uint32_t thread);
+		//the thread index of the caller, the last one for threads outside of the pool
+		uint32_t GetCurrentThread() const;
+		void PushJob(uint32_t thread, Job* job);
+		bool HasQueuedJobs() const;
+		//takes a job from the thread's own deque or steals one and runs it, false if there was none
+		bool RunJob(uint32_t thread);
+		void StartBatch(uint32_t thread, JobBatch& batch, uint32_t count);
+		void ExecuteJob(uint32_t thread, Job& job);
+		void StartTask(uint32_t thread, TaskGraph& graph, uint32_t task);
+		//starts the successors whose last predecessor it was
+		void CompleteTask(uint32_t thread, TaskGraph& graph, uint32_t task);
+
+		std::vector<std::thread> m_workers;
+		//one deque per worker and a last one for the calling thread
+		std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+		//pushing threads only take the sleep mutex to wake workers if there are sleeping ones
+		std::atomic<uint32_t> m_sleepingWorkers{ 0 };
+		bool m_stop = false;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wakeCondition;
+
+		std::atomic<bool> m_instrumentation{ false };
+		std::chrono::high_resolution_clock::time_point m_instrumentationStart;
+		//one list per thread, each only written by its thread
+		std::vector<std::vector<TaskRecord>> m_records;
+	};
+}
@@ -83,6 +83,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateRenderPass )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateShaderModule )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateFramebuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateGraphicsPipelines )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateComputePipelines )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkBeginCommandBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateSemaphore )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdBeginRenderPass )
@@ -92,6 +93,8 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdBindVertexBuffers )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdBindIndexBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdDraw )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdDrawIndexed )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdDispatch )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdFillBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdEndRenderPass )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkEndCommandBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdNextSubpass )
@@ -109,6 +112,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyDevice )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkResetFences )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdCopyBufferToImage )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdCopyImageToBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkGetBufferMemoryRequirements )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateSampler )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdPipelineBarrier )
@@ -124,6 +128,17 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroySemaphore )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyFence )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkFlushMappedMemoryRanges )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkFreeMemory )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdClearAttachments )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetQueryPoolResults )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdResetQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdWriteTimestamp )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkResetCommandPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdExecuteCommands )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreatePipelineCache )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetPipelineCacheData )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyPipelineCache )
 
 #undef DEVICE_LEVEL_VULKAN_FUNCTION
 
@@ -138,14 +153,22 @@ DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkAcquireNextImageKHR, VK_KHR_SWAPC
 DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkQueuePresentKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
 DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
 
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateAccelerationStructureNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroyAccelerationStructureNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkBindAccelerationStructureMemoryNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetAccelerationStructureHandleNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetAccelerationStructureMemoryRequirementsNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdBuildAccelerationStructureNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateRayTracingPipelinesNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetRayTracingShaderGroupHandlesNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
-DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdTraceRaysNV, VK_NV_RAY_TRACING_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetBufferDeviceAddress, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME )
+
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateAccelerationStructureKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroyAccelerationStructureKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetAccelerationStructureBuildSizesKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetAccelerationStructureDeviceAddressKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdBuildAccelerationStructuresKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdCopyAccelerationStructureKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdWriteAccelerationStructuresPropertiesKHR, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateRayTracingPipelinesKHR, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetRayTracingShaderGroupHandlesKHR, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCmdTraceRaysKHR, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateDeferredOperationKHR, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroyDeferredOperationKHR, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetDeferredOperationMaxConcurrencyKHR, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetDeferredOperationResultKHR, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME )
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDeferredOperationJoinKHR, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME )
 
 #undef DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
\ No newline at end of file
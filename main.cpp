@@ -9,6 +9,40 @@ int main(int argc, char* argv[]) {
 
 	MelonRenderer::Logger::Get().SetModeImmediate(true);
 
+	//--benchmark <name> runs a benchmark in a hidden window instead of the interactive loop
+	if (argc > 2 && std::string(argv[1]) == "--benchmark")
+	{
+		instance.Init(false);
+		bool success = instance.RunBenchmark(argv[2]);
+		instance.Fini();
+
+		return success ? 0 : 1;
+	}
+
+	//--cpu-render <file> [spp] writes a cpu raytraced image, also without raytracing support
+	if (argc > 2 && std::string(argv[1]) == "--cpu-render")
+	{
+		instance.Init(false);
+		bool success = instance.RenderCpu(argv[2], argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 64);
+		instance.Fini();
+
+		return success ? 0 : 1;
+	}
+
+	//--export-scene <file> [references] writes the default scene as a binary scene file, with references to the objs instead of embedded geometry
+	if (argc > 2 && std::string(argv[1]) == "--export-scene")
+	{
+		instance.Init(false);
+		bool success = instance.ExportScene(argv[2], !(argc > 3 && std::string(argv[3]) == "references"));
+		instance.Fini();
+
+		return success ? 0 : 1;
+	}
+
+	//--scene <file> loads a binary scene file instead of the default scene
+	if (argc > 2 && std::string(argv[1]) == "--scene")
+		instance.SetSceneFile(argv[2]);
+
 	instance.Init();
 	instance.Loop();
 	instance.Fini();
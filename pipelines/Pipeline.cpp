@@ -20,4 +20,32 @@ namespace MelonRenderer
 
 		return true;
 	}
+
+	bool Pipeline::Compile()
+	{
+		DestroyPipelines();
+		return CreateShaderModules() && CreateGraphicsPipeline();
+	}
+
+	void Pipeline::DestroyPipelines()
+	{
+		for (VkPipelineShaderStageCreateInfo& shaderStage : m_shaderStagesV)
+		{
+			vkDestroyShaderModule(Device::Get().m_device, shaderStage.module, nullptr);
+		}
+		m_shaderStagesV.clear();
+
+		vkDestroyPipeline(Device::Get().m_device, m_pipeline, nullptr);
+		m_pipeline = VK_NULL_HANDLE;
+	}
+
+	void Pipeline::SetPipelineCache(PipelineCache* pipelineCache)
+	{
+		m_pipelineCache = pipelineCache;
+	}
+
+	void Pipeline::SetFrameIndex(uint32_t frameIndex)
+	{
+		m_frameIndex = frameIndex;
+	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "../Shader.h"
 #include "../DeviceMemoryManager.h"
 #include "../Renderpass.h"
+#include "PipelineCache.h"
 
 #include <vector>
 
@@ -17,6 +18,13 @@ namespace MelonRenderer
 		virtual void Tick(VkCommandBuffer& commanduffer) = 0;
 
 		virtual void FillRenderpassInfo(Renderpass* renderpass) = 0;
+		//Init creates everything but the pipelines, the owner compiles them afterwards so several pipelines compile at once,
+		//only creates Vulkan objects and may run on any thread, replaces the pipelines of an earlier call
+		virtual bool Compile();
+		//pipelines are created through it, set before Init
+		void SetPipelineCache(PipelineCache* pipelineCache);
+		//slot of the frame the next Tick records, see Swapchain::GetFrameIndex
+		void SetFrameIndex(uint32_t frameIndex);
 
 	protected:
 		virtual void DefineVertices() = 0;
@@ -47,8 +55,10 @@ namespace MelonRenderer
 		//---------------------------------------
 
 		//---------------------------------------
-		VkPipeline m_pipeline;
+		VkPipeline m_pipeline = VK_NULL_HANDLE;
 		virtual bool CreateGraphicsPipeline() = 0;
+		//the pipelines and shader modules of the last Compile
+		virtual void DestroyPipelines();
 		//---------------------------------------
 
 		virtual bool Draw(VkCommandBuffer& commandBuffer) = 0;
@@ -68,5 +78,7 @@ namespace MelonRenderer
 		//---------------------------------------
 
 		DeviceMemoryManager* m_memoryManager;
+		PipelineCache* m_pipelineCache = nullptr;
+		uint32_t m_frameIndex = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "PipelineCache.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		uint64_t Checksum(const uint8_t* data, size_t size)
+		{
+			uint64_t hash = 0xCBF29CE484222325ull;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash = (hash ^ data[i]) * 0x100000001B3ull;
+			}
+			return hash;
+		}
+
+		//header of the data itself, VkPipelineCacheHeaderVersionOne, read by field since it is not padded
+		constexpr size_t vulkanCacheHeaderSize = 16 + VK_UUID_SIZE;
+	}
+
+	bool PipelineCache::Init(const VkPhysicalDeviceProperties& properties, const std::string& path, ThreadPool& threadPool)
+	{
+		m_properties = properties;
+		m_path = path;
+		m_warm = false;
+		m_threadPool = &threadPool;
+
+		std::vector<uint8_t> data;
+		m_warm = ReadFile(data);
+		if (!m_warm)
+			data.clear();
+
+		VkPipelineCacheCreateInfo pipelineCacheInfo = {};
+		pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheInfo.pNext = nullptr;
+		pipelineCacheInfo.flags = 0;
+		pipelineCacheInfo.initialDataSize = data.size();
+		pipelineCacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		VkResult result = vkCreatePipelineCache(Device::Get().m_device, &pipelineCacheInfo, nullptr, &m_pipelineCache);
+		if (result != VK_SUCCESS && m_warm)
+		{
+			//the driver may still reject data that passed the checks, an empty cache only costs the compilation
+			Logger::Log("Could not create pipeline cache from " + m_path + ", starting with an empty one.");
+			m_warm = false;
+			pipelineCacheInfo.initialDataSize = 0;
+			pipelineCacheInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache(Device::Get().m_device, &pipelineCacheInfo, nullptr, &m_pipelineCache);
+		}
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create pipeline cache.");
+			m_pipelineCache = VK_NULL_HANDLE;
+			return false;
+		}
+		m_savedSize = data.size();
+
+		return true;
+	}
+
+	bool PipelineCache::Save()
+	{
+		if (m_pipelineCache == VK_NULL_HANDLE)
+			return false;
+
+		size_t dataSize = 0;
+		VkResult result = vkGetPipelineCacheData(Device::Get().m_device, m_pipelineCache, &dataSize, nullptr);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not get pipeline cache size.");
+			return false;
+		}
+		if (dataSize == m_savedSize)
+			return true;
+
+		std::vector<uint8_t> file(sizeof(PipelineCacheFileHeader) + dataSize);
+		result = vkGetPipelineCacheData(Device::Get().m_device, m_pipelineCache, &dataSize, file.data() + sizeof(PipelineCacheFileHeader));
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not get pipeline cache data.");
+			return false;
+		}
+		file.resize(sizeof(PipelineCacheFileHeader) + dataSize);
+
+		PipelineCacheFileHeader header = {};
+		header.m_magic = pipelineCacheFileMagic;
+		header.m_version = pipelineCacheFileVersion;
+		header.m_vendorID = m_properties.vendorID;
+		header.m_deviceID = m_properties.deviceID;
+		header.m_driverVersion = m_properties.driverVersion;
+		memcpy(header.m_pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.m_dataSize = dataSize;
+		header.m_checksum = Checksum(file.data() + sizeof(PipelineCacheFileHeader), dataSize);
+		memcpy(file.data(), &header, sizeof(PipelineCacheFileHeader));
+
+		//written next to the file and renamed, so an interrupted write leaves the previous cache
+		const std::string temporaryPath = m_path + ".tmp";
+		{
+			std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!stream.write(reinterpret_cast<const char*>(file.data()), file.size()))
+			{
+				Logger::Log("Could not write pipeline cache file " + temporaryPath + ".");
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, m_path, error);
+		if (error)
+		{
+			Logger::Log("Could not replace pipeline cache file " + m_path + ".");
+			return false;
+		}
+		m_savedSize = dataSize;
+
+		Logger::Log("Saved " + std::to_string(dataSize) + " bytes of pipeline cache to " + m_path + ".");
+		return true;
+	}
+
+	bool PipelineCache::Clear()
+	{
+		if (m_pipelineCache != VK_NULL_HANDLE)
+			vkDestroyPipelineCache(Device::Get().m_device, m_pipelineCache, nullptr);
+		m_pipelineCache = VK_NULL_HANDLE;
+		m_warm = false;
+
+		VkPipelineCacheCreateInfo pipelineCacheInfo = {};
+		pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheInfo.pNext = nullptr;
+		pipelineCacheInfo.flags = 0;
+		pipelineCacheInfo.initialDataSize = 0;
+		pipelineCacheInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(Device::Get().m_device, &pipelineCacheInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+		{
+			Logger::Log("Could not create pipeline cache.");
+			m_pipelineCache = VK_NULL_HANDLE;
+			return false;
+		}
+
+		return true;
+	}
+
+	void PipelineCache::Fini()
+	{
+		m_threadPool = nullptr;
+		if (m_pipelineCache != VK_NULL_HANDLE)
+			vkDestroyPipelineCache(Device::Get().m_device, m_pipelineCache, nullptr);
+		m_pipelineCache = VK_NULL_HANDLE;
+	}
+
+	VkPipelineCache PipelineCache::GetVkPipelineCache() const
+	{
+		return m_pipelineCache;
+	}
+
+	bool PipelineCache::IsWarm() const
+	{
+		return m_warm;
+	}
+
+	bool PipelineCache::CreatePipelines(const std::vector<std::function<VkResult(VkPipelineCache)>>& creations)
+	{
+		std::atomic<uint32_t> failedCreations{ 0 };
+		m_threadPool->ParallelFor(static_cast<uint32_t>(creations.size()), [&](uint32_t i)
+			{
+				if (creations[i](m_pipelineCache) != VK_SUCCESS)
+					failedCreations++;
+			}, "create pipeline");
+
+		return failedCreations == 0;
+	}
+
+	VkResult PipelineCache::CreateRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& pipelineInfo, VkPipeline& pipeline)
+	{
+		VkDeferredOperationKHR deferredOperation = VK_NULL_HANDLE;
+		if (vkCreateDeferredOperationKHR == nullptr || vkCreateDeferredOperationKHR(Device::Get().m_device, nullptr, &deferredOperation) != VK_SUCCESS)
+			return vkCreateRayTracingPipelinesKHR(Device::Get().m_device, VK_NULL_HANDLE, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+		VkResult result = vkCreateRayTracingPipelinesKHR(Device::Get().m_device, deferredOperation, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+		if (result == VK_OPERATION_DEFERRED_KHR)
+		{
+			//the driver splits the compilation into as many parts as it reports, threads beyond that would return VK_THREAD_DONE_KHR at once
+			uint32_t concurrency = vkGetDeferredOperationMaxConcurrencyKHR(Device::Get().m_device, deferredOperation);
+			uint32_t threadCount = m_threadPool->GetThreadCount();
+			concurrency = concurrency < threadCount ? concurrency : threadCount;
+			concurrency = concurrency ? concurrency : 1;
+			m_threadPool->ParallelFor(concurrency, [&](uint32_t)
+				{
+					//idle means the remaining work is running on other threads but may hand out more
+					while (vkDeferredOperationJoinKHR(Device::Get().m_device, deferredOperation) == VK_THREAD_IDLE_KHR)
+					{
+						std::this_thread::yield();
+					}
+				}, "join pipeline compilation");
+			result = vkGetDeferredOperationResultKHR(Device::Get().m_device, deferredOperation);
+		}
+		else if (result == VK_OPERATION_NOT_DEFERRED_KHR)
+		{
+			result = VK_SUCCESS;
+		}
+
+		vkDestroyDeferredOperationKHR(Device::Get().m_device, deferredOperation, nullptr);
+		return result;
+	}
+
+	bool PipelineCache::ReadFile(std::vector<uint8_t>& data) const
+	{
+		std::ifstream stream(m_path, std::ios::ate | std::ios::binary);
+		if (!stream.is_open())
+		{
+			Logger::Log("No pipeline cache file " + m_path + ", pipelines are compiled from scratch.");
+			return false;
+		}
+
+		const size_t fileSize = static_cast<size_t>(stream.tellg());
+		PipelineCacheFileHeader header;
+		stream.seekg(0);
+		if (fileSize < sizeof(PipelineCacheFileHeader) || !stream.read(reinterpret_cast<char*>(&header), sizeof(PipelineCacheFileHeader)) ||
+			header.m_magic != pipelineCacheFileMagic || header.m_version != pipelineCacheFileVersion ||
+			header.m_dataSize != fileSize - sizeof(PipelineCacheFileHeader))
+		{
+			Logger::Log("Pipeline cache file " + m_path + " is not valid, pipelines are compiled from scratch.");
+			return false;
+		}
+
+		data.resize(header.m_dataSize);
+		if (!stream.read(reinterpret_cast<char*>(data.data()), data.size()) || Checksum(data.data(), data.size()) != header.m_checksum)
+		{
+			Logger::Log("Pipeline cache file " + m_path + " is corrupted, pipelines are compiled from scratch.");
+			return false;
+		}
+
+		if (!IsCompatible(header, data))
+		{
+			Logger::Log("Pipeline cache file " + m_path + " was written by another device or driver, pipelines are compiled from scratch.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineCache::IsCompatible(const PipelineCacheFileHeader& header, const std::vector<uint8_t>& data) const
+	{
+		if (header.m_vendorID != m_properties.vendorID || header.m_deviceID != m_properties.deviceID || header.m_driverVersion != m_properties.driverVersion ||
+			memcmp(header.m_pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE))
+			return false;
+
+		//the driver's own header has to agree as well
+		if (data.size() < vulkanCacheHeaderSize)
+			return false;
+		uint32_t vulkanHeader[4];
+		memcpy(vulkanHeader, data.data(), sizeof(vulkanHeader));
+		return vulkanHeader[0] >= vulkanCacheHeaderSize && vulkanHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			vulkanHeader[2] == m_properties.vendorID && vulkanHeader[3] == m_properties.deviceID &&
+			!memcmp(data.data() + sizeof(vulkanHeader), m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../Basics.h"
+#include "../cpu_raytracing/ThreadPool.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MelonRenderer
+{
+	constexpr uint32_t pipelineCacheFileMagic = 0x434C504D; //"MPLC"
+	constexpr uint32_t pipelineCacheFileVersion = 1;
+
+	//precedes the data of vkGetPipelineCacheData in the cache file
+	struct PipelineCacheFileHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		//the data is only handed to the same device and driver it came from
+		uint32_t m_vendorID;
+		uint32_t m_deviceID;
+		uint32_t m_driverVersion;
+		uint8_t m_pipelineCacheUUID[VK_UUID_SIZE];
+		uint32_t m_padding;
+		uint64_t m_dataSize;
+		//FNV-1a of the data, drivers are not required to survive a truncated or corrupted cache
+		uint64_t m_checksum;
+	};
+
+	//one VkPipelineCache shared by every pipeline, loaded from a file written by a previous run on the same device and driver,
+	//pipelines are compiled on the threads of its pool, the cache is internally synchronized
+	class PipelineCache
+	{
+	public:
+		//starts empty if the file is missing or does not match, which is not an error, the pool is owned by the caller
+		bool Init(const VkPhysicalDeviceProperties& properties, const std::string& path, ThreadPool& threadPool);
+		//writes the file if pipelines were added since it was loaded or saved
+		bool Save();
+		//drops every pipeline so the next compilation is cold, the file is kept
+		bool Clear();
+		void Fini();
+
+		VkPipelineCache GetVkPipelineCache() const;
+		//whether pipelines are created from a loaded file
+		bool IsWarm() const;
+
+		//runs every creation on the pool, each is handed the cache, false if any failed
+		bool CreatePipelines(const std::vector<std::function<VkResult(VkPipelineCache)>>& creations);
+		//as a deferred operation joined by every thread of the pool, directly without deferred host operations
+		VkResult CreateRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& pipelineInfo, VkPipeline& pipeline);
+
+	protected:
+		bool ReadFile(std::vector<uint8_t>& data) const;
+		bool IsCompatible(const PipelineCacheFileHeader& header, const std::vector<uint8_t>& data) const;
+
+		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties m_properties;
+		std::string m_path;
+		bool m_warm = false;
+		size_t m_savedSize = 0;
+		ThreadPool* m_threadPool = nullptr;
+	};
+}
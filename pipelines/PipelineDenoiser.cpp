@@ -0,0 +1,491 @@
+#include "PipelineDenoiser.h"
+
+namespace MelonRenderer
+{
+	void PipelineDenoiser::Init(VkPhysicalDevice& device, DeviceMemoryManager& memoryManager, VkRenderPass& renderPass, VkExtent2D windowExtent)
+	{
+		m_memoryManager = &memoryManager;
+		m_renderpass = &renderPass;
+		m_extent = windowExtent;
+
+		m_pushConstants.stepSize = 1;
+		m_pushConstants.readPing = 0;
+		m_pushConstants.historyValid = 0;
+		m_pushConstants.writeHistory = 0;
+		SetSettings(m_settings);
+
+		DefineVertices();
+
+		CreateImages();
+		CreateTimestampQueryPool();
+
+		CreatePipelineLayout();
+		CreateDescriptorPool();
+		CreateDescriptorSets();
+	}
+
+	void PipelineDenoiser::Tick(VkCommandBuffer& commandBuffer)
+	{
+		Draw(commandBuffer);
+	}
+
+	void PipelineDenoiser::Fini()
+	{
+	}
+
+	void PipelineDenoiser::FillRenderpassInfo(Renderpass* renderpass)
+	{
+	}
+
+	void PipelineDenoiser::RecreateOutput(VkExtent2D& windowExtent, const RaytracingOutputs& inputs)
+	{
+		m_extent = windowExtent;
+		m_inputs = inputs;
+
+		CleanupImages();
+		CreateImages();
+		UpdateDescriptorSets();
+	}
+
+	void PipelineDenoiser::SetInputs(const RaytracingOutputs& inputs)
+	{
+		m_inputs = inputs;
+	}
+
+	void PipelineDenoiser::ResetHistory()
+	{
+		m_historyValid = false;
+	}
+
+	float PipelineDenoiser::GetStageTime(DenoiserStage stage) const
+	{
+		return m_stageTimes[stage];
+	}
+
+	DenoiserStats PipelineDenoiser::GetStats() const
+	{
+		DenoiserStats stats;
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			stats.m_stageTimes[stage] = m_stageTimes[stage];
+		}
+		return stats;
+	}
+
+	const DenoiserSettings& PipelineDenoiser::GetSettings() const
+	{
+		return m_settings;
+	}
+
+	void PipelineDenoiser::SetSettings(const DenoiserSettings& settings)
+	{
+		if (settings.m_resetHistory)
+			ResetHistory();
+
+		m_settings = settings;
+		m_settings.m_resetHistory = false;
+		m_pushConstants.alpha = m_settings.m_alpha;
+		m_pushConstants.momentsAlpha = m_settings.m_momentsAlpha;
+		m_pushConstants.phiColor = m_settings.m_phiColor;
+		m_pushConstants.phiNormal = m_settings.m_phiNormal;
+		m_pushConstants.phiDepth = m_settings.m_phiDepth;
+	}
+
+	bool PipelineDenoiser::DrawSettings(DenoiserSettings& settings, const DenoiserStats& stats)
+	{
+		bool changed = false;
+		ImGui::Begin("Denoiser");
+
+		changed |= ImGui::SliderInt("a-trous iterations", &settings.m_atrousIterations, 1, 5);
+		changed |= ImGui::SliderFloat("temporal alpha", &settings.m_alpha, 0.01f, 1.f);
+		changed |= ImGui::SliderFloat("moments alpha", &settings.m_momentsAlpha, 0.01f, 1.f);
+		changed |= ImGui::SliderFloat("phi color", &settings.m_phiColor, 0.1f, 20.f);
+		changed |= ImGui::SliderFloat("phi normal", &settings.m_phiNormal, 1.f, 256.f);
+		changed |= ImGui::SliderFloat("phi depth", &settings.m_phiDepth, 0.001f, 1.f);
+		if (ImGui::Button("reset history"))
+		{
+			settings.m_resetHistory = true;
+			changed = true;
+		}
+		float totalTime = 0.f;
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			ImGui::Text("%s: %.3f ms", stageNames[stage], stats.m_stageTimes[stage]);
+			totalTime += stats.m_stageTimes[stage];
+		}
+		ImGui::Text("total: %.3f ms", totalTime);
+
+		ImGui::End();
+		return changed;
+	}
+
+	bool PipelineDenoiser::CreateImages()
+	{
+		VkCommandBuffer layoutTransitionCommandBuffer;
+		if (!m_memoryManager->CreateSingleUseCommand(layoutTransitionCommandBuffer))
+		{
+			Logger::Log("Could not create single use command buffer for transition of image layout.");
+			return false;
+		}
+
+		for (int i = 0; i < IMAGE_COUNT; i++)
+		{
+			if (!m_memoryManager->CreateImage(m_images[i], m_imageMemories[i], m_extent, VK_IMAGE_USAGE_STORAGE_BIT, VK_FORMAT_R32G32B32A32_SFLOAT)
+				|| !m_memoryManager->CreateImageView(m_imageViews[i], m_images[i], VK_FORMAT_R32G32B32A32_SFLOAT))
+			{
+				Logger::Log("Could not create denoiser image.");
+				return false;
+			}
+
+			if (!m_memoryManager->TransitionImageLayout(layoutTransitionCommandBuffer, m_images[i], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL))
+			{
+				Logger::Log("Could not transition denoiser image layout.");
+				return false;
+			}
+		}
+
+		if (!m_memoryManager->EndSingleUseCommand(layoutTransitionCommandBuffer))
+		{
+			Logger::Log("Could not end command buffer for image layout transition.");
+			return false;
+		}
+
+		//contents of the new history images are undefined
+		m_historyValid = false;
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CleanupImages()
+	{
+		for (int i = 0; i < IMAGE_COUNT; i++)
+		{
+			vkDestroyImage(Device::Get().m_device, m_images[i], nullptr);
+			vkDestroyImageView(Device::Get().m_device, m_imageViews[i], nullptr);
+			vkFreeMemory(Device::Get().m_device, m_imageMemories[i], nullptr);
+		}
+
+		return true;
+	}
+
+	bool PipelineDenoiser::UpdateDescriptorSets()
+	{
+		//same order as the bindings in svgfCommon.glsl
+		std::vector<VkImageView> imageViews = { m_inputs.m_color, m_inputs.m_features, m_inputs.m_albedo, m_inputs.m_motion,
+			m_imageViews[IMAGE_PREVIOUS_FEATURES], m_imageViews[IMAGE_HISTORY], m_imageViews[IMAGE_PREVIOUS_MOMENTS], m_imageViews[IMAGE_MOMENTS],
+			m_imageViews[IMAGE_PING], m_imageViews[IMAGE_PONG], m_inputs.m_output };
+
+		std::vector<VkDescriptorImageInfo> imageDescriptors(imageViews.size());
+		for (int i = 0; i < imageDescriptors.size(); i++)
+		{
+			imageDescriptors[i].imageView = imageViews[i];
+			imageDescriptors[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageDescriptors[i].sampler = VK_NULL_HANDLE;
+		}
+
+		std::vector<VkWriteDescriptorSet> writes(imageDescriptors.size());
+		for (int i = 0; i < writes.size(); i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].pNext = nullptr;
+			writes[i].dstSet = m_descriptorSets[0];
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[i].pBufferInfo = nullptr;
+			writes[i].pImageInfo = &imageDescriptors[i];
+			writes[i].dstArrayElement = 0;
+			writes[i].dstBinding = i;
+		}
+
+		vkUpdateDescriptorSets(Device::Get().m_device, writes.size(), writes.data(), 0, nullptr);
+
+		return true;
+	}
+
+	bool PipelineDenoiser::Dispatch(VkCommandBuffer& commandBuffer, DenoiserStage stage)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_stagePipelines[stage]);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DenoiserPushConstant), &m_pushConstants);
+		//8x8 workgroups, see svgfCommon.glsl
+		vkCmdDispatch(commandBuffer, (m_extent.width + 7) / 8, (m_extent.height + 7) / 8, 1);
+
+		//every pass reads what the one before wrote
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CreateTimestampQueryPool()
+	{
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = m_timestampFrameSlots * m_timestampsPerFrame;
+
+		VkResult result = vkCreateQueryPool(Device::Get().m_device, &queryPoolCreateInfo, nullptr, &m_timestampQueryPool);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create timestamp query pool for the denoiser.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineDenoiser::ReadStageTimes(uint32_t frameSlot)
+	{
+		if (!m_timestampWritten[frameSlot])
+			return true;
+
+		uint64_t timestamps[m_timestampsPerFrame];
+		VkResult result = vkGetQueryPoolResults(Device::Get().m_device, m_timestampQueryPool, frameSlot * m_timestampsPerFrame, m_timestampsPerFrame,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not get denoiser timestamps.");
+			return false;
+		}
+		m_timestampWritten[frameSlot] = false;
+
+		//timestamp period is given in nanoseconds
+		float timestampPeriod = m_memoryManager->GetPhysicalDeviceProperties().limits.timestampPeriod / 1000000.f;
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			float stageTime = (timestamps[stage + 1] - timestamps[stage]) * timestampPeriod;
+			m_stageTimes[stage] = m_stageTimes[stage] > 0.f ? m_stageTimes[stage] * 0.95f + stageTime * 0.05f : stageTime;
+		}
+
+		return true;
+	}
+
+	void PipelineDenoiser::DefineVertices()
+	{
+	}
+
+	bool PipelineDenoiser::CreateShaderModules()
+	{
+		const char* shaderFiles[STAGE_COUNT] = { "shaders/svgfReproject.spv", "shaders/svgfVariance.spv", "shaders/svgfAtrous.spv", "shaders/svgfModulate.spv" };
+
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			auto shaderCode = readFile(shaderFiles[stage]);
+
+			VkPipelineShaderStageCreateInfo computeShader;
+			if (!CreateShaderModule(shaderCode, computeShader.module))
+			{
+				return false;
+			}
+			computeShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computeShader.pNext = nullptr;
+			computeShader.flags = 0;
+			computeShader.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computeShader.pName = "main";
+			computeShader.pSpecializationInfo = nullptr;
+
+			m_shaderStagesV.emplace_back(computeShader);
+		}
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CreateGraphicsPipeline()
+	{
+		//one compute pipeline per stage, all share the layout
+		std::vector<VkComputePipelineCreateInfo> computePipelineInfos(STAGE_COUNT);
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			computePipelineInfos[stage].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			computePipelineInfos[stage].pNext = nullptr;
+			computePipelineInfos[stage].flags = 0;
+			computePipelineInfos[stage].stage = m_shaderStagesV[stage];
+			computePipelineInfos[stage].layout = m_pipelineLayout;
+			computePipelineInfos[stage].basePipelineHandle = VK_NULL_HANDLE;
+			computePipelineInfos[stage].basePipelineIndex = -1;
+		}
+
+		//one compilation per thread
+		std::vector<std::function<VkResult(VkPipelineCache)>> creations;
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			creations.emplace_back([&, stage](VkPipelineCache pipelineCache)
+				{
+					return vkCreateComputePipelines(Device::Get().m_device, pipelineCache, 1, &computePipelineInfos[stage], nullptr, &m_stagePipelines[stage]);
+				});
+		}
+
+		if (!m_pipelineCache->CreatePipelines(creations))
+		{
+			Logger::Log("Could not create denoiser pipelines.");
+			return false;
+		}
+
+		return true;
+	}
+
+	void PipelineDenoiser::DestroyPipelines()
+	{
+		Pipeline::DestroyPipelines();
+		for (int stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			vkDestroyPipeline(Device::Get().m_device, m_stagePipelines[stage], nullptr);
+			m_stagePipelines[stage] = VK_NULL_HANDLE;
+		}
+	}
+
+	bool PipelineDenoiser::Draw(VkCommandBuffer& commandBuffer)
+	{
+		uint32_t frameSlot = m_timestampFrameSlot;
+		m_timestampFrameSlot = (m_timestampFrameSlot + 1) % m_timestampFrameSlots;
+		ReadStageTimes(frameSlot);
+		uint32_t firstQuery = frameSlot * m_timestampsPerFrame;
+		vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, firstQuery, m_timestampsPerFrame);
+
+		//the raygen shader wrote the inputs, the last frame's passes may still read the history
+		VkMemoryBarrier inputBarrier = {};
+		inputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		inputBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		inputBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &inputBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, m_descriptorSets.size(), m_descriptorSets.data(), 0, nullptr);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, firstQuery + STAGE_REPROJECT);
+		m_pushConstants.historyValid = m_historyValid ? 1 : 0;
+		Dispatch(commandBuffer, STAGE_REPROJECT);
+
+		//reprojection writes ping, the variance estimate pong
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_timestampQueryPool, firstQuery + STAGE_VARIANCE);
+		Dispatch(commandBuffer, STAGE_VARIANCE);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_timestampQueryPool, firstQuery + STAGE_ATROUS);
+		for (int i = 0; i < m_settings.m_atrousIterations; i++)
+		{
+			m_pushConstants.stepSize = 1 << i;
+			m_pushConstants.readPing = i % 2;
+			m_pushConstants.writeHistory = i == 0 ? 1 : 0;
+			Dispatch(commandBuffer, STAGE_ATROUS);
+		}
+
+		//even iterations write ping, so the result is in ping after an odd number of them
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_timestampQueryPool, firstQuery + STAGE_MODULATE);
+		m_pushConstants.readPing = m_settings.m_atrousIterations % 2;
+		m_pushConstants.writeHistory = 0;
+		Dispatch(commandBuffer, STAGE_MODULATE);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_timestampQueryPool, firstQuery + STAGE_COUNT);
+		m_timestampWritten[frameSlot] = true;
+
+		//the output is copied to the swapchain next
+		VkMemoryBarrier outputBarrier = {};
+		outputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		outputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		outputBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &outputBarrier, 0, nullptr, 0, nullptr);
+
+		m_historyValid = true;
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CreatePipelineLayout()
+	{
+		//inputs from the raytracing pipeline, the intermediate images and the output, see svgfCommon.glsl
+		std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+		for (uint32_t binding = 0; binding < IMAGE_COUNT + 5; binding++)
+		{
+			VkDescriptorSetLayoutBinding imageLayoutBinding = {
+				binding,
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				1,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				nullptr
+			};
+			layoutBindings.emplace_back(imageLayoutBinding);
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			nullptr,
+			0,
+			layoutBindings.size(),
+			layoutBindings.data()
+		};
+		m_descriptorSetLayouts.resize(1);
+		VkResult result = vkCreateDescriptorSetLayout(Device::Get().m_device, &descriptorLayoutInfo, nullptr, m_descriptorSetLayouts.data());
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create denoiser descriptor set layout.");
+			return false;
+		}
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DenoiserPushConstant);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+			VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			nullptr,
+			0,
+			m_descriptorSetLayouts.size(),
+			m_descriptorSetLayouts.data(),
+			1,
+			&pushConstantRange
+		};
+		result = vkCreatePipelineLayout(Device::Get().m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create denoiser pipeline layout.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CreateDescriptorPool()
+	{
+		VkDescriptorPoolSize imagePoolSize = {};
+		imagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		imagePoolSize.descriptorCount = IMAGE_COUNT + 5;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			nullptr,
+			0,
+			1,
+			1,
+			&imagePoolSize
+		};
+		VkResult result = vkCreateDescriptorPool(Device::Get().m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create denoiser descriptor pool.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineDenoiser::CreateDescriptorSets()
+	{
+		VkDescriptorSetAllocateInfo allocInfo;
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+		allocInfo.descriptorPool = m_descriptorPool;
+		allocInfo.descriptorSetCount = m_descriptorSetLayouts.size();
+		allocInfo.pSetLayouts = m_descriptorSetLayouts.data();
+		m_descriptorSets.resize(m_descriptorSetLayouts.size());
+		VkResult result = vkAllocateDescriptorSets(Device::Get().m_device, &allocInfo, m_descriptorSets.data());
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not allocate denoiser descriptor set.");
+			return false;
+		}
+
+		return UpdateDescriptorSets();
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Pipeline.h"
+#include "PipelineRaytracing.h"
+#include "../imgui/imgui.h"
+
+namespace MelonRenderer
+{
+	struct DenoiserPushConstant
+	{
+		int   stepSize;
+		int   readPing; //the pass reads ping and writes pong, or the other way around
+		int   historyValid;
+		int   writeHistory;
+		float alpha; //minimum weight of the new frame in the temporal blend
+		float momentsAlpha;
+		float phiColor;
+		float phiNormal;
+		float phiDepth;
+	};
+
+	//everything the "Denoiser" window changes, the simulation edits a copy that is applied before the frame is prepared
+	struct DenoiserSettings
+	{
+		int m_atrousIterations = 5;
+		float m_alpha = 0.2f;
+		float m_momentsAlpha = 0.2f;
+		float m_phiColor = 4.f;
+		float m_phiNormal = 128.f;
+		float m_phiDepth = 0.1f;
+		//drops the history when applied, not kept by the pipeline
+		bool m_resetHistory = false;
+	};
+
+	struct DenoiserStats;
+
+	//SVGF style spatiotemporal filter of the raytracing output, runs as compute passes after the rays are traced
+	class PipelineDenoiser : public Pipeline
+	{
+	public:
+		enum DenoiserStage
+		{
+			STAGE_REPROJECT,
+			STAGE_VARIANCE,
+			STAGE_ATROUS,
+			STAGE_MODULATE,
+			STAGE_COUNT
+		};
+		static constexpr const char* stageNames[STAGE_COUNT] = { "reproject", "variance", "a-trous", "modulate" };
+
+		void Init(VkPhysicalDevice& device, DeviceMemoryManager& memoryManager, VkRenderPass& renderPass, VkExtent2D windowExtent) override;
+		void Tick(VkCommandBuffer& commandBuffer) override;
+		void Fini();
+
+		void FillRenderpassInfo(Renderpass* renderpass) override;
+		void RecreateOutput(VkExtent2D& windowExtent, const RaytracingOutputs& inputs);
+		void SetInputs(const RaytracingOutputs& inputs);
+
+		//drops the temporal history, the next frame is only filtered spatially
+		void ResetHistory();
+		//gpu time of a stage in ms, averaged over the last frames
+		float GetStageTime(DenoiserStage stage) const;
+		DenoiserStats GetStats() const;
+		const DenoiserSettings& GetSettings() const;
+		void SetSettings(const DenoiserSettings& settings);
+		//the "Denoiser" window, only touches its arguments so the simulation can draw it on any thread, true if a setting changed
+		static bool DrawSettings(DenoiserSettings& settings, const DenoiserStats& stats);
+
+	protected:
+		RaytracingOutputs m_inputs;
+
+		//intermediate images, all rgba32f and in the general layout
+		enum DenoiserImage
+		{
+			IMAGE_PREVIOUS_FEATURES,
+			IMAGE_HISTORY,
+			IMAGE_PREVIOUS_MOMENTS,
+			IMAGE_MOMENTS,
+			IMAGE_PING,
+			IMAGE_PONG,
+			IMAGE_COUNT
+		};
+		bool CreateImages();
+		bool CleanupImages();
+		bool UpdateDescriptorSets();
+		VkImage m_images[IMAGE_COUNT];
+		VkImageView m_imageViews[IMAGE_COUNT];
+		VkDeviceMemory m_imageMemories[IMAGE_COUNT];
+
+		bool Dispatch(VkCommandBuffer& commandBuffer, DenoiserStage stage);
+		VkPipeline m_stagePipelines[STAGE_COUNT] = {};
+		DenoiserPushConstant m_pushConstants;
+		bool m_historyValid = false;
+		DenoiserSettings m_settings;
+
+		//gpu timestamps before every stage and after the last one, per frame slot
+		bool CreateTimestampQueryPool();
+		bool ReadStageTimes(uint32_t frameSlot);
+		static constexpr uint32_t m_timestampFrameSlots = 4;
+		static constexpr uint32_t m_timestampsPerFrame = STAGE_COUNT + 1;
+		VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+		bool m_timestampWritten[m_timestampFrameSlots] = {};
+		uint32_t m_timestampFrameSlot = 0;
+		float m_stageTimes[STAGE_COUNT] = {};
+
+
+		//overrides
+		//---------------------------------------
+
+		void DefineVertices() override;
+
+		//shader modules
+		//---------------------------------------
+		bool CreateShaderModules() override;
+		//---------------------------------------
+
+		//---------------------------------------
+		bool CreateGraphicsPipeline() override;
+		void DestroyPipelines() override;
+		//---------------------------------------
+
+		bool Draw(VkCommandBuffer& commandBuffer) override;
+
+
+		//---------------------------------------
+		bool CreatePipelineLayout() override;
+		bool CreateDescriptorPool() override;
+		bool CreateDescriptorSets() override;
+		//---------------------------------------
+
+	};
+
+	struct DenoiserStats
+	{
+		float m_stageTimes[PipelineDenoiser::STAGE_COUNT] = {};
+	};
+}
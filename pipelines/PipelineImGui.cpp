@@ -1,5 +1,4 @@
 #include "PipelineImGui.h"
-#include "../imgui/imgui.h"
 
 namespace MelonRenderer
 {
@@ -17,10 +16,6 @@ namespace MelonRenderer
 		CreatePipelineLayout();
 		CreateDescriptorPool();
 		CreateDescriptorSets();
-
-		CreateShaderModules();
-
-		CreateGraphicsPipeline();
 	}
 
 	void PipelineImGui::Tick(VkCommandBuffer& commandBuffer)
@@ -69,6 +64,46 @@ namespace MelonRenderer
 		m_extent = windowExtent;
 	}
 
+	void PipelineImGui::CaptureDrawData(ImGuiFrameData& frameData)
+	{
+		ImDrawData* imguiDrawData = ImGui::GetDrawData();
+		frameData.m_vertices.clear();
+		frameData.m_indices.clear();
+		frameData.m_commands.clear();
+		frameData.m_displayPos = imguiDrawData->DisplayPos;
+		frameData.m_displaySize = imguiDrawData->DisplaySize;
+		frameData.m_framebufferScale = imguiDrawData->FramebufferScale;
+
+		//merged into one list like the buffers they are uploaded to
+		for (int i = 0; i < imguiDrawData->CmdListsCount; i++)
+		{
+			const ImDrawList* imguiCmdList = imguiDrawData->CmdLists[i];
+			const unsigned int vertexOffset = static_cast<unsigned int>(frameData.m_vertices.size());
+			const unsigned int indexOffset = static_cast<unsigned int>(frameData.m_indices.size());
+			for (int cmd_i = 0; cmd_i < imguiCmdList->CmdBuffer.Size; cmd_i++)
+			{
+				ImDrawCmd imguiDrawCommand = imguiCmdList->CmdBuffer[cmd_i];
+				imguiDrawCommand.VtxOffset += vertexOffset;
+				imguiDrawCommand.IdxOffset += indexOffset;
+				frameData.m_commands.emplace_back(imguiDrawCommand);
+			}
+			frameData.m_vertices.insert(frameData.m_vertices.end(), imguiCmdList->VtxBuffer.Data, imguiCmdList->VtxBuffer.Data + imguiCmdList->VtxBuffer.Size);
+			frameData.m_indices.insert(frameData.m_indices.end(), imguiCmdList->IdxBuffer.Data, imguiCmdList->IdxBuffer.Data + imguiCmdList->IdxBuffer.Size);
+		}
+	}
+
+	bool PipelineImGui::SetDrawData(const ImGuiFrameData& frameData)
+	{
+		m_drawCommands.clear();
+		if (!CreateImGuiDrawDataBuffer(frameData))
+			return false;
+
+		m_drawCommands = frameData.m_commands;
+		m_clipOffset = frameData.m_displayPos;
+		m_clipScale = frameData.m_framebufferScale;
+		return true;
+	}
+
 	void PipelineImGui::DefineVertices()
 	{
 		VkVertexInputBindingDescription vertexInputBinding;
@@ -225,7 +260,7 @@ namespace MelonRenderer
 		pipeline.renderPass = *m_renderpass;
 		pipeline.subpass = m_subpassNumber; 
 
-		VkResult result = vkCreateGraphicsPipelines(Device::Get().m_device, VK_NULL_HANDLE, 1, &pipeline, nullptr, &m_pipeline);
+		VkResult result = vkCreateGraphicsPipelines(Device::Get().m_device, m_pipelineCache->GetVkPipelineCache(), 1, &pipeline, nullptr, &m_pipeline);
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not create graphics pipeline.");
@@ -237,58 +272,43 @@ namespace MelonRenderer
 
 	bool PipelineImGui::Draw(VkCommandBuffer& commandBuffer)
 	{
-		if(CreateImGuiDrawDataBuffer())
+		if (m_drawCommands.empty())
+			return true;
+
+		CreateRenderState(commandBuffer);
+
+		// Will project scissor/clipping rectangles into framebuffer space
+		ImVec2 clipOff = m_clipOffset;         // (0,0) unless using multi-viewports
+		ImVec2 clipScale = m_clipScale; // (1,1) unless using retina display which are often (2,2)
+
+		// Render command lists, their offsets were rebased onto the merged buffers by CaptureDrawData
+		for (const ImDrawCmd& imguiDrawCommand : m_drawCommands)
 		{
-			CreateRenderState(commandBuffer);
-
-			ImDrawData* imguiDrawData = ImGui::GetDrawData();
-			// Will project scissor/clipping rectangles into framebuffer space
-			ImVec2 clipOff = imguiDrawData->DisplayPos;         // (0,0) unless using multi-viewports
-			ImVec2 clipScale = imguiDrawData->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
-
-			// Render command lists
-			// (Because we merged all buffers into a single one, we maintain our own offset into them)
-			int vertexOffset = 0;
-			int indexOffset = 0;
-			for (int i = 0; i < imguiDrawData->CmdListsCount; i++)
+			// Project scissor/clipping rectangles into framebuffer space
+			ImVec4 clipRect;
+			clipRect.x = (imguiDrawCommand.ClipRect.x - clipOff.x) * clipScale.x;
+			clipRect.y = (imguiDrawCommand.ClipRect.y - clipOff.y) * clipScale.y;
+			clipRect.z = (imguiDrawCommand.ClipRect.z - clipOff.x) * clipScale.x;
+			clipRect.w = (imguiDrawCommand.ClipRect.w - clipOff.y) * clipScale.y;
+
+			if (clipRect.x < m_extent.width && clipRect.y < m_extent.height && clipRect.z >= 0.0f && clipRect.w >= 0.0f)
 			{
-				const ImDrawList* imguiCmdList = imguiDrawData->CmdLists[i];
-				for (int cmd_i = 0; cmd_i < imguiCmdList->CmdBuffer.Size; cmd_i++)
-				{
-					const ImDrawCmd* imguiDrawCommand = &imguiCmdList->CmdBuffer[cmd_i];
-					
-					// Project scissor/clipping rectangles into framebuffer space
-					ImVec4 clipRect;
-					clipRect.x = (imguiDrawCommand->ClipRect.x - clipOff.x) * clipScale.x;
-					clipRect.y = (imguiDrawCommand->ClipRect.y - clipOff.y) * clipScale.y;
-					clipRect.z = (imguiDrawCommand->ClipRect.z - clipOff.x) * clipScale.x;
-					clipRect.w = (imguiDrawCommand->ClipRect.w - clipOff.y) * clipScale.y;
-
-					if (clipRect.x < m_extent.width && clipRect.y < m_extent.height && clipRect.z >= 0.0f && clipRect.w >= 0.0f)
-					{
-						// Negative offsets are illegal for vkCmdSetScissor
-						if (clipRect.x < 0.0f)
-							clipRect.x = 0.0f;
-						if (clipRect.y < 0.0f)
-							clipRect.y = 0.0f;
-
-						// Apply scissor/clipping rectangle
-						VkRect2D scissor;
-						scissor.offset.x = (int32_t)(clipRect.x);
-						scissor.offset.y = (int32_t)(clipRect.y);
-						scissor.extent.width = (uint32_t)(clipRect.z - clipRect.x);
-						scissor.extent.height = (uint32_t)(clipRect.w - clipRect.y);
-						vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-						// Draw
-						vkCmdDrawIndexed(commandBuffer, imguiDrawCommand->ElemCount, 1, imguiDrawCommand->IdxOffset + indexOffset,
-							imguiDrawCommand->VtxOffset + vertexOffset, 0);
-
-					}
-					
-				}
-				indexOffset += imguiCmdList->IdxBuffer.Size;
-				vertexOffset += imguiCmdList->VtxBuffer.Size;
+				// Negative offsets are illegal for vkCmdSetScissor
+				if (clipRect.x < 0.0f)
+					clipRect.x = 0.0f;
+				if (clipRect.y < 0.0f)
+					clipRect.y = 0.0f;
+
+				// Apply scissor/clipping rectangle
+				VkRect2D scissor;
+				scissor.offset.x = (int32_t)(clipRect.x);
+				scissor.offset.y = (int32_t)(clipRect.y);
+				scissor.extent.width = (uint32_t)(clipRect.z - clipRect.x);
+				scissor.extent.height = (uint32_t)(clipRect.w - clipRect.y);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+				// Draw
+				vkCmdDrawIndexed(commandBuffer, imguiDrawCommand.ElemCount, 1, imguiDrawCommand.IdxOffset, imguiDrawCommand.VtxOffset, 0);
 			}
 		}
 		return true;
@@ -443,10 +463,10 @@ namespace MelonRenderer
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, m_descriptorSets.size(),
 			m_descriptorSets.data(), 0, nullptr);
 
-		VkBuffer vertex_buffers[1] = { m_vertexBuffer };
+		VkBuffer vertex_buffers[1] = { m_vertexBuffers[m_frameIndex] };
 		VkDeviceSize vertex_offset[1] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertex_buffers, vertex_offset);
-		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffers[m_frameIndex], 0, sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
 
 		m_viewport.width = (float)m_extent.width;
 		m_viewport.height = (float)m_extent.height;
@@ -468,77 +488,73 @@ namespace MelonRenderer
 		return true;
 	}
 
-	bool PipelineImGui::CreateImGuiDrawDataBuffer()
+	bool PipelineImGui::CreateImGuiDrawDataBuffer(const ImGuiFrameData& frameData)
 	{
-		ImDrawData* imguiDrawData = ImGui::GetDrawData();
-
 		// Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
-		int fb_width = (int)(imguiDrawData->DisplaySize.x * imguiDrawData->FramebufferScale.x);
-		int fb_height = (int)(imguiDrawData->DisplaySize.y * imguiDrawData->FramebufferScale.y);
-		if (fb_width <= 0 || fb_height <= 0 || imguiDrawData->TotalVtxCount == 0)
+		int fb_width = (int)(frameData.m_displaySize.x * frameData.m_framebufferScale.x);
+		int fb_height = (int)(frameData.m_displaySize.y * frameData.m_framebufferScale.y);
+		if (fb_width <= 0 || fb_height <= 0 || frameData.m_vertices.empty())
 			return false;
 
 		VkResult result;
+		VkBuffer& vertexBuffer = m_vertexBuffers[m_frameIndex];
+		VkBuffer& indexBuffer = m_indexBuffers[m_frameIndex];
+		VkDeviceMemory& vertexBufferMemory = m_vertexBufferMemories[m_frameIndex];
+		VkDeviceMemory& indexBufferMemory = m_indexBufferMemories[m_frameIndex];
 
 		// Create or resize the vertex/index buffers
-		size_t vertexBufferSize = imguiDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		size_t indexBufferSize = imguiDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-		if (m_vertexBuffer == VK_NULL_HANDLE || m_vertexBufferSize < vertexBufferSize)
+		size_t vertexBufferSize = frameData.m_vertices.size() * sizeof(ImDrawVert);
+		size_t indexBufferSize = frameData.m_indices.size() * sizeof(ImDrawIdx);
+		if (vertexBuffer == VK_NULL_HANDLE || m_vertexBufferSizes[m_frameIndex] < vertexBufferSize)
 		{
-			if (m_vertexBuffer != VK_NULL_HANDLE)
-				vkDestroyBuffer(Device::Get().m_device, m_vertexBuffer, nullptr);
-			if (m_vertexBufferMemory != VK_NULL_HANDLE)
-				vkFreeMemory(Device::Get().m_device, m_vertexBufferMemory, nullptr);
+			if (vertexBuffer != VK_NULL_HANDLE)
+				vkDestroyBuffer(Device::Get().m_device, vertexBuffer, nullptr);
+			if (vertexBufferMemory != VK_NULL_HANDLE)
+				vkFreeMemory(Device::Get().m_device, vertexBufferMemory, nullptr);
 
 			VkDeviceSize vertexBufferSizeAligned = ((vertexBufferSize - 1) / 256 + 1) * 256;
 			m_memoryManager->CreateBuffer(vertexBufferSizeAligned, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				m_vertexBuffer, m_vertexBufferMemory);
-			m_vertexBufferSize = vertexBufferSize;
+				vertexBuffer, vertexBufferMemory);
+			m_vertexBufferSizes[m_frameIndex] = vertexBufferSize;
 		}
 
-		if (m_indexBuffer == VK_NULL_HANDLE || m_indexBufferSize < indexBufferSize)
+		if (indexBuffer == VK_NULL_HANDLE || m_indexBufferSizes[m_frameIndex] < indexBufferSize)
 		{
-			if (m_indexBuffer != VK_NULL_HANDLE)
-				vkDestroyBuffer(Device::Get().m_device, m_indexBuffer, nullptr);
-			if (m_indexBufferMemory != VK_NULL_HANDLE)
-				vkFreeMemory(Device::Get().m_device, m_indexBufferMemory, nullptr);
+			if (indexBuffer != VK_NULL_HANDLE)
+				vkDestroyBuffer(Device::Get().m_device, indexBuffer, nullptr);
+			if (indexBufferMemory != VK_NULL_HANDLE)
+				vkFreeMemory(Device::Get().m_device, indexBufferMemory, nullptr);
 
 			VkDeviceSize indexBufferSizeAligned = ((indexBufferSize - 1) / 256 + 1) * 256;
 			m_memoryManager->CreateBuffer(indexBufferSizeAligned, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				m_indexBuffer, m_indexBufferMemory);
-			m_indexBufferSize = indexBufferSize;
+				indexBuffer, indexBufferMemory);
+			m_indexBufferSizes[m_frameIndex] = indexBufferSize;
 		}
 			
 		// Upload vertex/index data into a single contiguous GPU buffer
 		ImDrawVert* vertexData = NULL;
 		ImDrawIdx* indexData = NULL;
-		result = vkMapMemory(Device::Get().m_device, m_vertexBufferMemory, 0, vertexBufferSize, 0, (void**)(&vertexData));
+		result = vkMapMemory(Device::Get().m_device, vertexBufferMemory, 0, vertexBufferSize, 0, (void**)(&vertexData));
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not map memory for imgui vertex buffer.");
 			return false;
 		}
-		result = vkMapMemory(Device::Get().m_device, m_indexBufferMemory, 0, indexBufferSize, 0, (void**)(&indexData));
+		result = vkMapMemory(Device::Get().m_device, indexBufferMemory, 0, indexBufferSize, 0, (void**)(&indexData));
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not map memory for imgui index buffer.");
 			return false;
 		}
 
-		for (int i = 0; i < imguiDrawData->CmdListsCount; i++)
-		{
-			const ImDrawList* imguiCmdList = imguiDrawData->CmdLists[i];
-			memcpy(vertexData, imguiCmdList->VtxBuffer.Data, imguiCmdList->VtxBuffer.Size * sizeof(ImDrawVert));
-			memcpy(indexData, imguiCmdList->IdxBuffer.Data, imguiCmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
-			vertexData += imguiCmdList->VtxBuffer.Size;
-			indexData += imguiCmdList->IdxBuffer.Size;
-		}
+		memcpy(vertexData, frameData.m_vertices.data(), vertexBufferSize);
+		memcpy(indexData, frameData.m_indices.data(), indexBufferSize);
 		VkMappedMemoryRange range[2] = {};
 		range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range[0].memory = m_vertexBufferMemory;
+		range[0].memory = vertexBufferMemory;
 		range[0].size = VK_WHOLE_SIZE;
 		range[1].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range[1].memory = m_indexBufferMemory;
+		range[1].memory = indexBufferMemory;
 		range[1].size = VK_WHOLE_SIZE;
 		result = vkFlushMappedMemoryRanges(Device::Get().m_device, 2, range);
 		if (result != VK_SUCCESS)
@@ -546,8 +562,8 @@ namespace MelonRenderer
 			Logger::Log("Could not map memory for imgui index buffer.");
 			return false;
 		}
-		vkUnmapMemory(Device::Get().m_device, m_vertexBufferMemory);
-		vkUnmapMemory(Device::Get().m_device, m_indexBufferMemory);
+		vkUnmapMemory(Device::Get().m_device, vertexBufferMemory);
+		vkUnmapMemory(Device::Get().m_device, indexBufferMemory);
 
 		return true;
 	}
@@ -1,8 +1,21 @@
 #pragma once
 #include "Pipeline.h"
+#include "../imgui/imgui.h"
 
 namespace MelonRenderer
 {
+	//a copy of ImGui's draw data, so the frame can be drawn while the next one is simulated
+	struct ImGuiFrameData
+	{
+		std::vector<ImDrawVert> m_vertices;
+		std::vector<ImDrawIdx> m_indices;
+		//offsets into the merged vertices and indices
+		std::vector<ImDrawCmd> m_commands;
+		ImVec2 m_displayPos;
+		ImVec2 m_displaySize;
+		ImVec2 m_framebufferScale;
+	};
+
 	class PipelineImGui : public Pipeline
 	{
 	public:
@@ -13,6 +26,11 @@ namespace MelonRenderer
 		void FillRenderpassInfo(Renderpass* renderpass) override;
 		void RecreateOutput(VkExtent2D& windowExtent);
 
+		//copies ImGui::GetDrawData after ImGui::Render, on the thread that built the frame
+		static void CaptureDrawData(ImGuiFrameData& frameData);
+		//uploads into the buffers of the frame slot, which the frame that used them last has finished reading
+		bool SetDrawData(const ImGuiFrameData& frameData);
+
 	protected:
 		//virtual void     = 0; in pipeline base
 		void DefineVertices() override;
@@ -43,14 +61,19 @@ namespace MelonRenderer
 		bool CreateFence();
 
 		bool CreateRenderState(VkCommandBuffer& commandBuffer);
-		bool CreateImGuiDrawDataBuffer();
+		bool CreateImGuiDrawDataBuffer(const ImGuiFrameData& frameData);
 		bool CreateFontTexture();
-		VkBuffer m_vertexBuffer;
-		VkBuffer m_indexBuffer;
-		VkDeviceMemory m_vertexBufferMemory;
-		VkDeviceMemory m_indexBufferMemory;
-		VkDeviceSize m_vertexBufferSize;
-		VkDeviceSize m_indexBufferSize;
+		//one vertex and index buffer per frame in flight
+		VkBuffer m_vertexBuffers[maxFramesInFlight] = {};
+		VkBuffer m_indexBuffers[maxFramesInFlight] = {};
+		VkDeviceMemory m_vertexBufferMemories[maxFramesInFlight] = {};
+		VkDeviceMemory m_indexBufferMemories[maxFramesInFlight] = {};
+		VkDeviceSize m_vertexBufferSizes[maxFramesInFlight] = {};
+		VkDeviceSize m_indexBufferSizes[maxFramesInFlight] = {};
+		//commands of the draw data set last, empty if there is nothing to draw
+		std::vector<ImDrawCmd> m_drawCommands;
+		ImVec2 m_clipOffset;
+		ImVec2 m_clipScale;
 
 		uint32_t m_subpassNumber = 0;
 
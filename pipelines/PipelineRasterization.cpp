@@ -1,5 +1,7 @@
 #include "PipelineRasterization.h"
 
+#include <chrono>
+
 namespace MelonRenderer
 {
 	void PipelineRasterization::Init(VkPhysicalDevice& physicalDevice, DeviceMemoryManager& memoryManager, VkRenderPass& renderPass, VkExtent2D windowExtent)
@@ -12,19 +14,17 @@ namespace MelonRenderer
 
 		CreateDepthBuffer();
 		CreateDynamicTransformBuffer();
+		CreateDefaultInstanceBuffer();
+		CreateGBufferRenderpass();
+		CreateGBuffer();
 
 		CreatePipelineLayout();
 		CreateDescriptorPool();
 		CreateDescriptorSets();
-
-		CreateShaderModules();
-
-		CreateGraphicsPipeline();
 	}
 
 	void PipelineRasterization::Tick(VkCommandBuffer& commandBuffer)
 	{
-		m_memoryManager->UpdateDynamicUBO(m_dynamicTransformBuffer);
 		Draw(commandBuffer);
 	}
 
@@ -34,13 +34,15 @@ namespace MelonRenderer
 		colorAttachment.flags = 0;
 		colorAttachment.format = VK_FORMAT_B8G8R8A8_UNORM; //TODO: parameter
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		//loaded so raytraced output copied into the swapchain image is kept, cleared in Draw otherwise
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 		*renderpass->GetColorAttachmentPointer() = colorAttachment;
+		m_colorClearValue = *renderpass->GetColorClearValuePointer();
 
 		// Depth attachment
 		VkAttachmentDescription depthAttachment = {};
@@ -75,10 +77,11 @@ namespace MelonRenderer
 		VkSubpassDependency dependency = {};
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = subpassNumber;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		//the loaded color attachment may have been written by a copy before the renderpass
+		dependency.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependency.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		renderpass->AddSubpassDependency(dependency);
@@ -86,16 +89,19 @@ namespace MelonRenderer
 
 	void PipelineRasterization::FillAttachmentInfo(Swapchain* swapchain)
 	{
+		m_swapchain = swapchain;
 		swapchain->AddAttachment(m_depthBufferView);
 	}
 
 	void PipelineRasterization::RecreateOutput(VkExtent2D& windowExtent)
 	{
 		vkDeviceWaitIdle(Device::Get().m_device);
+		CleanupGBuffer();
 		CleanupDepthBuffer();
 
 		m_extent = windowExtent;
 		CreateDepthBuffer();
+		CreateGBuffer();
 	}
 
 	void PipelineRasterization::SetCamera(Camera* camera)
@@ -108,12 +114,157 @@ namespace MelonRenderer
 		m_scene = scene;
 	}
 
+	void PipelineRasterization::SetRasterizeScene(bool rasterizeScene)
+	{
+		m_rasterizeScene = rasterizeScene;
+	}
+
+	void PipelineRasterization::SetThreadPool(ThreadPool& threadPool)
+	{
+		m_threadPool = &threadPool;
+	}
+
+	void PipelineRasterization::SetRecordingThreadCount(uint32_t threadCount)
+	{
+		DestroyRecordingSlices();
+		const uint32_t poolThreadCount = m_threadPool ? m_threadPool->GetThreadCount() : 1;
+		m_recordingThreadCount = threadCount && threadCount < poolThreadCount ? threadCount : poolThreadCount;
+	}
+
+	uint32_t PipelineRasterization::GetDrawCallCount() const
+	{
+		return m_drawCallCount;
+	}
+
+	float PipelineRasterization::GetRecordingMs() const
+	{
+		return m_recordingMs;
+	}
+
+	RasterizationStats PipelineRasterization::GetStats() const
+	{
+		RasterizationStats stats;
+		stats.m_drawCallCount = m_drawCallCount;
+		stats.m_staticBatchCount = static_cast<uint32_t>(m_staticBatcher.GetBatches().size());
+		stats.m_recordingMs = m_recordingMs;
+		return stats;
+	}
+
+	const RasterizationSettings& PipelineRasterization::GetSettings() const
+	{
+		return m_settings;
+	}
+
+	void PipelineRasterization::SetSettings(const RasterizationSettings& settings)
+	{
+		m_settings = settings;
+	}
+
+	bool PipelineRasterization::DrawSettings(RasterizationSettings& settings, const RasterizationStats& stats)
+	{
+		bool changed = false;
+		ImGui::Begin("Scene");
+
+		changed |= ImGui::InputFloat3("light position", &settings.m_sceneInfo.lightPosition[0]);
+		changed |= ImGui::SliderFloat("light intensity", &settings.m_sceneInfo.lightIntensity, 0.f, 10.f);
+		changed |= ImGui::Checkbox("static batching", &settings.m_useStaticBatching);
+		ImGui::Text("draw calls: %u, static batches: %u", stats.m_drawCallCount, stats.m_staticBatchCount);
+
+		ImGui::End();
+		return changed;
+	}
+
+	bool PipelineRasterization::PrepareFrame()
+	{
+		//the slot's fence was waited for
+		ReleaseRetiredBuffers(m_frameIndex);
+
+		//a failed batch upload disables batching, the frame is drawn without it
+		UpdateStaticBatches();
+		const bool success = UpdateInstanceStreams() && UpdateDynamicTransformBuffer();
+		CullInstances();
+
+		return success;
+	}
+
+	std::vector<RetiredBuffer>& PipelineRasterization::GetRetiredBuffers()
+	{
+		return m_retiredBuffers[(m_frameIndex + maxFramesInFlight - 1) % maxFramesInFlight];
+	}
+
+	void PipelineRasterization::ReleaseRetiredBuffers(uint32_t frame)
+	{
+		for (RetiredBuffer& retiredBuffer : m_retiredBuffers[frame])
+		{
+			vkDestroyBuffer(Device::Get().m_device, retiredBuffer.m_buffer, nullptr);
+			vkFreeMemory(Device::Get().m_device, retiredBuffer.m_bufferMemory, nullptr);
+		}
+		m_retiredBuffers[frame].clear();
+	}
+
+	VkSubpassContents PipelineRasterization::GetSubpassContents() const
+	{
+		return m_rasterizeScene && m_recordingThreadCount > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+	}
+
+	bool PipelineRasterization::DrawGBuffer(VkCommandBuffer& commandBuffer)
+	{
+		VkClearValue clearValues[3] = {};
+		clearValues[0].color = { 0.f, 0.f, 0.f, -1.f };
+		clearValues[1].color.uint32[0] = 0;
+		clearValues[2].depthStencil = { 1.f, 0 };
+
+		VkRenderPassBeginInfo renderPassBegin = {};
+		renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBegin.pNext = nullptr;
+		renderPassBegin.renderPass = m_gbufferRenderpass;
+		renderPassBegin.framebuffer = m_gbufferFramebuffer;
+		renderPassBegin.renderArea.offset.x = 0;
+		renderPassBegin.renderArea.offset.y = 0;
+		renderPassBegin.renderArea.extent = m_extent;
+		renderPassBegin.clearValueCount = 3;
+		renderPassBegin.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_gbufferPipeline);
+		DrawInstances(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		return true;
+	}
+
+	GBuffer PipelineRasterization::GetGBuffer() const
+	{
+		GBuffer gbuffer;
+		gbuffer.m_normalDistance = m_gbufferNormalDistanceView;
+		gbuffer.m_material = m_gbufferMaterialView;
+		return gbuffer;
+	}
+
 	void PipelineRasterization::Fini()
 	{
 		vkDestroyPipelineLayout(Device::Get().m_device, m_pipelineLayout, nullptr);
 		vkDestroyPipeline(Device::Get().m_device, m_pipeline, nullptr);
+		vkDestroyPipeline(Device::Get().m_device, m_gbufferPipeline, nullptr);
+		CleanupGBuffer();
+		vkDestroyRenderPass(Device::Get().m_device, m_gbufferRenderpass, nullptr);
+		m_staticBatcher.Fini();
+		DestroyInstanceStreamBuffers();
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			ReleaseRetiredBuffers(frame);
+		}
+		vkDestroyBuffer(Device::Get().m_device, m_defaultInstanceBuffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_defaultInstanceBufferMemory, nullptr);
+		DestroyRecordingSlices();
 
-		free(m_dynamicTransformBuffer.m_uploadBuffer);
+		//freeing the memory unmaps it
+		for (FrameTransformBuffer& frameBuffer : m_transformBuffers)
+		{
+			vkDestroyBuffer(Device::Get().m_device, frameBuffer.m_buffer.m_buffer, nullptr);
+			vkFreeMemory(Device::Get().m_device, frameBuffer.m_buffer.m_bufferMemory, nullptr);
+		}
 	}
 
 	void PipelineRasterization::DefineVertices()
@@ -148,6 +299,92 @@ namespace MelonRenderer
 		vertexAttributeMaterial.format = VK_FORMAT_R32_UINT;
 		vertexAttributeMaterial.offset = sizeof(float) * 8;
 		m_vertexInputAttributes.emplace_back(vertexAttributeMaterial);
+
+		//compact instances, draws of single instances read the identity from m_defaultInstanceBuffer
+		VkVertexInputBindingDescription instanceInputBinding;
+		instanceInputBinding.binding = 1;
+		instanceInputBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		instanceInputBinding.stride = sizeof(CompactInstance);
+		m_vertexInputBindings.emplace_back(instanceInputBinding);
+
+		VkVertexInputAttributeDescription instanceAttributePositionScale, instanceAttributeRotation, instanceAttributeMaterial;
+		instanceAttributePositionScale.binding = 1;
+		instanceAttributePositionScale.location = 4;
+		instanceAttributePositionScale.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		instanceAttributePositionScale.offset = 0;
+		m_vertexInputAttributes.emplace_back(instanceAttributePositionScale);
+
+		instanceAttributeRotation.binding = 1;
+		instanceAttributeRotation.location = 5;
+		instanceAttributeRotation.format = VK_FORMAT_R16G16B16A16_SNORM;
+		instanceAttributeRotation.offset = sizeof(float) * 4;
+		m_vertexInputAttributes.emplace_back(instanceAttributeRotation);
+
+		instanceAttributeMaterial.binding = 1;
+		instanceAttributeMaterial.location = 6;
+		instanceAttributeMaterial.format = VK_FORMAT_R32_UINT;
+		instanceAttributeMaterial.offset = sizeof(float) * 6;
+		m_vertexInputAttributes.emplace_back(instanceAttributeMaterial);
+	}
+
+	bool PipelineRasterization::CreateDefaultInstanceBuffer()
+	{
+		CompactInstance identity = PackCompactInstance(vec3(0.f), vec4(0.f, 0.f, 0.f, 1.f), 1.f);
+		if (!m_memoryManager->CreateOptimalBuffer(m_defaultInstanceBuffer, m_defaultInstanceBufferMemory, &identity, sizeof(CompactInstance),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
+		{
+			Logger::Log("Could not create default instance buffer.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineRasterization::UpdateInstanceStreams()
+	{
+		const uint64_t instanceStreamUpdate = m_scene->GetInstanceStreamUpdate();
+		if (instanceStreamUpdate == m_uploadedInstanceStreamUpdate)
+			return true;
+		m_uploadedInstanceStreamUpdate = instanceStreamUpdate;
+
+		//earlier frames may still draw the old copies
+		std::vector<RetiredBuffer>& retiredBuffers = GetRetiredBuffers();
+		for (InstanceStreamBuffer& instanceStreamBuffer : m_instanceStreamBuffers)
+		{
+			if (instanceStreamBuffer.m_buffer != VK_NULL_HANDLE)
+				retiredBuffers.push_back({ instanceStreamBuffer.m_buffer, instanceStreamBuffer.m_bufferMemory });
+		}
+		m_instanceStreamBuffers.clear();
+		InvalidateIdentityElements();
+
+		const std::vector<InstanceStream>& instanceStreams = m_scene->GetInstanceStreams();
+		m_instanceStreamBuffers.resize(instanceStreams.size());
+		for (size_t i = 0; i < instanceStreams.size(); i++)
+		{
+			if (instanceStreams[i].m_instances.empty())
+				continue;
+
+			if (!m_memoryManager->CreateOptimalBuffer(m_instanceStreamBuffers[i].m_buffer, m_instanceStreamBuffers[i].m_bufferMemory,
+				instanceStreams[i].m_instances.data(), instanceStreams[i].m_instances.size() * sizeof(CompactInstance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
+			{
+				Logger::Log("Could not create instance stream buffer.");
+				return false;
+			}
+			m_instanceStreamBuffers[i].m_instanceCount = static_cast<uint32_t>(instanceStreams[i].m_instances.size());
+			m_instanceStreamBuffers[i].m_drawableIndex = instanceStreams[i].m_drawableIndex;
+		}
+
+		return true;
+	}
+
+	void PipelineRasterization::DestroyInstanceStreamBuffers()
+	{
+		for (InstanceStreamBuffer& instanceStreamBuffer : m_instanceStreamBuffers)
+		{
+			vkDestroyBuffer(Device::Get().m_device, instanceStreamBuffer.m_buffer, nullptr);
+			vkFreeMemory(Device::Get().m_device, instanceStreamBuffer.m_bufferMemory, nullptr);
+		}
+		m_instanceStreamBuffers.clear();
 	}
 
 	bool PipelineRasterization::CreateDepthBuffer()
@@ -237,6 +474,149 @@ namespace MelonRenderer
 		return true;
 	}
 
+	bool PipelineRasterization::CreateGBufferRenderpass()
+	{
+		VkAttachmentDescription attachments[3] = {};
+		for (int i = 0; i < 2; i++)
+		{
+			attachments[i].flags = 0;
+			attachments[i].format = i == 0 ? m_gbufferNormalDistanceFormat : m_gbufferMaterialFormat;
+			attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			//read as storage images by the raygen shader
+			attachments[i].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		attachments[2].flags = 0;
+		attachments[2].format = m_depthBufferFormat;
+		attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReferences[2] = {
+			{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }
+		};
+		VkAttachmentReference depthReference = { 2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 2;
+		subpass.pColorAttachments = colorReferences;
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		//the raygen shader of the previous frame may still read the G-buffer, the one of this frame reads it afterwards
+		//all commands, the raytracing stage is not available on every device
+		VkSubpassDependency dependencies[2] = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pNext = nullptr;
+		renderPassInfo.flags = 0;
+		renderPassInfo.attachmentCount = 3;
+		renderPassInfo.pAttachments = attachments;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies;
+
+		VkResult result = vkCreateRenderPass(Device::Get().m_device, &renderPassInfo, nullptr, &m_gbufferRenderpass);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create renderpass for G-buffer.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineRasterization::CreateGBuffer()
+	{
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		if (!m_memoryManager->CreateImage(m_gbufferNormalDistance, m_gbufferNormalDistanceMemory, m_extent, usage, m_gbufferNormalDistanceFormat)
+			|| !m_memoryManager->CreateImageView(m_gbufferNormalDistanceView, m_gbufferNormalDistance, m_gbufferNormalDistanceFormat)
+			|| !m_memoryManager->CreateImage(m_gbufferMaterial, m_gbufferMaterialMemory, m_extent, usage, m_gbufferMaterialFormat)
+			|| !m_memoryManager->CreateImageView(m_gbufferMaterialView, m_gbufferMaterial, m_gbufferMaterialFormat))
+		{
+			Logger::Log("Could not create G-buffer image.");
+			return false;
+		}
+
+		//the raygen shader binds the G-buffer even when it is not drawn
+		VkCommandBuffer layoutTransitionCommandBuffer;
+		if (!m_memoryManager->CreateSingleUseCommand(layoutTransitionCommandBuffer))
+		{
+			Logger::Log("Could not create single use command buffer for transition of image layout.");
+			return false;
+		}
+		m_memoryManager->TransitionImageLayout(layoutTransitionCommandBuffer, m_gbufferNormalDistance, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		m_memoryManager->TransitionImageLayout(layoutTransitionCommandBuffer, m_gbufferMaterial, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		if (!m_memoryManager->EndSingleUseCommand(layoutTransitionCommandBuffer))
+		{
+			Logger::Log("Could not end command buffer for image layout transition.");
+			return false;
+		}
+
+		VkImageView attachments[3] = { m_gbufferNormalDistanceView, m_gbufferMaterialView, m_depthBufferView };
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.pNext = nullptr;
+		framebufferInfo.flags = 0;
+		framebufferInfo.renderPass = m_gbufferRenderpass;
+		framebufferInfo.attachmentCount = 3;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = m_extent.width;
+		framebufferInfo.height = m_extent.height;
+		framebufferInfo.layers = 1;
+
+		VkResult result = vkCreateFramebuffer(Device::Get().m_device, &framebufferInfo, nullptr, &m_gbufferFramebuffer);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create framebuffer for G-buffer.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineRasterization::CleanupGBuffer()
+	{
+		vkDestroyFramebuffer(Device::Get().m_device, m_gbufferFramebuffer, nullptr);
+
+		vkDestroyImageView(Device::Get().m_device, m_gbufferNormalDistanceView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_gbufferNormalDistanceMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_gbufferNormalDistance, nullptr);
+
+		vkDestroyImageView(Device::Get().m_device, m_gbufferMaterialView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_gbufferMaterialMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_gbufferMaterial, nullptr);
+
+		return true;
+	}
+
 	bool PipelineRasterization::CreateShaderModules()
 	{
 		auto vertShaderCode = readFile("shaders/vert.spv");
@@ -264,6 +644,16 @@ namespace MelonRenderer
 		m_shaderStagesV.emplace_back(vertexShader);
 		m_shaderStagesV.emplace_back(fragmentShader);
 
+		//G-buffer
+		auto gbufferVertShaderCode = readFile("shaders/gbufferVert.spv");
+		auto gbufferFragShaderCode = readFile("shaders/gbufferFrag.spv");
+
+		CreateShaderModule(gbufferVertShaderCode, vertexShader.module);
+		CreateShaderModule(gbufferFragShaderCode, fragmentShader.module);
+
+		m_gbufferShaderStages.emplace_back(vertexShader);
+		m_gbufferShaderStages.emplace_back(fragmentShader);
+
 		return true;
 	}
 
@@ -395,41 +785,214 @@ namespace MelonRenderer
 		pipeline.renderPass = *m_renderpass;
 		pipeline.subpass = 0;
 
-		VkResult result = vkCreateGraphicsPipelines(Device::Get().m_device, VK_NULL_HANDLE, 1, &pipeline, nullptr, &m_pipeline);
+		//same state with the G-buffer shaders writing to two attachments
+		VkPipelineColorBlendAttachmentState gbufferBlendAttachments[2] = { colorBlendAttachment[0], colorBlendAttachment[0] };
+		VkPipelineColorBlendStateCreateInfo gbufferColorBlendInfo = pipelineColorBlendInfo;
+		gbufferColorBlendInfo.attachmentCount = 2;
+		gbufferColorBlendInfo.pAttachments = gbufferBlendAttachments;
+		VkGraphicsPipelineCreateInfo gbufferPipeline = pipeline;
+		gbufferPipeline.pColorBlendState = &gbufferColorBlendInfo;
+		gbufferPipeline.pStages = m_gbufferShaderStages.data();
+		gbufferPipeline.stageCount = static_cast<uint32_t>(m_gbufferShaderStages.size());
+		gbufferPipeline.renderPass = m_gbufferRenderpass;
+
+		//both are compiled at the same time
+		VkResult result = VK_SUCCESS;
+		VkResult gbufferResult = VK_SUCCESS;
+		m_pipelineCache->CreatePipelines({
+			[&](VkPipelineCache pipelineCache)
+			{
+				return result = vkCreateGraphicsPipelines(Device::Get().m_device, pipelineCache, 1, &pipeline, nullptr, &m_pipeline);
+			},
+			[&](VkPipelineCache pipelineCache)
+			{
+				return gbufferResult = vkCreateGraphicsPipelines(Device::Get().m_device, pipelineCache, 1, &gbufferPipeline, nullptr, &m_gbufferPipeline);
+			} });
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not create graphics pipeline.");
 			return false;
 		}
 
+		if (gbufferResult != VK_SUCCESS)
+		{
+			Logger::Log("Could not create G-buffer pipeline.");
+			return false;
+		}
+
 		return true;
 	}
 
+	void PipelineRasterization::DestroyPipelines()
+	{
+		Pipeline::DestroyPipelines();
+		for (VkPipelineShaderStageCreateInfo& shaderStage : m_gbufferShaderStages)
+		{
+			vkDestroyShaderModule(Device::Get().m_device, shaderStage.module, nullptr);
+		}
+		m_gbufferShaderStages.clear();
+
+		vkDestroyPipeline(Device::Get().m_device, m_gbufferPipeline, nullptr);
+		m_gbufferPipeline = VK_NULL_HANDLE;
+	}
+
 	bool PipelineRasterization::CreateDynamicTransformBuffer()
 	{
-		//TODO: uncouple size from number of instances, take fixed value instead and increase if needed? decide with memory allocator
-		m_dynamicTransformBuffer.m_numberOfElements = m_scene->m_drawableInstances.size();
-		m_dynamicTransformBuffer.m_alignment = sizeof(DrawableInstance);
+		for (FrameTransformBuffer& frameBuffer : m_transformBuffers)
+		{
+			frameBuffer.m_buffer.m_numberOfElements = m_scene->m_drawableInstances.size();
+			frameBuffer.m_buffer.m_alignment = sizeof(DrawableInstance);
+			frameBuffer.m_uploadedTransformUpdate = 0;
+
+			if (!m_memoryManager->CreateDynamicUBO(frameBuffer.m_buffer))
+			{
+				Logger::Log("Could not create dynamic transform buffer.");
+				return false;
+			}
+		}
+
+		return true;
+	}
 
-		if (!m_memoryManager->CreateDynamicUBO(m_dynamicTransformBuffer))
+	bool PipelineRasterization::GrowDynamicTransformBuffer()
+	{
+		//the other frames keep their buffers until they grow themselves
+		FrameTransformBuffer& frameBuffer = m_transformBuffers[m_frameIndex];
+		vkDestroyBuffer(Device::Get().m_device, frameBuffer.m_buffer.m_buffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, frameBuffer.m_buffer.m_bufferMemory, nullptr);
+
+		const uint32_t elementCount = static_cast<uint32_t>(m_scene->m_drawableInstances.size() + GetIdentityElementCount());
+		const uint32_t doubledCount = 2 * frameBuffer.m_buffer.m_numberOfElements;
+		frameBuffer.m_buffer.m_numberOfElements = elementCount > doubledCount ? elementCount : doubledCount;
+		frameBuffer.m_uploadedTransformUpdate = 0;
+		frameBuffer.m_changedInstances.clear();
+		frameBuffer.m_identityElementsValid = false;
+		if (!m_memoryManager->CreateDynamicUBO(frameBuffer.m_buffer))
 		{
-			Logger::Log("Could not create dynamic transform buffer.");
+			Logger::Log("Could not grow dynamic transform buffer.");
 			return false;
 		}
 
+		VkWriteDescriptorSet dynamicTransformUBO;
+		dynamicTransformUBO.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		dynamicTransformUBO.pNext = nullptr;
+		dynamicTransformUBO.dstSet = m_descriptorSets[m_frameIndex];
+		dynamicTransformUBO.descriptorCount = 1;
+		dynamicTransformUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		dynamicTransformUBO.pBufferInfo = &frameBuffer.m_buffer.m_descriptorBufferInfo;
+		dynamicTransformUBO.dstArrayElement = 0;
+		dynamicTransformUBO.dstBinding = 1;
+		vkUpdateDescriptorSets(Device::Get().m_device, 1, &dynamicTransformUBO, 0, nullptr);
+
 		return true;
 	}
 
+	void PipelineRasterization::InvalidateIdentityElements()
+	{
+		for (FrameTransformBuffer& frameBuffer : m_transformBuffers)
+		{
+			frameBuffer.m_identityElementsValid = false;
+		}
+	}
+
 	bool PipelineRasterization::UpdateDynamicTransformBuffer()
 	{
+		//every buffer collects the changes until its frame comes up again, after missing an update, e.g. while raytracing, 
+		//each one is copied completely once
+		const uint64_t transformUpdate = m_scene->GetTransformUpdate();
+		if (transformUpdate != m_collectedTransformUpdate)
+		{
+			const bool missedUpdate = transformUpdate != m_collectedTransformUpdate + 1;
+			const std::vector<uint32_t>& changedInstances = m_scene->GetChangedInstances();
+			for (FrameTransformBuffer& frameBuffer : m_transformBuffers)
+			{
+				if (missedUpdate)
+					frameBuffer.m_uploadedTransformUpdate = 0;
+				if (frameBuffer.m_uploadedTransformUpdate)
+					frameBuffer.m_changedInstances.insert(frameBuffer.m_changedInstances.end(), changedInstances.begin(), changedInstances.end());
+				else
+					frameBuffer.m_changedInstances.clear();
+			}
+			m_collectedTransformUpdate = transformUpdate;
+		}
+
+		FrameTransformBuffer& frameBuffer = m_transformBuffers[m_frameIndex];
+		//created instances are part of the changed ones, so only a grown buffer has to be filled completely
+		if (m_scene->m_drawableInstances.size() + GetIdentityElementCount() > frameBuffer.m_buffer.m_numberOfElements && 
+			!GrowDynamicTransformBuffer())
+			return false;
+		DynamicUniformBuffer& dynamicTransformBuffer = frameBuffer.m_buffer;
+
+		//instances never reach the identity elements, so they are only written after batches or streams changed or the buffer grew
+		if (!frameBuffer.m_identityElementsValid)
+		{
+			const std::vector<StaticBatch>& staticBatches = m_staticBatcher.GetBatches();
+			const std::vector<InstanceStream>& instanceStreams = m_scene->GetInstanceStreams();
+			std::vector<uint32_t> identityElements;
+			for (uint32_t k = 0; k < GetIdentityElementCount(); k++)
+			{
+				DrawableInstance* identityInstance = (DrawableInstance*)(((uint64_t)dynamicTransformBuffer.m_uploadBuffer +
+					(GetIdentityElement(k) * dynamicTransformBuffer.m_alignment)));
+				*identityInstance = {};
+				if (k < staticBatches.size())
+				{
+					identityInstance->m_drawableIndex = staticBatches[k].m_drawableIndex;
+					identityInstance->m_textureOffset = staticBatches[k].m_textureOffset;
+				}
+				else
+				{
+					identityInstance->m_drawableIndex = instanceStreams[k - staticBatches.size()].m_drawableIndex;
+				}
+				identityElements.emplace_back(GetIdentityElement(k));
+			}
+			std::reverse(identityElements.begin(), identityElements.end());
+
+			if (!identityElements.empty() && !m_memoryManager->UpdateDynamicUBO(dynamicTransformBuffer, identityElements))
+			{
+				Logger::Log("Could not update identity elements of dynamic uniform buffer.");
+				return false;
+			}
+			frameBuffer.m_identityElementsValid = true;
+		}
+
+		if (transformUpdate == frameBuffer.m_uploadedTransformUpdate)
+			return true;
+		const bool partialUpdate = frameBuffer.m_uploadedTransformUpdate != 0;
+		frameBuffer.m_uploadedTransformUpdate = transformUpdate;
+
+		if (partialUpdate)
+		{
+			//the updates since the last upload may have changed the same instances
+			std::vector<uint32_t>& changedInstances = frameBuffer.m_changedInstances;
+			std::sort(changedInstances.begin(), changedInstances.end());
+			changedInstances.erase(std::unique(changedInstances.begin(), changedInstances.end()), changedInstances.end());
+			for (uint32_t i : changedInstances)
+			{
+				DrawableInstance* mat = (DrawableInstance*)(((uint64_t)dynamicTransformBuffer.m_uploadBuffer +
+					(i * dynamicTransformBuffer.m_alignment)));
+				*mat = m_scene->m_drawableInstances[i];
+			}
+
+			const bool updated = changedInstances.empty() || m_memoryManager->UpdateDynamicUBO(dynamicTransformBuffer, changedInstances);
+			changedInstances.clear();
+			if (!updated)
+			{
+				Logger::Log("Could not update dynamic uniform buffer.");
+				return false;
+			}
+
+			return true;
+		}
+		frameBuffer.m_changedInstances.clear();
+
 		for (int i = 0; i < m_scene->m_drawableInstances.size(); i++)
 		{
-			DrawableInstance* mat = (DrawableInstance*)(((uint64_t)m_dynamicTransformBuffer.m_uploadBuffer + 
-				(i * m_dynamicTransformBuffer.m_alignment)));
+			DrawableInstance* mat = (DrawableInstance*)(((uint64_t)dynamicTransformBuffer.m_uploadBuffer + 
+				(i * dynamicTransformBuffer.m_alignment)));
 			*mat = m_scene->m_drawableInstances.operator[](i);
 		}
 
-		if (!m_memoryManager->UpdateDynamicUBO(m_dynamicTransformBuffer))
+		if (!m_memoryManager->UpdateDynamicUBO(dynamicTransformBuffer))
 		{
 			Logger::Log("Could not update dynamic uniform buffer.");
 			return false;
@@ -438,66 +1001,367 @@ namespace MelonRenderer
 		return true;
 	}
 
-	bool PipelineRasterization::Draw(VkCommandBuffer& commandBuffer)
+	bool PipelineRasterization::UpdateStaticBatches()
 	{
-		UpdateDynamicTransformBuffer();
+		//disabling drops the batches, so they are rebuilt for the current instances when it is enabled again
+		if (!m_settings.m_useStaticBatching)
+		{
+			if (!m_staticBatcher.GetBatches().empty())
+			{
+				m_staticBatcher.RetireBuffers(GetRetiredBuffers());
+				m_staticBatcher.Fini();
+				InvalidateIdentityElements();
+			}
+			return true;
+		}
+		if (!m_staticBatcher.IsOutdated(*m_scene))
+			return true;
+
+		//earlier frames may still draw the old batches
+		m_staticBatcher.RetireBuffers(GetRetiredBuffers());
+		m_staticBatcher.Build(*m_scene);
+		InvalidateIdentityElements();
+		if (!m_staticBatcher.Upload(*m_memoryManager))
+		{
+			Logger::Log("Could not upload static batches.");
+			m_staticBatcher.Fini();
+			m_settings.m_useStaticBatching = false;
+			return false;
+		}
 
-		ImGui::Begin("Scene");
+		return true;
+	}
 
-		static float lightPosition[3] = { -50.f, 50.f, -50.f };
-		static float lightIntensity = 1.f;
+	uint32_t PipelineRasterization::GetIdentityElementCount() const
+	{
+		return static_cast<uint32_t>(m_staticBatcher.GetBatches().size() + m_scene->GetInstanceStreams().size());
+	}
 
-		ImGui::InputFloat3("light position", lightPosition);
-		m_pushConstants.lightPosition.x = lightPosition[0];
-		m_pushConstants.lightPosition.y = lightPosition[1];
-		m_pushConstants.lightPosition.z = lightPosition[2];
-		ImGui::SliderFloat("light intensity", &lightIntensity, 0.f, 10.f);
-		m_pushConstants.lightIntensity = lightIntensity;
+	uint32_t PipelineRasterization::GetIdentityElement(uint32_t k) const
+	{
+		return m_transformBuffers[m_frameIndex].m_buffer.m_numberOfElements - 1 - k;
+	}
 
-		ImGui::End();
+	bool PipelineRasterization::Draw(VkCommandBuffer& commandBuffer)
+	{
+		if (!m_rasterizeScene)
+		{
+			vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			return true;
+		}
+
+		auto recordingStart = std::chrono::high_resolution_clock::now();
+
+		//the renderpass began the subpass for secondary command buffers, nothing may be recorded into the primary until the next one
+		if (m_recordingThreadCount > 1)
+		{
+			RecordSecondaryCommandBuffers(commandBuffer);
+			m_recordingMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordingStart).count();
+			vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			return true;
+		}
 
-		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(m_pushConstants), &m_pushConstants);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SceneInfo), &m_settings.m_sceneInfo);
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
-		uint32_t dynamicOffset = 0;
-		
+		VkClearAttachment colorClear = {};
+		colorClear.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorClear.colorAttachment = 0;
+		colorClear.clearValue = m_colorClearValue;
+		VkClearRect clearRect = {};
+		clearRect.rect.offset = { 0, 0 };
+		clearRect.rect.extent = m_extent;
+		clearRect.baseArrayLayer = 0;
+		clearRect.layerCount = 1;
+		vkCmdClearAttachments(commandBuffer, 1, &colorClear, 1, &clearRect);
+
+		DrawInstances(commandBuffer);
+		m_recordingMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordingStart).count();
+
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+		return true;
+	}
+
+	void PipelineRasterization::DrawInstances(VkCommandBuffer& commandBuffer)
+	{
+		m_drawCallCount = RecordDraws(commandBuffer, 0, static_cast<uint32_t>(m_visibleInstances.size()), true);
+	}
+
+	void PipelineRasterization::CullInstances()
+	{
 		m_viewport.height = (float)m_extent.height;
 		m_viewport.width = (float)m_extent.width;
 		m_viewport.minDepth = (float)0.0f;
 		m_viewport.maxDepth = (float)1.0f;
 		m_viewport.x = 0;
 		m_viewport.y = 0;
-		vkCmdSetViewport(commandBuffer, 0, 1, &m_viewport);
 
 		m_scissorRect2D.extent.width = m_extent.width;
 		m_scissorRect2D.extent.height = m_extent.height;
 		m_scissorRect2D.offset.x = 0;
 		m_scissorRect2D.offset.y = 0;
+
+		const CameraMatrices& camera = m_camera->GetFrameMatrices();
+		m_frustum = Frustum(camera.projection * camera.view);
+		if (const InstanceIndex* spatialIndex = m_scene->GetSpatialIndex())
+		{
+			spatialIndex->QueryFrustum(m_frustum, m_visibleInstances);
+		}
+		else
+		{
+			m_visibleInstances.resize(m_scene->m_drawableInstances.size());
+			for (uint32_t i = 0; i < m_visibleInstances.size(); i++)
+			{
+				m_visibleInstances[i] = i;
+			}
+		}
+
+		//batches only exist while batching is enabled and are current after UpdateStaticBatches
+		if (!m_staticBatcher.GetBatches().empty() && m_transformBuffers[m_frameIndex].m_identityElementsValid)
+		{
+			size_t visibleCount = 0;
+			for (uint32_t i : m_visibleInstances)
+			{
+				if (!m_staticBatcher.IsBatched(i))
+					m_visibleInstances[visibleCount++] = i;
+			}
+			m_visibleInstances.resize(visibleCount);
+		}
+
+		m_visibleDrawables.resize(m_visibleInstances.size());
+		for (size_t v = 0; v < m_visibleInstances.size(); v++)
+		{
+			m_visibleDrawables[v] = m_scene->m_drawableInstances[m_visibleInstances[v]].m_drawableIndex;
+		}
+
+		//one instanced draw per stream, culled as a whole
+		const std::vector<InstanceStream>& instanceStreams = m_scene->GetInstanceStreams();
+		m_visibleInstanceStreams.clear();
+		for (uint32_t s = 0; s < m_instanceStreamBuffers.size(); s++)
+		{
+			if (m_instanceStreamBuffers[s].m_instanceCount && m_frustum.Intersects(instanceStreams[s].m_bounds))
+				m_visibleInstanceStreams.emplace_back(s);
+		}
+	}
+
+	uint32_t PipelineRasterization::RecordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last, bool drawIdentityElements) const
+	{
+		vkCmdSetViewport(commandBuffer, 0, 1, &m_viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &m_scissorRect2D);
 
 		VkDeviceSize offsets[1] = { 0 };
 
-		for (int i = 0; i < m_scene->m_drawableInstances.size(); i++)
+		//instances drawn on their own read the identity as their compact instance
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &m_defaultInstanceBuffer, offsets);
+
+		//one set per frame slot, with the frame's camera matrices and transform buffer
+		const FrameTransformBuffer& frameBuffer = m_transformBuffers[m_frameIndex];
+		const VkDescriptorSet* descriptorSet = &m_descriptorSets[m_frameIndex];
+
+		uint32_t drawCallCount = 0;
+		for (uint32_t v = first; v < last; v++)
 		{
-			Drawable* drawable = &m_scene->m_drawables[m_scene->m_drawableInstances[i].m_drawableIndex];
+			const uint32_t i = m_visibleInstances[v];
+			const Drawable* drawable = &m_scene->m_drawables[m_visibleDrawables[v]];
 
 			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawable->m_vertexBuffer, offsets);
 			vkCmdBindIndexBuffer(commandBuffer, drawable->m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-			uint32_t dynamicOffset = i * m_dynamicTransformBuffer.m_alignment;
+			uint32_t dynamicOffset = i * frameBuffer.m_buffer.m_alignment;
 
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, m_descriptorSets.data(), 
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, descriptorSet, 
 				1, &dynamicOffset);
 
 			vkCmdDrawIndexed(commandBuffer, drawable->m_indexCount, 1, 0, 0, 0);
+			drawCallCount++;
 		}
 
-		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		if (!drawIdentityElements || !frameBuffer.m_identityElementsValid)
+			return drawCallCount;
+
+		const std::vector<StaticBatch>& staticBatches = m_staticBatcher.GetBatches();
+		for (uint32_t b = 0; b < staticBatches.size(); b++)
+		{
+			const StaticBatch& batch = staticBatches[b];
+			if (!m_frustum.Intersects(batch.m_bounds))
+				continue;
+
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &batch.m_vertexBuffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, batch.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+			uint32_t dynamicOffset = GetIdentityElement(b) * frameBuffer.m_buffer.m_alignment;
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, descriptorSet,
+				1, &dynamicOffset);
+
+			vkCmdDrawIndexed(commandBuffer, batch.m_indexCount, 1, 0, 0, 0);
+			drawCallCount++;
+		}
+
+		for (uint32_t s : m_visibleInstanceStreams)
+		{
+			const InstanceStreamBuffer& instanceStreamBuffer = m_instanceStreamBuffers[s];
+			const Drawable* drawable = &m_scene->m_drawables[instanceStreamBuffer.m_drawableIndex];
+
+			VkBuffer vertexBuffers[2] = { drawable->m_vertexBuffer, instanceStreamBuffer.m_buffer };
+			VkDeviceSize vertexOffsets[2] = { 0, 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexOffsets);
+			vkCmdBindIndexBuffer(commandBuffer, drawable->m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+			uint32_t dynamicOffset = GetIdentityElement(static_cast<uint32_t>(staticBatches.size()) + s) * frameBuffer.m_buffer.m_alignment;
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, descriptorSet,
+				1, &dynamicOffset);
+
+			vkCmdDrawIndexed(commandBuffer, drawable->m_indexCount, instanceStreamBuffer.m_instanceCount, 0, 0, 0);
+			drawCallCount++;
+		}
+
+		return drawCallCount;
+	}
+
+	bool PipelineRasterization::RecordSecondaryCommandBuffers(VkCommandBuffer& commandBuffer)
+	{
+		const uint32_t sliceCount = m_recordingThreadCount;
+		if (m_recordingSliceCount != sliceCount && !CreateRecordingSlices(sliceCount, maxFramesInFlight))
+		{
+			return false;
+		}
+
+		m_recordingFrameSlices = &m_recordingSlices[m_frameIndex * sliceCount];
+		m_recordingInheritance = {};
+		m_recordingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		m_recordingInheritance.pNext = nullptr;
+		m_recordingInheritance.renderPass = *m_renderpass;
+		m_recordingInheritance.subpass = 0;
+		m_recordingInheritance.framebuffer = m_swapchain->GetFramebuffer();
+		m_failedSlices = 0;
+		m_sliceDrawCallCounts.assign(sliceCount, 0);
+
+		//PrepareFrame culled already, the slices split the visible instances between them
+		if (m_recordingGraph.IsEmpty())
+			m_recordingGraph.AddParallelTask("record slice", sliceCount, [this](uint32_t s) { RecordSlice(s); });
+		m_threadPool->Run(m_recordingGraph);
+
+		const RecordingSlice* slices = m_recordingFrameSlices;
+		if (m_failedSlices)
+		{
+			Logger::Log("Could not record secondary command buffers.");
+			return false;
+		}
+
+		std::vector<VkCommandBuffer> commandBuffers(sliceCount);
+		m_drawCallCount = 0;
+		for (uint32_t s = 0; s < sliceCount; s++)
+		{
+			commandBuffers[s] = slices[s].m_commandBuffer;
+			m_drawCallCount += m_sliceDrawCallCounts[s];
+		}
+		vkCmdExecuteCommands(commandBuffer, sliceCount, commandBuffers.data());
+
+		return true;
+	}
+
+	void PipelineRasterization::RecordSlice(uint32_t s)
+	{
+		const RecordingSlice& slice = m_recordingFrameSlices[s];
+		//the frame slot was waited for, so the slice's previous commands are done
+		vkResetCommandPool(Device::Get().m_device, slice.m_commandPool, 0);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.pNext = nullptr;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &m_recordingInheritance;
+		if (vkBeginCommandBuffer(slice.m_commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			m_failedSlices++;
+			return;
+		}
+
+		vkCmdPushConstants(slice.m_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SceneInfo), &m_settings.m_sceneInfo);
+		vkCmdBindPipeline(slice.m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+
+		//secondary command buffers are executed in order, so the clear precedes every draw
+		if (s == 0)
+		{
+			VkClearAttachment colorClear = {};
+			colorClear.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			colorClear.colorAttachment = 0;
+			colorClear.clearValue = m_colorClearValue;
+			VkClearRect clearRect = {};
+			clearRect.rect.offset = { 0, 0 };
+			clearRect.rect.extent = m_extent;
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+			vkCmdClearAttachments(slice.m_commandBuffer, 1, &colorClear, 1, &clearRect);
+		}
+
+		const uint32_t sliceCount = m_recordingSliceCount;
+		const uint64_t visibleCount = m_visibleInstances.size();
+		const uint32_t first = static_cast<uint32_t>(visibleCount * s / sliceCount);
+		const uint32_t last = static_cast<uint32_t>(visibleCount * (s + 1) / sliceCount);
+		m_sliceDrawCallCounts[s] = RecordDraws(slice.m_commandBuffer, first, last, s == sliceCount - 1);
+
+		if (vkEndCommandBuffer(slice.m_commandBuffer) != VK_SUCCESS)
+			m_failedSlices++;
+	}
+
+	bool PipelineRasterization::CreateRecordingSlices(uint32_t sliceCount, uint32_t frameCount)
+	{
+		DestroyRecordingSlices();
+
+		m_recordingSlices.resize(sliceCount * frameCount);
+		for (RecordingSlice& slice : m_recordingSlices)
+		{
+			VkCommandPoolCreateInfo commandPoolInfo = {};
+			commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolInfo.pNext = nullptr;
+			commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			commandPoolInfo.queueFamilyIndex = 0; //TODO: make variable as soon as it is defined as a non constant
+			if (vkCreateCommandPool(Device::Get().m_device, &commandPoolInfo, nullptr, &slice.m_commandPool) != VK_SUCCESS)
+			{
+				Logger::Log("Could not create recording command pool.");
+				DestroyRecordingSlices();
+				return false;
+			}
+
+			VkCommandBufferAllocateInfo commandBufferInfo = {};
+			commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferInfo.pNext = nullptr;
+			commandBufferInfo.commandPool = slice.m_commandPool;
+			commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			commandBufferInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(Device::Get().m_device, &commandBufferInfo, &slice.m_commandBuffer) != VK_SUCCESS)
+			{
+				Logger::Log("Could not allocate secondary command buffer.");
+				DestroyRecordingSlices();
+				return false;
+			}
+		}
+		m_recordingSliceCount = sliceCount;
 
 		return true;
 	}
 
+	void PipelineRasterization::DestroyRecordingSlices()
+	{
+		if (!m_recordingSlices.empty())
+			vkDeviceWaitIdle(Device::Get().m_device);
+
+		//destroying a pool frees its command buffers
+		for (RecordingSlice& slice : m_recordingSlices)
+		{
+			if (slice.m_commandPool != VK_NULL_HANDLE)
+				vkDestroyCommandPool(Device::Get().m_device, slice.m_commandPool, nullptr);
+		}
+		m_recordingSlices.clear();
+		m_recordingSliceCount = 0;
+		m_recordingGraph.Clear();
+	}
+
 	bool PipelineRasterization::CreatePipelineLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
@@ -585,30 +1449,31 @@ namespace MelonRenderer
 	{
 		std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
 		VkDescriptorPoolSize poolSizeViewProjection = {};
+		//one set per frame in flight
 		poolSizeViewProjection.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizeViewProjection.descriptorCount = 1; 
+		poolSizeViewProjection.descriptorCount = maxFramesInFlight; 
 		descriptorPoolSizes.emplace_back(poolSizeViewProjection);
 
 		VkDescriptorPoolSize poolSizeDynamicTransform = {};
 		poolSizeDynamicTransform.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		poolSizeDynamicTransform.descriptorCount = 1;
+		poolSizeDynamicTransform.descriptorCount = maxFramesInFlight;
 		descriptorPoolSizes.emplace_back(poolSizeDynamicTransform);
 
 		VkDescriptorPoolSize storageBufferPoolSize = {};
 		storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		storageBufferPoolSize.descriptorCount = m_scene->m_drawables.size();
+		storageBufferPoolSize.descriptorCount = m_scene->m_drawables.size() * maxFramesInFlight;
 		descriptorPoolSizes.emplace_back(storageBufferPoolSize);
 
 		VkDescriptorPoolSize poolSizeTextureSampler = {};
 		poolSizeTextureSampler.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizeTextureSampler.descriptorCount = m_memoryManager->GetNumberTextures();
+		poolSizeTextureSampler.descriptorCount = m_memoryManager->GetNumberTextures() * maxFramesInFlight;
 		descriptorPoolSizes.emplace_back(poolSizeTextureSampler);
 
 		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
 			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 			nullptr,
 			0,
-			1, //TODO: max sets, make non constant, take number from CreatePipelineLayout
+			maxFramesInFlight, //TODO: max sets, take number from CreatePipelineLayout
 			descriptorPoolSizes.size(),
 			descriptorPoolSizes.data()
 		};
@@ -624,13 +1489,15 @@ namespace MelonRenderer
 
 	bool PipelineRasterization::CreateDescriptorSets()
 	{
+		//the same layout for every frame slot
+		std::vector<VkDescriptorSetLayout> setLayouts(maxFramesInFlight, m_descriptorSetLayouts[0]);
 		VkDescriptorSetAllocateInfo allocInfo;
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocInfo.pNext = nullptr;
 		allocInfo.descriptorPool = m_descriptorPool;
-		allocInfo.descriptorSetCount = m_descriptorSetLayouts.size();
-		allocInfo.pSetLayouts = m_descriptorSetLayouts.data();
-		m_descriptorSets.resize(m_descriptorSetLayouts.size());
+		allocInfo.descriptorSetCount = setLayouts.size();
+		allocInfo.pSetLayouts = setLayouts.data();
+		m_descriptorSets.resize(setLayouts.size());
 		VkResult result = vkAllocateDescriptorSets(Device::Get().m_device, &allocInfo, m_descriptorSets.data());
 		if (result != VK_SUCCESS)
 		{
@@ -644,56 +1511,61 @@ namespace MelonRenderer
 			materialDescBufferInfo.push_back({ m_scene->m_drawables[i].m_materialBuffer, 0, VK_WHOLE_SIZE });
 		}
 
+		VkDescriptorBufferInfo cameraDescBufferInfo[maxFramesInFlight];
 		std::vector<VkWriteDescriptorSet> descriptorSetWrites;
-		uint32_t dstBinding = 0;
-
-		//camera
-		VkWriteDescriptorSet viewProjectionUBODescriptorSet;
-		viewProjectionUBODescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		viewProjectionUBODescriptorSet.pNext = nullptr;
-		viewProjectionUBODescriptorSet.dstSet = m_descriptorSets[0];
-		viewProjectionUBODescriptorSet.descriptorCount = 1;
-		viewProjectionUBODescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		viewProjectionUBODescriptorSet.pBufferInfo = m_camera->GetCameraDescriptor();
-		viewProjectionUBODescriptorSet.dstArrayElement = 0;
-		viewProjectionUBODescriptorSet.dstBinding = dstBinding++;
-		descriptorSetWrites.emplace_back(viewProjectionUBODescriptorSet);
-
-		//transform dyn ubo
-		VkWriteDescriptorSet dynamicTransformUBO;
-		dynamicTransformUBO.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		dynamicTransformUBO.pNext = nullptr;
-		dynamicTransformUBO.dstSet = m_descriptorSets[0];
-		dynamicTransformUBO.descriptorCount = 1;
-		dynamicTransformUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		dynamicTransformUBO.pBufferInfo = &m_dynamicTransformBuffer.m_descriptorBufferInfo;
-		dynamicTransformUBO.dstArrayElement = 0;
-		dynamicTransformUBO.dstBinding = dstBinding++;
-		descriptorSetWrites.emplace_back(dynamicTransformUBO);
-
-		//materials
-		VkWriteDescriptorSet materialDescriptorSet;
-		materialDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		materialDescriptorSet.pNext = nullptr;
-		materialDescriptorSet.dstSet = m_descriptorSets[0];
-		materialDescriptorSet.descriptorCount = materialDescBufferInfo.size();
-		materialDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		materialDescriptorSet.pBufferInfo = materialDescBufferInfo.data();
-		materialDescriptorSet.dstArrayElement = 0;
-		materialDescriptorSet.dstBinding = dstBinding++;
-		descriptorSetWrites.emplace_back(materialDescriptorSet);
-
-		//image sampler
-		VkWriteDescriptorSet imageSamplerDescriptorSet;
-		imageSamplerDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		imageSamplerDescriptorSet.pNext = nullptr;
-		imageSamplerDescriptorSet.dstSet = m_descriptorSets[0];
-		imageSamplerDescriptorSet.descriptorCount = m_memoryManager->GetNumberTextures();
-		imageSamplerDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		imageSamplerDescriptorSet.pImageInfo = m_memoryManager->GetDescriptorImageInfo();
-		imageSamplerDescriptorSet.dstArrayElement = 0;
-		imageSamplerDescriptorSet.dstBinding = dstBinding++;
-		descriptorSetWrites.emplace_back(imageSamplerDescriptorSet);
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			uint32_t dstBinding = 0;
+
+			//camera
+			cameraDescBufferInfo[frame] = m_camera->GetCameraDescriptor(frame);
+			VkWriteDescriptorSet viewProjectionUBODescriptorSet;
+			viewProjectionUBODescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			viewProjectionUBODescriptorSet.pNext = nullptr;
+			viewProjectionUBODescriptorSet.dstSet = m_descriptorSets[frame];
+			viewProjectionUBODescriptorSet.descriptorCount = 1;
+			viewProjectionUBODescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			viewProjectionUBODescriptorSet.pBufferInfo = &cameraDescBufferInfo[frame];
+			viewProjectionUBODescriptorSet.dstArrayElement = 0;
+			viewProjectionUBODescriptorSet.dstBinding = dstBinding++;
+			descriptorSetWrites.emplace_back(viewProjectionUBODescriptorSet);
+
+			//transform dyn ubo
+			VkWriteDescriptorSet dynamicTransformUBO;
+			dynamicTransformUBO.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			dynamicTransformUBO.pNext = nullptr;
+			dynamicTransformUBO.dstSet = m_descriptorSets[frame];
+			dynamicTransformUBO.descriptorCount = 1;
+			dynamicTransformUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			dynamicTransformUBO.pBufferInfo = &m_transformBuffers[frame].m_buffer.m_descriptorBufferInfo;
+			dynamicTransformUBO.dstArrayElement = 0;
+			dynamicTransformUBO.dstBinding = dstBinding++;
+			descriptorSetWrites.emplace_back(dynamicTransformUBO);
+
+			//materials
+			VkWriteDescriptorSet materialDescriptorSet;
+			materialDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			materialDescriptorSet.pNext = nullptr;
+			materialDescriptorSet.dstSet = m_descriptorSets[frame];
+			materialDescriptorSet.descriptorCount = materialDescBufferInfo.size();
+			materialDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			materialDescriptorSet.pBufferInfo = materialDescBufferInfo.data();
+			materialDescriptorSet.dstArrayElement = 0;
+			materialDescriptorSet.dstBinding = dstBinding++;
+			descriptorSetWrites.emplace_back(materialDescriptorSet);
+
+			//image sampler
+			VkWriteDescriptorSet imageSamplerDescriptorSet;
+			imageSamplerDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			imageSamplerDescriptorSet.pNext = nullptr;
+			imageSamplerDescriptorSet.dstSet = m_descriptorSets[frame];
+			imageSamplerDescriptorSet.descriptorCount = m_memoryManager->GetNumberTextures();
+			imageSamplerDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			imageSamplerDescriptorSet.pImageInfo = m_memoryManager->GetDescriptorImageInfo();
+			imageSamplerDescriptorSet.dstArrayElement = 0;
+			imageSamplerDescriptorSet.dstBinding = dstBinding++;
+			descriptorSetWrites.emplace_back(imageSamplerDescriptorSet);
+		}
 
 		vkUpdateDescriptorSets(Device::Get().m_device, descriptorSetWrites.size(), descriptorSetWrites.data(), 0, nullptr);
 
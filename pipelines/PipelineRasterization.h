@@ -2,6 +2,10 @@
 #include "Pipeline.h"
 #include "../Camera.h"
 #include "../simple_scene_graph/Scene.h"
+#include "../simple_scene_graph/StaticBatcher.h"
+#include "../cpu_raytracing/ThreadPool.h"
+
+#include <memory>
 
 namespace MelonRenderer
 {
@@ -11,6 +15,57 @@ namespace MelonRenderer
 		float lightIntensity;
 	};
 
+	//everything the "Scene" window changes, the simulation edits a copy that is applied before the frame is prepared
+	struct RasterizationSettings
+	{
+		SceneInfo m_sceneInfo = { vec3(-50.f, 50.f, -50.f), 1.f };
+		bool m_useStaticBatching = true;
+	};
+
+	//of the last rasterized frame, the recording time does not include PrepareFrame
+	struct RasterizationStats
+	{
+		uint32_t m_drawCallCount = 0;
+		uint32_t m_staticBatchCount = 0;
+		float m_recordingMs = 0.f;
+	};
+
+	//primary surfaces rasterized for the hybrid raytracing mode, both images stay in the general layout
+	struct GBuffer
+	{
+		VkImageView m_normalDistance; //world normal and distance to the camera, negative distance where nothing was drawn
+		VkImageView m_material; //drawable, material and packed uv
+	};
+
+
+	//gpu copy of one of the scene's instance streams
+	struct InstanceStreamBuffer
+	{
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_bufferMemory = VK_NULL_HANDLE;
+		uint32_t m_instanceCount = 0;
+		uint32_t m_drawableIndex = 0;
+	};
+
+	//dynamic transform buffer of one frame in flight, the instances come first,
+	//draws of static batches and then instance streams take identity elements from the end backwards
+	struct FrameTransformBuffer
+	{
+		DynamicUniformBuffer m_buffer;
+		//Scene::GetTransformUpdate at the last upload, 0 before the first or after the changes of an update were missed
+		uint64_t m_uploadedTransformUpdate = 0;
+		//changed by the updates since the last upload, the scene only keeps the changes of its latest update
+		std::vector<uint32_t> m_changedInstances;
+		//false until the identity elements are written
+		bool m_identityElementsValid = false;
+	};
+
+	//secondary command buffer of one slice of the draws, with a pool of its own since slices are recorded on different threads
+	struct RecordingSlice
+	{
+		VkCommandPool m_commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+	};
 
 	class PipelineRasterization : public Pipeline
 	{
@@ -20,10 +75,35 @@ namespace MelonRenderer
 		void Fini();
 
 		void FillRenderpassInfo(Renderpass* renderpass) override;
+		//keeps the swapchain for the framebuffer the secondary command buffers are recorded for
 		void FillAttachmentInfo(Swapchain* swapchain); //TODO: implement for every pipeline?
 		void RecreateOutput(VkExtent2D& windowExtent);
 		void SetCamera(Camera* camera);
 		void SetScene(Scene* scene);
+		//when disabled only the subpass is advanced, the color attachment keeps its loaded content
+		void SetRasterizeScene(bool rasterizeScene);
+		//pool the secondary command buffers are recorded on, owned by the caller and has to outlive the pipeline
+		void SetThreadPool(ThreadPool& threadPool);
+		//1 records every draw into the primary command buffer, more split the draws into secondary command buffers recorded in parallel,
+		//0 uses every thread of the pool, at most as many as the pool has
+		void SetRecordingThreadCount(uint32_t threadCount);
+		//how the renderpass has to begin its first subpass for the next Tick
+		VkSubpassContents GetSubpassContents() const;
+		uint32_t GetDrawCallCount() const;
+		float GetRecordingMs() const;
+		RasterizationStats GetStats() const;
+		const RasterizationSettings& GetSettings() const;
+		void SetSettings(const RasterizationSettings& settings);
+		//the "Scene" window, only touches its arguments so the simulation can draw it on any thread, true if a setting changed
+		static bool DrawSettings(RasterizationSettings& settings, const RasterizationStats& stats);
+
+		//everything of the frame that reads the scene: rebuilds batches and streams, uploads the frame's transforms and culls
+		//with the matrices the camera uploaded for the frame, on the main thread before the next simulation may change the scene,
+		//Tick and DrawGBuffer only record what it left
+		bool PrepareFrame();
+		//renders the G-buffer in its own renderpass, has to be recorded outside of the main renderpass
+		bool DrawGBuffer(VkCommandBuffer& commandBuffer);
+		GBuffer GetGBuffer() const;
 
 	protected:
 		//virtual void     = 0; in pipeline base
@@ -37,13 +117,82 @@ namespace MelonRenderer
 
 		//---------------------------------------
 		bool CreateGraphicsPipeline() override;
+		void DestroyPipelines() override;
 		//---------------------------------------
 
 		bool CreateDynamicTransformBuffer();
+		//of the frame slot, the slot was waited for so nothing reads its buffer anymore
 		bool UpdateDynamicTransformBuffer();
-		DynamicUniformBuffer m_dynamicTransformBuffer;
+		//at least doubles the capacity of the frame's buffer, so spawning instances every frame reallocates rarely
+		bool GrowDynamicTransformBuffer();
+		//the identity elements of every frame have to be written again
+		void InvalidateIdentityElements();
+		FrameTransformBuffer m_transformBuffers[maxFramesInFlight];
+		//Scene::GetTransformUpdate whose changed instances were added to every buffer
+		uint64_t m_collectedTransformUpdate = 0;
+
+		//buffers the previous frames may still draw, kept with the slot of the last one and destroyed when that slot is prepared again
+		std::vector<RetiredBuffer>& GetRetiredBuffers();
+		void ReleaseRetiredBuffers(uint32_t frame);
+		std::vector<RetiredBuffer> m_retiredBuffers[maxFramesInFlight];
+
+		//rebuilds the batches when static instances were created, removed or moved
+		bool UpdateStaticBatches();
+		StaticBatcher m_staticBatcher;
+		RasterizationSettings m_settings;
+
+		//one buffer per stream, replaced whenever a stream changed
+		bool UpdateInstanceStreams();
+		void DestroyInstanceStreamBuffers();
+		std::vector<InstanceStreamBuffer> m_instanceStreamBuffers;
+		//Scene::GetInstanceStreamUpdate at the last upload
+		uint64_t m_uploadedInstanceStreamUpdate = 0;
+		//the identity as a single compact instance, bound for every draw that is not of a stream
+		bool CreateDefaultInstanceBuffer();
+		VkBuffer m_defaultInstanceBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_defaultInstanceBufferMemory = VK_NULL_HANDLE;
+
+		//elements of the frame's buffer with the identity transform and the drawable of a static batch, k < batch count, or of an instance stream
+		uint32_t GetIdentityElementCount() const;
+		uint32_t GetIdentityElement(uint32_t k) const;
 
 		bool Draw(VkCommandBuffer& commandBuffer) override;
+		//records every culled draw into commandBuffer
+		void DrawInstances(VkCommandBuffer& commandBuffer);
+		//frustum culled with the scene's spatial index if it has one, instances drawn by a static batch are left out, as are streams
+		//outside of the frustum, also sets the viewport and scissor rect every recording reads
+		void CullInstances();
+		//visible instances [first, last) and, if asked, the static batches culled by their bounds and the visible instance streams,
+		//only reads the pipeline, so slices can be recorded concurrently and while the scene is simulated, returns the number of draw calls
+		uint32_t RecordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last, bool drawIdentityElements) const;
+		std::vector<uint32_t> m_visibleInstances;
+		//drawable of each visible instance, the scene's instances may already be changed while recording
+		std::vector<uint32_t> m_visibleDrawables;
+		std::vector<uint32_t> m_visibleInstanceStreams;
+		Frustum m_frustum;
+		uint32_t m_drawCallCount = 0;
+		float m_recordingMs = 0.f;
+
+		//one slice per recording thread, the first one clears the attachment and the last one draws batches and streams,
+		//run as a parallel task on the pool
+		bool RecordSecondaryCommandBuffers(VkCommandBuffer& commandBuffer);
+		void RecordSlice(uint32_t slice);
+		//slices for every frame slot, recreated when the thread count changed
+		bool CreateRecordingSlices(uint32_t sliceCount, uint32_t frameCount);
+		void DestroyRecordingSlices();
+		ThreadPool* m_threadPool = nullptr;
+		uint32_t m_recordingThreadCount = 1;
+		//sliceCount slices of the first frame slot, then of the second one and so on
+		std::vector<RecordingSlice> m_recordingSlices;
+		uint32_t m_recordingSliceCount = 0;
+		TaskGraph m_recordingGraph;
+		//what the slices of the current frame record into and inherit
+		const RecordingSlice* m_recordingFrameSlices = nullptr;
+		VkCommandBufferInheritanceInfo m_recordingInheritance;
+		//no logging on the workers, failures are counted and reported afterwards
+		std::atomic<uint32_t> m_failedSlices{ 0 };
+		std::vector<uint32_t> m_sliceDrawCallCounts;
+		Swapchain* m_swapchain = nullptr;
 
 
 		//---------------------------------------
@@ -55,7 +204,8 @@ namespace MelonRenderer
 		Camera* m_camera;
 		Scene* m_scene;
 
-		SceneInfo m_pushConstants;
+		bool m_rasterizeScene = true;
+		VkClearValue m_colorClearValue;
 
 
 		VkAttachmentReference m_depthAttachmentReference;
@@ -70,6 +220,23 @@ namespace MelonRenderer
 		VkFormat m_depthBufferFormat = VK_FORMAT_D32_SFLOAT; 
 		bool CreateDepthBuffer();
 		bool CleanupDepthBuffer();
+
+		//G-buffer, shares the depth buffer with the main renderpass
+		bool CreateGBufferRenderpass();
+		bool CreateGBuffer();
+		bool CleanupGBuffer();
+		VkRenderPass m_gbufferRenderpass = VK_NULL_HANDLE;
+		VkFramebuffer m_gbufferFramebuffer = VK_NULL_HANDLE;
+		VkPipeline m_gbufferPipeline = VK_NULL_HANDLE;
+		std::vector<VkPipelineShaderStageCreateInfo> m_gbufferShaderStages;
+		VkImage m_gbufferNormalDistance;
+		VkImageView m_gbufferNormalDistanceView;
+		VkDeviceMemory m_gbufferNormalDistanceMemory;
+		VkImage m_gbufferMaterial;
+		VkImageView m_gbufferMaterialView;
+		VkDeviceMemory m_gbufferMaterialMemory;
+		VkFormat m_gbufferNormalDistanceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		VkFormat m_gbufferMaterialFormat = VK_FORMAT_R32G32B32A32_UINT;
 		//---------------------------------------
 	};
 }
\ No newline at end of file
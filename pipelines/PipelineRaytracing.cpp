@@ -16,20 +16,20 @@ namespace MelonRenderer
 		CreateBLAS();
 
 		CreateTLAS();
+		CreateTimestampQueryPool();
 
 		CreateStorageImage();
+		CreateBlueNoiseBuffer();
+		CreateRayCounterBuffer();
 
 		CreatePipelineLayout();
 		CreateDescriptorPool();
 		CreateDescriptorSets();
-
-		CreateShaderModules();
-		CreateGraphicsPipeline();
-		CreateShaderBindingTable();
 	}
 
 	void PipelineRaytracing::Tick(VkCommandBuffer& commandBuffer)
 	{
+		RecordTLASUpdate(commandBuffer);
 		Draw(commandBuffer);
 	}
 
@@ -37,34 +37,237 @@ namespace MelonRenderer
 	{
 	}
 
+	bool PipelineRaytracing::Compile()
+	{
+		return Pipeline::Compile() && CreateShaderBindingTable();
+	}
+
 	void PipelineRaytracing::FillRenderpassInfo(Renderpass* renderpass)
 	{
 	}
 
 	void PipelineRaytracing::RecreateOutput(VkExtent2D& windowExtent)
 	{
+		//the renderer sets the recreated G-buffer before this
 		m_extent = windowExtent;
 
 		CleanupStorageImage();
 		CreateStorageImage();
+		UpdateStorageImageDescriptors();
+	}
 
-		VkDescriptorImageInfo storageImageDescriptor;
-		storageImageDescriptor.imageView = m_storageImageView;
-		storageImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		storageImageDescriptor.sampler = VK_NULL_HANDLE;
+	bool PipelineRaytracing::UpdateStorageImageDescriptors()
+	{
+		//output, accumulation, the denoiser features, the G-buffer and the moments for adaptive sampling
+		std::vector<VkImageView> imageViews = { m_storageImageView, m_accumulationImageView, m_featureImageView, m_albedoImageView, m_motionImageView,
+			m_gbuffer.m_normalDistance, m_gbuffer.m_material, m_momentsImageView };
+		std::vector<uint32_t> bindings = { 1, 8, 10, 11, 12, 13, 14, 16 };
 
-		VkWriteDescriptorSet resultWriteImageDescriptorSet;
-		resultWriteImageDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		resultWriteImageDescriptorSet.pNext = nullptr;
-		resultWriteImageDescriptorSet.dstSet = m_descriptorSets[0];
-		resultWriteImageDescriptorSet.descriptorCount = 1;
-		resultWriteImageDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-		resultWriteImageDescriptorSet.pBufferInfo = nullptr;
-		resultWriteImageDescriptorSet.pImageInfo = &storageImageDescriptor;
-		resultWriteImageDescriptorSet.dstArrayElement = 0;
-		resultWriteImageDescriptorSet.dstBinding = 1;
+		std::vector<VkDescriptorImageInfo> imageDescriptors(imageViews.size());
+		for (int i = 0; i < imageDescriptors.size(); i++)
+		{
+			imageDescriptors[i].imageView = imageViews[i];
+			imageDescriptors[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageDescriptors[i].sampler = VK_NULL_HANDLE;
+		}
+
+		std::vector<VkWriteDescriptorSet> writes(imageDescriptors.size());
+		for (int i = 0; i < writes.size(); i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].pNext = nullptr;
+			writes[i].dstSet = m_descriptorSets[0];
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[i].pBufferInfo = nullptr;
+			writes[i].pImageInfo = &imageDescriptors[i];
+			writes[i].dstArrayElement = 0;
+			writes[i].dstBinding = bindings[i];
+		}
+
+		vkUpdateDescriptorSets(Device::Get().m_device, writes.size(), writes.data(), 0, nullptr);
+
+		return true;
+	}
+
+	void PipelineRaytracing::SetSampler(SamplerType sampler)
+	{
+		m_settings.m_sampler = sampler;
+	}
+
+	void PipelineRaytracing::SetSamplesPerFrame(int samples)
+	{
+		m_settings.m_numberOfSamples = samples;
+	}
+
+	void PipelineRaytracing::SetLightRadius(float radius)
+	{
+		m_settings.m_lightRadius = radius;
+	}
+
+	void PipelineRaytracing::SetAdaptiveSampling(bool adaptive, float threshold, int maxSamples, float budget)
+	{
+		m_settings.m_adaptive = adaptive;
+		m_settings.m_adaptiveThreshold = threshold;
+		m_settings.m_adaptiveMaxSamples = maxSamples;
+		m_settings.m_adaptiveBudget = budget;
+	}
+
+	void PipelineRaytracing::SetAccumulate(bool accumulate)
+	{
+		m_settings.m_accumulate = accumulate;
+	}
+
+	void PipelineRaytracing::ResetAccumulation()
+	{
+		m_resetAccumulation = true;
+	}
+
+	uint32_t PipelineRaytracing::GetAccumulatedFrames() const
+	{
+		return m_accumulatedFrames;
+	}
+
+	RaytracingStats PipelineRaytracing::GetStats() const
+	{
+		RaytracingStats stats;
+		stats.m_accumulatedFrames = m_accumulatedFrames;
+		stats.m_blasCount = static_cast<uint32_t>(m_blasVector.size());
+		stats.m_blasBuildBatchCount = m_blasBuildBatchCount;
+		stats.m_blasBuildTimeGPU = m_blasBuildTimeGPU;
+		stats.m_blasBuildTimeCPU = m_blasBuildTimeCPU;
+		stats.m_tlasUpdateTime = m_tlasUpdateTime;
+		stats.m_tlasUpdateTimeAverage = m_tlasUpdateTimeAverage;
+		stats.m_tlasRefitCount = m_tlasRefitCount;
+		stats.m_tlasRebuildCount = m_tlasRebuildCount;
+		stats.m_tlasDegradation = m_tlasDegradation;
+		stats.m_rayCounts = m_rayCounts;
+		stats.m_pixelCount = m_extent.width * m_extent.height;
+		return stats;
+	}
+
+	const RaytracingSettings& PipelineRaytracing::GetSettings() const
+	{
+		return m_settings;
+	}
+
+	void PipelineRaytracing::SetSettings(const RaytracingSettings& settings)
+	{
+		//the other settings are compared with the accumulated ones by Draw
+		if (settings.m_accumulate != m_settings.m_accumulate)
+			m_resetAccumulation = true;
+		m_settings = settings;
+	}
+
+	bool PipelineRaytracing::DrawSettings(RaytracingSettings& settings, const RaytracingStats& stats)
+	{
+		bool changed = false;
+		ImGui::Begin("Scene");
+
+		changed |= ImGui::ColorEdit3("clear value", &settings.m_clearColor[0]);
+		changed |= ImGui::InputFloat3("light position", &settings.m_lightPosition[0]);
+		changed |= ImGui::SliderFloat("light intensity", &settings.m_lightIntensity, 0.f, 10.f);
+		changed |= ImGui::SliderInt("number of samples", &settings.m_numberOfSamples, 1, 80);
+		changed |= ImGui::Combo("sampler", &settings.m_sampler, samplerNames, SAMPLER_COUNT);
+		changed |= ImGui::SliderFloat("light radius", &settings.m_lightRadius, 0.f, 20.f);
+		changed |= ImGui::Checkbox("accumulate", &settings.m_accumulate);
+		ImGui::SameLine();
+		ImGui::Text("%u frames", stats.m_accumulatedFrames);
+		ImGui::Text("BLAS: %u in %u batches, %.3f ms GPU, %.3f ms CPU", stats.m_blasCount, stats.m_blasBuildBatchCount, stats.m_blasBuildTimeGPU, stats.m_blasBuildTimeCPU);
+		changed |= ImGui::SliderFloat("TLAS rebuild threshold", &settings.m_tlasRebuildThreshold, 1.f, 10.f);
+		ImGui::Text("TLAS update: %.3f ms (avg %.3f ms)", stats.m_tlasUpdateTime, stats.m_tlasUpdateTimeAverage);
+		ImGui::Text("TLAS refits: %u, rebuilds: %u, degradation: %.2f", stats.m_tlasRefitCount, stats.m_tlasRebuildCount, stats.m_tlasDegradation);
+		changed |= ImGui::Checkbox("adaptive sampling", &settings.m_adaptive);
+		if (settings.m_adaptive)
+		{
+			changed |= ImGui::SliderFloat("adaptive threshold", &settings.m_adaptiveThreshold, 0.005f, 0.5f, "%.3f");
+			changed |= ImGui::SliderInt("adaptive max samples", &settings.m_adaptiveMaxSamples, 1, 64);
+			changed |= ImGui::SliderFloat("adaptive budget (spp)", &settings.m_adaptiveBudget, 0.f, 16.f);
+			changed |= ImGui::Checkbox("sample heatmap", &settings.m_heatmap);
+			if (!settings.m_accumulate)
+				ImGui::Text("needs accumulation");
+		}
+		changed |= ImGui::Checkbox("count rays", &settings.m_countRays);
+		if (settings.m_countRays)
+		{
+			float pixels = static_cast<float>(stats.m_pixelCount);
+			ImGui::Text("rays per pixel: %.2f primary, %.2f shadow, %.2f reflection", stats.m_rayCounts.m_primary / pixels, stats.m_rayCounts.m_shadow / pixels,
+				stats.m_rayCounts.m_reflection / pixels);
+		}
+
+		ImGui::End();
+		return changed;
+	}
+
+	bool PipelineRaytracing::ReadAccumulationImage(std::vector<vec4>& pixels)
+	{
+		pixels.resize(m_extent.width * m_extent.height);
+		return m_memoryManager->ReadImage(m_accumulationImage, m_extent, sizeof(vec4), pixels.data());
+	}
 
-		vkUpdateDescriptorSets(Device::Get().m_device, 1, &resultWriteImageDescriptorSet, 0, nullptr);
+	bool PipelineRaytracing::ReadStorageImage(std::vector<uint32_t>& pixels)
+	{
+		pixels.resize(m_extent.width * m_extent.height);
+		return m_memoryManager->ReadImage(m_storageImage, m_extent, sizeof(uint32_t), pixels.data());
+	}
+
+	void PipelineRaytracing::SetGBuffer(const GBuffer& gbuffer)
+	{
+		m_gbuffer = gbuffer;
+	}
+
+	void PipelineRaytracing::SetHybrid(bool hybrid)
+	{
+		if (m_hybrid != hybrid)
+			m_resetAccumulation = true;
+		m_hybrid = hybrid;
+	}
+
+	void PipelineRaytracing::SetCountRays(bool countRays)
+	{
+		m_settings.m_countRays = countRays;
+	}
+
+	bool PipelineRaytracing::ReadRayCounts(RayCounts& rayCounts)
+	{
+		//the slot of the last recorded frame
+		vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+		memcpy(&rayCounts, static_cast<uint8_t*>(m_rayCounterData) + m_frameIndex * m_rayCounterStride, sizeof(RayCounts));
+
+		return true;
+	}
+
+	bool PipelineRaytracing::CreateRayCounterBuffer()
+	{
+		m_rayCounterStride = AlignUp(sizeof(RayCounts), m_memoryManager->GetPhysicalDeviceProperties().limits.minStorageBufferOffsetAlignment);
+		const VkDeviceSize bufferSize = m_rayCounterStride * maxFramesInFlight;
+		if (!m_memoryManager->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_rayCounterBuffer, m_rayCounterBufferMemory))
+		{
+			Logger::Log("Could not create ray counter buffer.");
+			return false;
+		}
+
+		if (vkMapMemory(Device::Get().m_device, m_rayCounterBufferMemory, 0, bufferSize, 0, &m_rayCounterData) != VK_SUCCESS)
+		{
+			Logger::Log("Could not map ray counter buffer.");
+			return false;
+		}
+		memset(m_rayCounterData, 0, bufferSize);
+
+		return true;
+	}
+
+	RaytracingOutputs PipelineRaytracing::GetOutputs() const
+	{
+		RaytracingOutputs outputs;
+		outputs.m_color = m_accumulationImageView;
+		outputs.m_features = m_featureImageView;
+		outputs.m_albedo = m_albedoImageView;
+		outputs.m_motion = m_motionImageView;
+		outputs.m_output = m_storageImageView;
+
+		return outputs;
 	}
 
 	void PipelineRaytracing::SetCamera(Camera* camera)
@@ -77,9 +280,11 @@ namespace MelonRenderer
 		m_scene = scene;
 	}
 
-	void PipelineRaytracing::SetRaytracingProperties(VkPhysicalDeviceRayTracingPropertiesNV* raytracingProperties)
+	void PipelineRaytracing::SetRaytracingProperties(VkPhysicalDeviceRayTracingPipelinePropertiesKHR* raytracingProperties, 
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR* accelerationStructureProperties)
 	{
 		m_raytracingProperties = raytracingProperties;
+		m_accelerationStructureProperties = accelerationStructureProperties;
 	}
 
 	VkImage PipelineRaytracing::GetStorageImage()
@@ -87,73 +292,125 @@ namespace MelonRenderer
 		return m_storageImage;
 	}
 
-	bool PipelineRaytracing::ConvertToGeometryNV(std::vector<VkGeometryNV>& target, uint32_t drawableHandle)
+	bool PipelineRaytracing::CreateAccelerationStructure(VkAccelerationStructureTypeKHR type, VkDeviceSize size, AccelerationStructure& accelerationStructure)
 	{
-		Drawable* drawable = &m_scene->m_drawables[drawableHandle];
+		if (!m_memoryManager->CreateBuffer(size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, accelerationStructure.m_buffer, accelerationStructure.m_memory))
+		{
+			Logger::Log("Could not create buffer for acceleration structure.");
+			return false;
+		}
 
-		VkGeometryTrianglesNV triangles = {};
-		triangles.sType = VK_STRUCTURE_TYPE_GEOMETRY_TRIANGLES_NV;
-		triangles.pNext = nullptr;
-		triangles.vertexData = drawable->m_vertexBuffer;
-		triangles.vertexOffset = 0;
-		triangles.vertexCount = drawable->m_vertexCount;
-		triangles.vertexStride = sizeof(Vertex);
-		triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; //are the vertices defined correctly for this struct?
-		triangles.indexData = drawable->m_indexBuffer;
-		triangles.indexOffset = 0;
-		triangles.indexCount = drawable->m_indexCount;
-		triangles.indexType = VK_INDEX_TYPE_UINT32;
-		//no transform data for dynamic objects currently
+		VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo = {};
+		accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		accelerationStructureCreateInfo.pNext = nullptr;
+		accelerationStructureCreateInfo.createFlags = 0;
+		accelerationStructureCreateInfo.buffer = accelerationStructure.m_buffer;
+		accelerationStructureCreateInfo.offset = 0;
+		accelerationStructureCreateInfo.size = size;
+		accelerationStructureCreateInfo.type = type;
+		accelerationStructureCreateInfo.deviceAddress = 0;
+
+		VkResult result = vkCreateAccelerationStructureKHR(Device::Get().m_device, &accelerationStructureCreateInfo, nullptr, &accelerationStructure.m_accelerationStructure);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create acceleration structure.");
+			return false;
+		}
 
-		VkGeometryDataNV geoData = {};
-		geoData.triangles = triangles;
-		geoData.aabbs = {};
-		geoData.aabbs.sType = VK_STRUCTURE_TYPE_GEOMETRY_AABB_NV;
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = accelerationStructure.m_accelerationStructure;
+		accelerationStructure.m_deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(Device::Get().m_device, &addressInfo);
+		accelerationStructure.m_size = size;
 
-		VkGeometryNV geometry;
-		geometry.sType = VK_STRUCTURE_TYPE_GEOMETRY_NV;
-		geometry.pNext = nullptr;
-		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_NV;
-		geometry.geometry = geoData;
-		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_NV;
+		return true;
+	}
+
+	void PipelineRaytracing::DestroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+	{
+		vkDestroyAccelerationStructureKHR(Device::Get().m_device, accelerationStructure.m_accelerationStructure, nullptr);
+		vkDestroyBuffer(Device::Get().m_device, accelerationStructure.m_buffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, accelerationStructure.m_memory, nullptr);
+
+		accelerationStructure = AccelerationStructure();
+	}
 
-		target.push_back(geometry);
+	bool PipelineRaytracing::CreateScratchBuffer(VkDeviceSize size, VkBuffer& scratchBuffer, VkDeviceMemory& scratchBufferMemory, VkDeviceAddress& scratchAddress)
+	{
+		//scratch addresses have to respect the minimum alignment, allocate enough to align the start
+		VkDeviceSize alignment = m_accelerationStructureProperties->minAccelerationStructureScratchOffsetAlignment;
+		if (!m_memoryManager->CreateBuffer(size + alignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratchBuffer, scratchBufferMemory))
+		{
+			Logger::Log("Could not create scratch buffer for acceleration structure.");
+			return false;
+		}
+		scratchAddress = AlignUp(m_memoryManager->GetBufferDeviceAddress(scratchBuffer), alignment);
+
+		return true;
+	}
+
+	bool PipelineRaytracing::ReserveBLASScratchPool(VkDeviceSize size)
+	{
+		if (size <= m_blasScratchPoolSize)
+			return true;
+
+		vkDestroyBuffer(Device::Get().m_device, m_blasScratchPool, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_blasScratchPoolMemory, nullptr);
+		m_blasScratchPoolSize = 0;
+
+		if (!CreateScratchBuffer(size, m_blasScratchPool, m_blasScratchPoolMemory, m_blasScratchPoolAddress))
+		{
+			return false;
+		}
+		m_blasScratchPoolSize = size;
 
 		return true;
 	}
 
-	bool PipelineRaytracing::ConvertToGeometryNV(std::vector<VkGeometryNV>& target, uint32_t drawableHandle, uint32_t instanceHandle)
+	bool PipelineRaytracing::ConvertToGeometry(uint32_t drawableHandle)
 	{
 		Drawable* drawable = &m_scene->m_drawables[drawableHandle];
 
-		VkGeometryTrianglesNV triangles = {};
-		triangles.sType = VK_STRUCTURE_TYPE_GEOMETRY_TRIANGLES_NV;
+		VkAccelerationStructureGeometryTrianglesDataKHR triangles = {};
+		triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
 		triangles.pNext = nullptr;
-		triangles.vertexData =  drawable->m_vertexBuffer;
-		triangles.vertexOffset = 0;
-		triangles.vertexCount = drawable->m_vertexCount;
+		triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		triangles.vertexData.deviceAddress = m_memoryManager->GetBufferDeviceAddress(drawable->m_vertexBuffer);
 		triangles.vertexStride = sizeof(Vertex);
-		triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; //are the vertices defined correctly for this struct?
-		triangles.indexData = drawable->m_indexBuffer;
-		triangles.indexOffset = 0;
-		triangles.indexCount = drawable->m_indexCount;
+		triangles.maxVertex = drawable->m_vertexCount - 1;
 		triangles.indexType = VK_INDEX_TYPE_UINT32;
-		triangles.transformData = m_sceneBuffer;
-		triangles.transformOffset = instanceHandle * sizeof(DrawableInstance) + sizeof(uint32_t) * 2; 
-		
-		VkGeometryDataNV geoData = {};
-		geoData.triangles = triangles;
-		geoData.aabbs = {};
-		geoData.aabbs.sType = VK_STRUCTURE_TYPE_GEOMETRY_AABB_NV;
+		triangles.indexData.deviceAddress = m_memoryManager->GetBufferDeviceAddress(drawable->m_indexBuffer);
+		//no transform data for dynamic objects, they are placed by their instance
+		triangles.transformData.deviceAddress = 0;
 
-		VkGeometryNV geometry;
-		geometry.sType = VK_STRUCTURE_TYPE_GEOMETRY_NV;
+		VkAccelerationStructureGeometryKHR geometry = {};
+		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
 		geometry.pNext = nullptr;
-		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_NV;
-		geometry.geometry = geoData;
-		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_NV;
+		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		geometry.geometry.triangles = triangles;
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
 
-		target.push_back(geometry);
+		VkAccelerationStructureBuildRangeInfoKHR buildRange = {};
+		buildRange.primitiveCount = drawable->m_indexCount / 3;
+		buildRange.primitiveOffset = 0;
+		buildRange.firstVertex = 0;
+		buildRange.transformOffset = 0;
+
+		m_rtGeometries.back().emplace_back(geometry);
+		m_rtBuildRanges.back().emplace_back(buildRange);
+
+		return true;
+	}
+
+	bool PipelineRaytracing::ConvertToGeometry(uint32_t drawableHandle, uint32_t staticTransformIndex)
+	{
+		if (!ConvertToGeometry(drawableHandle))
+			return false;
+
+		m_rtGeometries.back().back().geometry.triangles.transformData.deviceAddress = m_memoryManager->GetBufferDeviceAddress(m_staticTransformBuffer);
+		m_rtBuildRanges.back().back().transformOffset = staticTransformIndex * sizeof(VkTransformMatrixKHR);
 
 		return true;
 	}
@@ -162,6 +419,12 @@ namespace MelonRenderer
 	{
 		m_dynamicDrawableInstances.clear();
 		m_staticDrawableInstances.resize(0);
+		m_rtGeometries.resize(0);
+		m_rtBuildRanges.resize(0);
+		m_blasInstances.resize(0);
+		m_blasInstanceBLASIndices.resize(0);
+		m_blasInstanceSceneHandles.resize(0);
+		m_shaderBindingGeometryIDs.resize(0);
 
 		for (int i = 0; i < m_scene->m_drawableInstances.size(); i++)
 		{
@@ -181,58 +444,120 @@ namespace MelonRenderer
 			}
 		}
 
-		//TODO: check if this should be 1 when using static blas
-		uint32_t blasInstanceId = 0; //not used in shader currently
+		//instance streams use the BLAS of their drawable as well
+		const std::vector<InstanceStream>& instanceStreams = m_scene->GetInstanceStreams();
+		for (const InstanceStream& instanceStream : instanceStreams)
+		{
+			if (!instanceStream.m_instances.empty() && m_dynamicDrawableInstances.find(instanceStream.m_drawableIndex) == m_dynamicDrawableInstances.end())
+				m_dynamicDrawableInstances.emplace(instanceStream.m_drawableIndex, std::vector<uint32_t>());
+		}
+
+		//the custom index is the material override of compact instances plus one, 0 keeps the vertices' materials
+		const uint32_t noMaterialOverride = 0;
 		uint32_t instanceOffset = 0; //for the shader binding table to correctly assign entries
-		uint64_t blasId = 0; //to be able to assign handles to the correct instances
+		uint32_t blasId = 0; //to be able to assign handles to the correct instances
 
 		if (m_staticDrawableInstances.size())
 		{
-			std::vector<VkGeometryNV> staticGeometry;
+			if (!CreateStaticTransformBuffer())
+				return false;
 
-			for (uint32_t instanceHandle : m_staticDrawableInstances)
+			//all static instances share one BLAS, one geometry per instance with its transform baked in
+			m_rtGeometries.emplace_back();
+			m_rtBuildRanges.emplace_back();
+			for (uint32_t i = 0; i < m_staticDrawableInstances.size(); i++)
 			{
-				ConvertToGeometryNV(staticGeometry, m_scene->m_drawableInstances[instanceHandle].m_drawableIndex, instanceHandle);
+				uint32_t instanceHandle = m_staticDrawableInstances[i];
+				ConvertToGeometry(m_scene->m_drawableInstances[instanceHandle].m_drawableIndex, i);
 
 				m_shaderBindingGeometryIDs.emplace_back(instanceHandle);
 				instanceOffset++;
 			}
-			m_rtGeometries.emplace_back(staticGeometry);
-
 
 			BLASInstance blasInstance;
 			blasInstance.m_transform = mat3x4(1.f);
-			blasInstance.m_instanceId = blasInstanceId++;
+			blasInstance.m_instanceId = noMaterialOverride;
 			blasInstance.m_mask = 0xff;
 			blasInstance.m_instanceOffset = 0;
-			blasInstance.m_flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV;
-			blasInstance.m_accelerationStructureHandle = blasId++; //set to handle after blas creation
+			blasInstance.m_flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			blasInstance.m_accelerationStructureHandle = 0; //set to device address after blas creation
 
 			m_blasInstances.emplace_back(blasInstance);
+			m_blasInstanceBLASIndices.emplace_back(blasId++);
+			m_blasInstanceSceneHandles.emplace_back(UINT32_MAX);
 		}
 
-		
+		std::unordered_map<uint32_t, uint32_t> drawableBLASIndices;
 		for (const auto& dynamicDrawableInstances : m_dynamicDrawableInstances)
 		{
-			std::vector<VkGeometryNV> dynamicGeometry;
-
+			drawableBLASIndices[dynamicDrawableInstances.first] = blasId;
 			for (uint32_t instanceHandle : dynamicDrawableInstances.second) 
 			{
 				BLASInstance blasInstance;
-				blasInstance.m_transform = m_scene->m_drawableInstances[instanceHandle].m_transformation;
-				blasInstance.m_instanceId = blasInstanceId++;
+				blasInstance.m_transform = m_scene->m_drawableInstances[instanceHandle].m_transformation.ToMat3x4();
+				blasInstance.m_instanceId = noMaterialOverride;
 				blasInstance.m_mask = 0xff;
 				blasInstance.m_instanceOffset = instanceOffset++;
-				blasInstance.m_flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV;
-				blasInstance.m_accelerationStructureHandle = blasId; //set to handle after blas creation
+				blasInstance.m_flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+				blasInstance.m_accelerationStructureHandle = 0; //set to device address after blas creation
 
 				m_shaderBindingGeometryIDs.emplace_back(instanceHandle);
 				m_blasInstances.emplace_back(blasInstance);
+				m_blasInstanceBLASIndices.emplace_back(blasId);
+				m_blasInstanceSceneHandles.emplace_back(instanceHandle);
 			}
 
 			blasId++;
-			ConvertToGeometryNV(dynamicGeometry, dynamicDrawableInstances.first);
-			m_rtGeometries.emplace_back(dynamicGeometry);
+			m_rtGeometries.emplace_back();
+			m_rtBuildRanges.emplace_back();
+			ConvertToGeometry(dynamicDrawableInstances.first);
+		}
+
+		//every copy is a TLAS instance, all copies of a stream share one hit group entry,
+		//whose scene buffer element behind the instances holds the stream's drawable
+		for (uint32_t s = 0; s < instanceStreams.size(); s++)
+		{
+			const InstanceStream& instanceStream = instanceStreams[s];
+			if (instanceStream.m_instances.empty())
+				continue;
+
+			m_shaderBindingGeometryIDs.emplace_back(static_cast<uint32_t>(m_scene->m_drawableInstances.size() + s));
+			const uint32_t streamInstanceOffset = instanceOffset++;
+			const uint32_t streamBLASIndex = drawableBLASIndices[instanceStream.m_drawableIndex];
+			for (const CompactInstance& compactInstance : instanceStream.m_instances)
+			{
+				BLASInstance blasInstance;
+				blasInstance.m_transform = UnpackTransform(compactInstance).ToMat3x4();
+				blasInstance.m_instanceId = compactInstance.m_materialOverride == CompactInstance::m_noMaterialOverride ? noMaterialOverride :
+					compactInstance.m_materialOverride + 1;
+				blasInstance.m_mask = 0xff;
+				blasInstance.m_instanceOffset = streamInstanceOffset;
+				blasInstance.m_flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+				blasInstance.m_accelerationStructureHandle = 0; //set to device address after blas creation
+
+				m_blasInstances.emplace_back(blasInstance);
+				m_blasInstanceBLASIndices.emplace_back(streamBLASIndex);
+				m_blasInstanceSceneHandles.emplace_back(UINT32_MAX);
+			}
+		}
+
+		return true;
+	}
+
+	bool PipelineRaytracing::CreateStaticTransformBuffer()
+	{
+		std::vector<VkTransformMatrixKHR> staticTransforms(m_staticDrawableInstances.size());
+		for (int i = 0; i < m_staticDrawableInstances.size(); i++)
+		{
+			//VkTransformMatrixKHR is a row major 3x4 matrix, the same layout as AffineTransform
+			memcpy(&staticTransforms[i], &m_scene->m_drawableInstances[m_staticDrawableInstances[i]].m_transformation, sizeof(VkTransformMatrixKHR));
+		}
+
+		if (!m_memoryManager->CreateOptimalBuffer(m_staticTransformBuffer, m_staticTransformBufferMemory, staticTransforms.data(),
+			staticTransforms.size() * sizeof(VkTransformMatrixKHR), m_memoryManager->GetAccelerationStructureInputUsage()))
+		{
+			Logger::Log("Could not create buffer for static instance transforms.");
+			return false;
 		}
 
 		return true;
@@ -240,276 +565,489 @@ namespace MelonRenderer
 
 	bool PipelineRaytracing::CreateBLAS()
 	{
-		VkResult result;
 		VkDeviceSize maxScratchSize = 0;
-		uint64_t blasId = 0;
+		m_blasSizeUncompacted = 0;
 
 		m_blasVector.resize(m_rtGeometries.size());
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(m_blasVector.size());
+		std::vector<VkDeviceSize> scratchSizes(m_blasVector.size());
 		for (int i = 0; i < m_blasVector.size(); i++)
 		{
-			BLAS& blas = m_blasVector[i];
-
-			blas.m_accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV;
-			blas.m_accelerationStructureInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_NV; 
-			blas.m_accelerationStructureInfo.geometryCount = m_rtGeometries[i].size();
-			blas.m_accelerationStructureInfo.pGeometries = m_rtGeometries[i].data();
-			blas.m_accelerationStructureInfo.instanceCount = 0;
-
-			VkAccelerationStructureCreateInfoNV accelerationStructureCreateInfo;
-			accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
-			accelerationStructureCreateInfo.pNext = nullptr;
-			accelerationStructureCreateInfo.compactedSize = 0;
-			accelerationStructureCreateInfo.info = blas.m_accelerationStructureInfo;
-
-			result = vkCreateAccelerationStructureNV(Device::Get().m_device, &accelerationStructureCreateInfo, nullptr, &blas.m_accelerationStructure);
-			if (result != VK_SUCCESS)
+			VkAccelerationStructureBuildGeometryInfoKHR& buildInfo = buildInfos[i];
+			buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+			buildInfo.pNext = nullptr;
+			buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+			buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			buildInfo.srcAccelerationStructure = VK_NULL_HANDLE;
+			buildInfo.geometryCount = m_rtGeometries[i].size();
+			buildInfo.pGeometries = m_rtGeometries[i].data();
+			buildInfo.ppGeometries = nullptr;
+
+			std::vector<uint32_t> maxPrimitiveCounts;
+			for (const auto& buildRange : m_rtBuildRanges[i])
 			{
-				Logger::Log("Could not create bottom level acceleration structure.");
-				return false;
+				maxPrimitiveCounts.emplace_back(buildRange.primitiveCount);
 			}
 
-			VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo;
-			memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-			memoryRequirementsInfo.pNext = nullptr;
-			memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_NV;
-			memoryRequirementsInfo.accelerationStructure = blas.m_accelerationStructure;
-
-			VkMemoryRequirements2 memoryRequirements2 = {};
-			vkGetAccelerationStructureMemoryRequirementsNV(Device::Get().m_device, &memoryRequirementsInfo, &memoryRequirements2);
-
-			VkMemoryAllocateInfo memoryAllocateInfo;
-			memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			memoryAllocateInfo.pNext = nullptr;
-			memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-			m_memoryManager->FindMemoryTypeFromProperties(memoryRequirements2.memoryRequirements.memoryTypeBits,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocateInfo.memoryTypeIndex);
-			result = vkAllocateMemory(Device::Get().m_device, &memoryAllocateInfo, nullptr, &blas.m_accelerationStructureMemory);
-			if (result != VK_SUCCESS)
-			{
-				Logger::Log("Could not allocate memory for bottom level acceleration structure.");
-				return false;
-			}
+			VkAccelerationStructureBuildSizesInfoKHR buildSizes = {};
+			buildSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			vkGetAccelerationStructureBuildSizesKHR(Device::Get().m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, 
+				maxPrimitiveCounts.data(), &buildSizes);
 
-			VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo;
-			accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
-			accelerationStructureMemoryInfo.pNext = nullptr;
-			accelerationStructureMemoryInfo.accelerationStructure = blas.m_accelerationStructure;
-			accelerationStructureMemoryInfo.memory = blas.m_accelerationStructureMemory;
-			accelerationStructureMemoryInfo.memoryOffset = 0;
-			accelerationStructureMemoryInfo.deviceIndexCount = 0;
-			accelerationStructureMemoryInfo.pDeviceIndices = nullptr;
-			result = vkBindAccelerationStructureMemoryNV(Device::Get().m_device, 1, &accelerationStructureMemoryInfo);
-			if (result != VK_SUCCESS)
+			if (!CreateAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildSizes.accelerationStructureSize, m_blasVector[i]))
 			{
-				Logger::Log("Could not bind memory for bottom level acceleration structure.");
+				Logger::Log("Could not create bottom level acceleration structure.");
 				return false;
 			}
+			buildInfo.dstAccelerationStructure = m_blasVector[i].m_accelerationStructure;
 
-			result = vkGetAccelerationStructureHandleNV(Device::Get().m_device, blas.m_accelerationStructure, sizeof(uint64_t), &blas.m_handle);
-			if (result != VK_SUCCESS)
-			{
-				Logger::Log("Could not get handle for bottom level acceleration structure.");
-				return false;
-			}
+			m_blasSizeUncompacted += buildSizes.accelerationStructureSize;
+			scratchSizes[i] = buildSizes.buildScratchSize;
+		}
 
-			for (BLASInstance& blasInstance : m_blasInstances)
-			{
-				if (blasInstance.m_accelerationStructureHandle == blasId)
-					blasInstance.m_accelerationStructureHandle = blas.m_handle;
-			}
-			blasId++;
+		//builds within one batch run concurrently on disjoint partitions of the scratch pool
+		VkDeviceSize scratchAlignment = m_accelerationStructureProperties->minAccelerationStructureScratchOffsetAlignment;
+		VkDeviceSize totalScratchSize = 0;
+		for (int i = 0; i < m_blasVector.size(); i++)
+		{
+			scratchSizes[i] = AlignUp(scratchSizes[i], scratchAlignment);
+			totalScratchSize += scratchSizes[i];
+			if (scratchSizes[i] > maxScratchSize)
+				maxScratchSize = scratchSizes[i];
+		}
+		VkDeviceSize scratchPoolSize = totalScratchSize < m_blasScratchBudget ? totalScratchSize : m_blasScratchBudget;
+		if (scratchPoolSize < maxScratchSize)
+			scratchPoolSize = maxScratchSize;
+		if (!ReserveBLASScratchPool(scratchPoolSize))
+		{
+			Logger::Log("Could not create scratch buffer for bottom level acceleration structure.");
+			return false;
+		}
 
-			VkAccelerationStructureMemoryRequirementsInfoNV scratchMemoryRequirementsInfo{};
-			scratchMemoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-			scratchMemoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_NV;
-			scratchMemoryRequirementsInfo.accelerationStructure = m_tlas.m_accelerationStructure;
+		//compacted sizes are only known after the build, they are written into this query pool
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+		queryPoolCreateInfo.queryCount = m_blasVector.size();
 
-			VkMemoryRequirements2 memoryRequirementScratchBLAS;
-			vkGetAccelerationStructureMemoryRequirementsNV(Device::Get().m_device, &memoryRequirementsInfo, &memoryRequirementScratchBLAS);
-			if (memoryRequirementScratchBLAS.memoryRequirements.size > maxScratchSize)
-				maxScratchSize = memoryRequirementScratchBLAS.memoryRequirements.size;
+		VkQueryPool compactedSizeQueryPool;
+		VkResult result = vkCreateQueryPool(Device::Get().m_device, &queryPoolCreateInfo, nullptr, &compactedSizeQueryPool);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create query pool for compacted acceleration structure sizes.");
+			return false;
 		}
 
-		//simple scratch buffer approach, can be expanded to build several acceleration structures simultaneously
-		//TODO: look at compaction to reduce memory footprint
-		VkBuffer scratchBuffer;
-		VkDeviceMemory scratchBufferMemory;
-		if (!m_memoryManager->CreateBuffer(maxScratchSize, VK_BUFFER_USAGE_RAY_TRACING_BIT_NV, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratchBuffer, scratchBufferMemory))
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = 2;
+		VkQueryPool buildTimeQueryPool;
+		result = vkCreateQueryPool(Device::Get().m_device, &queryPoolCreateInfo, nullptr, &buildTimeQueryPool);
+		if (result != VK_SUCCESS)
 		{
-			Logger::Log("Could not create scratch buffer for bottom level acceleration structure.");
+			Logger::Log("Could not create query pool for acceleration structure build time.");
 			return false;
 		}
 
+		auto buildStart = std::chrono::high_resolution_clock::now();
+
 		VkCommandBuffer buildBLASCmdBuffer;
 		if(!m_memoryManager->CreateSingleUseCommand(buildBLASCmdBuffer))
 		{
 			Logger::Log("Could not create single use cmd buffer for building BLAS.");
 			return false;
 		}
-		for (auto& blas : m_blasVector)
+		vkCmdResetQueryPool(buildBLASCmdBuffer, compactedSizeQueryPool, 0, m_blasVector.size());
+		vkCmdResetQueryPool(buildBLASCmdBuffer, buildTimeQueryPool, 0, 2);
+		vkCmdWriteTimestamp(buildBLASCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, buildTimeQueryPool, 0);
+
+		m_blasBuildBatchCount = 0;
+		uint32_t batchStart = 0;
+		while (batchStart < m_blasVector.size())
 		{
-			vkCmdBuildAccelerationStructureNV(buildBLASCmdBuffer, &blas.m_accelerationStructureInfo, VK_NULL_HANDLE, 0, VK_FALSE,
-				blas.m_accelerationStructure, VK_NULL_HANDLE, scratchBuffer, 0);
+			//fill the batch until the scratch pool or the batch size limit is reached
+			uint32_t batchEnd = batchStart;
+			VkDeviceSize scratchOffset = 0;
+			std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRanges;
+			while (batchEnd < m_blasVector.size() && batchEnd - batchStart < m_blasMaxBatchSize 
+				&& scratchOffset + scratchSizes[batchEnd] <= m_blasScratchPoolSize)
+			{
+				buildInfos[batchEnd].scratchData.deviceAddress = m_blasScratchPoolAddress + scratchOffset;
+				buildRanges.emplace_back(m_rtBuildRanges[batchEnd].data());
+				scratchOffset += scratchSizes[batchEnd];
+				batchEnd++;
+			}
+
+			vkCmdBuildAccelerationStructuresKHR(buildBLASCmdBuffer, batchEnd - batchStart, &buildInfos[batchStart], buildRanges.data());
+			m_blasBuildBatchCount++;
 
+			//scratch pool is reused by the next batch, compacted size queries read the finished structures
 			VkMemoryBarrier memoryBarrier;
 			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
 			memoryBarrier.pNext = nullptr;
-			memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-			memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-			vkCmdPipelineBarrier(buildBLASCmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
+			memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+			memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+			vkCmdPipelineBarrier(buildBLASCmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
 				0, 1, &memoryBarrier, 0, 0, 0, 0);
+
+			batchStart = batchEnd;
+		}
+		vkCmdWriteTimestamp(buildBLASCmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, buildTimeQueryPool, 1);
+
+		std::vector<VkAccelerationStructureKHR> accelerationStructures;
+		for (const auto& blas : m_blasVector)
+		{
+			accelerationStructures.emplace_back(blas.m_accelerationStructure);
 		}
+		vkCmdWriteAccelerationStructuresPropertiesKHR(buildBLASCmdBuffer, accelerationStructures.size(), accelerationStructures.data(),
+			VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizeQueryPool, 0);
+
 		if(!m_memoryManager->EndSingleUseCommand(buildBLASCmdBuffer))
 		{
 			Logger::Log("Could not end single use cmd buffer for building BLAS.");
 			return false;
 		}
 
-		if (!m_memoryManager->CreateBuffer(m_blasInstances.size() * sizeof(BLASInstance), VK_BUFFER_USAGE_RAY_TRACING_BIT_NV, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_instanceBuffer, m_instanceBufferMemory))
+		m_blasBuildTimeCPU = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+		uint64_t timestamps[2];
+		result = vkGetQueryPoolResults(Device::Get().m_device, buildTimeQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		m_blasBuildTimeGPU = result == VK_SUCCESS ? 
+			(timestamps[1] - timestamps[0]) * m_memoryManager->GetPhysicalDeviceProperties().limits.timestampPeriod / 1000000.f : 0.f;
+		vkDestroyQueryPool(Device::Get().m_device, buildTimeQueryPool, nullptr);
+
+		Logger::Log("Built " + std::to_string(m_blasVector.size()) + " BLAS in " + std::to_string(m_blasBuildBatchCount) + " batches with " 
+			+ std::to_string(m_blasScratchPoolSize / 1024) + " KiB scratch pool, GPU: " + std::to_string(m_blasBuildTimeGPU) + " ms, CPU: " 
+			+ std::to_string(m_blasBuildTimeCPU) + " ms.");
+
+		if (!CompactBLAS(compactedSizeQueryPool))
 		{
-			Logger::Log("Could not create buffer for blas instance data.");
+			Logger::Log("Could not compact bottom level acceleration structures.");
 			return false;
 		}
-		UpdateBLASInstances();
+		vkDestroyQueryPool(Device::Get().m_device, compactedSizeQueryPool, nullptr);
 
+		for (int i = 0; i < m_blasInstances.size(); i++)
+		{
+			m_blasInstances[i].m_accelerationStructureHandle = m_blasVector[m_blasInstanceBLASIndices[i]].m_deviceAddress;
+		}
 
-		vkDestroyBuffer(Device::Get().m_device, scratchBuffer, nullptr);
-		vkFreeMemory(Device::Get().m_device, scratchBufferMemory, nullptr);
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			if (!m_memoryManager->CreateBuffer(m_blasInstances.size() * sizeof(BLASInstance), 
+				VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR, 
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_instanceBuffers[frame], m_instanceBufferMemories[frame]))
+			{
+				Logger::Log("Could not create buffer for blas instance data.");
+				return false;
+			}
+			m_instanceBufferAddresses[frame] = m_memoryManager->GetBufferDeviceAddress(m_instanceBuffers[frame]);
+			UpdateBLASInstances(frame);
+		}
 
 		return true;
 	}
 
-	bool PipelineRaytracing::UpdateBLASInstances()
+	bool PipelineRaytracing::CompactBLAS(VkQueryPool compactedSizeQueryPool)
 	{
-		if (!m_memoryManager->CopyDataToMemory(m_instanceBufferMemory, m_blasInstances.data(), m_blasInstances.size() * sizeof(BLASInstance)))
+		std::vector<VkDeviceSize> compactedSizes(m_blasVector.size());
+		VkResult result = vkGetQueryPoolResults(Device::Get().m_device, compactedSizeQueryPool, 0, compactedSizes.size(), compactedSizes.size() * sizeof(VkDeviceSize),
+			compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		if (result != VK_SUCCESS)
 		{
-			Logger::Log("Could not copy data to blas instance buffer.");
+			Logger::Log("Could not get compacted acceleration structure sizes.");
 			return false;
 		}
-		return true;
-	}
-
-	bool PipelineRaytracing::CreateTLAS()
-	{	
-		m_tlas.m_accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
-		m_tlas.m_accelerationStructureInfo.pNext = nullptr;
-		m_tlas.m_accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_NV;
-		m_tlas.m_accelerationStructureInfo.flags = 0;
-		m_tlas.m_accelerationStructureInfo.geometryCount = 0;
-		m_tlas.m_accelerationStructureInfo.pGeometries = nullptr;
-		m_tlas.m_accelerationStructureInfo.instanceCount = m_blasInstances.size();
-		
-		VkAccelerationStructureCreateInfoNV accelerationStructureCreateInfo;
-		accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
-		accelerationStructureCreateInfo.pNext = nullptr;
-		accelerationStructureCreateInfo.compactedSize = 0;
-		accelerationStructureCreateInfo.info = m_tlas.m_accelerationStructureInfo;
 
-		VkResult result = vkCreateAccelerationStructureNV(Device::Get().m_device, &accelerationStructureCreateInfo, nullptr, &m_tlas.m_accelerationStructure);
-		if (result != VK_SUCCESS)
+		VkCommandBuffer compactBLASCmdBuffer;
+		if (!m_memoryManager->CreateSingleUseCommand(compactBLASCmdBuffer))
 		{
-			Logger::Log("Could not create bottom level acceleration structure.");
+			Logger::Log("Could not create single use cmd buffer for compacting BLAS.");
 			return false;
 		}
 
-		VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo;
-		memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-		memoryRequirementsInfo.pNext = nullptr;
-		memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_NV;
-		memoryRequirementsInfo.accelerationStructure = m_tlas.m_accelerationStructure;
+		m_blasSizeCompacted = 0;
+		std::vector<BLAS> compactedBLASVector(m_blasVector.size());
+		for (int i = 0; i < m_blasVector.size(); i++)
+		{
+			if (!CreateAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[i], compactedBLASVector[i]))
+			{
+				Logger::Log("Could not create compacted bottom level acceleration structure.");
+				return false;
+			}
 
-		VkMemoryRequirements2 memoryRequirements2 = {};
-		vkGetAccelerationStructureMemoryRequirementsNV(Device::Get().m_device, &memoryRequirementsInfo, &memoryRequirements2);
+			VkCopyAccelerationStructureInfoKHR copyInfo = {};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.pNext = nullptr;
+			copyInfo.src = m_blasVector[i].m_accelerationStructure;
+			copyInfo.dst = compactedBLASVector[i].m_accelerationStructure;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(compactBLASCmdBuffer, &copyInfo);
 
-		VkMemoryAllocateInfo memoryAllocateInfo;
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.pNext = nullptr;
-		memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-		m_memoryManager->FindMemoryTypeFromProperties(memoryRequirements2.memoryRequirements.memoryTypeBits,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocateInfo.memoryTypeIndex);
-		result = vkAllocateMemory(Device::Get().m_device, &memoryAllocateInfo, nullptr, &m_tlas.m_accelerationStructureMemory);
-		if (result != VK_SUCCESS)
+			m_blasSizeCompacted += compactedSizes[i];
+		}
+
+		if (!m_memoryManager->EndSingleUseCommand(compactBLASCmdBuffer))
 		{
-			Logger::Log("Could not allocate memory for bottom level acceleration structure.");
+			Logger::Log("Could not end single use cmd buffer for compacting BLAS.");
 			return false;
 		}
 
-		VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo;
-		accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
-		accelerationStructureMemoryInfo.pNext = nullptr;
-		accelerationStructureMemoryInfo.accelerationStructure = m_tlas.m_accelerationStructure;
-		accelerationStructureMemoryInfo.memory = m_tlas.m_accelerationStructureMemory;
-		accelerationStructureMemoryInfo.memoryOffset = 0;
-		accelerationStructureMemoryInfo.deviceIndexCount = 0;
-		accelerationStructureMemoryInfo.pDeviceIndices = nullptr;
-		result = vkBindAccelerationStructureMemoryNV(Device::Get().m_device, 1, &accelerationStructureMemoryInfo);
-		if (result != VK_SUCCESS)
+		for (int i = 0; i < m_blasVector.size(); i++)
 		{
-			Logger::Log("Could not bind memory for bottom level acceleration structure.");
-			return false;
+			DestroyAccelerationStructure(m_blasVector[i]);
 		}
+		m_blasVector = compactedBLASVector;
 
-		result = vkGetAccelerationStructureHandleNV(Device::Get().m_device, m_tlas.m_accelerationStructure, sizeof(uint64_t), &m_tlas.m_handle);
-		if (result != VK_SUCCESS)
+		std::string logMessage = "BLAS memory before compaction: ";
+		logMessage.append(std::to_string(m_blasSizeUncompacted / 1024)).append(" KiB, after compaction: ");
+		logMessage.append(std::to_string(m_blasSizeCompacted / 1024)).append(" KiB.");
+		Logger::Log(logMessage);
+
+		return true;
+	}
+
+	bool PipelineRaytracing::UpdateBLASInstances(uint32_t frame)
+	{
+		if (!m_memoryManager->CopyDataToMemory(m_instanceBufferMemories[frame], m_blasInstances.data(), m_blasInstances.size() * sizeof(BLASInstance)))
 		{
-			Logger::Log("Could not get handle for bottom level acceleration structure.");
+			Logger::Log("Could not copy data to blas instance buffer.");
 			return false;
 		}
+		return true;
+	}
 
-		//simple scratch buffer approach, can be expanded to build several acceleration structures simultaneously
-		//TODO: look at compaction to reduce memory footprint
-		VkAccelerationStructureMemoryRequirementsInfoNV scratchMemoryRequirementsInfo{};
-		scratchMemoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-		scratchMemoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_NV;
-		scratchMemoryRequirementsInfo.accelerationStructure = m_tlas.m_accelerationStructure;
-
-		VkMemoryRequirements2 memoryRequirementScratchTLAS;
-		vkGetAccelerationStructureMemoryRequirementsNV(Device::Get().m_device, &memoryRequirementsInfo, &memoryRequirementScratchTLAS);
+	bool PipelineRaytracing::CreateTLAS()
+	{	
+		VkAccelerationStructureGeometryInstancesDataKHR instancesData = {};
+		instancesData.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		instancesData.pNext = nullptr;
+		instancesData.arrayOfPointers = VK_FALSE;
+		instancesData.data.deviceAddress = m_instanceBufferAddresses[m_frameIndex];
+
+		m_tlasGeometry = {};
+		m_tlasGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		m_tlasGeometry.pNext = nullptr;
+		m_tlasGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		m_tlasGeometry.geometry.instances = instancesData;
+		m_tlasGeometry.flags = 0;
+
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {};
+		buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+		buildInfo.pNext = nullptr;
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries = &m_tlasGeometry;
+
+		uint32_t instanceCount = m_blasInstances.size();
+		VkAccelerationStructureBuildSizesInfoKHR buildSizes = {};
+		buildSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+		vkGetAccelerationStructureBuildSizesKHR(Device::Get().m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &instanceCount, &buildSizes);
+
+		if (!CreateAccelerationStructure(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildSizes.accelerationStructureSize, m_tlas))
+		{
+			Logger::Log("Could not create top level acceleration structure.");
+			return false;
+		}
 
-		VkBuffer scratchBuffer;
-		VkDeviceMemory scratchBufferMemory;
-		if (!m_memoryManager->CreateBuffer(memoryRequirementScratchTLAS.memoryRequirements.size, VK_BUFFER_USAGE_RAY_TRACING_BIT_NV, 
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scratchBuffer, scratchBufferMemory))
+		//kept alive for refits, large enough for both a full build and an update
+		VkDeviceSize scratchSize = buildSizes.buildScratchSize > buildSizes.updateScratchSize ? buildSizes.buildScratchSize : buildSizes.updateScratchSize;
+		if (!CreateScratchBuffer(scratchSize, m_tlasScratchBuffer, m_tlasScratchBufferMemory, m_tlasScratchAddress))
 		{
-			Logger::Log("Could not create scratch buffer for bottom level acceleration structure.");
+			Logger::Log("Could not create scratch buffer for top level acceleration structure.");
 			return false;
 		}
 
 		VkCommandBuffer buildTLASCmdBuffer;
 		if (!m_memoryManager->CreateSingleUseCommand(buildTLASCmdBuffer))
 		{
-			Logger::Log("Could not create single use cmd buffer for building BLAS.");
+			Logger::Log("Could not create single use cmd buffer for building TLAS.");
 			return false;
 		}
-		
-		vkCmdBuildAccelerationStructureNV(buildTLASCmdBuffer, &m_tlas.m_accelerationStructureInfo, m_instanceBuffer, 0, VK_FALSE,
-			m_tlas.m_accelerationStructure, VK_NULL_HANDLE, scratchBuffer, 0);
+		BuildTLAS(buildTLASCmdBuffer, false);
+		if (!m_memoryManager->EndSingleUseCommand(buildTLASCmdBuffer))
+		{
+			Logger::Log("Could not end single use cmd buffer for building TLAS.");
+			return false;
+		}
+
+		m_uploadedInstanceListUpdate = m_scene->GetInstanceListUpdate();
+		m_uploadedInstanceStreamUpdate = m_scene->GetInstanceStreamUpdate();
+		ResetInstanceBuildBounds();
 
+		return true;
+	}
+
+	bool PipelineRaytracing::BuildTLAS(VkCommandBuffer& commandBuffer, bool update)
+	{
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {};
+		buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+		buildInfo.pNext = nullptr;
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		buildInfo.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		//updates happen in place
+		buildInfo.srcAccelerationStructure = update ? m_tlas.m_accelerationStructure : VK_NULL_HANDLE;
+		buildInfo.dstAccelerationStructure = m_tlas.m_accelerationStructure;
+		buildInfo.geometryCount = 1;
+		//the instances of the frame slot, an update may read other instance data than the build it refits
+		m_tlasGeometry.geometry.instances.data.deviceAddress = m_instanceBufferAddresses[m_frameIndex];
+		buildInfo.pGeometries = &m_tlasGeometry;
+		buildInfo.ppGeometries = nullptr;
+		buildInfo.scratchData.deviceAddress = m_tlasScratchAddress;
+
+		//previous frames may still trace against the TLAS
 		VkMemoryBarrier memoryBarrier;
 		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
 		memoryBarrier.pNext = nullptr;
-		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-		vkCmdPipelineBarrier(buildTLASCmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
 			0, 1, &memoryBarrier, 0, 0, 0, 0);
-		
-		if (!m_memoryManager->EndSingleUseCommand(buildTLASCmdBuffer))
+
+		VkAccelerationStructureBuildRangeInfoKHR buildRange = {};
+		buildRange.primitiveCount = m_blasInstances.size();
+		const VkAccelerationStructureBuildRangeInfoKHR* buildRanges = &buildRange;
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &buildRanges);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+			0, 1, &memoryBarrier, 0, 0, 0, 0);
+
+		return true;
+	}
+
+	void PipelineRaytracing::ResetInstanceBuildBounds()
+	{
+		m_instanceBuildBounds.resize(m_blasInstances.size());
+		for (int i = 0; i < m_blasInstances.size(); i++)
 		{
-			Logger::Log("Could not end single use cmd buffer for building BLAS.");
+			uint32_t instanceHandle = m_blasInstanceSceneHandles[i];
+			if (instanceHandle == UINT32_MAX)
+				continue;
+
+			const DrawableInstance& instance = m_scene->m_drawableInstances[instanceHandle];
+			m_instanceBuildBounds[i] = m_scene->m_drawables[instance.m_drawableIndex].GetBoundingBox().Transform(instance.m_transformation);
+		}
+		m_tlasDegradation = 1.f;
+	}
+
+	bool PipelineRaytracing::RecreateAccelerationStructures()
+	{
+		//instance references, shader binding table and scene buffer all depend on the list of instances
+		vkQueueWaitIdle(Device::Get().m_multipurposeQueue);
+
+		for (auto& blas : m_blasVector)
+		{
+			DestroyAccelerationStructure(blas);
+		}
+		DestroyAccelerationStructure(m_tlas);
+		vkDestroyBuffer(Device::Get().m_device, m_tlasScratchBuffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_tlasScratchBufferMemory, nullptr);
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			vkDestroyBuffer(Device::Get().m_device, m_instanceBuffers[frame], nullptr);
+			vkFreeMemory(Device::Get().m_device, m_instanceBufferMemories[frame], nullptr);
+		}
+		vkDestroyBuffer(Device::Get().m_device, m_staticTransformBuffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_staticTransformBufferMemory, nullptr);
+		m_staticTransformBuffer = VK_NULL_HANDLE;
+		m_staticTransformBufferMemory = VK_NULL_HANDLE;
+		DestroySceneInformationBuffer();
+		vkDestroyBuffer(Device::Get().m_device, m_shaderBindingTable, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_shaderBindingTableMemory, nullptr);
+
+		if (!CreateSceneInformationBuffer() || !PrepareDrawableInstances() || !CreateBLAS() || !CreateTLAS() || !CreateShaderBindingTable())
+		{
+			Logger::Log("Could not recreate acceleration structures.");
+			return false;
+		}
+		m_tlasRebuildCount++;
+
+		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo;
+		descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+		descriptorAccelerationStructureInfo.pNext = nullptr;
+		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+		descriptorAccelerationStructureInfo.pAccelerationStructures = &m_tlas.m_accelerationStructure;
+
+		std::vector<VkWriteDescriptorSet> writes(2);
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].pNext = &descriptorAccelerationStructureInfo;
+		writes[0].dstSet = m_descriptorSets[0];
+		writes[0].dstBinding = 0;
+		writes[0].dstArrayElement = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].pNext = nullptr;
+		writes[1].dstSet = m_descriptorSets[0];
+		writes[1].dstBinding = 4;
+		writes[1].dstArrayElement = 0;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[1].pBufferInfo = &m_sceneBufferDescriptor;
+
+		vkUpdateDescriptorSets(Device::Get().m_device, writes.size(), writes.data(), 0, nullptr);
+
+		return true;
+	}
+
+	bool PipelineRaytracing::CreateTimestampQueryPool()
+	{
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = m_timestampFrameSlots * 2;
+
+		VkResult result = vkCreateQueryPool(Device::Get().m_device, &queryPoolCreateInfo, nullptr, &m_timestampQueryPool);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not create timestamp query pool for raytracing.");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PipelineRaytracing::ReadTLASUpdateTime(uint32_t frameSlot)
+	{
+		if (!m_timestampWritten[frameSlot])
+			return true;
+
+		uint64_t timestamps[2];
+		VkResult result = vkGetQueryPoolResults(Device::Get().m_device, m_timestampQueryPool, frameSlot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		if (result != VK_SUCCESS)
+		{
+			Logger::Log("Could not get TLAS update timestamps.");
 			return false;
 		}
+		m_timestampWritten[frameSlot] = false;
 
-		vkDestroyBuffer(Device::Get().m_device, scratchBuffer, nullptr);
-		vkFreeMemory(Device::Get().m_device, scratchBufferMemory, nullptr);
+		//timestamp period is given in nanoseconds
+		m_tlasUpdateTime = (timestamps[1] - timestamps[0]) * m_memoryManager->GetPhysicalDeviceProperties().limits.timestampPeriod / 1000000.f;
+		m_tlasUpdateTimeAverage = m_tlasUpdateTimeAverage * 0.95f + m_tlasUpdateTime * 0.05f;
 
 		return true;
 	}
 
 	bool PipelineRaytracing::CreateSceneInformationBuffer()
 	{
-		if (!m_memoryManager->CreateOptimalBuffer(m_sceneBuffer, m_sceneBufferMemory, m_scene->m_drawableInstances.data(), 
-			m_scene->m_drawableInstances.size() * sizeof(DrawableInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		//one element per instance stream follows the instances, partial updates never reach them
+		std::vector<DrawableInstance> sceneInformation(m_scene->m_drawableInstances);
+		for (const InstanceStream& instanceStream : m_scene->GetInstanceStreams())
+		{
+			DrawableInstance streamInformation = {};
+			streamInformation.m_drawableIndex = instanceStream.m_drawableIndex;
+			sceneInformation.emplace_back(streamInformation);
+		}
+
+		if (!m_memoryManager->CreateOptimalBuffer(m_sceneBuffer, m_sceneBufferMemory, sceneInformation.data(), 
+			sceneInformation.size() * sizeof(DrawableInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
 		{
 			Logger::Log("Could not create optimal buffer for scene data for raytracing.");
 			return false;
@@ -519,28 +1057,199 @@ namespace MelonRenderer
 		m_sceneBufferDescriptor.offset = 0;
 		m_sceneBufferDescriptor.range = VK_WHOLE_SIZE;
 
+		//laid out like the scene buffer, so the changed elements are copied to the same offsets
+		const VkDeviceSize sceneBufferSize = sceneInformation.size() * sizeof(DrawableInstance);
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			if (!m_memoryManager->CreateBuffer(sceneBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				m_sceneStagingBuffers[frame], m_sceneStagingBufferMemories[frame]))
+			{
+				Logger::Log("Could not create staging buffer for scene data for raytracing.");
+				return false;
+			}
+
+			if (vkMapMemory(Device::Get().m_device, m_sceneStagingBufferMemories[frame], 0, sceneBufferSize, 0, &m_sceneStagingData[frame]) != VK_SUCCESS)
+			{
+				Logger::Log("Could not map staging buffer for scene data for raytracing.");
+				return false;
+			}
+		}
+		m_pendingSceneCopies.clear();
+
 		return true;
 	}
 
+	void PipelineRaytracing::DestroySceneInformationBuffer()
+	{
+		vkDestroyBuffer(Device::Get().m_device, m_sceneBuffer, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_sceneBufferMemory, nullptr);
+		for (uint32_t frame = 0; frame < maxFramesInFlight; frame++)
+		{
+			//freeing the memory unmaps it
+			vkDestroyBuffer(Device::Get().m_device, m_sceneStagingBuffers[frame], nullptr);
+			vkFreeMemory(Device::Get().m_device, m_sceneStagingBufferMemories[frame], nullptr);
+			m_sceneStagingBuffers[frame] = VK_NULL_HANDLE;
+			m_sceneStagingBufferMemories[frame] = VK_NULL_HANDLE;
+			m_sceneStagingData[frame] = nullptr;
+		}
+	}
+
+	void PipelineRaytracing::StageSceneInformation(const std::vector<uint32_t>& instances)
+	{
+		char* stagingData = static_cast<char*>(m_sceneStagingData[m_frameIndex]);
+		m_pendingSceneCopies.clear();
+		for (size_t k = 0; k < instances.size(); k++)
+		{
+			const VkDeviceSize offset = instances[k] * sizeof(DrawableInstance);
+			memcpy(stagingData + offset, &m_scene->m_drawableInstances[instances[k]], sizeof(DrawableInstance));
+
+			//consecutive instances are packed into one copy region
+			if (k && instances[k] == instances[k - 1] + 1)
+			{
+				m_pendingSceneCopies.back().size += sizeof(DrawableInstance);
+			}
+			else
+			{
+				VkBufferCopy copyRegion = {};
+				copyRegion.srcOffset = offset;
+				copyRegion.dstOffset = offset;
+				copyRegion.size = sizeof(DrawableInstance);
+				m_pendingSceneCopies.emplace_back(copyRegion);
+			}
+		}
+	}
+
 	bool PipelineRaytracing::UpdateTransformations()
 	{
-		//TODO: rework in a way that blas instances are easily updatable
-		//blas instance buffer
-		//PrepareDrawableInstances();
-		//UpdateBLASInstances();
-		//BuildTLAS();
+		const uint64_t transformUpdate = m_scene->GetTransformUpdate();
+		if (m_scene->GetInstanceListUpdate() != m_uploadedInstanceListUpdate || m_scene->GetInstanceStreamUpdate() != m_uploadedInstanceStreamUpdate)
+		{
+			m_resetAccumulation = true;
+			m_uploadedTransformUpdate = transformUpdate;
+			return RecreateAccelerationStructures();
+		}
+
+		//nothing to compare or upload if no instance moved since the last frame that was read
+		const bool partialUpdate = m_uploadedTransformUpdate && transformUpdate == m_uploadedTransformUpdate + 1;
+		if (transformUpdate == m_uploadedTransformUpdate || (partialUpdate && m_scene->GetChangedInstances().empty()))
+		{
+			m_uploadedTransformUpdate = transformUpdate;
+			return true;
+		}
+		m_uploadedTransformUpdate = transformUpdate;
+
+		uint32_t dirtyInstances = 0;
+		for (int i = 0; i < m_blasInstances.size(); i++)
+		{
+			uint32_t instanceHandle = m_blasInstanceSceneHandles[i];
+			if (instanceHandle == UINT32_MAX)
+				continue;
+
+			mat3x4 transform = m_scene->m_drawableInstances[instanceHandle].m_transformation.ToMat3x4();
+			if (transform != m_blasInstances[i].m_transform)
+			{
+				m_blasInstances[i].m_transform = transform;
+				dirtyInstances++;
+			}
+		}
 
+		if (!dirtyInstances)
+			return true;
+		m_resetAccumulation = true;
 
-		//scene buffer
-		if(!m_memoryManager->UpdateOptimalBuffer(m_sceneBuffer, m_scene->m_drawableInstances.data(), m_scene->m_drawableInstances.size() * sizeof(DrawableInstance)))
+		//refitting keeps the tree topology, its nodes grow with the distance instances moved since the last build
+		float buildSurfaceArea = 0.f;
+		float refitSurfaceArea = 0.f;
+		for (int i = 0; i < m_blasInstances.size(); i++)
+		{
+			uint32_t instanceHandle = m_blasInstanceSceneHandles[i];
+			if (instanceHandle == UINT32_MAX)
+				continue;
+
+			const DrawableInstance& instance = m_scene->m_drawableInstances[instanceHandle];
+			AABB refitBounds = m_scene->m_drawables[instance.m_drawableIndex].GetBoundingBox().Transform(instance.m_transformation);
+			refitBounds.Expand(m_instanceBuildBounds[i]);
+
+			buildSurfaceArea += m_instanceBuildBounds[i].SurfaceArea();
+			refitSurfaceArea += refitBounds.SurfaceArea();
+		}
+		m_tlasDegradation = buildSurfaceArea > 0.f ? refitSurfaceArea / buildSurfaceArea : 1.f;
+		bool rebuild = m_tlasDegradation > m_settings.m_tlasRebuildThreshold;
+
+		if (!UpdateBLASInstances(m_frameIndex))
 		{
-			Logger::Log("Could not update scene buffer.");
 			return false;
 		}
 
+		//scene buffer, only the changed instances unless an update was missed, staged for the frame slot and copied by the next Tick
+		if (partialUpdate)
+		{
+			StageSceneInformation(m_scene->GetChangedInstances());
+		}
+		else
+		{
+			std::vector<uint32_t> instances(m_scene->m_drawableInstances.size());
+			for (uint32_t i = 0; i < instances.size(); i++)
+			{
+				instances[i] = i;
+			}
+			StageSceneInformation(instances);
+		}
+
+		//a rebuild left for the next Tick is not turned into a refit
+		if (rebuild)
+		{
+			m_pendingTLASUpdate = TLAS_UPDATE_REBUILD;
+			ResetInstanceBuildBounds();
+			m_tlasRebuildCount++;
+		}
+		else
+		{
+			if (m_pendingTLASUpdate == TLAS_UPDATE_NONE)
+				m_pendingTLASUpdate = TLAS_UPDATE_REFIT;
+			m_tlasRefitCount++;
+		}
+
 		return true;
 	}
 
+	void PipelineRaytracing::RecordTLASUpdate(VkCommandBuffer& commandBuffer)
+	{
+		if (m_pendingTLASUpdate == TLAS_UPDATE_NONE)
+			return;
+
+		if (!m_pendingSceneCopies.empty())
+		{
+			//the frames before may still read the scene buffer, the barrier waits for their shaders as well
+			VkMemoryBarrier sceneBarrier = {};
+			sceneBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			sceneBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			sceneBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				1, &sceneBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdCopyBuffer(commandBuffer, m_sceneStagingBuffers[m_frameIndex], m_sceneBuffer, static_cast<uint32_t>(m_pendingSceneCopies.size()),
+				m_pendingSceneCopies.data());
+			m_pendingSceneCopies.clear();
+
+			sceneBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			sceneBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0,
+				1, &sceneBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		uint32_t frameSlot = m_timestampFrameSlot;
+		m_timestampFrameSlot = (m_timestampFrameSlot + 1) % m_timestampFrameSlots;
+		ReadTLASUpdateTime(frameSlot);
+
+		vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, frameSlot * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, frameSlot * 2);
+		BuildTLAS(commandBuffer, m_pendingTLASUpdate == TLAS_UPDATE_REFIT);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, m_timestampQueryPool, frameSlot * 2 + 1);
+		m_timestampWritten[frameSlot] = true;
+		m_pendingTLASUpdate = TLAS_UPDATE_NONE;
+	}
+
 	bool PipelineRaytracing::CreateStorageImage()
 	{
 		if (!m_memoryManager->CreateImage(m_storageImage, m_storageImageMemory, m_extent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT))
@@ -555,16 +1264,58 @@ namespace MelonRenderer
 			return false;
 		}
 
+		if (!m_memoryManager->CreateImage(m_accumulationImage, m_accumulationImageMemory, m_extent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT, 
+			VK_FORMAT_R32G32B32A32_SFLOAT))
+		{
+			Logger::Log("Could not create accumulation image for raytracing.");
+			return false;
+		}
+
+		if (!m_memoryManager->CreateImageView(m_accumulationImageView, m_accumulationImage, VK_FORMAT_R32G32B32A32_SFLOAT))
+		{
+			Logger::Log("Could not create accumulation image view for raytracing.");
+			return false;
+		}
+
+		if (!m_memoryManager->CreateImage(m_featureImage, m_featureImageMemory, m_extent, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_FORMAT_R32G32B32A32_SFLOAT)
+			|| !m_memoryManager->CreateImageView(m_featureImageView, m_featureImage, VK_FORMAT_R32G32B32A32_SFLOAT))
+		{
+			Logger::Log("Could not create feature image for raytracing.");
+			return false;
+		}
+		if (!m_memoryManager->CreateImage(m_albedoImage, m_albedoImageMemory, m_extent, VK_IMAGE_USAGE_STORAGE_BIT, VK_FORMAT_R16G16B16A16_SFLOAT)
+			|| !m_memoryManager->CreateImageView(m_albedoImageView, m_albedoImage, VK_FORMAT_R16G16B16A16_SFLOAT))
+		{
+			Logger::Log("Could not create albedo image for raytracing.");
+			return false;
+		}
+		if (!m_memoryManager->CreateImage(m_motionImage, m_motionImageMemory, m_extent, VK_IMAGE_USAGE_STORAGE_BIT, VK_FORMAT_R16G16B16A16_SFLOAT)
+			|| !m_memoryManager->CreateImageView(m_motionImageView, m_motionImage, VK_FORMAT_R16G16B16A16_SFLOAT))
+		{
+			Logger::Log("Could not create motion vector image for raytracing.");
+			return false;
+		}
+		if (!m_memoryManager->CreateImage(m_momentsImage, m_momentsImageMemory, m_extent, VK_IMAGE_USAGE_STORAGE_BIT, VK_FORMAT_R32G32B32A32_SFLOAT)
+			|| !m_memoryManager->CreateImageView(m_momentsImageView, m_momentsImage, VK_FORMAT_R32G32B32A32_SFLOAT))
+		{
+			Logger::Log("Could not create moments image for raytracing.");
+			return false;
+		}
+
 		VkCommandBuffer layoutTransitionCommandBuffer;
 		if (!m_memoryManager->CreateSingleUseCommand(layoutTransitionCommandBuffer))
 		{
 			Logger::Log("Could not create single use command buffer for transition of image layout.");
 			return false;
 		}
-		if (!m_memoryManager->TransitionImageLayout(layoutTransitionCommandBuffer, m_storageImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL ))
+		for (VkImage image : { m_storageImage, m_accumulationImage, m_featureImage, m_albedoImage, m_motionImage, m_momentsImage })
 		{
-			Logger::Log("Could not transition storage image layout for raytracing.");
-			return false;
+			if (!m_memoryManager->TransitionImageLayout(layoutTransitionCommandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL))
+			{
+				Logger::Log("Could not transition storage image layout for raytracing.");
+				return false;
+			}
 		}
 		if (!m_memoryManager->EndSingleUseCommand(layoutTransitionCommandBuffer))
 		{
@@ -572,6 +1323,27 @@ namespace MelonRenderer
 			return false;
 		}
 
+		//contents of the new accumulation image are undefined
+		m_resetAccumulation = true;
+
+		return true;
+	}
+
+	bool PipelineRaytracing::CreateBlueNoiseBuffer()
+	{
+		std::vector<float> blueNoise;
+		if (!GenerateBlueNoise(blueNoiseSize, blueNoise))
+		{
+			return false;
+		}
+
+		if (!m_memoryManager->CreateOptimalBuffer(m_blueNoiseBuffer, m_blueNoiseBufferMemory, blueNoise.data(), blueNoise.size() * sizeof(float),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		{
+			Logger::Log("Could not create blue noise buffer.");
+			return false;
+		}
+
 		return true;
 	}
 
@@ -580,25 +1352,49 @@ namespace MelonRenderer
 		vkDestroyImage(Device::Get().m_device, m_storageImage, nullptr);
 		vkDestroyImageView(Device::Get().m_device, m_storageImageView, nullptr);
 		vkFreeMemory(Device::Get().m_device, m_storageImageMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_accumulationImage, nullptr);
+		vkDestroyImageView(Device::Get().m_device, m_accumulationImageView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_accumulationImageMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_featureImage, nullptr);
+		vkDestroyImageView(Device::Get().m_device, m_featureImageView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_featureImageMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_albedoImage, nullptr);
+		vkDestroyImageView(Device::Get().m_device, m_albedoImageView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_albedoImageMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_motionImage, nullptr);
+		vkDestroyImageView(Device::Get().m_device, m_motionImageView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_motionImageMemory, nullptr);
+		vkDestroyImage(Device::Get().m_device, m_momentsImage, nullptr);
+		vkDestroyImageView(Device::Get().m_device, m_momentsImageView, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_momentsImageMemory, nullptr);
 
 		return true;
 	}
 
 	bool PipelineRaytracing::CreateShaderBindingTable()
 	{
-		uint32_t shaderBindingTableSize = sizeof(ShaderBindingTableEntry) * (m_scene->m_drawableInstances.size() + 3);
-		if(!m_memoryManager->CreateBuffer(shaderBindingTableSize, VK_BUFFER_USAGE_RAY_TRACING_BIT_NV, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			m_shaderBindingTable, m_shaderBindingTableMemory))
+		const uint32_t handleSize = m_raytracingProperties->shaderGroupHandleSize;
+		const VkDeviceSize baseAlignment = m_raytracingProperties->shaderGroupBaseAlignment;
+
+		//every entry holds the shader group handle followed by the geometry id of the instance
+		m_shaderBindingTableStride = AlignUp(handleSize + sizeof(uint32_t), m_raytracingProperties->shaderGroupHandleAlignment);
+
+		//each region has to start at a multiple of the base alignment, the raygen region size has to match its stride
+		//the regular and the hybrid raygen shader get a region each, only one of them is used per trace
+		VkDeviceSize raygenRegionSize = AlignUp(m_shaderBindingTableStride, baseAlignment);
+		VkDeviceSize missRegionSize = AlignUp(m_shaderBindingTableStride * 2, baseAlignment);
+		VkDeviceSize hitRegionSize = AlignUp(m_shaderBindingTableStride * m_shaderBindingGeometryIDs.size(), baseAlignment);
+		VkDeviceSize shaderBindingTableSize = raygenRegionSize * 2 + missRegionSize + hitRegionSize;
+
+		if(!m_memoryManager->CreateBuffer(shaderBindingTableSize, VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_shaderBindingTable, m_shaderBindingTableMemory))
 		{
 			Logger::Log("Could not create shader binding table buffer.");
 			return false;
 		}
 
-		void* data;
-		vkMapMemory(Device::Get().m_device, m_shaderBindingTableMemory, 0, VK_WHOLE_SIZE, 0, &data);
-
-		std::vector<uint8_t> shaderHandles(m_raytracingProperties->shaderGroupHandleSize * m_rtShaderGroups.size());
-		VkResult result = vkGetRayTracingShaderGroupHandlesNV(Device::Get().m_device, m_pipeline, 0, m_rtShaderGroups.size(), 
+		std::vector<uint8_t> shaderHandles(handleSize * m_rtShaderGroups.size());
+		VkResult result = vkGetRayTracingShaderGroupHandlesKHR(Device::Get().m_device, m_pipeline, 0, m_rtShaderGroups.size(), 
 			shaderHandles.size(), shaderHandles.data());
 		if(result != VK_SUCCESS)
 		{
@@ -606,36 +1402,49 @@ namespace MelonRenderer
 			return false;
 		}
 
-		//TODO: check minimum shader binding table alignment and add padding or use different struct if needed
-
+		uint8_t* data;
+		vkMapMemory(Device::Get().m_device, m_shaderBindingTableMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+		memset(data, 0, shaderBindingTableSize);
 
-		std::vector<ShaderBindingTableEntry> shaderBindingTable;
-		shaderBindingTable.reserve(shaderBindingTableSize);
+		//raygen and hybrid raygen, the hybrid group comes after the hit group
+		memcpy(data, shaderHandles.data(), handleSize);
+		memcpy(data + raygenRegionSize, shaderHandles.data() + handleSize * 4, handleSize);
 
-		ShaderBindingTableEntry raygenGroupGeneral;
-		memcpy(raygenGroupGeneral.shaderGroupHandle, shaderHandles.data(), 16);
-		shaderBindingTable.emplace_back(raygenGroupGeneral);
-
-		ShaderBindingTableEntry rayMissGroupGeneral;
-		memcpy(rayMissGroupGeneral.shaderGroupHandle, shaderHandles.data() + 16, 16);
-		shaderBindingTable.emplace_back(rayMissGroupGeneral);
-
-		ShaderBindingTableEntry shadowRayMissGroupGeneral;
-		memcpy(shadowRayMissGroupGeneral.shaderGroupHandle, shaderHandles.data() + 32, 16);
-		shaderBindingTable.emplace_back(shadowRayMissGroupGeneral);
+		//miss and shadow miss
+		uint8_t* missData = data + raygenRegionSize * 2;
+		memcpy(missData, shaderHandles.data() + handleSize, handleSize);
+		memcpy(missData + m_shaderBindingTableStride, shaderHandles.data() + handleSize * 2, handleSize);
 
+		//one hit entry per instance
+		uint8_t* hitData = missData + missRegionSize;
 		for (int i = 0; i < m_shaderBindingGeometryIDs.size(); i++)
 		{
-			ShaderBindingTableEntry hitGroupGeometry;
-			memcpy(hitGroupGeometry.shaderGroupHandle, shaderHandles.data() + 48, 16);
-			hitGroupGeometry.geometryID = m_shaderBindingGeometryIDs[i];
-			shaderBindingTable.emplace_back(hitGroupGeometry);
+			uint8_t* entry = hitData + i * m_shaderBindingTableStride;
+			memcpy(entry, shaderHandles.data() + handleSize * 3, handleSize);
+			memcpy(entry + handleSize, &m_shaderBindingGeometryIDs[i], sizeof(uint32_t));
 		}
 
-		memcpy(data, shaderBindingTable.data(), shaderBindingTable.size() * sizeof(ShaderBindingTableEntry));
-
 		vkUnmapMemory(Device::Get().m_device, m_shaderBindingTableMemory);
 
+		VkDeviceAddress shaderBindingTableAddress = m_memoryManager->GetBufferDeviceAddress(m_shaderBindingTable);
+		m_raygenRegion.deviceAddress = shaderBindingTableAddress;
+		m_raygenRegion.stride = raygenRegionSize;
+		m_raygenRegion.size = raygenRegionSize;
+
+		m_hybridRaygenRegion.deviceAddress = shaderBindingTableAddress + raygenRegionSize;
+		m_hybridRaygenRegion.stride = raygenRegionSize;
+		m_hybridRaygenRegion.size = raygenRegionSize;
+
+		m_missRegion.deviceAddress = shaderBindingTableAddress + raygenRegionSize * 2;
+		m_missRegion.stride = m_shaderBindingTableStride;
+		m_missRegion.size = missRegionSize;
+
+		m_hitRegion.deviceAddress = shaderBindingTableAddress + raygenRegionSize * 2 + missRegionSize;
+		m_hitRegion.stride = m_shaderBindingTableStride;
+		m_hitRegion.size = hitRegionSize;
+
+		m_callableRegion = {};
+
 		return true;
 	}
 
@@ -679,103 +1488,124 @@ namespace MelonRenderer
 		auto missShaderCode = readFile("shaders/rmiss.spv");
 		auto missShadowShaderCode = readFile("shaders/rmissShadow.spv");
 		auto hitShaderCode = readFile("shaders/rchit.spv");
+		auto hybridRaygenShaderCode = readFile("shaders/rgenHybrid.spv");
 		
-		VkPipelineShaderStageCreateInfo raygenShader, missShader, hitShader, missShadowShader;
+		VkPipelineShaderStageCreateInfo raygenShader, missShader, hitShader, missShadowShader, hybridRaygenShader;
 
 		CreateShaderModule(raygenShaderCode, raygenShader.module);
 		CreateShaderModule(missShaderCode, missShader.module);
 		CreateShaderModule(missShadowShaderCode, missShadowShader.module);
 		CreateShaderModule(hitShaderCode, hitShader.module);
+		CreateShaderModule(hybridRaygenShaderCode, hybridRaygenShader.module);
 
 		raygenShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		raygenShader.pNext = nullptr;
 		raygenShader.flags = 0;
-		raygenShader.stage = VK_SHADER_STAGE_RAYGEN_BIT_NV;
+		raygenShader.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 		raygenShader.pName = "main";
 		raygenShader.pSpecializationInfo = nullptr;
 
 		missShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		missShader.pNext = nullptr;
 		missShader.flags = 0;
-		missShader.stage = VK_SHADER_STAGE_MISS_BIT_NV;
+		missShader.stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 		missShader.pName = "main";
 		missShader.pSpecializationInfo = nullptr;
 
 		missShadowShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		missShadowShader.pNext = nullptr;
 		missShadowShader.flags = 0;
-		missShadowShader.stage = VK_SHADER_STAGE_MISS_BIT_NV;
+		missShadowShader.stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 		missShadowShader.pName = "main";
 		missShadowShader.pSpecializationInfo = nullptr;
 
 		hitShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		hitShader.pNext = nullptr;
 		hitShader.flags = 0;
-		hitShader.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV;
+		hitShader.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
 		hitShader.pName = "main";
 		hitShader.pSpecializationInfo = nullptr;
 
-		VkRayTracingShaderGroupCreateInfoNV raygenGroupInfo, missGroupInfo, missShadowGroupInfo, hitGroupInfo = {};
+		hybridRaygenShader.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		hybridRaygenShader.pNext = nullptr;
+		hybridRaygenShader.flags = 0;
+		hybridRaygenShader.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+		hybridRaygenShader.pName = "main";
+		hybridRaygenShader.pSpecializationInfo = nullptr;
 
-		raygenGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
+		VkRayTracingShaderGroupCreateInfoKHR raygenGroupInfo = {}, missGroupInfo = {}, missShadowGroupInfo = {}, hitGroupInfo = {}, hybridRaygenGroupInfo = {};
+
+		raygenGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
 		raygenGroupInfo.pNext = nullptr;
-		raygenGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
+		raygenGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
 		raygenGroupInfo.generalShader = 0;
-		raygenGroupInfo.closestHitShader = VK_SHADER_UNUSED_NV;
-		raygenGroupInfo.anyHitShader = VK_SHADER_UNUSED_NV;
-		raygenGroupInfo.intersectionShader = VK_SHADER_UNUSED_NV;
+		raygenGroupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+		raygenGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+		raygenGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
 
-		missGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
+		missGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
 		missGroupInfo.pNext = nullptr;
-		missGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
+		missGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
 		missGroupInfo.generalShader = 1;
-		missGroupInfo.closestHitShader = VK_SHADER_UNUSED_NV;
-		missGroupInfo.anyHitShader = VK_SHADER_UNUSED_NV;
-		missGroupInfo.intersectionShader = VK_SHADER_UNUSED_NV;
+		missGroupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+		missGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+		missGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
 
-		missShadowGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
+		missShadowGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
 		missShadowGroupInfo.pNext = nullptr;
-		missShadowGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
+		missShadowGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
 		missShadowGroupInfo.generalShader = 2;
-		missShadowGroupInfo.closestHitShader = VK_SHADER_UNUSED_NV;
-		missShadowGroupInfo.anyHitShader = VK_SHADER_UNUSED_NV;
-		missShadowGroupInfo.intersectionShader = VK_SHADER_UNUSED_NV;
+		missShadowGroupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+		missShadowGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+		missShadowGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
 
-		hitGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
+		hitGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
 		hitGroupInfo.pNext = nullptr;
-		hitGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_NV;
-		hitGroupInfo.generalShader = VK_SHADER_UNUSED_NV;
+		hitGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+		hitGroupInfo.generalShader = VK_SHADER_UNUSED_KHR;
 		hitGroupInfo.closestHitShader = 3;
-		hitGroupInfo.anyHitShader = VK_SHADER_UNUSED_NV;
-		hitGroupInfo.intersectionShader = VK_SHADER_UNUSED_NV;
+		hitGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+		hitGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
+
+		hybridRaygenGroupInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+		hybridRaygenGroupInfo.pNext = nullptr;
+		hybridRaygenGroupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+		hybridRaygenGroupInfo.generalShader = 4;
+		hybridRaygenGroupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+		hybridRaygenGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+		hybridRaygenGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
 
 		m_shaderStagesV.emplace_back(raygenShader);
 		m_shaderStagesV.emplace_back(missShader);
 		m_shaderStagesV.emplace_back(missShadowShader);
 		m_shaderStagesV.emplace_back(hitShader);
+		m_shaderStagesV.emplace_back(hybridRaygenShader);
 
 		m_rtShaderGroups.emplace_back(raygenGroupInfo);
 		m_rtShaderGroups.emplace_back(missGroupInfo);
 		m_rtShaderGroups.emplace_back(missShadowGroupInfo);
 		m_rtShaderGroups.emplace_back(hitGroupInfo);
+		m_rtShaderGroups.emplace_back(hybridRaygenGroupInfo);
 
 		return true;
 	}
 
 	bool PipelineRaytracing::CreateGraphicsPipeline()
 	{
-		VkRayTracingPipelineCreateInfoNV raytracePipleineInfo;
-		raytracePipleineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
+		VkRayTracingPipelineCreateInfoKHR raytracePipleineInfo = {};
+		raytracePipleineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
 		raytracePipleineInfo.pNext = nullptr;
 		raytracePipleineInfo.flags = 0;
 		raytracePipleineInfo.stageCount = m_shaderStagesV.size();
 		raytracePipleineInfo.pStages = m_shaderStagesV.data();
 		raytracePipleineInfo.groupCount = m_rtShaderGroups.size();
 		raytracePipleineInfo.pGroups = m_rtShaderGroups.data();
-		raytracePipleineInfo.maxRecursionDepth = 2;
+		//shadow rays are traced from the closest hit shader, in hybrid mode also from the raygen shader
+		raytracePipleineInfo.maxPipelineRayRecursionDepth = m_raytracingProperties->maxRayRecursionDepth < 2 ? m_raytracingProperties->maxRayRecursionDepth : 2;
 		raytracePipleineInfo.layout = m_pipelineLayout;
 		raytracePipleineInfo.basePipelineIndex = 0;
-		VkResult result = vkCreateRayTracingPipelinesNV(Device::Get().m_device, VK_NULL_HANDLE, 1, &raytracePipleineInfo, nullptr, &m_pipeline);
+		//the slowest pipeline to compile, split between threads by the driver
+		VkResult result = m_pipelineCache->CreateRayTracingPipeline(raytracePipleineInfo, m_pipeline);
 		if (result != VK_SUCCESS)
 		{
 			Logger::Log("Could not create raytracing pipeline.");
@@ -785,48 +1615,125 @@ namespace MelonRenderer
 		return true;
 	}
 
-	bool PipelineRaytracing::Draw(VkCommandBuffer& commandBuffer)
+	void PipelineRaytracing::DestroyPipelines()
 	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, m_pipeline);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, m_pipelineLayout, 0, m_descriptorSets.size(), m_descriptorSets.data(),
-			0, nullptr);
+		Pipeline::DestroyPipelines();
+		m_rtShaderGroups.clear();
 
-		ImGui::Begin("Scene");
-		
-		static float clearColor[3] = {0.f, 0.4531f, 0.78125f};
-		static float lightPosition[3] = { -50.f, 50.f, -50.f };
-		static float lightIntensity = 1.f;
-		static int numberOfSamples = 1;
-		ImGui::ColorEdit3("clear value", clearColor);
-		m_rtPushConstants.clearColor.x = clearColor[0];
-		m_rtPushConstants.clearColor.y = clearColor[1];
-		m_rtPushConstants.clearColor.z = clearColor[2];
-		ImGui::InputFloat3("light position", lightPosition);
-		m_rtPushConstants.lightPosition.x = lightPosition[0];
-		m_rtPushConstants.lightPosition.y = lightPosition[1];
-		m_rtPushConstants.lightPosition.z = lightPosition[2];
-		ImGui::SliderFloat("light intensity", &lightIntensity, 0.f, 10.f);
-		m_rtPushConstants.lightIntensity = lightIntensity;
-		ImGui::SliderInt("number of samples", &numberOfSamples, 0, 80);
-		m_rtPushConstants.numberOfSamples = numberOfSamples;
+		vkDestroyBuffer(Device::Get().m_device, m_shaderBindingTable, nullptr);
+		vkFreeMemory(Device::Get().m_device, m_shaderBindingTableMemory, nullptr);
+		m_shaderBindingTable = VK_NULL_HANDLE;
+		m_shaderBindingTableMemory = VK_NULL_HANDLE;
+	}
 
-		ImGui::End();
+	bool PipelineRaytracing::Draw(VkCommandBuffer& commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline);
+		//in binding order, the camera comes before the ray counters
+		uint32_t dynamicOffsets[2] = { m_camera->GetDynamicOffset(m_frameIndex), static_cast<uint32_t>(m_frameIndex * m_rayCounterStride) };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0, m_descriptorSets.size(), m_descriptorSets.data(),
+			2, dynamicOffsets);
+
+		m_rtPushConstants.clearColor.x = m_settings.m_clearColor.x;
+		m_rtPushConstants.clearColor.y = m_settings.m_clearColor.y;
+		m_rtPushConstants.clearColor.z = m_settings.m_clearColor.z;
+		m_rtPushConstants.lightPosition = m_settings.m_lightPosition;
+		m_rtPushConstants.lightIntensity = m_settings.m_lightIntensity;
+		m_rtPushConstants.numberOfSamples = m_settings.m_numberOfSamples;
+		m_rtPushConstants.sampler = m_settings.m_sampler;
+		m_rtPushConstants.lightRadius = m_settings.m_lightRadius;
+
+		//any change to what the rays see invalidates the running average
+		const CameraMatrices& camera = m_camera->GetFrameMatrices();
+		if (memcmp(&camera, &m_accumulationCamera, sizeof(CameraMatrices)) != 0
+			|| m_rtPushConstants.clearColor != m_accumulationPushConstants.clearColor
+			|| m_rtPushConstants.lightPosition != m_accumulationPushConstants.lightPosition
+			|| m_rtPushConstants.lightIntensity != m_accumulationPushConstants.lightIntensity
+			|| m_rtPushConstants.numberOfSamples != m_accumulationPushConstants.numberOfSamples
+			|| m_rtPushConstants.sampler != m_accumulationPushConstants.sampler
+			|| m_rtPushConstants.lightRadius != m_accumulationPushConstants.lightRadius)
+		{
+			m_resetAccumulation = true;
+		}
+		if (m_resetAccumulation || !m_settings.m_accumulate)
+		{
+			m_accumulatedFrames = 0;
+			m_accumulationCamera = camera;
+			m_accumulationPushConstants = m_rtPushConstants;
+			m_resetAccumulation = false;
+		}
+		m_rtPushConstants.frame = m_accumulatedFrames++;
+		//restarts the sample sequence with the accumulation so it stays stratified, keeps it running for the denoiser otherwise
+		m_rtPushConstants.sampleFrame = m_settings.m_accumulate ? m_rtPushConstants.frame : m_sampleFrame;
+		m_sampleFrame++;
+
+		//the adaptive pass refines the running average, it needs the moments of previous frames
+		bool adaptivePass = m_settings.m_adaptive && m_settings.m_accumulate;
+		m_rtPushConstants.adaptivePass = 0;
+		m_rtPushConstants.adaptiveThreshold = m_settings.m_adaptiveThreshold;
+		m_rtPushConstants.adaptiveMaxSamples = m_settings.m_adaptiveMaxSamples;
+		m_rtPushConstants.adaptiveBudget = static_cast<uint32_t>(m_settings.m_adaptiveBudget * m_extent.width * m_extent.height);
+		m_rtPushConstants.heatmap = m_settings.m_heatmap && adaptivePass ? 1 : 0;
+
+		//the slot's frame finished before it was prepared, so its counts are complete, they lag the frames in flight behind
+		m_rtPushConstants.countRays = m_settings.m_countRays ? 1 : 0;
+		const bool countRays = m_settings.m_countRays || adaptivePass;
+		const VkDeviceSize counterOffset = m_frameIndex * m_rayCounterStride;
+		if (countRays)
+		{
+			memcpy(&m_rayCounts, static_cast<uint8_t*>(m_rayCounterData) + counterOffset, sizeof(RayCounts));
+
+			VkMemoryBarrier resetBarrier = {};
+			resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			resetBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			resetBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				1, &resetBarrier, 0, nullptr, 0, nullptr);
+			vkCmdFillBuffer(commandBuffer, m_rayCounterBuffer, counterOffset, sizeof(RayCounts), 0);
+
+			VkMemoryBarrier counterBarrier = {};
+			counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0,
+				1, &counterBarrier, 0, nullptr, 0, nullptr);
+		}
 
-		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV,
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
 			0, sizeof(RtPushConstant), &m_rtPushConstants);
 
-		VkDeviceSize bindingOffsetRayGenShader = 0;
-		VkDeviceSize bindingOffsetMissShader = m_shaderBindingTableStride;
-		VkDeviceSize bindingOffsetMissShadowShader = m_shaderBindingTableStride * 2;
-		VkDeviceSize bindingOffsetHitShader = m_shaderBindingTableStride * 3;
-		m_raytracingProperties;
-		vkCmdTraceRaysNV(commandBuffer, 
-			m_shaderBindingTable, bindingOffsetRayGenShader,
-			m_shaderBindingTable, bindingOffsetMissShader, m_shaderBindingTableStride,
-			m_shaderBindingTable, bindingOffsetHitShader, m_shaderBindingTableStride,
-			VK_NULL_HANDLE, 0, 0,
+		vkCmdTraceRaysKHR(commandBuffer, m_hybrid ? &m_hybridRaygenRegion : &m_raygenRegion, &m_missRegion, &m_hitRegion, &m_callableRegion,
 			m_extent.width, m_extent.height, 1);
 
+		if (adaptivePass)
+		{
+			//reads the accumulation and moments the first pass wrote
+			VkMemoryBarrier passBarrier = {};
+			passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0,
+				1, &passBarrier, 0, nullptr, 0, nullptr);
+
+			m_rtPushConstants.adaptivePass = 1;
+			vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
+				0, sizeof(RtPushConstant), &m_rtPushConstants);
+
+			vkCmdTraceRaysKHR(commandBuffer, m_hybrid ? &m_hybridRaygenRegion : &m_raygenRegion, &m_missRegion, &m_hitRegion, &m_callableRegion,
+				m_extent.width, m_extent.height, 1);
+		}
+
+		if (countRays)
+		{
+			//read on the host once the slot's fence signalled
+			VkMemoryBarrier readbackBarrier = {};
+			readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			readbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_HOST_BIT, 0,
+				1, &readbackBarrier, 0, nullptr, 0, nullptr);
+		}
+
 		return true;
 	}
 
@@ -837,9 +1744,9 @@ namespace MelonRenderer
 
 		VkDescriptorSetLayoutBinding accelerationStructureLayoutBinding = {
 			layoutBindingIndex++,
-			VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV,
+			VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR,
 			1,
-			VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(accelerationStructureLayoutBinding);
@@ -848,16 +1755,17 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 			1,
-			VK_SHADER_STAGE_RAYGEN_BIT_NV,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(writeImageLayoutBinding);
 
+		//offset to the matrices of the frame when bound
 		VkDescriptorSetLayoutBinding cameraLayoutBinding = {
 			layoutBindingIndex++,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			1,
-			VK_SHADER_STAGE_RAYGEN_BIT_NV,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(cameraLayoutBinding);
@@ -866,7 +1774,7 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			m_scene->m_drawables.size(), //TODO: update this when number of objects changes
-			VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(materialsLayoutBinding);
@@ -875,7 +1783,7 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			1,
-			VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(sceneLayoutBinding);
@@ -884,7 +1792,7 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			m_memoryManager->GetNumberTextures(),
-			VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_RAYGEN_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(samplerLayoutBinding);
@@ -893,7 +1801,7 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			m_scene->m_drawables.size(), //TODO: update this when number of objects changes
-			VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(verticesLayoutBinding);
@@ -902,10 +1810,73 @@ namespace MelonRenderer
 			layoutBindingIndex++,
 			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 			m_scene->m_drawables.size(), //TODO: update this when number of objects changes
-			VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+			VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
 			nullptr
 		};
 		layoutBindings.emplace_back(indicesLayoutBinding);
+
+		VkDescriptorSetLayoutBinding accumulationImageLayoutBinding = {
+			layoutBindingIndex++,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			1,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+			nullptr
+		};
+		layoutBindings.emplace_back(accumulationImageLayoutBinding);
+
+		VkDescriptorSetLayoutBinding blueNoiseLayoutBinding = {
+			layoutBindingIndex++,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+			nullptr
+		};
+		layoutBindings.emplace_back(blueNoiseLayoutBinding);
+
+		//denoiser features
+		for (int i = 0; i < 3; i++)
+		{
+			VkDescriptorSetLayoutBinding featureLayoutBinding = {
+				layoutBindingIndex++,
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				1,
+				VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+				nullptr
+			};
+			layoutBindings.emplace_back(featureLayoutBinding);
+		}
+
+		//G-buffer
+		for (int i = 0; i < 2; i++)
+		{
+			VkDescriptorSetLayoutBinding gbufferLayoutBinding = {
+				layoutBindingIndex++,
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				1,
+				VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+				nullptr
+			};
+			layoutBindings.emplace_back(gbufferLayoutBinding);
+		}
+
+		//offset to the counters of the frame when bound
+		VkDescriptorSetLayoutBinding rayCounterLayoutBinding = {
+			layoutBindingIndex++,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+			1,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+			nullptr
+		};
+		layoutBindings.emplace_back(rayCounterLayoutBinding);
+
+		VkDescriptorSetLayoutBinding momentsLayoutBinding = {
+			layoutBindingIndex++,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			1,
+			VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+			nullptr
+		};
+		layoutBindings.emplace_back(momentsLayoutBinding);
 		
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = {
@@ -925,7 +1896,7 @@ namespace MelonRenderer
 
 		std::vector<VkPushConstantRange> pushConstantRanges;
 		VkPushConstantRange pushConstantRangeTransforms = {};
-		pushConstantRangeTransforms.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV | VK_SHADER_STAGE_MISS_BIT_NV | VK_SHADER_STAGE_RAYGEN_BIT_NV;
+		pushConstantRangeTransforms.stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 		pushConstantRangeTransforms.offset = 0;
 		pushConstantRangeTransforms.size = sizeof(RtPushConstant);
 		pushConstantRanges.emplace_back(pushConstantRangeTransforms);
@@ -953,25 +1924,30 @@ namespace MelonRenderer
 	{
 		std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
 		VkDescriptorPoolSize accelerationStructurePoolSize = {};
-		accelerationStructurePoolSize.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
+		accelerationStructurePoolSize.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
 		accelerationStructurePoolSize.descriptorCount = 1;
 		descriptorPoolSizes.emplace_back(accelerationStructurePoolSize);
 
 		VkDescriptorPoolSize outputImagePoolSize = {};
 		outputImagePoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-		outputImagePoolSize.descriptorCount = 1;
+		outputImagePoolSize.descriptorCount = 8; //output, accumulation, denoiser features, G-buffer and moments
 		descriptorPoolSizes.emplace_back(outputImagePoolSize);
 
 		VkDescriptorPoolSize cameraPoolSize = {};
-		cameraPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		cameraPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		cameraPoolSize.descriptorCount = 1;
 		descriptorPoolSizes.emplace_back(cameraPoolSize);
 		
 		VkDescriptorPoolSize storageBufferPoolSize = {};
 		storageBufferPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		storageBufferPoolSize.descriptorCount = m_scene->m_drawables.size()*4;
+		storageBufferPoolSize.descriptorCount = m_scene->m_drawables.size()*4 + 1; //+1 for blue noise
 		descriptorPoolSizes.emplace_back(storageBufferPoolSize);
 
+		VkDescriptorPoolSize rayCounterPoolSize = {};
+		rayCounterPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		rayCounterPoolSize.descriptorCount = 1;
+		descriptorPoolSizes.emplace_back(rayCounterPoolSize);
+
 		VkDescriptorPoolSize poolSizeTextureSampler = {};
 		poolSizeTextureSampler.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		poolSizeTextureSampler.descriptorCount = m_memoryManager->GetNumberTextures();
@@ -1024,8 +2000,8 @@ namespace MelonRenderer
 		std::vector<VkWriteDescriptorSet> writes;
 		uint32_t dstBinding = 0;
 
-		VkWriteDescriptorSetAccelerationStructureNV descriptorAccelerationStructureInfo;
-		descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_NV;
+		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo;
+		descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
 		descriptorAccelerationStructureInfo.pNext = nullptr;
 		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
 		descriptorAccelerationStructureInfo.pAccelerationStructures = &m_tlas.m_accelerationStructure;
@@ -1036,7 +2012,7 @@ namespace MelonRenderer
 		accelerationStructureDescriptorSet.pNext = &descriptorAccelerationStructureInfo;
 		accelerationStructureDescriptorSet.dstSet = m_descriptorSets[0];
 		accelerationStructureDescriptorSet.descriptorCount = 1;
-		accelerationStructureDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
+		accelerationStructureDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
 		accelerationStructureDescriptorSet.pBufferInfo = nullptr;
 		accelerationStructureDescriptorSet.dstArrayElement = 0;
 		accelerationStructureDescriptorSet.dstBinding = dstBinding++;
@@ -1061,13 +2037,14 @@ namespace MelonRenderer
 		writes.emplace_back(resultWriteImageDescriptorSet);
 
 		//camera
+		VkDescriptorBufferInfo cameraDescriptor = m_camera->GetCameraDescriptor(0);
 		VkWriteDescriptorSet uniformWriteBufferDescriptorSet;
 		uniformWriteBufferDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		uniformWriteBufferDescriptorSet.pNext = nullptr;
 		uniformWriteBufferDescriptorSet.dstSet = m_descriptorSets[0];
 		uniformWriteBufferDescriptorSet.descriptorCount = 1;
-		uniformWriteBufferDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uniformWriteBufferDescriptorSet.pBufferInfo = m_camera->GetCameraDescriptor();
+		uniformWriteBufferDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		uniformWriteBufferDescriptorSet.pBufferInfo = &cameraDescriptor;
 		uniformWriteBufferDescriptorSet.pImageInfo = nullptr;
 		uniformWriteBufferDescriptorSet.dstArrayElement = 0;
 		uniformWriteBufferDescriptorSet.dstBinding = dstBinding++;
@@ -1132,9 +2109,43 @@ namespace MelonRenderer
 		indicesDescriptorSet.dstArrayElement = 0;
 		indicesDescriptorSet.dstBinding = dstBinding++;
 		writes.emplace_back(indicesDescriptorSet);
+
+		//accumulation image, written with the other storage images
+		dstBinding++;
+
+		VkDescriptorBufferInfo blueNoiseDescriptor = { m_blueNoiseBuffer, 0, VK_WHOLE_SIZE };
+
+		//blue noise
+		VkWriteDescriptorSet blueNoiseDescriptorSet;
+		blueNoiseDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		blueNoiseDescriptorSet.pNext = nullptr;
+		blueNoiseDescriptorSet.dstSet = m_descriptorSets[0];
+		blueNoiseDescriptorSet.descriptorCount = 1;
+		blueNoiseDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		blueNoiseDescriptorSet.pBufferInfo = &blueNoiseDescriptor;
+		blueNoiseDescriptorSet.dstArrayElement = 0;
+		blueNoiseDescriptorSet.dstBinding = dstBinding++;
+		writes.emplace_back(blueNoiseDescriptorSet);
+
+		//denoiser features and G-buffer, written with the other storage images
+		dstBinding += 5;
+
+		VkDescriptorBufferInfo rayCounterDescriptor = { m_rayCounterBuffer, 0, sizeof(RayCounts) };
+
+		//ray counters
+		VkWriteDescriptorSet rayCounterDescriptorSet;
+		rayCounterDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		rayCounterDescriptorSet.pNext = nullptr;
+		rayCounterDescriptorSet.dstSet = m_descriptorSets[0];
+		rayCounterDescriptorSet.descriptorCount = 1;
+		rayCounterDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		rayCounterDescriptorSet.pBufferInfo = &rayCounterDescriptor;
+		rayCounterDescriptorSet.dstArrayElement = 0;
+		rayCounterDescriptorSet.dstBinding = dstBinding++;
+		writes.emplace_back(rayCounterDescriptorSet);
 		
 		vkUpdateDescriptorSets(Device::Get().m_device, writes.size(), writes.data(), 0, nullptr);
 
-		return true;
+		return UpdateStorageImageDescriptors();
 	}
 }
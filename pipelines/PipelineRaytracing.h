@@ -1,53 +1,41 @@
 #pragma once
 
 #include "Pipeline.h"
+#include "PipelineRasterization.h"
 #include "../simple_scene_graph/Scene.h"
 #include "../imgui/imgui.h"
+#include "../Sampling.h"
+
+#include <chrono>
 
 namespace MelonRenderer
 {
-	// Bottom-level acceleration structure
-	struct BLAS
+	// Acceleration structure together with the buffer it lives in
+	struct AccelerationStructure
 	{
-		VkAccelerationStructureNV m_accelerationStructure = VK_NULL_HANDLE;
-		VkDeviceMemory m_accelerationStructureMemory = VK_NULL_HANDLE;
-		VkAccelerationStructureInfoNV m_accelerationStructureInfo = {
-		VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV,
-		nullptr,
-		VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV,
-		VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_NV,
-		1,
-		1,
-		nullptr}; 
-		uint64_t m_handle = 0;
+		VkAccelerationStructureKHR m_accelerationStructure = VK_NULL_HANDLE;
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_memory = VK_NULL_HANDLE;
+		VkDeviceSize m_size = 0;
+		VkDeviceAddress m_deviceAddress = 0;
 	};
 
-	//from vulkan spec 
+	// Bottom-level acceleration structure
+	using BLAS = AccelerationStructure;
+	// Top-level acceleration structure
+	using TLAS = AccelerationStructure;
+
+	//from vulkan spec, same layout as VkAccelerationStructureInstanceKHR
 	struct BLASInstance
 	{
-		glm::mat3x4 m_transform;
+		glm::mat3x4 m_transform; //row major, use the transposed world transform
 		uint32_t m_instanceId : 24;
 		uint32_t m_mask : 8;
 		uint32_t m_instanceOffset : 24;
 		uint32_t m_flags : 8;
-		uint64_t m_accelerationStructureHandle;
-	};
-
-	// Top-level acceleration structure
-	struct TLAS
-	{
-		VkAccelerationStructureNV m_accelerationStructure = VK_NULL_HANDLE;
-		VkDeviceMemory m_accelerationStructureMemory = VK_NULL_HANDLE;
-		VkAccelerationStructureInfoNV m_accelerationStructureInfo = {
-		VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV,
-		nullptr,
-		VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_NV,
-		VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_NV,
-		1,
-		1,
-		nullptr };
-		uint64_t m_handle = 0;
+		uint64_t m_accelerationStructureHandle; //device address of the referenced BLAS
 	};
+	static_assert(sizeof(BLASInstance) == sizeof(VkAccelerationStructureInstanceKHR), "BLASInstance has to match VkAccelerationStructureInstanceKHR");
 
 	struct RtPushConstant
 	{
@@ -55,14 +43,70 @@ namespace MelonRenderer
 		glm::vec3 lightPosition;
 		float     lightIntensity;
 		int       numberOfSamples;
+		int       frame; //number of frames already accumulated
+		int       sampler; //SamplerType
+		float     lightRadius;
+		int       sampleFrame; //seeds the samplers, keeps counting when accumulation is reset
+		int       countRays;
+		int       adaptivePass; //second trace of the frame, only adds samples to noisy pixels
+		float     adaptiveThreshold; //relative standard error a pixel is sampled down to
+		int       adaptiveMaxSamples; //per pixel and frame
+		uint32_t  adaptiveBudget; //samples of the adaptive pass over all pixels
+		int       heatmap; //shows the samples per pixel of the frame instead of the image
+	};
+
+	//images written by the raygen shader that the denoiser reads
+	struct RaytracingOutputs
+	{
+		VkImageView m_color; //linear, the accumulated result
+		VkImageView m_features; //normal and primary hit distance
+		VkImageView m_albedo;
+		VkImageView m_motion;
+		VkImageView m_output; //rgba8 image copied to the swapchain
+	};
+
+	//rays traced in one frame, summed over all pixels
+	struct RayCounts
+	{
+		uint32_t m_primary;
+		uint32_t m_shadow;
+		uint32_t m_reflection;
+		uint32_t m_adaptiveSamples; //samples requested in the adaptive pass, may exceed the budget
+	};
+
+	//everything the "Scene" window changes for raytracing, the simulation edits a copy that is applied before the frame is prepared
+	struct RaytracingSettings
+	{
+		vec3 m_clearColor = vec3(0.f, 0.4531f, 0.78125f);
+		vec3 m_lightPosition = vec3(-50.f, 50.f, -50.f);
+		float m_lightIntensity = 1.f;
+		int m_numberOfSamples = 1;
+		int m_sampler = SAMPLER_SOBOL;
+		float m_lightRadius = 0.f;
+		bool m_accumulate = true;
+		float m_tlasRebuildThreshold = 2.f;
+		bool m_adaptive = false;
+		float m_adaptiveThreshold = 0.05f;
+		int m_adaptiveMaxSamples = 8;
+		float m_adaptiveBudget = 1.f;
+		bool m_heatmap = false;
+		bool m_countRays = false;
 	};
 
-	struct ShaderBindingTableEntry
+	struct RaytracingStats
 	{
-		uint8_t shaderGroupHandle[16]; //Vulkan shader group size
-		uint32_t geometryID;
-		uint8_t padding[12]; //from size 20 to 32 bytes
-		uint8_t padding2[32];
+		uint32_t m_accumulatedFrames = 0;
+		uint32_t m_blasCount = 0;
+		uint32_t m_blasBuildBatchCount = 0;
+		float m_blasBuildTimeGPU = 0.f;
+		float m_blasBuildTimeCPU = 0.f;
+		float m_tlasUpdateTime = 0.f;
+		float m_tlasUpdateTimeAverage = 0.f;
+		uint32_t m_tlasRefitCount = 0;
+		uint32_t m_tlasRebuildCount = 0;
+		float m_tlasDegradation = 1.f;
+		RayCounts m_rayCounts = {};
+		uint32_t m_pixelCount = 0;
 	};
 
 	class PipelineRaytracing : public Pipeline
@@ -71,20 +115,51 @@ namespace MelonRenderer
 		void Init(VkPhysicalDevice& device, DeviceMemoryManager& memoryManager, VkRenderPass& renderPass, VkExtent2D windowExtent) override;
 		void Tick(VkCommandBuffer& commandBuffer) override;
 		void Fini();
+		//the shader binding table holds the group handles of the compiled pipeline
+		bool Compile() override;
 
 		void FillRenderpassInfo(Renderpass* renderpass) override;
 		void RecreateOutput(VkExtent2D& windowExtent);
 		void SetCamera(Camera* camera);
 		void SetScene(Scene* scene);
-		void SetRaytracingProperties(VkPhysicalDeviceRayTracingPropertiesNV* raytracingProperties);
+		void SetRaytracingProperties(VkPhysicalDeviceRayTracingPipelinePropertiesKHR* raytracingProperties, 
+			VkPhysicalDeviceAccelerationStructurePropertiesKHR* accelerationStructureProperties);
 
+		//reads the current instance transforms on the main thread before the next simulation may change them, the next Tick refits the TLAS
+		//or rebuilds it if the refit quality degraded, the acceleration structures are recreated right away if instances changed
 		bool UpdateTransformations();
 
 		//TODO: move
 		VkImage GetStorageImage();
 
+		//sampling and accumulation control, used by the benchmarks
+		void SetSampler(SamplerType sampler);
+		void SetSamplesPerFrame(int samples);
+		void SetLightRadius(float radius);
+		//budget is given in average extra samples per pixel, only applied while accumulating
+		void SetAdaptiveSampling(bool adaptive, float threshold = 0.05f, int maxSamples = 8, float budget = 1.f);
+		void SetAccumulate(bool accumulate);
+		void ResetAccumulation();
+		uint32_t GetAccumulatedFrames() const;
+		RaytracingStats GetStats() const;
+		const RaytracingSettings& GetSettings() const;
+		void SetSettings(const RaytracingSettings& settings);
+		//the raytracing part of the "Scene" window, only touches its arguments so the simulation can draw it on any thread, true if a setting changed
+		static bool DrawSettings(RaytracingSettings& settings, const RaytracingStats& stats);
+		bool ReadAccumulationImage(std::vector<vec4>& pixels);
+		bool ReadStorageImage(std::vector<uint32_t>& pixels);
+		RaytracingOutputs GetOutputs() const;
+
+		//hybrid mode, primary surfaces are read from the rasterized G-buffer instead of being traced
+		void SetGBuffer(const GBuffer& gbuffer);
+		void SetHybrid(bool hybrid);
+		void SetCountRays(bool countRays);
+		//waits for the queue, returns the counts of the last traced frame
+		bool ReadRayCounts(RayCounts& rayCounts);
+
 	protected:
-		VkPhysicalDeviceRayTracingPropertiesNV* m_raytracingProperties;
+		VkPhysicalDeviceRayTracingPipelinePropertiesKHR* m_raytracingProperties;
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR* m_accelerationStructureProperties;
 
 		Scene* m_scene;
 		Camera* m_camera;
@@ -93,29 +168,110 @@ namespace MelonRenderer
 		std::unordered_map<uint32_t, std::vector<uint32_t>> m_dynamicDrawableInstances;
 		std::vector<uint32_t> m_staticDrawableInstances;
 
+		//acceleration structures
+		bool CreateAccelerationStructure(VkAccelerationStructureTypeKHR type, VkDeviceSize size, AccelerationStructure& accelerationStructure);
+		void DestroyAccelerationStructure(AccelerationStructure& accelerationStructure);
+		bool CreateScratchBuffer(VkDeviceSize size, VkBuffer& scratchBuffer, VkDeviceMemory& scratchBufferMemory, VkDeviceAddress& scratchAddress);
+
 		//BLAS
-		bool ConvertToGeometryNV(std::vector<VkGeometryNV>& target, uint32_t drawableHandle);
-		bool ConvertToGeometryNV(std::vector<VkGeometryNV>& target, uint32_t drawableHandle, uint32_t instanceHandle);
+		bool ConvertToGeometry(uint32_t drawableHandle);
+		bool ConvertToGeometry(uint32_t drawableHandle, uint32_t staticTransformIndex);
 		bool PrepareDrawableInstances();
+		bool CreateStaticTransformBuffer();
 		bool CreateBLAS();
-		bool UpdateBLASInstances();
-		std::vector<std::vector<VkGeometryNV>> m_rtGeometries;
+		bool CompactBLAS(VkQueryPool compactedSizeQueryPool);
+		//copies m_blasInstances into the instance buffer of the frame slot
+		bool UpdateBLASInstances(uint32_t frame);
+		std::vector<std::vector<VkAccelerationStructureGeometryKHR>> m_rtGeometries;
+		std::vector<std::vector<VkAccelerationStructureBuildRangeInfoKHR>> m_rtBuildRanges;
 		std::vector<BLAS> m_blasVector;
+		//BLAS index for every entry of m_blasInstances
+		std::vector<uint32_t> m_blasInstanceBLASIndices;
+		VkDeviceSize m_blasSizeUncompacted = 0;
+		VkDeviceSize m_blasSizeCompacted = 0;
+
+		//scratch pool shared by all BLAS builds, kept for rebuilds and only grown when needed
+		bool ReserveBLASScratchPool(VkDeviceSize size);
+		VkBuffer m_blasScratchPool = VK_NULL_HANDLE;
+		VkDeviceMemory m_blasScratchPoolMemory = VK_NULL_HANDLE;
+		VkDeviceAddress m_blasScratchPoolAddress = 0;
+		VkDeviceSize m_blasScratchPoolSize = 0;
+		//caps the scratch pool, builds that do not fit go into the next batch
+		VkDeviceSize m_blasScratchBudget = 64 * 1024 * 1024;
+		uint32_t m_blasMaxBatchSize = 64;
+		uint32_t m_blasBuildBatchCount = 0;
+		float m_blasBuildTimeGPU = 0.f;
+		float m_blasBuildTimeCPU = 0.f;
+
+		//world transforms of all static instances, referenced by the geometries of the static BLAS
+		VkBuffer m_staticTransformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_staticTransformBufferMemory = VK_NULL_HANDLE;
 
 		//TLAS
 		bool CreateTLAS();
+		bool BuildTLAS(VkCommandBuffer& commandBuffer, bool update);
+		bool RecreateAccelerationStructures();
+		void ResetInstanceBuildBounds();
 		TLAS m_tlas;
+		VkAccelerationStructureGeometryKHR m_tlasGeometry;
+		VkBuffer m_tlasScratchBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_tlasScratchBufferMemory = VK_NULL_HANDLE;
+		VkDeviceAddress m_tlasScratchAddress = 0;
 		std::vector<BLASInstance> m_blasInstances;
-		VkBuffer m_instanceBuffer;
-		VkDeviceMemory m_instanceBufferMemory;
+		//scene instance handle for every entry of m_blasInstances, UINT32_MAX for the static BLAS and copies of instance streams
+		std::vector<uint32_t> m_blasInstanceSceneHandles;
+		//one per frame in flight, a TLAS update reads the one of its frame while the frame before may still be building from its own
+		VkBuffer m_instanceBuffers[maxFramesInFlight] = {};
+		VkDeviceMemory m_instanceBufferMemories[maxFramesInFlight] = {};
+		VkDeviceAddress m_instanceBufferAddresses[maxFramesInFlight] = {};
+		//Scene::GetInstanceListUpdate the acceleration structures were built for
+		uint64_t m_uploadedInstanceListUpdate = 0;
+		//Scene::GetInstanceStreamUpdate the acceleration structures were built for
+		uint64_t m_uploadedInstanceStreamUpdate = 0;
+		//Scene::GetTransformUpdate the instances were last read at
+		uint64_t m_uploadedTransformUpdate = 0;
+
+		//refit quality, world bounds of the instances at the last full build
+		std::vector<AABB> m_instanceBuildBounds;
+		float m_tlasDegradation = 1.f;
+		uint32_t m_tlasRefitCount = 0;
+		uint32_t m_tlasRebuildCount = 0;
+
+		//the TLAS update UpdateTransformations left for the next Tick
+		enum TLASUpdate
+		{
+			TLAS_UPDATE_NONE,
+			TLAS_UPDATE_REFIT,
+			TLAS_UPDATE_REBUILD
+		};
+		void RecordTLASUpdate(VkCommandBuffer& commandBuffer);
+		TLASUpdate m_pendingTLASUpdate = TLAS_UPDATE_NONE;
+
+		//gpu timestamps around the TLAS update, one pair of queries per frame slot
+		bool CreateTimestampQueryPool();
+		bool ReadTLASUpdateTime(uint32_t frameSlot);
+		static constexpr uint32_t m_timestampFrameSlots = 4;
+		VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+		bool m_timestampWritten[m_timestampFrameSlots] = {};
+		uint32_t m_timestampFrameSlot = 0;
+		float m_tlasUpdateTime = 0.f;
+		float m_tlasUpdateTimeAverage = 0.f;
 
 		//TODO: integrate with simple scene graph, DrawableInstance to NodeDrawable
 		//scene description
 		bool CreateSceneInformationBuffer();
+		void DestroySceneInformationBuffer();
+		//writes the instances into the staging buffer of the frame slot and replaces the pending copies
+		void StageSceneInformation(const std::vector<uint32_t>& instances);
 		
 		VkBuffer m_sceneBuffer;
 		VkDeviceMemory m_sceneBufferMemory;
 		VkDescriptorBufferInfo m_sceneBufferDescriptor;
+		//one persistently mapped staging buffer per frame in flight, copied to the scene buffer by RecordTLASUpdate
+		VkBuffer m_sceneStagingBuffers[maxFramesInFlight] = {};
+		VkDeviceMemory m_sceneStagingBufferMemories[maxFramesInFlight] = {};
+		void* m_sceneStagingData[maxFramesInFlight] = {};
+		std::vector<VkBufferCopy> m_pendingSceneCopies;
 
 		//storage image
 		VkImage m_storageImage;
@@ -124,14 +280,65 @@ namespace MelonRenderer
 		bool CreateStorageImage();
 		bool CleanupStorageImage();
 
-		//shader binding table
+		//running average of all frames since the camera, scene or light last changed
+		bool UpdateStorageImageDescriptors();
+		VkImage m_accumulationImage;
+		VkImageView m_accumulationImageView;
+		VkDeviceMemory m_accumulationImageMemory;
+		bool m_resetAccumulation = true;
+		uint32_t m_accumulatedFrames = 0;
+		uint32_t m_sampleFrame = 0;
+		CameraMatrices m_accumulationCamera;
+		RtPushConstant m_accumulationPushConstants;
+
+		//sampling
+		bool CreateBlueNoiseBuffer();
+		VkBuffer m_blueNoiseBuffer;
+		VkDeviceMemory m_blueNoiseBufferMemory;
+
+		//guide features of the primary hit for denoising
+		VkImage m_featureImage;
+		VkImageView m_featureImageView;
+		VkDeviceMemory m_featureImageMemory;
+		VkImage m_albedoImage;
+		VkImageView m_albedoImageView;
+		VkDeviceMemory m_albedoImageMemory;
+		VkImage m_motionImage;
+		VkImageView m_motionImageView;
+		VkDeviceMemory m_motionImageMemory;
+
+		//adaptive sampling, per pixel luminance moments of the running average
+		VkImage m_momentsImage;
+		VkImageView m_momentsImageView;
+		VkDeviceMemory m_momentsImageMemory;
+
+		//hybrid mode
+		GBuffer m_gbuffer;
+		bool m_hybrid = false;
+
+		//atomic ray counters written by the raygen shaders, host visible and mapped, one slot per frame in flight bound at its dynamic offset,
+		//a slot is read when it is recorded again, after its frame finished
+		bool CreateRayCounterBuffer();
+		VkBuffer m_rayCounterBuffer;
+		VkDeviceMemory m_rayCounterBufferMemory;
+		VkDeviceSize m_rayCounterStride = sizeof(RayCounts);
+		void* m_rayCounterData = nullptr;
+		RayCounts m_rayCounts = {};
+
+		//shader binding table, entries are the shader group handle followed by the geometry id
 		bool CreateShaderBindingTable();
-		VkBuffer m_shaderBindingTable;
-		VkDeviceMemory m_shaderBindingTableMemory;
+		VkBuffer m_shaderBindingTable = VK_NULL_HANDLE;
+		VkDeviceMemory m_shaderBindingTableMemory = VK_NULL_HANDLE;
 		VkDeviceSize m_shaderBindingTableStride = 64;
+		VkStridedDeviceAddressRegionKHR m_raygenRegion = {};
+		VkStridedDeviceAddressRegionKHR m_hybridRaygenRegion = {};
+		VkStridedDeviceAddressRegionKHR m_missRegion = {};
+		VkStridedDeviceAddressRegionKHR m_hitRegion = {};
+		VkStridedDeviceAddressRegionKHR m_callableRegion = {};
 		std::vector<uint32_t> m_shaderBindingGeometryIDs;
 
 		RtPushConstant m_rtPushConstants;
+		RaytracingSettings m_settings;
 
 
 		//overrides
@@ -142,11 +349,12 @@ namespace MelonRenderer
 		//shader modules
 		//---------------------------------------
 		bool CreateShaderModules() override;
-		std::vector<VkRayTracingShaderGroupCreateInfoNV> m_rtShaderGroups;
+		std::vector<VkRayTracingShaderGroupCreateInfoKHR> m_rtShaderGroups;
 		//---------------------------------------
 
 		//---------------------------------------
 		bool CreateGraphicsPipeline() override;
+		void DestroyPipelines() override;
 		//---------------------------------------
 
 		bool Draw(VkCommandBuffer& commandBuffer) override;
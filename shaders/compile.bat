@@ -2,7 +2,14 @@
 %VULKAN_SDK%/Bin32/glslc.exe shaders/shader.frag -o shaders/frag.spv
 %VULKAN_SDK%/Bin32/glslc.exe shaders/imgui.vert -o shaders/imguiVert.spv
 %VULKAN_SDK%/Bin32/glslc.exe shaders/imgui.frag -o shaders/imguiFrag.spv
-%VULKAN_SDK%/Bin32/glslc.exe shaders/raytrace.rchit -o shaders/rchit.spv
-%VULKAN_SDK%/Bin32/glslc.exe shaders/raytrace.rgen -o shaders/rgen.spv
-%VULKAN_SDK%/Bin32/glslc.exe shaders/raytrace.rmiss -o shaders/rmiss.spv
-%VULKAN_SDK%/Bin32/glslc.exe shaders/raytraceShadow.rmiss -o shaders/rmissShadow.spv
\ No newline at end of file
+%VULKAN_SDK%/Bin32/glslc.exe shaders/gbuffer.vert -o shaders/gbufferVert.spv
+%VULKAN_SDK%/Bin32/glslc.exe shaders/gbuffer.frag -o shaders/gbufferFrag.spv
+%VULKAN_SDK%/Bin32/glslc.exe --target-env=vulkan1.2 shaders/raytrace.rchit -o shaders/rchit.spv
+%VULKAN_SDK%/Bin32/glslc.exe --target-env=vulkan1.2 shaders/raytrace.rgen -o shaders/rgen.spv
+%VULKAN_SDK%/Bin32/glslc.exe --target-env=vulkan1.2 shaders/raytraceHybrid.rgen -o shaders/rgenHybrid.spv
+%VULKAN_SDK%/Bin32/glslc.exe --target-env=vulkan1.2 shaders/raytrace.rmiss -o shaders/rmiss.spv
+%VULKAN_SDK%/Bin32/glslc.exe --target-env=vulkan1.2 shaders/raytraceShadow.rmiss -o shaders/rmissShadow.spv
+%VULKAN_SDK%/Bin32/glslc.exe shaders/svgfReproject.comp -o shaders/svgfReproject.spv
+%VULKAN_SDK%/Bin32/glslc.exe shaders/svgfVariance.comp -o shaders/svgfVariance.spv
+%VULKAN_SDK%/Bin32/glslc.exe shaders/svgfAtrous.comp -o shaders/svgfAtrous.spv
+%VULKAN_SDK%/Bin32/glslc.exe shaders/svgfModulate.comp -o shaders/svgfModulate.spv
\ No newline at end of file
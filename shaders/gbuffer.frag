@@ -0,0 +1,19 @@
+#version 450
+
+// Primary surfaces for the hybrid raytracing mode, read by raytraceHybrid.rgen
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexCoord;
+layout (location = 3) flat in uint inMaterial;
+layout (location = 4) flat in uint inObjId;
+layout (location = 5) flat in vec3 inCameraPos;
+
+layout (location = 0) out vec4 outNormalDistance;
+layout (location = 1) out uvec4 outMaterial;
+
+void main() 
+{
+	outNormalDistance = vec4(normalize(inNormal), length(inPos - inCameraPos));
+	outMaterial = uvec4(inObjId, inMaterial, packHalf2x16(inTexCoord), 0);
+}
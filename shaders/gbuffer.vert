@@ -0,0 +1,58 @@
+#version 450
+
+layout(binding = 0) uniform CameraProperties
+{
+mat4 view;
+mat4 projection;
+mat4 viewInverse;
+mat4 projectionInverse;
+} cam;
+
+layout (binding = 1) uniform ObjectData {
+  mat3x4 transfo; //rows of the affine transform, vec4(p, 1) * transfo
+  uint  objId;
+  uint  txtOffset;
+} object;
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 inTexCoord;
+layout (location = 3) in uint matID;
+//compact instance, the identity for draws of single instances
+layout (location = 4) in vec4 instancePositionScale;
+layout (location = 5) in vec4 instanceRotation; //quaternion
+layout (location = 6) in uint instanceMaterial; //0xFFFFFFFF keeps matID
+
+layout (location = 0) out vec3 outPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outTexCoord;
+layout (location = 3) flat out uint outMaterial;
+layout (location = 4) flat out uint outObjId;
+layout (location = 5) flat out vec3 outCameraPos;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() 
+{
+	vec4 rotation = normalize(instanceRotation);
+	vec3 instancePos = rotate(rotation, pos * instancePositionScale.w) + instancePositionScale.xyz;
+	vec3 instanceNormal = rotate(rotation, normal);
+	vec4 worldPos = vec4(vec4(instancePos, 1) * object.transfo, 1);
+
+	gl_Position = cam.projection * cam.view * worldPos;
+
+	//the cofactor matrix is the inverse transpose times the determinant, only its sign matters before normalizing
+	vec3 row0 = object.transfo[0].xyz;
+	vec3 row1 = object.transfo[1].xyz;
+	vec3 row2 = object.transfo[2].xyz;
+	mat3 cofactors = mat3(cross(row1, row2), cross(row2, row0), cross(row0, row1));
+	outPos = worldPos.xyz;
+	outNormal = instanceNormal * cofactors * sign(dot(row0, cross(row1, row2)));
+	outTexCoord = inTexCoord;
+	outMaterial = instanceMaterial == 0xFFFFFFFFu ? matID : instanceMaterial;
+	outObjId = object.objId;
+	outCameraPos = cam.viewInverse[3].xyz;
+}
@@ -6,14 +6,23 @@ struct hitPayload
   vec3 hitValue;
   int done;
   int depth;
+  uint seed;            // state of the random sampler
+  uint sampleIndex;     // index into the sample sequence of this pixel
+  uint sampleDimension; // next unused dimension of the sample
+  // features of the primary hit, written by the closest hit shader at depth 0
+  vec3 primaryNormal;
+  float primaryDistance; // negative if the primary ray missed
+  vec3 primaryAlbedo;
+  uint shadowRays;       // shadow rays traced along the path, for statistics
 };
 
 struct sceneDesc
 {
-  mat4 transfo;
-  mat4 transfoIT;
+  mat3x4 transfo; //rows of the affine transform, vec4(p, 1) * transfo
   int  objId;
   int  txtOffset;
+  int  padding0; //matches the 16 byte alignment of DrawableInstance
+  int  padding1;
 };
 
 struct Vertex
@@ -0,0 +1,90 @@
+// Adaptive sample counts, accumulation, output and denoiser features of a pixel, shared by both raygen shaders.
+// Expects the storage images, rayCounters, cam and pushC to be declared before.
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Samples a pixel traces in this pass, 0 skips it. The adaptive pass only adds samples where the relative standard
+// error of the running average is above the threshold, until the sample budget of the frame is used up.
+int pixelSamples()
+{
+    if(pushC.adaptivePass == 0)
+        return pushC.samples;
+
+    ivec2 pixel = ivec2(gl_LaunchIDEXT.xy);
+    vec4 moments = imageLoad(momentsImage, pixel);
+    float n = imageLoad(accumulationImage, pixel).w;
+
+    // Error of the mean falls with 1/sqrt(n), a single sample gives no variance estimate yet
+    float needed = float(pushC.adaptiveMaxSamples);
+    if(n > 1.0)
+    {
+        float variance = max(moments.y - moments.x * moments.x, 0.0) * n / (n - 1.0);
+        float error = sqrt(variance / n) / (moments.x + 0.01);
+        if(error <= pushC.adaptiveThreshold)
+            return 0;
+        float ratio = error / pushC.adaptiveThreshold;
+        needed = ceil(n * (ratio * ratio - 1.0));
+    }
+    uint samples = uint(min(needed, float(pushC.adaptiveMaxSamples)));
+
+    uint used = atomicAdd(rayCounters.adaptiveSamples, samples);
+    if(used >= pushC.adaptiveBudget)
+        return 0;
+    return int(min(samples, pushC.adaptiveBudget - used));
+}
+
+// Index of the first sample of this pass in the sample sequence of the pixel
+uint firstSampleIndex()
+{
+    if(pushC.frame > 0 || pushC.adaptivePass != 0)
+        return uint(imageLoad(accumulationImage, ivec2(gl_LaunchIDEXT.xy)).w);
+    return uint(pushC.sampleFrame * pushC.samples);
+}
+
+vec3 heatmapColor(float t)
+{
+    t = clamp(t, 0.0, 1.0);
+    return vec3(smoothstep(0.5, 1.0, t), 1.0 - abs(2.0 * t - 1.0), 1.0 - smoothstep(0.0, 0.5, t));
+}
+
+void storePixel(vec3 hitValues, vec2 luminanceMoments, int samples, vec3 primaryNormal, float primaryDistance, vec3 primaryAlbedo, vec3 primaryDirection)
+{
+    ivec2 pixel = ivec2(gl_LaunchIDEXT.xy);
+
+    // Blend into the running average, weighted by the number of samples the pixel already has
+    float accumulatedSamples = 0.0;
+    vec4 moments = vec4(0);
+    if(pushC.frame > 0 || pushC.adaptivePass != 0)
+    {
+        vec4 accumulated = imageLoad(accumulationImage, pixel);
+        moments = imageLoad(momentsImage, pixel);
+        accumulatedSamples = accumulated.w;
+        float weight = float(samples) / (accumulatedSamples + float(samples));
+        hitValues = mix(accumulated.xyz, hitValues, weight);
+        luminanceMoments = mix(moments.xy, luminanceMoments, weight);
+    }
+    float frameSamples = pushC.adaptivePass != 0 ? moments.z + float(samples) : float(samples);
+    imageStore(accumulationImage, pixel, vec4(hitValues, accumulatedSamples + float(samples)));
+    imageStore(momentsImage, pixel, vec4(luminanceMoments, frameSamples, 0.0));
+
+    vec3 color = pushC.heatmap != 0 ? heatmapColor(frameSamples / float(pushC.samples + pushC.adaptiveMaxSamples)) : hitValues;
+    imageStore(image, pixel, vec4(color.zyx, 1.0));
+
+    // Features are kept from the first pass of the frame
+    if(pushC.adaptivePass != 0)
+        return;
+
+    // Reproject the primary hit, misses are treated as infinitely far away
+    vec3 cameraPosition = (cam.viewInverse * vec4(0, 0, 0, 1)).xyz;
+    vec4 previousClip = primaryDistance < 0.0 ? cam.previousViewProjection * vec4(primaryDirection, 0.0)
+        : cam.previousViewProjection * vec4(cameraPosition + primaryDirection * primaryDistance, 1.0);
+    vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    vec2 currentUV = (vec2(gl_LaunchIDEXT.xy) + 0.5) / vec2(gl_LaunchSizeEXT.xy);
+
+    imageStore(featureImage, pixel, vec4(primaryNormal, primaryDistance));
+    imageStore(albedoImage, pixel, vec4(primaryAlbedo, 1.0));
+    imageStore(motionImage, pixel, vec4(previousUV - currentUV, 0.0, 0.0));
+}
@@ -0,0 +1,97 @@
+// Sample generators for the path tracer, selected at runtime with pushC.sampler.
+// Every call to sample2D consumes two dimensions, the dimension counter travels with the payload
+// so raygen and closest hit draw from the same sequence.
+// Requires random.glsl and the blueNoise buffer to be declared before inclusion.
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+
+#define BLUE_NOISE_SIZE 64
+
+uint hashUint(uint x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+uint hashCombine(uint seed, uint v)
+{
+  return seed ^ (hashUint(v) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// Second Sobol dimension, the first one is the bit reversed index
+uint sobolSecondDimension(uint index)
+{
+  uint v = 1u << 31;
+  uint result = 0;
+  for(; index != 0; index >>= 1, v ^= v >> 1)
+  {
+    if((index & 1u) != 0)
+      result ^= v;
+  }
+  return result;
+}
+
+// Owen scrambling with a hash, see Burley, "Practical Hash-based Owen Scrambling"
+uint laineKarrasPermutation(uint x, uint seed)
+{
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+uint nestedUniformScramble(uint x, uint seed)
+{
+  x = bitfieldReverse(x);
+  x = laineKarrasPermutation(x, seed);
+  return bitfieldReverse(x);
+}
+
+// Shuffled and scrambled 2D Sobol, every dimension pair gets its own seed
+vec2 sobolOwen2D(uint index, uint seed)
+{
+  uint shuffledIndex = nestedUniformScramble(index, hashCombine(seed, 0u));
+  uint x = nestedUniformScramble(bitfieldReverse(shuffledIndex), hashCombine(seed, 1u));
+  uint y = nestedUniformScramble(sobolSecondDimension(shuffledIndex), hashCombine(seed, 2u));
+  // 24 bits are all a float in [0, 1) can hold
+  return vec2(x >> 8, y >> 8) / float(1u << 24);
+}
+
+// Blue noise tile decorrelated per dimension by R2 offsets, animated over samples with the R2 sequence
+vec2 blueNoise2D(uvec2 pixel, uint index, uint dimension)
+{
+  const vec2 r2 = vec2(0.7548776662, 0.5698402910);
+  uvec2 offset = uvec2(fract(r2 * float(dimension + 1)) * BLUE_NOISE_SIZE);
+  uvec2 p0 = (pixel + offset) % BLUE_NOISE_SIZE;
+  uvec2 p1 = (pixel + offset + uvec2(BLUE_NOISE_SIZE / 2, BLUE_NOISE_SIZE / 3)) % BLUE_NOISE_SIZE;
+  vec2 value = vec2(blueNoise.v[p0.y * BLUE_NOISE_SIZE + p0.x], blueNoise.v[p1.y * BLUE_NOISE_SIZE + p1.x]);
+  return fract(value + r2 * float(index));
+}
+
+vec2 sample2D(int samplerType, uint sampleIndex, inout uint dimension, inout uint seed)
+{
+  uint currentDimension = dimension;
+  dimension += 2;
+
+  if(samplerType == SAMPLER_SOBOL)
+  {
+    uint pixelSeed = hashUint(gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x);
+    return sobolOwen2D(sampleIndex, hashCombine(pixelSeed, currentDimension));
+  }
+  if(samplerType == SAMPLER_BLUE_NOISE)
+  {
+    return blueNoise2D(gl_LaunchIDEXT.xy, sampleIndex, currentDimension);
+  }
+
+  float r1 = rnd(seed);
+  float r2 = rnd(seed);
+  return vec2(r1, r2);
+}
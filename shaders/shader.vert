@@ -9,8 +9,7 @@ mat4 projectionInverse;
 } cam;
 
 layout (binding = 1) uniform ObjectData {
-  mat4 transfo;
-  mat4 transfoIT;
+  mat3x4 transfo; //rows of the affine transform, vec4(p, 1) * transfo
   uint  objId;
   uint  txtOffset;
 } object;
@@ -19,6 +18,10 @@ layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 inTexCoord;
 layout (location = 3) in uint matID;
+//compact instance, the identity for draws of single instances
+layout (location = 4) in vec4 instancePositionScale;
+layout (location = 5) in vec4 instanceRotation; //quaternion
+layout (location = 6) in uint instanceMaterial; //0xFFFFFFFF keeps matID
 
 layout (location = 0) out vec3 outPos;
 layout (location = 1) out vec3 outNormal;
@@ -27,18 +30,25 @@ layout (location = 3) out vec2 outTexCoord;
 layout (location = 4) flat out uint outMaterial;
 layout (location = 5) flat out uint outObjId;
 
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main() 
 {
-	vec4 transformedPos = vec4(pos, 1);
+	vec4 rotation = normalize(instanceRotation);
+	vec3 instancePos = rotate(rotation, pos * instancePositionScale.w) + instancePositionScale.xyz;
+	vec3 instanceNormal = rotate(rotation, normal);
+	vec4 transformedPos = vec4(vec4(instancePos, 1) * object.transfo, 1);
 
-	gl_Position = cam.projection * cam.view * object.transfo * transformedPos;
+	gl_Position = cam.projection * cam.view * transformedPos;
 
-	//redundant calculation?
-	outPos = vec3(object.transfo * transformedPos);
-	outNormal = normal;
+	outPos = transformedPos.xyz;
+	outNormal = instanceNormal;
 	outViewPos = cam.view[3].xyz;
 	outViewPos = vec3(0, 0, 0); //debug, specular calculation not working correctly
 	outTexCoord = inTexCoord;
-	outMaterial = matID;
+	outMaterial = instanceMaterial == 0xFFFFFFFFu ? matID : instanceMaterial;
 	outObjId = object.objId;
 }
\ No newline at end of file
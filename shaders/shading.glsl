@@ -0,0 +1,62 @@
+// Direct light of the spherical light including its shadow ray, shared by the closest hit and the hybrid raygen shader.
+// Expects topLevelAS, the isShadowed payload at location 1, pushC and sampler.glsl to be declared before.
+
+vec3 shadeDirect(WaveFrontMaterial mat, vec3 texel, vec3 worldPos, vec3 normal, vec3 viewDir,
+                 uint sampleIndex, inout uint sampleDimension, inout uint seed, inout uint shadowRays)
+{
+  //TODO: other types of lights
+  // Point on the spherical light, a radius of 0 is a point light
+  vec2 lightSample = sample2D(pushC.sampler, sampleIndex, sampleDimension, seed);
+  float lightZ = 1.0 - 2.0 * lightSample.x;
+  float lightPhi = 2.0 * 3.14159265 * lightSample.y;
+  vec3 lightOffset = vec3(sqrt(max(0.0, 1.0 - lightZ * lightZ)) * vec2(cos(lightPhi), sin(lightPhi)), lightZ);
+  vec3 lDir = pushC.lightPosition + pushC.lightRadius * lightOffset - worldPos;
+  float lightDistance   = length(lDir);
+  //lightIntensity = pushC.lightIntensity / lightDistance * lightDistance; //this is a way too harsh falloff
+  vec3 L = normalize(lDir);
+
+  // Lambertian
+  vec3 diffuse = vec3(0);
+  if(mat.illum >= 1)
+  {
+    float dotNL = max(dot(normal, L), 0.0);
+    diffuse = vec3(mat.diffuse) * dotNL + vec3(mat.ambient);
+  }
+  diffuse *= texel;
+
+  vec3  specular    = vec3(0);
+  //this was missing from the nvidia tutorial, no shadow for faces facing away from light otherwise
+  float attenuation = 0.3;
+
+  // Tracing shadow ray only if the light is visible from the surface
+  if(dot(normal, L) > 0)
+  {
+    float tMin   = 0.001;
+    float tMax   = lightDistance;
+    uint  flags = gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsOpaqueEXT | gl_RayFlagsSkipClosestHitShaderEXT;
+    isShadowed = true;
+
+    traceRayEXT(topLevelAS,  // acceleration structure
+            flags,       // rayFlags
+            0xFF,        // cullMask
+            0,           // sbtRecordOffset
+            0,           // sbtRecordStride
+            1,           // missIndex
+            worldPos,    // ray origin
+            tMin,        // ray min range
+            L,           // ray direction
+            tMax,        // ray max range
+            1            // payload (location = 1)
+    );
+    shadowRays++;
+
+    if(!isShadowed)
+    {
+      attenuation = 1.0;
+      // Specular
+      specular = computeSpecular(mat, viewDir, L, normal);
+    }
+  }
+
+  return pushC.lightIntensity * attenuation * (diffuse + specular);
+}
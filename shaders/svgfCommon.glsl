@@ -0,0 +1,62 @@
+// Shared resources of the SVGF denoiser passes, all images stay in the general layout
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0, set = 0, rgba32f) uniform readonly image2D colorImage;   // noisy raytraced color
+layout(binding = 1, set = 0, rgba32f) uniform readonly image2D featureImage; // normal, primary hit distance, negative on miss
+layout(binding = 2, set = 0, rgba16f) uniform readonly image2D albedoImage;
+layout(binding = 3, set = 0, rgba16f) uniform readonly image2D motionImage;  // offset to the previous frame in uv
+layout(binding = 4, set = 0, rgba32f) uniform image2D previousFeatureImage;
+layout(binding = 5, set = 0, rgba32f) uniform image2D historyImage;          // filtered illumination of the last frame
+layout(binding = 6, set = 0, rgba32f) uniform image2D previousMomentsImage;
+layout(binding = 7, set = 0, rgba32f) uniform image2D momentsImage;          // luminance moments, history length
+layout(binding = 8, set = 0, rgba32f) uniform image2D pingImage;             // illumination, variance
+layout(binding = 9, set = 0, rgba32f) uniform image2D pongImage;
+layout(binding = 10, set = 0, rgba8) uniform writeonly image2D outputImage;
+
+layout(push_constant) uniform Constants
+{
+  int   stepSize;
+  int   readPing;     // the pass reads ping and writes pong, or the other way around
+  int   historyValid;
+  int   writeHistory;
+  float alpha;        // minimum weight of the new frame in the temporal blend
+  float momentsAlpha;
+  float phiColor;
+  float phiNormal;
+  float phiDepth;
+} pushC;
+
+float luminance(vec3 color)
+{
+  return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+bool insideImage(ivec2 pixel, ivec2 size)
+{
+  return all(greaterThanEqual(pixel, ivec2(0))) && all(lessThan(pixel, size));
+}
+
+vec4 loadIllumination(ivec2 pixel)
+{
+  return pushC.readPing != 0 ? imageLoad(pingImage, pixel) : imageLoad(pongImage, pixel);
+}
+
+void storeIllumination(ivec2 pixel, vec4 value)
+{
+  if(pushC.readPing != 0)
+    imageStore(pongImage, pixel, value);
+  else
+    imageStore(pingImage, pixel, value);
+}
+
+// Edge stopping weight of the primary hit distance, relative so it works at any distance
+float depthWeight(float centerDistance, float sampleDistance, float pixelDistance)
+{
+  return exp(-abs(centerDistance - sampleDistance) / (pushC.phiDepth * centerDistance * pixelDistance + 1e-4));
+}
+
+float normalWeight(vec3 centerNormal, vec3 sampleNormal)
+{
+  return pow(max(dot(centerNormal, sampleNormal), 0.0), pushC.phiNormal);
+}
@@ -0,0 +1,74 @@
+#include "HandlePool.h"
+
+namespace MelonRenderer
+{
+	uint32_t HandlePool::Create(uint32_t index)
+	{
+		uint32_t slot;
+		if (m_firstFree != m_invalidHandle)
+		{
+			slot = m_firstFree;
+			m_firstFree = m_indices[slot];
+			if (m_firstFree == m_invalidHandle)
+				m_lastFree = m_invalidHandle;
+		}
+		else
+		{
+			//the last slot would make the highest generation's handle m_invalidHandle
+			if (m_indices.size() >= m_indexMask)
+			{
+				Logger::Log("Could not create a handle, all slots are taken.");
+				return m_invalidHandle;
+			}
+
+			slot = static_cast<uint32_t>(m_indices.size());
+			m_indices.emplace_back();
+			m_generations.emplace_back(0);
+		}
+
+		m_indices[slot] = index;
+		return (static_cast<uint32_t>(m_generations[slot]) << m_indexBits) | slot;
+	}
+
+	void HandlePool::Destroy(uint32_t handle)
+	{
+		const uint32_t slot = handle & m_indexMask;
+		m_generations[slot]++;
+		m_indices[slot] = m_invalidHandle;
+		if (m_lastFree != m_invalidHandle)
+			m_indices[m_lastFree] = slot;
+		else
+			m_firstFree = slot;
+		m_lastFree = slot;
+	}
+
+	void HandlePool::Reserve(size_t count)
+	{
+		m_indices.reserve(count);
+		m_generations.reserve(count);
+	}
+
+	void HandlePool::Clear()
+	{
+		m_indices.clear();
+		m_generations.clear();
+		m_firstFree = m_invalidHandle;
+		m_lastFree = m_invalidHandle;
+	}
+
+	bool HandlePool::IsValid(uint32_t handle) const
+	{
+		const uint32_t slot = handle & m_indexMask;
+		return handle != m_invalidHandle && slot < m_generations.size() && m_generations[slot] == handle >> m_indexBits;
+	}
+
+	uint32_t HandlePool::GetIndex(uint32_t handle) const
+	{
+		return m_indices[handle & m_indexMask];
+	}
+
+	void HandlePool::SetIndex(uint32_t handle, uint32_t index)
+	{
+		m_indices[handle & m_indexMask] = index;
+	}
+}
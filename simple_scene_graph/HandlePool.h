@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../Basics.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	//generational handles for objects the owner keeps in dense arrays and moves around on removal,
+	//the low 24 bits of a handle select a slot holding the object's dense index, the high 8 bits are the slot's generation,
+	//which changes when the object is destroyed, so stale handles are caught until a slot was reused 256 times,
+	//freed slots are reused oldest first, a pool that never destroyed anything hands out handles equal to the dense index
+	class HandlePool
+	{
+	public:
+		static constexpr uint32_t m_invalidHandle = UINT32_MAX;
+		static constexpr uint32_t m_indexBits = 24;
+		static constexpr uint32_t m_indexMask = (1u << m_indexBits) - 1;
+
+		//m_invalidHandle once every slot is taken
+		uint32_t Create(uint32_t index);
+		void Destroy(uint32_t handle);
+		void Reserve(size_t count);
+		void Clear();
+
+		bool IsValid(uint32_t handle) const;
+		//handle has to be valid
+		uint32_t GetIndex(uint32_t handle) const;
+		//after the owner moved the object
+		void SetIndex(uint32_t handle, uint32_t index);
+
+	protected:
+		std::vector<uint32_t> m_indices;
+		std::vector<uint8_t> m_generations;
+		//free slots are linked through m_indices
+		uint32_t m_firstFree = m_invalidHandle;
+		uint32_t m_lastFree = m_invalidHandle;
+	};
+}
@@ -0,0 +1,111 @@
+#include "InstanceIndex.h"
+#include "Scene.h"
+
+namespace MelonRenderer
+{
+	void InstanceIndex::Build(const Scene& scene)
+	{
+		m_scene = &scene;
+		Rebuild();
+		m_rebuildCount = 0;
+	}
+
+	void InstanceIndex::Update(const std::vector<uint32_t>& changedInstances)
+	{
+		if (m_instanceBounds.size() != m_scene->m_drawableInstances.size())
+		{
+			Rebuild();
+			return;
+		}
+
+		if (changedInstances.empty())
+			return;
+
+		for (uint32_t instance : changedInstances)
+		{
+			UpdateBounds(instance);
+		}
+
+		//walking up from every leaf only pays off while few instances moved
+		if (changedInstances.size() * 8 < m_instanceBounds.size())
+			m_bvh.Refit(m_instanceBounds, changedInstances);
+		else
+			m_bvh.Refit(m_instanceBounds);
+
+		if (m_bvh.GetSurfaceAreaSum() > m_rebuildThreshold * m_builtSurfaceAreaSum)
+		{
+			m_bvh.Build(m_instanceBounds);
+			m_builtSurfaceAreaSum = m_bvh.GetSurfaceAreaSum();
+			m_rebuildCount++;
+		}
+	}
+
+	void InstanceIndex::Rebuild()
+	{
+		m_instanceBounds.resize(m_scene->m_drawableInstances.size());
+		for (uint32_t instance = 0; instance < m_instanceBounds.size(); instance++)
+		{
+			UpdateBounds(instance);
+		}
+
+		m_bvh.Build(m_instanceBounds);
+		m_builtSurfaceAreaSum = m_bvh.GetSurfaceAreaSum();
+		m_rebuildCount++;
+	}
+
+	void InstanceIndex::UpdateBounds(uint32_t instance)
+	{
+		const DrawableInstance& drawableInstance = m_scene->m_drawableInstances[instance];
+		m_instanceBounds[instance] = m_scene->m_drawables[drawableInstance.m_drawableIndex].GetBoundingBox().Transform(drawableInstance.m_transformation);
+	}
+
+	void InstanceIndex::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& instances) const
+	{
+		instances.clear();
+		m_bvh.Query([&](const AABB& bounds) { return frustum.Intersects(bounds); }, [&](uint32_t instance)
+			{
+				//leaves hold up to four instances
+				if (frustum.Intersects(m_instanceBounds[instance]))
+					instances.emplace_back(instance);
+			});
+	}
+
+	void InstanceIndex::QuerySphere(const vec3& center, float radius, std::vector<uint32_t>& instances) const
+	{
+		instances.clear();
+		m_bvh.QuerySphere(center, radius, [&](uint32_t instance, float& sphereRadius)
+			{
+				if (SquaredDistance(m_instanceBounds[instance], center) <= sphereRadius * sphereRadius)
+					instances.emplace_back(instance);
+			});
+	}
+
+	void InstanceIndex::QueryRay(const Ray& ray, std::vector<uint32_t>& instances) const
+	{
+		instances.clear();
+		Ray queryRay = ray;
+		const vec3 inverseDirection = 1.f / ray.m_direction;
+		//nothing counts as a hit, so m_tMax is never shortened and every overlapped leaf is visited
+		m_bvh.Traverse(queryRay, [&](uint32_t instance, Ray& traversedRay)
+			{
+				if (IntersectAABB(m_instanceBounds[instance], traversedRay, inverseDirection) != FLT_MAX)
+					instances.emplace_back(instance);
+				return false;
+			}, false);
+	}
+
+	const AABB& InstanceIndex::GetBounds(uint32_t instance) const
+	{
+		return m_instanceBounds[instance];
+	}
+
+	size_t InstanceIndex::GetInstanceCount() const
+	{
+		return m_instanceBounds.size();
+	}
+
+	uint32_t InstanceIndex::GetRebuildCount() const
+	{
+		return m_rebuildCount;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../cpu_raytracing/BVH.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	class Scene;
+
+	//binary BVH over the world bounds of the drawable instances, for culling, picking and light queries,
+	//refit for moved instances and rebuilt once the refits made it too expensive to traverse
+	class InstanceIndex
+	{
+	public:
+		//bounds come from the drawables, call after they are loaded
+		void Build(const Scene& scene);
+		//changedInstances as given by Scene::GetChangedInstances, added instances cause a rebuild
+		void Update(const std::vector<uint32_t>& changedInstances);
+
+		//instances whose bounds overlap, instances is cleared first and has no particular order
+		void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& instances) const;
+		void QuerySphere(const vec3& center, float radius, std::vector<uint32_t>& instances) const;
+		//instances whose bounds the ray enters between m_tMin and m_tMax
+		void QueryRay(const Ray& ray, std::vector<uint32_t>& instances) const;
+
+		const AABB& GetBounds(uint32_t instance) const;
+		size_t GetInstanceCount() const;
+		uint32_t GetRebuildCount() const;
+
+	protected:
+		//a rebuild pays off once the summed node surface area grew by this factor
+		static constexpr float m_rebuildThreshold = 1.5f;
+
+		void Rebuild();
+		void UpdateBounds(uint32_t instance);
+
+		const Scene* m_scene = nullptr;
+		std::vector<AABB> m_instanceBounds;
+		BVH m_bvh;
+		float m_builtSurfaceAreaSum = 0.f;
+		uint32_t m_rebuildCount = 0;
+	};
+}
@@ -0,0 +1,54 @@
+#include "InstanceStream.h"
+
+#include <cmath>
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		uint32_t PackSnorm16(float value)
+		{
+			value = value < -1.f ? -1.f : (value > 1.f ? 1.f : value);
+			return static_cast<uint16_t>(static_cast<int16_t>(std::round(value * 32767.f)));
+		}
+
+		//what the vertex input of a VK_FORMAT_R16G16B16A16_SNORM attribute returns
+		float UnpackSnorm16(uint32_t value)
+		{
+			float unpacked = static_cast<int16_t>(static_cast<uint16_t>(value)) / 32767.f;
+			return unpacked < -1.f ? -1.f : unpacked;
+		}
+	}
+
+	CompactInstance PackCompactInstance(const vec3& position, const vec4& rotation, float scale, uint32_t materialOverride)
+	{
+		CompactInstance instance;
+		instance.m_position[0] = position.x;
+		instance.m_position[1] = position.y;
+		instance.m_position[2] = position.z;
+		instance.m_scale = scale;
+		instance.m_rotation[0] = PackSnorm16(rotation.x) | (PackSnorm16(rotation.y) << 16);
+		instance.m_rotation[1] = PackSnorm16(rotation.z) | (PackSnorm16(rotation.w) << 16);
+		instance.m_materialOverride = materialOverride;
+		instance.m_padding = 0;
+		return instance;
+	}
+
+	AffineTransform UnpackTransform(const CompactInstance& instance)
+	{
+		vec4 q = vec4(UnpackSnorm16(instance.m_rotation[0]), UnpackSnorm16(instance.m_rotation[0] >> 16),
+			UnpackSnorm16(instance.m_rotation[1]), UnpackSnorm16(instance.m_rotation[1] >> 16));
+		float length = glm::length(q);
+		q = length > 0.f ? q / length : vec4(0.f, 0.f, 0.f, 1.f);
+
+		const float s = instance.m_scale;
+		AffineTransform transform;
+		transform.m_rows[0] = vec4(s * (1.f - 2.f * (q.y * q.y + q.z * q.z)), s * 2.f * (q.x * q.y - q.z * q.w), s * 2.f * (q.x * q.z + q.y * q.w),
+			instance.m_position[0]);
+		transform.m_rows[1] = vec4(s * 2.f * (q.x * q.y + q.z * q.w), s * (1.f - 2.f * (q.x * q.x + q.z * q.z)), s * 2.f * (q.y * q.z - q.x * q.w),
+			instance.m_position[1]);
+		transform.m_rows[2] = vec4(s * 2.f * (q.x * q.z - q.y * q.w), s * 2.f * (q.y * q.z + q.x * q.w), s * (1.f - 2.f * (q.x * q.x + q.y * q.y)),
+			instance.m_position[2]);
+		return transform;
+	}
+}
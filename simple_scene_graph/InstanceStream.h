@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../Basics.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	//32 bytes per copy instead of a 64 byte DrawableInstance and a hierarchy node, read by shader.vert as instance rate vertex attributes
+	struct CompactInstance
+	{
+		float m_position[3];
+		float m_scale; //uniform
+		uint32_t m_rotation[2]; //unit quaternion x, y, z, w as snorm16
+		uint32_t m_materialOverride; //material of the drawable used for every triangle, m_noMaterialOverride keeps the vertices' ones
+		uint32_t m_padding;
+
+		static constexpr uint32_t m_noMaterialOverride = UINT32_MAX;
+	};
+	static_assert(sizeof(CompactInstance) == 32, "CompactInstance is read with a stride of 32 bytes");
+
+	//rotation is a unit quaternion as x, y, z, w
+	CompactInstance PackCompactInstance(const vec3& position, const vec4& rotation, float scale,
+		uint32_t materialOverride = CompactInstance::m_noMaterialOverride);
+	//the same transform the shaders apply, the rotation is renormalized after unpacking
+	AffineTransform UnpackTransform(const CompactInstance& instance);
+
+	//copies of a single drawable without nodes or handles, for vegetation and crowds, drawn with one instanced call
+	//and added to the TLAS as one instance per copy, copies are only added and cleared in bulk
+	struct InstanceStream
+	{
+		uint32_t m_drawableIndex;
+		std::vector<CompactInstance> m_instances;
+		//world space, of all copies
+		AABB m_bounds;
+	};
+}
@@ -1,7 +1,12 @@
 #include "Scene.h"
+#include "../cpu_raytracing/CpuScene.h"
 
 namespace MelonRenderer
 {
+	Scene::Scene()
+	{
+	}
+
 	Scene::~Scene()
 	{
 		for (auto& drawable : m_drawables)
@@ -12,43 +17,248 @@ namespace MelonRenderer
 
 	void Scene::UpdateInstanceTransforms()
 	{
-		typedef std::pair<Node*, mat4> NodeCall;
-
-		std::stack<NodeCall> nodeCallStack;
+		m_hierarchy.UpdateWorldTransforms();
+		for (uint32_t instance : m_hierarchy.GetRemovedDrawableInstances())
+		{
+			//may have been removed on its own already
+			if (m_instanceHandles.IsValid(instance))
+				RemoveDrawableInstance(instance);
+		}
 
-		for (auto rootChild : m_rootChildren)
+		//removals after a creation or move can leave indices behind the end
+		m_changedInstances.clear();
+		for (uint32_t index : m_pendingChangedInstances)
 		{
-			nodeCallStack.emplace(std::make_pair(rootChild, mat4(1.f)));
+			if (index < m_drawableInstances.size())
+				m_changedInstances.emplace_back(index);
 		}
+		m_pendingChangedInstances.clear();
 
-		while (!nodeCallStack.empty())
+		const std::vector<uint32_t>& changedNodes = m_hierarchy.GetChangedNodes();
+		const std::vector<uint32_t>& nodeInstances = m_hierarchy.GetDrawableInstances();
+		const std::vector<AffineTransform>& worldTransforms = m_hierarchy.GetWorldTransforms();
+		auto updateInstances = [&](uint32_t task)
 		{
-			NodeCall nodeCall = nodeCallStack.top();
-			nodeCallStack.pop();
+			const size_t begin = static_cast<size_t>(task) * m_transformGrainSize;
+			const size_t end = begin + m_transformGrainSize < changedNodes.size() ? begin + m_transformGrainSize : changedNodes.size();
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint32_t drawableInstance = nodeInstances[changedNodes[i]];
+				if (!m_instanceHandles.IsValid(drawableInstance))
+					continue;
 
-			uint32_t* drawableHandle = nullptr;
-			auto parentMat = nodeCall.first->CalculateWorldTransform(nodeCall.second, &drawableHandle);
-			if (drawableHandle != nullptr)
+				m_drawableInstances[m_instanceHandles.GetIndex(drawableInstance)].m_transformation = worldTransforms[changedNodes[i]];
+			}
+		};
+		//every instance belongs to one node, so tasks never write the same instance
+		const uint32_t taskCount = static_cast<uint32_t>((changedNodes.size() + m_transformGrainSize - 1) / m_transformGrainSize);
+		if (m_threadPool && m_threadPool->GetThreadCount() > 1 && taskCount > 1)
+		{
+			m_threadPool->ParallelFor(taskCount, updateInstances);
+		}
+		else
+		{
+			for (uint32_t task = 0; task < taskCount; task++)
 			{
-				m_drawableInstances[*drawableHandle].m_transformation = parentMat;
-				m_drawableInstances[*drawableHandle].m_transformationInverseTranspose = glm::inverse(glm::transpose(parentMat));
+				updateInstances(task);
 			}
-			for (auto child : nodeCall.first->m_children)
+		}
+
+		for (uint32_t node : changedNodes)
+		{
+			const uint32_t drawableInstance = nodeInstances[node];
+			if (m_instanceHandles.IsValid(drawableInstance))
+				m_changedInstances.emplace_back(m_instanceHandles.GetIndex(drawableInstance));
+		}
+		//neighbouring instances can be uploaded as one range
+		std::sort(m_changedInstances.begin(), m_changedInstances.end());
+		m_changedInstances.erase(std::unique(m_changedInstances.begin(), m_changedInstances.end()), m_changedInstances.end());
+		m_transformUpdate++;
+
+		//both only read the instances, so the refit runs alongside the spatial index update
+		if (m_rayQueries && m_spatialIndex && m_threadPool->GetThreadCount() > 1)
+		{
+			if (!m_refitGraph)
 			{
-				nodeCallStack.emplace(std::make_pair(child, parentMat));
+				m_refitGraph = std::make_unique<TaskGraph>();
+				m_refitGraph->AddTask("ray query refit", [this]() { m_rayQueries->UpdateInstances(m_changedInstances); });
+				m_refitGraph->AddTask("spatial index update", [this]() { m_spatialIndex->Update(m_changedInstances); });
 			}
+			m_threadPool->Run(*m_refitGraph);
+			return;
 		}
+
+		if (m_rayQueries)
+			m_rayQueries->UpdateInstances(m_changedInstances);
+		if (m_spatialIndex)
+			m_spatialIndex->Update(m_changedInstances);
+	}
+
+	const std::vector<uint32_t>& Scene::GetChangedInstances() const
+	{
+		return m_changedInstances;
+	}
+
+	uint64_t Scene::GetTransformUpdate() const
+	{
+		return m_transformUpdate;
+	}
+
+	uint64_t Scene::GetInstanceListUpdate() const
+	{
+		return m_instanceListUpdate;
+	}
+
+	uint64_t Scene::GetStaticInstanceListUpdate() const
+	{
+		return m_staticInstanceListUpdate;
 	}
 
 	uint32_t Scene::CreateDrawableInstance(uint32_t drawableHandle, bool isStatic)
 	{
-		DrawableInstance instance = {};
-		instance.m_drawableIndex = drawableHandle;
-		instance.m_textureOffset = 0;
+		const uint32_t index = static_cast<uint32_t>(m_drawableInstances.size());
+		const uint32_t instance = m_instanceHandles.Create(index);
+		if (instance == HandlePool::m_invalidHandle)
+			return SceneHierarchy::m_noDrawableInstance;
+
+		DrawableInstance drawableInstance = {};
+		drawableInstance.m_drawableIndex = drawableHandle;
+		drawableInstance.m_textureOffset = 0;
 
-		m_drawableInstances.emplace_back(instance);
+		m_drawableInstances.emplace_back(drawableInstance);
 		m_drawableInstanceIsStatic.emplace_back(isStatic);
+		m_drawableInstanceHandles.emplace_back(instance);
+		m_pendingChangedInstances.emplace_back(index);
+		m_instanceListUpdate++;
+		if (isStatic)
+			m_staticInstanceListUpdate++;
+
+		return instance;
+	}
+
+	void Scene::RemoveDrawableInstance(uint32_t instance)
+	{
+		if (!m_instanceHandles.IsValid(instance))
+		{
+			Logger::Log("Could not remove a drawable instance that does not exist.");
+			return;
+		}
+
+		const uint32_t index = m_instanceHandles.GetIndex(instance);
+		const uint32_t last = static_cast<uint32_t>(m_drawableInstances.size() - 1);
+		if (m_drawableInstanceIsStatic[index])
+			m_staticInstanceListUpdate++;
+		if (index != last)
+		{
+			m_drawableInstances[index] = m_drawableInstances[last];
+			m_drawableInstanceIsStatic[index] = m_drawableInstanceIsStatic[last];
+			m_drawableInstanceHandles[index] = m_drawableInstanceHandles[last];
+			m_instanceHandles.SetIndex(m_drawableInstanceHandles[index], index);
+			m_pendingChangedInstances.emplace_back(index);
+		}
+		m_drawableInstances.pop_back();
+		m_drawableInstanceIsStatic.pop_back();
+		m_drawableInstanceHandles.pop_back();
+		m_instanceHandles.Destroy(instance);
+		m_instanceListUpdate++;
+	}
+
+	bool Scene::IsValidDrawableInstance(uint32_t instance) const
+	{
+		return m_instanceHandles.IsValid(instance);
+	}
+
+	uint32_t Scene::GetDrawableInstanceIndex(uint32_t instance) const
+	{
+		return m_instanceHandles.GetIndex(instance);
+	}
+
+	uint32_t Scene::GetDrawableInstanceHandle(uint32_t index) const
+	{
+		return m_drawableInstanceHandles[index];
+	}
+
+	void Scene::ReserveDrawableInstances(size_t instanceCount)
+	{
+		m_drawableInstances.reserve(instanceCount);
+		m_drawableInstanceIsStatic.reserve(instanceCount);
+		m_drawableInstanceHandles.reserve(instanceCount);
+		m_instanceHandles.Reserve(instanceCount);
+		m_pendingChangedInstances.reserve(instanceCount);
+	}
+
+	uint32_t Scene::CreateInstanceStream(uint32_t drawableIndex)
+	{
+		InstanceStream stream;
+		stream.m_drawableIndex = drawableIndex;
+		m_instanceStreams.emplace_back(stream);
+		m_instanceStreamUpdate++;
+		return static_cast<uint32_t>(m_instanceStreams.size() - 1);
+	}
 
-		return m_drawableInstances.size() - 1;
+	void Scene::AddStreamInstances(uint32_t stream, const CompactInstance* instances, size_t count)
+	{
+		InstanceStream& instanceStream = m_instanceStreams[stream];
+		const AABB& drawableBounds = m_drawables[instanceStream.m_drawableIndex].GetBoundingBox();
+		instanceStream.m_instances.insert(instanceStream.m_instances.end(), instances, instances + count);
+		for (size_t i = 0; i < count; i++)
+		{
+			instanceStream.m_bounds.Expand(drawableBounds.Transform(UnpackTransform(instances[i])));
+		}
+		m_instanceStreamUpdate++;
+	}
+
+	void Scene::ClearInstanceStream(uint32_t stream)
+	{
+		m_instanceStreams[stream].m_instances.clear();
+		m_instanceStreams[stream].m_bounds = AABB();
+		m_instanceStreamUpdate++;
+	}
+
+	const std::vector<InstanceStream>& Scene::GetInstanceStreams() const
+	{
+		return m_instanceStreams;
+	}
+
+	uint64_t Scene::GetInstanceStreamUpdate() const
+	{
+		return m_instanceStreamUpdate;
+	}
+
+	void Scene::SetThreadPool(ThreadPool& threadPool, uint32_t transformGrainSize)
+	{
+		m_transformGrainSize = transformGrainSize ? transformGrainSize : 1;
+		m_threadPool = &threadPool;
+		m_hierarchy.SetThreadPool(m_threadPool->GetThreadCount() > 1 ? m_threadPool : nullptr, m_transformGrainSize);
+		if (m_rayQueries)
+			m_rayQueries->SetThreadPool(*m_threadPool);
+	}
+
+	void Scene::EnableRayQueries()
+	{
+		if (!m_threadPool)
+		{
+			Logger::Log("Could not enable ray queries, the scene has no thread pool.");
+			return;
+		}
+
+		m_rayQueries = std::make_unique<CpuScene>();
+		m_rayQueries->Build(*this, *m_threadPool);
+	}
+
+	const CpuScene* Scene::GetRayQueries() const
+	{
+		return m_rayQueries.get();
+	}
+
+	void Scene::EnableSpatialIndex()
+	{
+		m_spatialIndex = std::make_unique<InstanceIndex>();
+		m_spatialIndex->Build(*this);
+	}
+
+	const InstanceIndex* Scene::GetSpatialIndex() const
+	{
+		return m_spatialIndex.get();
 	}
 }
\ No newline at end of file
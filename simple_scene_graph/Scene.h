@@ -1,27 +1,98 @@
 #pragma once
 #include "NodeDrawable.h"
 #include "NodeCamera.h"
-#include <stack>
+#include "SceneHierarchy.h"
+#include "InstanceIndex.h"
+#include "InstanceStream.h"
 #include <utility>
+#include <algorithm>
+#include <memory>
 
 namespace MelonRenderer
 {
+	class CpuScene;
+	class ThreadPool;
+	class TaskGraph;
+
 	class Scene
 	{
 	public:
+		Scene();
 		~Scene();
 
-		std::vector<Node*> m_rootChildren;
+		SceneHierarchy m_hierarchy;
 
+		//world transforms of changed hierarchy nodes are copied to their drawable instances,
+		//instances of nodes removed from the hierarchy are removed as well
 		void UpdateInstanceTransforms();
+		//indices of the instances changed by the last UpdateInstanceTransforms, sorted, including new instances
+		//and instances moved to another index by removals
+		const std::vector<uint32_t>& GetChangedInstances() const;
+		//counts UpdateInstanceTransforms calls, whoever missed one has to read all instances again
+		uint64_t GetTransformUpdate() const;
+		//counts creations and removals of instances, whoever keeps per instance data by index has to rebuild it if it changed
+		uint64_t GetInstanceListUpdate() const;
+		//counts creations and removals of static instances only
+		uint64_t GetStaticInstanceListUpdate() const;
 
-		//returns a handle to give to a NodeDrawable
+		//returns a generational handle to give to a node of m_hierarchy
 		uint32_t CreateDrawableInstance(uint32_t drawableHandle, bool isStatic);
+		//the last instance takes its index, which is reported as changed by the next UpdateInstanceTransforms
+		void RemoveDrawableInstance(uint32_t instance);
+		bool IsValidDrawableInstance(uint32_t instance) const;
+		//index into m_drawableInstances
+		uint32_t GetDrawableInstanceIndex(uint32_t instance) const;
+		uint32_t GetDrawableInstanceHandle(uint32_t index) const;
+		void ReserveDrawableInstances(size_t instanceCount);
+
+		//returns the index of a new stream of copies of the drawable, which has to be loaded for the bounds
+		uint32_t CreateInstanceStream(uint32_t drawableIndex);
+		//appends count copies in one go, reserving once
+		void AddStreamInstances(uint32_t stream, const CompactInstance* instances, size_t count);
+		void ClearInstanceStream(uint32_t stream);
+		const std::vector<InstanceStream>& GetInstanceStreams() const;
+		//counts changes to any stream, whoever keeps copies of the streams has to read them again
+		uint64_t GetInstanceStreamUpdate() const;
+
+		//pool for transform updates and batched ray queries, owned by the caller and has to outlive the scene, a single threaded pool uses none,
+		//transform updates split the nodes of a hierarchy level into tasks of transformGrainSize
+		void SetThreadPool(ThreadPool& threadPool, uint32_t transformGrainSize = 1024);
+
+		//cpu hierarchies for picking and collision, refit by UpdateInstanceTransforms, call after the drawables are loaded and SetThreadPool
+		void EnableRayQueries();
+		//nullptr until enabled, queries are thread safe
+		const CpuScene* GetRayQueries() const;
+
+		//instance bounds for culling and coarse queries, updated by UpdateInstanceTransforms, call after the drawables are loaded
+		void EnableSpatialIndex();
+		//nullptr until enabled
+		const InstanceIndex* GetSpatialIndex() const;
 
 		//TODO: save seperatley, to allow nodes direct access, without requesting a handle from them
 		std::vector<Drawable> m_drawables;
 		//simple solution to group objects together for now
 		std::vector<bool> m_drawableInstanceIsStatic;
+		//dense, removals move the last instance into the gap, so indices are only stable between instance list updates
 		std::vector<DrawableInstance> m_drawableInstances;
+
+	protected:
+		std::vector<uint32_t> m_changedInstances;
+		uint64_t m_transformUpdate = 0;
+
+		HandlePool m_instanceHandles;
+		std::vector<uint32_t> m_drawableInstanceHandles;
+		//indices created or moved since the last UpdateInstanceTransforms
+		std::vector<uint32_t> m_pendingChangedInstances;
+		uint64_t m_instanceListUpdate = 0;
+		uint64_t m_staticInstanceListUpdate = 0;
+
+		std::vector<InstanceStream> m_instanceStreams;
+		uint64_t m_instanceStreamUpdate = 0;
+
+		ThreadPool* m_threadPool = nullptr;
+		uint32_t m_transformGrainSize = 1024;
+		std::unique_ptr<CpuScene> m_rayQueries;
+		std::unique_ptr<InstanceIndex> m_spatialIndex;
+		std::unique_ptr<TaskGraph> m_refitGraph;
 	};
 }
\ No newline at end of file
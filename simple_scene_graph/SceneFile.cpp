@@ -0,0 +1,408 @@
+#include "SceneFile.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MelonRenderer
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			Logger::Log("Could not open file " + path + ".");
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			Logger::Log("Could not get the size of file " + path + ".");
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+		{
+			Logger::Log("Could not create a mapping of file " + path + ".");
+			return false;
+		}
+
+		//the view keeps the mapping alive
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data)
+		{
+			Logger::Log("Could not map file " + path + ".");
+			return false;
+		}
+		m_size = static_cast<size_t>(size.QuadPart);
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			Logger::Log("Could not open file " + path + ".");
+			return false;
+		}
+
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0)
+		{
+			Logger::Log("Could not get the size of file " + path + ".");
+			close(file);
+			return false;
+		}
+
+		void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (data == MAP_FAILED)
+		{
+			Logger::Log("Could not map file " + path + ".");
+			return false;
+		}
+		m_size = static_cast<size_t>(status.st_size);
+#endif
+
+		m_data = static_cast<const uint8_t*>(data);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!m_data)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+#else
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	const uint8_t* MappedFile::GetData() const
+	{
+		return m_data;
+	}
+
+	size_t MappedFile::GetSize() const
+	{
+		return m_size;
+	}
+
+	namespace
+	{
+		constexpr uint64_t sceneFileAlignment = 16;
+
+		//appends count elements to the end of file, aligned for in place reads
+		template<typename T>
+		SceneFileSection AppendSection(std::vector<uint8_t>& file, const T* data, size_t count)
+		{
+			file.resize((file.size() + sceneFileAlignment - 1) & ~(sceneFileAlignment - 1));
+			SceneFileSection section = { file.size(), count };
+			if (count)
+			{
+				file.resize(file.size() + count * sizeof(T));
+				memcpy(file.data() + section.m_offset, data, count * sizeof(T));
+			}
+			return section;
+		}
+
+		SceneFileSection AppendString(std::string& strings, const std::string& string)
+		{
+			SceneFileSection section = { strings.size(), string.size() };
+			strings += string;
+			return section;
+		}
+
+		bool SectionIsValid(const SceneFileSection& section, size_t elementSize, size_t fileSize)
+		{
+			//counts are checked against the file size first, so the product below cannot overflow
+			if (section.m_offset > fileSize || section.m_count > fileSize)
+				return false;
+			if (section.m_offset % sceneFileAlignment && elementSize > 1)
+				return false;
+			return section.m_count * elementSize <= fileSize - section.m_offset;
+		}
+
+		bool StringIsValid(const SceneFileSection& string, const SceneFileSection& strings)
+		{
+			return string.m_offset <= strings.m_count && string.m_count <= strings.m_count - string.m_offset;
+		}
+
+		template<typename T>
+		const T* GetSection(const uint8_t* file, const SceneFileSection& section)
+		{
+			return reinterpret_cast<const T*>(file + section.m_offset);
+		}
+
+		std::string GetString(const uint8_t* file, const SceneFileSection& strings, const SceneFileSection& string)
+		{
+			return std::string(GetSection<char>(file, strings) + string.m_offset, string.m_count);
+		}
+	}
+
+	bool ExportScene(const Scene& scene, const std::string& path, bool embedGeometry)
+	{
+		const SceneHierarchy& hierarchy = scene.m_hierarchy;
+		const uint32_t nodeCount = static_cast<uint32_t>(hierarchy.GetNodeCount());
+
+		std::vector<uint8_t> file(sizeof(SceneFileHeader));
+		SceneFileHeader header = {};
+		header.m_magic = sceneFileMagic;
+		header.m_version = sceneFileVersion;
+		header.m_vertexSize = sizeof(Vertex);
+		header.m_materialSize = sizeof(WaveFrontMaterial);
+		header.m_transformSize = sizeof(AffineTransform);
+
+		std::string strings;
+		std::vector<SceneFileDrawable> drawables(scene.m_drawables.size());
+		std::vector<SceneFileMaterial> materials;
+		for (size_t i = 0; i < scene.m_drawables.size(); i++)
+		{
+			const Drawable& drawable = scene.m_drawables[i];
+			SceneFileDrawable& fileDrawable = drawables[i];
+			fileDrawable = {};
+			//drawables without an obj, like the cube, are always embedded
+			if (!embedGeometry && !drawable.GetPath().empty())
+			{
+				fileDrawable.m_path = AppendString(strings, drawable.GetPath());
+				continue;
+			}
+
+			fileDrawable.m_vertices = AppendSection(file, drawable.GetVertices().data(), drawable.GetVertices().size());
+			fileDrawable.m_indices = AppendSection(file, drawable.GetIndices().data(), drawable.GetIndices().size());
+
+			materials.resize(drawable.GetMaterials().size());
+			for (size_t material = 0; material < materials.size(); material++)
+			{
+				materials[material].m_material = drawable.GetMaterials()[material];
+				materials[material].m_textureName = AppendString(strings, drawable.GetTextureNames()[material]);
+			}
+			fileDrawable.m_materials = AppendSection(file, materials.data(), materials.size());
+		}
+		header.m_drawables = AppendSection(file, drawables.data(), drawables.size());
+
+		std::vector<SceneFileInstance> instances(scene.m_drawableInstances.size());
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			instances[i].m_drawableIndex = scene.m_drawableInstances[i].m_drawableIndex;
+			instances[i].m_textureOffset = scene.m_drawableInstances[i].m_textureOffset;
+			instances[i].m_isStatic = scene.m_drawableInstanceIsStatic[i] ? 1 : 0;
+			instances[i].m_padding = 0;
+		}
+		header.m_instances = AppendSection(file, instances.data(), instances.size());
+
+		//the hierarchy's storage already has the layout of the file, only instance handles become indices
+		std::vector<uint32_t> drawableInstances(hierarchy.GetDrawableInstances());
+		for (uint32_t& drawableInstance : drawableInstances)
+		{
+			drawableInstance = scene.IsValidDrawableInstance(drawableInstance) ? scene.GetDrawableInstanceIndex(drawableInstance) : SceneHierarchy::m_noDrawableInstance;
+		}
+		header.m_nodeParents = AppendSection(file, hierarchy.GetParents().data(), nodeCount);
+		header.m_nodeDrawableInstances = AppendSection(file, drawableInstances.data(), nodeCount);
+		header.m_nodeTransforms = AppendSection(file, hierarchy.GetLocalTransforms().data(), nodeCount);
+		header.m_strings = AppendSection(file, strings.data(), strings.size());
+		memcpy(file.data(), &header, sizeof(SceneFileHeader));
+
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		if (!stream.write(reinterpret_cast<const char*>(file.data()), file.size()))
+		{
+			Logger::Log("Could not write scene file " + path + ".");
+			return false;
+		}
+
+		Logger::Log("Exported " + std::to_string(nodeCount) + " nodes and " + std::to_string(drawables.size()) + " drawables to " + path +
+			" (" + std::to_string(file.size()) + " bytes).");
+		return true;
+	}
+
+	bool LoadScene(Scene& scene, DeviceMemoryManager& memoryManager, const std::string& path)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (!scene.m_drawables.empty() || !scene.m_drawableInstances.empty() || scene.m_hierarchy.GetNodeCount())
+		{
+			Logger::Log("Could not load scene file " + path + " into a scene that is not empty.");
+			return false;
+		}
+
+		MappedFile mappedFile;
+		if (!mappedFile.Open(path))
+			return false;
+		const uint8_t* file = mappedFile.GetData();
+		const size_t fileSize = mappedFile.GetSize();
+
+		SceneFileHeader header;
+		if (fileSize < sizeof(SceneFileHeader))
+		{
+			Logger::Log("Could not load scene file " + path + ", it is too small.");
+			return false;
+		}
+		memcpy(&header, file, sizeof(SceneFileHeader));
+		if (header.m_magic != sceneFileMagic || header.m_version != sceneFileVersion)
+		{
+			Logger::Log("Could not load scene file " + path + ", it is no scene file or of another version.");
+			return false;
+		}
+		if (header.m_vertexSize != sizeof(Vertex) || header.m_materialSize != sizeof(WaveFrontMaterial) || header.m_transformSize != sizeof(AffineTransform))
+		{
+			Logger::Log("Could not load scene file " + path + ", it was written with different vertex, material or transform layouts.");
+			return false;
+		}
+
+		//everything is checked before the scene is touched, so a broken file leaves it empty
+		const uint64_t nodeCount = header.m_nodeParents.m_count;
+		if (!SectionIsValid(header.m_drawables, sizeof(SceneFileDrawable), fileSize) ||
+			!SectionIsValid(header.m_instances, sizeof(SceneFileInstance), fileSize) ||
+			!SectionIsValid(header.m_nodeParents, sizeof(uint32_t), fileSize) ||
+			!SectionIsValid(header.m_nodeDrawableInstances, sizeof(uint32_t), fileSize) ||
+			!SectionIsValid(header.m_nodeTransforms, sizeof(AffineTransform), fileSize) ||
+			!SectionIsValid(header.m_strings, sizeof(char), fileSize) ||
+			header.m_nodeDrawableInstances.m_count != nodeCount || header.m_nodeTransforms.m_count != nodeCount ||
+			nodeCount >= SceneHierarchy::m_noParent || header.m_instances.m_count >= SceneHierarchy::m_noDrawableInstance)
+		{
+			Logger::Log("Could not load scene file " + path + ", its sections are out of range.");
+			return false;
+		}
+
+		const SceneFileDrawable* drawables = GetSection<SceneFileDrawable>(file, header.m_drawables);
+		for (uint64_t i = 0; i < header.m_drawables.m_count; i++)
+		{
+			const SceneFileDrawable& drawable = drawables[i];
+			bool valid = StringIsValid(drawable.m_path, header.m_strings) &&
+				SectionIsValid(drawable.m_vertices, sizeof(Vertex), fileSize) &&
+				SectionIsValid(drawable.m_indices, sizeof(uint32_t), fileSize) &&
+				SectionIsValid(drawable.m_materials, sizeof(SceneFileMaterial), fileSize) &&
+				drawable.m_vertices.m_count < UINT32_MAX && drawable.m_indices.m_count < UINT32_MAX;
+
+			const uint32_t* indices = GetSection<uint32_t>(file, drawable.m_indices);
+			for (uint64_t index = 0; valid && index < drawable.m_indices.m_count; index++)
+			{
+				valid = indices[index] < drawable.m_vertices.m_count;
+			}
+			const SceneFileMaterial* materials = GetSection<SceneFileMaterial>(file, drawable.m_materials);
+			for (uint64_t material = 0; valid && material < drawable.m_materials.m_count; material++)
+			{
+				valid = StringIsValid(materials[material].m_textureName, header.m_strings);
+			}
+
+			if (!valid)
+			{
+				Logger::Log("Could not load scene file " + path + ", drawable " + std::to_string(i) + " is broken.");
+				return false;
+			}
+		}
+
+		const SceneFileInstance* instances = GetSection<SceneFileInstance>(file, header.m_instances);
+		for (uint64_t i = 0; i < header.m_instances.m_count; i++)
+		{
+			if (instances[i].m_drawableIndex >= header.m_drawables.m_count)
+			{
+				Logger::Log("Could not load scene file " + path + ", instance " + std::to_string(i) + " uses a drawable that does not exist.");
+				return false;
+			}
+		}
+
+		const uint32_t* parents = GetSection<uint32_t>(file, header.m_nodeParents);
+		const uint32_t* drawableInstances = GetSection<uint32_t>(file, header.m_nodeDrawableInstances);
+		for (uint32_t node = 0; node < nodeCount; node++)
+		{
+			if ((parents[node] != SceneHierarchy::m_noParent && parents[node] >= node) ||
+				(drawableInstances[node] != SceneHierarchy::m_noDrawableInstance && drawableInstances[node] >= header.m_instances.m_count))
+			{
+				Logger::Log("Could not load scene file " + path + ", node " + std::to_string(node) + " has an invalid parent or instance.");
+				return false;
+			}
+		}
+
+		std::vector<Drawable> loadedDrawables;
+		loadedDrawables.reserve(header.m_drawables.m_count);
+		std::vector<std::string> textureNames;
+		for (uint64_t i = 0; i < header.m_drawables.m_count; i++)
+		{
+			const SceneFileDrawable& drawable = drawables[i];
+			Drawable loadedDrawable;
+			bool initialized;
+			if (drawable.m_vertices.m_count)
+			{
+				//the drawable keeps its own copy, the geometry is read from the mapping once
+				const SceneFileMaterial* materials = GetSection<SceneFileMaterial>(file, drawable.m_materials);
+				std::vector<WaveFrontMaterial> drawableMaterials(drawable.m_materials.m_count);
+				textureNames.resize(drawable.m_materials.m_count);
+				for (uint64_t material = 0; material < drawable.m_materials.m_count; material++)
+				{
+					drawableMaterials[material] = materials[material].m_material;
+					textureNames[material] = GetString(file, header.m_strings, materials[material].m_textureName);
+				}
+
+				initialized = loadedDrawable.Init(memoryManager, GetSection<Vertex>(file, drawable.m_vertices), static_cast<uint32_t>(drawable.m_vertices.m_count),
+					GetSection<uint32_t>(file, drawable.m_indices), static_cast<uint32_t>(drawable.m_indices.m_count), drawableMaterials.data(), textureNames);
+			}
+			else if (drawable.m_path.m_count)
+			{
+				initialized = loadedDrawable.Init(memoryManager, GetString(file, header.m_strings, drawable.m_path));
+			}
+			else
+			{
+				initialized = loadedDrawable.Init(memoryManager);
+			}
+
+			if (!initialized)
+			{
+				Logger::Log("Could not initialize drawable " + std::to_string(i) + " of scene file " + path + ".");
+				for (auto& drawable : loadedDrawables)
+				{
+					drawable.Fini();
+				}
+				return false;
+			}
+			loadedDrawables.emplace_back(loadedDrawable);
+		}
+		scene.m_drawables = std::move(loadedDrawables);
+
+		scene.ReserveDrawableInstances(header.m_instances.m_count);
+		std::vector<uint32_t> instanceHandles(header.m_instances.m_count);
+		for (uint64_t i = 0; i < header.m_instances.m_count; i++)
+		{
+			instanceHandles[i] = scene.CreateDrawableInstance(instances[i].m_drawableIndex, instances[i].m_isStatic != 0);
+			scene.m_drawableInstances[i].m_textureOffset = instances[i].m_textureOffset;
+		}
+
+		std::vector<uint32_t> nodeInstanceHandles(nodeCount);
+		for (uint32_t node = 0; node < nodeCount; node++)
+		{
+			nodeInstanceHandles[node] = drawableInstances[node] == SceneHierarchy::m_noDrawableInstance ? SceneHierarchy::m_noDrawableInstance :
+				instanceHandles[drawableInstances[node]];
+		}
+		scene.m_hierarchy.CreateNodes(static_cast<uint32_t>(nodeCount), parents, GetSection<AffineTransform>(file, header.m_nodeTransforms), nodeInstanceHandles.data());
+
+		float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		Logger::Log("Loaded scene file " + path + " with " + std::to_string(nodeCount) + " nodes, " + std::to_string(header.m_instances.m_count) +
+			" instances and " + std::to_string(header.m_drawables.m_count) + " drawables in " + std::to_string(elapsed) + " ms.");
+		return true;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <string>
+
+namespace MelonRenderer
+{
+	//binary scene files hold no pointers, every section is an offset in bytes from the start of the file and an element count,
+	//so a mapped file is read in place
+	constexpr uint32_t sceneFileMagic = 0x4E43534D; //"MSCN"
+	constexpr uint32_t sceneFileVersion = 1;
+
+	struct SceneFileSection
+	{
+		uint64_t m_offset;
+		uint64_t m_count;
+	};
+
+	struct SceneFileHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		//files are only read by builds with the same layouts
+		uint32_t m_vertexSize;
+		uint32_t m_materialSize;
+		uint32_t m_transformSize;
+		uint32_t m_padding;
+		SceneFileSection m_drawables; //SceneFileDrawable
+		SceneFileSection m_instances; //SceneFileInstance
+		//one entry per node, parents precede their children like in SceneHierarchy, all references are indices
+		SceneFileSection m_nodeParents; //uint32_t
+		SceneFileSection m_nodeDrawableInstances; //uint32_t
+		SceneFileSection m_nodeTransforms; //AffineTransform, 16 byte aligned
+		SceneFileSection m_strings; //char, not null terminated
+	};
+
+	struct SceneFileDrawable
+	{
+		//obj to import if the geometry is not embedded, the cube if the path is empty as well
+		SceneFileSection m_path; //into m_strings
+		SceneFileSection m_vertices; //Vertex
+		SceneFileSection m_indices; //uint32_t
+		SceneFileSection m_materials; //SceneFileMaterial
+	};
+
+	struct SceneFileMaterial
+	{
+		WaveFrontMaterial m_material;
+		//textureId is resolved from the name on load, an empty name keeps it
+		SceneFileSection m_textureName; //into m_strings
+	};
+
+	struct SceneFileInstance
+	{
+		uint32_t m_drawableIndex;
+		uint32_t m_textureOffset;
+		uint32_t m_isStatic;
+		uint32_t m_padding;
+	};
+
+	//read only view of a whole file
+	class MappedFile
+	{
+	public:
+		~MappedFile();
+
+		bool Open(const std::string& path);
+		void Close();
+
+		const uint8_t* GetData() const;
+		size_t GetSize() const;
+
+	protected:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+	//call after UpdateInstanceTransforms, so removed nodes are gone,
+	//embedGeometry copies vertices, indices and materials of every drawable, otherwise drawables loaded from an obj reference it by path
+	bool ExportScene(const Scene& scene, const std::string& path, bool embedGeometry = true);
+	//into an empty scene, the file is validated before anything is created,
+	//nodes are copied from the mapping in bulk and embedded geometry is uploaded straight from it
+	bool LoadScene(Scene& scene, DeviceMemoryManager& memoryManager, const std::string& path);
+}
@@ -0,0 +1,415 @@
+#include "SceneHierarchy.h"
+#include "../cpu_raytracing/ThreadPool.h"
+
+namespace MelonRenderer
+{
+	uint32_t SceneHierarchy::CreateNode(uint32_t parent, const AffineTransform& localTransform, uint32_t drawableInstance)
+	{
+		uint32_t parentIndex = m_noParent;
+		if (parent != m_noParent)
+		{
+			if (m_handles.IsValid(parent))
+				parentIndex = m_handles.GetIndex(parent);
+			else
+				Logger::Log("Could not create a node with a parent that does not exist, it is added to the root instead.");
+		}
+
+		return CreateNodeAt(parentIndex, localTransform, drawableInstance);
+	}
+
+	uint32_t SceneHierarchy::CreateNode(uint32_t parent, const mat4& localTransform, uint32_t drawableInstance)
+	{
+		return CreateNode(parent, AffineTransform(localTransform), drawableInstance);
+	}
+
+	void SceneHierarchy::CreateNodes(uint32_t count, const uint32_t* parents, const AffineTransform* localTransforms, const uint32_t* drawableInstances,
+		uint32_t* nodes)
+	{
+		const uint32_t first = static_cast<uint32_t>(m_parents.size());
+		Reserve(m_parents.size() + count);
+		m_dirtyNodes.reserve(m_dirtyNodes.size() + count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t parentIndex = m_noParent;
+			if (parents[i] != m_noParent)
+			{
+				if (parents[i] < i)
+					parentIndex = first + parents[i];
+				else
+					Logger::Log("Could not create a node with a parent that does not exist yet, it is added to the root instead.");
+			}
+
+			const uint32_t node = CreateNodeAt(parentIndex, localTransforms[i], drawableInstances[i]);
+			if (nodes)
+				nodes[i] = node;
+		}
+	}
+
+	uint32_t SceneHierarchy::CreateNodeAt(uint32_t parentIndex, const AffineTransform& localTransform, uint32_t drawableInstance)
+	{
+		const uint32_t index = static_cast<uint32_t>(m_parents.size());
+		const uint32_t node = m_handles.Create(index);
+		if (node == HandlePool::m_invalidHandle)
+			return m_noParent;
+
+		if (parentIndex != m_noParent)
+			m_childCounts[parentIndex]++;
+
+		m_nodeHandles.emplace_back(node);
+		m_parents.emplace_back(parentIndex);
+		m_childCounts.emplace_back(0);
+		m_depths.emplace_back(parentIndex == m_noParent ? 0 : m_depths[parentIndex] + 1);
+		m_localTransforms.emplace_back(localTransform);
+		m_worldTransforms.emplace_back(localTransform);
+		m_drawableInstances.emplace_back(drawableInstance);
+		m_dirty.emplace_back(0);
+		MarkDirty(index);
+		m_levelsValid = false;
+
+		return node;
+	}
+
+	void SceneHierarchy::RemoveNode(uint32_t node)
+	{
+		if (!m_handles.IsValid(node))
+		{
+			Logger::Log("Could not remove a node that does not exist.");
+			return;
+		}
+
+		m_removedNodes.emplace_back(m_handles.GetIndex(node));
+		m_handles.Destroy(node);
+	}
+
+	bool SceneHierarchy::IsValid(uint32_t node) const
+	{
+		return m_handles.IsValid(node);
+	}
+
+	void SceneHierarchy::Reserve(size_t nodeCount)
+	{
+		m_handles.Reserve(nodeCount);
+		m_nodeHandles.reserve(nodeCount);
+		m_parents.reserve(nodeCount);
+		m_childCounts.reserve(nodeCount);
+		m_depths.reserve(nodeCount);
+		m_localTransforms.reserve(nodeCount);
+		m_worldTransforms.reserve(nodeCount);
+		m_drawableInstances.reserve(nodeCount);
+		m_dirty.reserve(nodeCount);
+	}
+
+	void SceneHierarchy::SetLocalTransform(uint32_t node, const AffineTransform& localTransform)
+	{
+		const uint32_t index = m_handles.GetIndex(node);
+		m_localTransforms[index] = localTransform;
+		MarkDirty(index);
+	}
+
+	void SceneHierarchy::SetLocalTransform(uint32_t node, const mat4& localTransform)
+	{
+		SetLocalTransform(node, AffineTransform(localTransform));
+	}
+
+	const AffineTransform& SceneHierarchy::GetLocalTransform(uint32_t node) const
+	{
+		return m_localTransforms[m_handles.GetIndex(node)];
+	}
+
+	const AffineTransform& SceneHierarchy::GetWorldTransform(uint32_t node) const
+	{
+		return m_worldTransforms[m_handles.GetIndex(node)];
+	}
+
+	uint32_t SceneHierarchy::GetParent(uint32_t node) const
+	{
+		const uint32_t parentIndex = m_parents[m_handles.GetIndex(node)];
+		return parentIndex == m_noParent ? m_noParent : m_nodeHandles[parentIndex];
+	}
+
+	uint32_t SceneHierarchy::GetDrawableInstance(uint32_t node) const
+	{
+		return m_drawableInstances[m_handles.GetIndex(node)];
+	}
+
+	size_t SceneHierarchy::GetNodeCount() const
+	{
+		return m_parents.size();
+	}
+
+	const std::vector<uint32_t>& SceneHierarchy::GetParents() const
+	{
+		return m_parents;
+	}
+
+	const std::vector<AffineTransform>& SceneHierarchy::GetLocalTransforms() const
+	{
+		return m_localTransforms;
+	}
+
+	const std::vector<AffineTransform>& SceneHierarchy::GetWorldTransforms() const
+	{
+		return m_worldTransforms;
+	}
+
+	const std::vector<uint32_t>& SceneHierarchy::GetDrawableInstances() const
+	{
+		return m_drawableInstances;
+	}
+
+	uint32_t SceneHierarchy::GetNodeHandle(uint32_t index) const
+	{
+		return m_nodeHandles[index];
+	}
+
+	void SceneHierarchy::SetThreadPool(ThreadPool* threadPool, uint32_t grainSize)
+	{
+		m_threadPool = threadPool;
+		m_grainSize = grainSize ? grainSize : 1;
+	}
+
+	void SceneHierarchy::UpdateWorldTransforms()
+	{
+		m_changedNodes.clear();
+		m_removedDrawableInstances.clear();
+		if (!m_removedNodes.empty())
+			RemoveNodes();
+		if (m_dirtyNodes.empty())
+			return;
+
+		//descendants always have higher indices, so nothing in front of the first dirty node with children can change
+		uint32_t firstParent = UINT32_MAX;
+		for (uint32_t node : m_dirtyNodes)
+		{
+			if (m_childCounts[node] && node < firstParent)
+				firstParent = node;
+		}
+
+		//dirty leaves in front of it have no dirty ancestor and do not spread
+		for (uint32_t node : m_dirtyNodes)
+		{
+			if (node >= firstParent)
+				continue;
+
+			const uint32_t parent = m_parents[node];
+			m_worldTransforms[node] = parent == m_noParent ? m_localTransforms[node] : Compose(m_worldTransforms[parent], m_localTransforms[node]);
+			m_changedNodes.emplace_back(node);
+		}
+
+		const uint32_t nodeCount = static_cast<uint32_t>(m_parents.size());
+		if (m_threadPool && firstParent != UINT32_MAX)
+		{
+			//the level pass visits every node, so it only pays off if a good part of them changed
+			UpdateLevels();
+			size_t changedEstimate = 0;
+			for (uint32_t node : m_dirtyNodes)
+			{
+				changedEstimate += m_subtreeSizes[node];
+			}
+			if (changedEstimate > 2 * m_grainSize && changedEstimate * 8 > nodeCount)
+			{
+				UpdateWorldTransformsParallel(firstParent);
+				return;
+			}
+		}
+
+		for (uint32_t node = firstParent; node < nodeCount; node++)
+		{
+			const uint32_t parent = m_parents[node];
+			if (!m_dirty[node] && (parent == m_noParent || !m_dirty[parent]))
+				continue;
+
+			m_dirty[node] = 1;
+			m_worldTransforms[node] = parent == m_noParent ? m_localTransforms[node] : Compose(m_worldTransforms[parent], m_localTransforms[node]);
+			m_changedNodes.emplace_back(node);
+		}
+
+		for (uint32_t node : m_changedNodes)
+		{
+			m_dirty[node] = 0;
+		}
+		m_dirtyNodes.clear();
+	}
+
+	void SceneHierarchy::UpdateWorldTransformsParallel(uint32_t firstParent)
+	{
+		//every level waits for the one above, so a parent's flag and world transform are final when its children read them
+		for (size_t level = 0; level + 1 < m_levelStarts.size(); level++)
+		{
+			const uint32_t levelBegin = m_levelStarts[level];
+			const uint32_t levelEnd = m_levelStarts[level + 1];
+			auto updateTask = [&](uint32_t task)
+			{
+				const uint32_t taskBegin = levelBegin + task * m_grainSize;
+				const uint32_t taskEnd = taskBegin + m_grainSize < levelEnd ? taskBegin + m_grainSize : levelEnd;
+				for (uint32_t i = taskBegin; i < taskEnd; i++)
+				{
+					//dirty leaves in front of firstParent are already done
+					const uint32_t node = m_levelOrder[i];
+					const uint32_t parent = m_parents[node];
+					if (node < firstParent || (!m_dirty[node] && (parent == m_noParent || !m_dirty[parent])))
+						continue;
+
+					m_dirty[node] = 1;
+					m_worldTransforms[node] = parent == m_noParent ? m_localTransforms[node] : Compose(m_worldTransforms[parent], m_localTransforms[node]);
+				}
+			};
+
+			const uint32_t taskCount = (levelEnd - levelBegin + m_grainSize - 1) / m_grainSize;
+			if (taskCount > 1)
+				m_threadPool->ParallelFor(taskCount, updateTask);
+			else
+				updateTask(0);
+		}
+
+		//in index order, like the serial update
+		const uint32_t nodeCount = static_cast<uint32_t>(m_parents.size());
+		for (uint32_t node = firstParent; node < nodeCount; node++)
+		{
+			if (m_dirty[node])
+				m_changedNodes.emplace_back(node);
+		}
+
+		for (uint32_t node : m_changedNodes)
+		{
+			m_dirty[node] = 0;
+		}
+		m_dirtyNodes.clear();
+	}
+
+	void SceneHierarchy::UpdateLevels()
+	{
+		if (m_levelsValid)
+			return;
+		m_levelsValid = true;
+
+		//counting sort by depth, nodes keep their index order within a level
+		uint32_t levelCount = 0;
+		for (uint32_t depth : m_depths)
+		{
+			levelCount = depth + 1 > levelCount ? depth + 1 : levelCount;
+		}
+
+		m_levelStarts.assign(levelCount + 1, 0);
+		for (uint32_t depth : m_depths)
+		{
+			m_levelStarts[depth + 1]++;
+		}
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			m_levelStarts[level + 1] += m_levelStarts[level];
+		}
+
+		std::vector<uint32_t> levelEnds(m_levelStarts.begin(), m_levelStarts.end() - 1);
+		m_levelOrder.resize(m_parents.size());
+		for (uint32_t node = 0; node < m_parents.size(); node++)
+		{
+			m_levelOrder[levelEnds[m_depths[node]]++] = node;
+		}
+
+		//children have higher indices, so a backwards pass has every subtree complete before adding it to its parent
+		m_subtreeSizes.assign(m_parents.size(), 1);
+		for (size_t node = m_parents.size(); node > 0; node--)
+		{
+			const uint32_t parent = m_parents[node - 1];
+			if (parent != m_noParent)
+				m_subtreeSizes[parent] += m_subtreeSizes[node - 1];
+		}
+	}
+
+	const std::vector<uint32_t>& SceneHierarchy::GetChangedNodes() const
+	{
+		return m_changedNodes;
+	}
+
+	const std::vector<uint32_t>& SceneHierarchy::GetRemovedDrawableInstances() const
+	{
+		return m_removedDrawableInstances;
+	}
+
+	void SceneHierarchy::MarkDirty(uint32_t index)
+	{
+		if (m_dirty[index])
+			return;
+
+		m_dirty[index] = 1;
+		m_dirtyNodes.emplace_back(index);
+	}
+
+	void SceneHierarchy::RemoveNodes()
+	{
+		//the nodes behind the first removed one move forward in order, so parents stay in front of their children
+		//and a removed parent is always seen before its descendants
+		uint32_t first = UINT32_MAX;
+		for (uint32_t index : m_removedNodes)
+		{
+			first = index < first ? index : first;
+		}
+		const uint32_t nodeCount = static_cast<uint32_t>(m_parents.size());
+		m_compactedIndices.assign(nodeCount - first, 0);
+		for (uint32_t index : m_removedNodes)
+		{
+			m_compactedIndices[index - first] = m_noParent;
+		}
+		m_removedNodes.clear();
+
+		uint32_t next = first;
+		for (uint32_t index = first; index < nodeCount; index++)
+		{
+			//parents in front of first neither move nor get removed
+			uint32_t parent = m_parents[index];
+			if (parent != m_noParent && parent >= first)
+			{
+				parent = m_compactedIndices[parent - first];
+				if (parent == m_noParent)
+					m_compactedIndices[index - first] = m_noParent;
+			}
+
+			if (m_compactedIndices[index - first] == m_noParent)
+			{
+				if (parent != m_noParent)
+					m_childCounts[parent]--;
+				//explicitly removed nodes already freed their handle
+				if (m_handles.IsValid(m_nodeHandles[index]))
+					m_handles.Destroy(m_nodeHandles[index]);
+				if (m_drawableInstances[index] != m_noDrawableInstance)
+					m_removedDrawableInstances.emplace_back(m_drawableInstances[index]);
+				continue;
+			}
+
+			m_compactedIndices[index - first] = next;
+			m_parents[next] = parent;
+			if (next != index)
+			{
+				m_nodeHandles[next] = m_nodeHandles[index];
+				m_childCounts[next] = m_childCounts[index];
+				m_depths[next] = m_depths[index];
+				m_localTransforms[next] = m_localTransforms[index];
+				m_worldTransforms[next] = m_worldTransforms[index];
+				m_drawableInstances[next] = m_drawableInstances[index];
+				m_dirty[next] = m_dirty[index];
+				m_handles.SetIndex(m_nodeHandles[next], next);
+			}
+			next++;
+		}
+
+		m_nodeHandles.resize(next);
+		m_parents.resize(next);
+		m_childCounts.resize(next);
+		m_depths.resize(next);
+		m_localTransforms.resize(next);
+		m_worldTransforms.resize(next);
+		m_drawableInstances.resize(next);
+		m_dirty.resize(next);
+		m_levelsValid = false;
+
+		size_t dirtyCount = 0;
+		for (uint32_t index : m_dirtyNodes)
+		{
+			const uint32_t compacted = index < first ? index : m_compactedIndices[index - first];
+			if (compacted != m_noParent)
+				m_dirtyNodes[dirtyCount++] = compacted;
+		}
+		m_dirtyNodes.resize(dirtyCount);
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Basics.h"
+#include "../AffineKernels.h"
+#include "HandlePool.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	class ThreadPool;
+
+	//flattened scene graph, nodes live in contiguous arrays and a parent is always stored before its children,
+	//so the world transforms are computed in one pass in index order, starting at the first node that changed,
+	//nodes are addressed by generational handles from a HandlePool, which stay valid while removals move nodes around
+	class SceneHierarchy
+	{
+	public:
+		static constexpr uint32_t m_noParent = UINT32_MAX;
+		static constexpr uint32_t m_noDrawableInstance = UINT32_MAX;
+
+		//returns the handle of the node, parent has to be a valid handle or m_noParent
+		uint32_t CreateNode(uint32_t parent, const AffineTransform& localTransform, uint32_t drawableInstance = m_noDrawableInstance);
+		//the last row of localTransform is ignored
+		uint32_t CreateNode(uint32_t parent, const mat4& localTransform, uint32_t drawableInstance = m_noDrawableInstance);
+		//count nodes at once without reallocating per node, parents index the nodes of this batch, each in front of its children,
+		//or are m_noParent, handles are written to nodes if given
+		void CreateNodes(uint32_t count, const uint32_t* parents, const AffineTransform* localTransforms, const uint32_t* drawableInstances,
+			uint32_t* nodes = nullptr);
+		//removes the node and its descendants, its handle becomes invalid at once, theirs with the next UpdateWorldTransforms,
+		//which compacts the nodes in one pass over the nodes behind the first removed one, however many were removed
+		void RemoveNode(uint32_t node);
+		bool IsValid(uint32_t node) const;
+		void Reserve(size_t nodeCount);
+
+		//marks the node dirty, its subtree is updated by the next UpdateWorldTransforms
+		void SetLocalTransform(uint32_t node, const AffineTransform& localTransform);
+		void SetLocalTransform(uint32_t node, const mat4& localTransform);
+		const AffineTransform& GetLocalTransform(uint32_t node) const;
+		//valid after UpdateWorldTransforms
+		const AffineTransform& GetWorldTransform(uint32_t node) const;
+		//handle of the parent or m_noParent
+		uint32_t GetParent(uint32_t node) const;
+		uint32_t GetDrawableInstance(uint32_t node) const;
+		//includes removed nodes until the next UpdateWorldTransforms
+		size_t GetNodeCount() const;
+
+		//contiguous storage by index, parents are indices as well, GetNodeHandle turns an index into a handle
+		const std::vector<uint32_t>& GetParents() const;
+		const std::vector<AffineTransform>& GetLocalTransforms() const;
+		const std::vector<AffineTransform>& GetWorldTransforms() const;
+		const std::vector<uint32_t>& GetDrawableInstances() const;
+		uint32_t GetNodeHandle(uint32_t index) const;
+
+		//with a thread pool, large updates go level by level, the nodes of a level in tasks of grainSize nodes,
+		//the results are the same as without one
+		void SetThreadPool(ThreadPool* threadPool, uint32_t grainSize = 1024);
+
+		//only dirty nodes and their descendants are recomputed, nothing is done without dirty nodes
+		void UpdateWorldTransforms();
+		//indices of the nodes whose world transform changed in the last UpdateWorldTransforms
+		const std::vector<uint32_t>& GetChangedNodes() const;
+		//drawable instances of the nodes compacted away by the last UpdateWorldTransforms
+		const std::vector<uint32_t>& GetRemovedDrawableInstances() const;
+
+	protected:
+		uint32_t CreateNodeAt(uint32_t parentIndex, const AffineTransform& localTransform, uint32_t drawableInstance);
+		void MarkDirty(uint32_t index);
+		void RemoveNodes();
+		void UpdateLevels();
+		void UpdateWorldTransformsParallel(uint32_t firstParent);
+
+		HandlePool m_handles;
+		std::vector<uint32_t> m_nodeHandles;
+		std::vector<uint32_t> m_parents;
+		std::vector<uint32_t> m_childCounts;
+		std::vector<AffineTransform> m_localTransforms;
+		std::vector<AffineTransform> m_worldTransforms;
+		std::vector<uint32_t> m_drawableInstances;
+
+		//set for dirty nodes and, during an update, for nodes below them
+		std::vector<uint8_t> m_dirty;
+		std::vector<uint32_t> m_dirtyNodes;
+		std::vector<uint32_t> m_changedNodes;
+
+		//indices of removed nodes, their descendants follow them at the next update
+		std::vector<uint32_t> m_removedNodes;
+		std::vector<uint32_t> m_removedDrawableInstances;
+		//new index of every node from the first removed one on, m_noParent for removed ones
+		std::vector<uint32_t> m_compactedIndices;
+
+		//nodes of the same depth do not depend on each other, m_levelStarts[depth] is their first entry in m_levelOrder
+		std::vector<uint32_t> m_depths;
+		std::vector<uint32_t> m_levelOrder;
+		std::vector<uint32_t> m_levelStarts;
+		//node count of every subtree, to estimate how much an update changes
+		std::vector<uint32_t> m_subtreeSizes;
+		bool m_levelsValid = false;
+
+		ThreadPool* m_threadPool = nullptr;
+		uint32_t m_grainSize = 1024;
+	};
+}
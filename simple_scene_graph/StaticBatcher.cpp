@@ -0,0 +1,290 @@
+#include "StaticBatcher.h"
+#include "Scene.h"
+#include "../AffineKernels.h"
+
+#include <algorithm>
+
+namespace MelonRenderer
+{
+	namespace
+	{
+		//spreads the lower 10 bits of value to every third bit
+		uint32_t SpreadBits(uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		uint32_t MortonCode(const vec3& normalized)
+		{
+			vec3 cell = glm::clamp(normalized * 1023.f, vec3(0.f), vec3(1023.f));
+			return SpreadBits(static_cast<uint32_t>(cell.x)) | (SpreadBits(static_cast<uint32_t>(cell.y)) << 1) |
+				(SpreadBits(static_cast<uint32_t>(cell.z)) << 2);
+		}
+
+		struct BatchKey
+		{
+			uint32_t m_drawableIndex;
+			uint32_t m_textureOffset;
+			uint32_t m_mortonCode;
+			uint32_t m_instance;
+
+			bool operator<(const BatchKey& other) const
+			{
+				if (m_drawableIndex != other.m_drawableIndex)
+					return m_drawableIndex < other.m_drawableIndex;
+				if (m_textureOffset != other.m_textureOffset)
+					return m_textureOffset < other.m_textureOffset;
+				return m_mortonCode < other.m_mortonCode;
+			}
+		};
+	}
+
+	bool StaticBatcher::IsOutdated(const Scene& scene)
+	{
+		if (scene.GetStaticInstanceListUpdate() != m_builtStaticInstanceListUpdate)
+			return true;
+
+		//removals of other instances move static ones to other indices, which keeps their batches
+		const uint64_t instanceListUpdate = scene.GetInstanceListUpdate();
+		if (instanceListUpdate != m_checkedInstanceListUpdate)
+		{
+			const uint32_t instanceCount = static_cast<uint32_t>(scene.m_drawableInstances.size());
+			m_batched.resize(instanceCount);
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				m_batched[i] = IsBatchable(scene, i);
+			}
+			m_checkedInstanceListUpdate = instanceListUpdate;
+		}
+
+		const uint64_t transformUpdate = scene.GetTransformUpdate();
+		if (transformUpdate == m_checkedTransformUpdate)
+			return false;
+		const bool partialCheck = transformUpdate == m_checkedTransformUpdate + 1;
+		m_checkedTransformUpdate = transformUpdate;
+
+		if (m_batchedHandles.empty())
+			return false;
+
+		//after missing an update every batched instance is compared, otherwise only the changed ones
+		const uint32_t instanceCount = static_cast<uint32_t>(m_batched.size());
+		const std::vector<uint32_t>& changedInstances = scene.GetChangedInstances();
+		const uint32_t checkCount = partialCheck ? static_cast<uint32_t>(changedInstances.size()) : instanceCount;
+		for (uint32_t j = 0; j < checkCount; j++)
+		{
+			const uint32_t i = partialCheck ? changedInstances[j] : j;
+			if (!m_batched[i])
+				continue;
+
+			const uint32_t handle = scene.GetDrawableInstanceHandle(i);
+			const size_t position = std::lower_bound(m_batchedHandles.begin(), m_batchedHandles.end(), handle) - m_batchedHandles.begin();
+			if (m_batchedTransforms[position] != scene.m_drawableInstances[i].m_transformation)
+				return true;
+		}
+
+		return false;
+	}
+
+	void StaticBatcher::Build(const Scene& scene)
+	{
+		DestroyBuffers();
+		m_batches.clear();
+		m_batchVertices.clear();
+		m_batchIndices.clear();
+		m_batchedVertexCount = 0;
+		m_batchedHandles.clear();
+		m_batchedTransforms.clear();
+
+		const uint32_t instanceCount = static_cast<uint32_t>(scene.m_drawableInstances.size());
+		m_batched.assign(instanceCount, 0);
+		m_builtStaticInstanceListUpdate = scene.GetStaticInstanceListUpdate();
+		m_checkedInstanceListUpdate = scene.GetInstanceListUpdate();
+		m_checkedTransformUpdate = scene.GetTransformUpdate();
+
+		std::vector<BatchKey> keys;
+		std::vector<vec3> centers;
+		AABB centerBounds;
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			if (!IsBatchable(scene, i))
+				continue;
+
+			const DrawableInstance& instance = scene.m_drawableInstances[i];
+			AABB bounds = scene.m_drawables[instance.m_drawableIndex].GetBoundingBox().Transform(instance.m_transformation);
+			vec3 center = (bounds.m_min + bounds.m_max) * 0.5f;
+			centerBounds.Expand(center);
+			centers.emplace_back(center);
+			keys.push_back({ instance.m_drawableIndex, instance.m_textureOffset, 0, i });
+		}
+
+		if (keys.empty())
+			return;
+
+		vec3 extent = centerBounds.m_max - centerBounds.m_min;
+		vec3 scale = vec3(extent.x > 0.f ? 1.f / extent.x : 0.f, extent.y > 0.f ? 1.f / extent.y : 0.f, extent.z > 0.f ? 1.f / extent.z : 0.f);
+		for (size_t k = 0; k < keys.size(); k++)
+		{
+			keys[k].m_mortonCode = MortonCode((centers[k] - centerBounds.m_min) * scale);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		std::vector<std::pair<uint32_t, uint32_t>> batchedInstances;
+		batchedInstances.reserve(keys.size());
+		for (const BatchKey& key : keys)
+		{
+			const Drawable& drawable = scene.m_drawables[key.m_drawableIndex];
+			const std::vector<Vertex>& vertices = drawable.GetVertices();
+			const std::vector<uint32_t>& indices = drawable.GetIndices();
+
+			if (m_batches.empty() || m_batches.back().m_drawableIndex != key.m_drawableIndex || m_batches.back().m_textureOffset != key.m_textureOffset ||
+				m_batchVertices.back().size() + vertices.size() > m_maxBatchVertices)
+			{
+				StaticBatch batch;
+				batch.m_drawableIndex = key.m_drawableIndex;
+				batch.m_textureOffset = key.m_textureOffset;
+				m_batches.emplace_back(batch);
+				m_batchVertices.emplace_back();
+				m_batchIndices.emplace_back();
+			}
+
+			StaticBatch& batch = m_batches.back();
+			std::vector<Vertex>& batchVertices = m_batchVertices.back();
+			std::vector<uint32_t>& batchIndices = m_batchIndices.back();
+
+			const AffineTransform& transform = scene.m_drawableInstances[key.m_instance].m_transformation;
+			const AffineTransform normalMatrix = NormalMatrix(transform);
+			const uint32_t firstVertex = static_cast<uint32_t>(batchVertices.size());
+			for (const Vertex& vertex : vertices)
+			{
+				Vertex transformed = vertex;
+				vec3 position = transform.TransformPoint(vec3(vertex.posX, vertex.posY, vertex.posZ));
+				vec3 normal = normalMatrix.TransformVector(vec3(vertex.normalX, vertex.normalY, vertex.normalZ));
+				float length = glm::length(normal);
+				normal = length > 0.f ? normal / length : normal;
+				transformed.posX = position.x;
+				transformed.posY = position.y;
+				transformed.posZ = position.z;
+				transformed.normalX = normal.x;
+				transformed.normalY = normal.y;
+				transformed.normalZ = normal.z;
+				batchVertices.emplace_back(transformed);
+				batch.m_bounds.Expand(position);
+			}
+			for (uint32_t index : indices)
+			{
+				batchIndices.emplace_back(firstVertex + index);
+			}
+			batch.m_indexCount += static_cast<uint32_t>(indices.size());
+			m_batchedVertexCount += vertices.size();
+
+			m_batched[key.m_instance] = 1;
+			batchedInstances.emplace_back(scene.GetDrawableInstanceHandle(key.m_instance), key.m_instance);
+		}
+
+		std::sort(batchedInstances.begin(), batchedInstances.end());
+		m_batchedHandles.reserve(batchedInstances.size());
+		m_batchedTransforms.reserve(batchedInstances.size());
+		for (const std::pair<uint32_t, uint32_t>& batchedInstance : batchedInstances)
+		{
+			m_batchedHandles.emplace_back(batchedInstance.first);
+			m_batchedTransforms.emplace_back(scene.m_drawableInstances[batchedInstance.second].m_transformation);
+		}
+	}
+
+	bool StaticBatcher::Upload(DeviceMemoryManager& memoryManager)
+	{
+		for (size_t b = 0; b < m_batches.size(); b++)
+		{
+			StaticBatch& batch = m_batches[b];
+			if (!memoryManager.CreateOptimalBuffer(batch.m_vertexBuffer, batch.m_vertexBufferMemory, m_batchVertices[b].data(),
+				sizeof(Vertex) * m_batchVertices[b].size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
+			{
+				Logger::Log("Could not create static batch vertex buffer.");
+				return false;
+			}
+
+			if (!memoryManager.CreateOptimalBuffer(batch.m_indexBuffer, batch.m_indexBufferMemory, m_batchIndices[b].data(),
+				sizeof(uint32_t) * m_batchIndices[b].size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+			{
+				Logger::Log("Could not create static batch index buffer.");
+				return false;
+			}
+		}
+
+		std::vector<std::vector<Vertex>>().swap(m_batchVertices);
+		std::vector<std::vector<uint32_t>>().swap(m_batchIndices);
+
+		return true;
+	}
+
+	void StaticBatcher::RetireBuffers(std::vector<RetiredBuffer>& retiredBuffers)
+	{
+		for (StaticBatch& batch : m_batches)
+		{
+			if (batch.m_vertexBuffer == VK_NULL_HANDLE)
+				continue;
+
+			retiredBuffers.push_back({ batch.m_vertexBuffer, batch.m_vertexBufferMemory });
+			retiredBuffers.push_back({ batch.m_indexBuffer, batch.m_indexBufferMemory });
+			batch.m_vertexBuffer = VK_NULL_HANDLE;
+		}
+	}
+
+	void StaticBatcher::Fini()
+	{
+		DestroyBuffers();
+		m_batches.clear();
+		m_batchedHandles.clear();
+		m_batchedTransforms.clear();
+		m_builtStaticInstanceListUpdate = UINT64_MAX;
+	}
+
+	const std::vector<StaticBatch>& StaticBatcher::GetBatches() const
+	{
+		return m_batches;
+	}
+
+	bool StaticBatcher::IsBatched(uint32_t instance) const
+	{
+		return m_batched[instance];
+	}
+
+	size_t StaticBatcher::GetBatchedInstanceCount() const
+	{
+		return m_batchedHandles.size();
+	}
+
+	size_t StaticBatcher::GetBatchedVertexCount() const
+	{
+		return m_batchedVertexCount;
+	}
+
+	bool StaticBatcher::IsBatchable(const Scene& scene, uint32_t instance) const
+	{
+		if (!scene.m_drawableInstanceIsStatic[instance])
+			return false;
+
+		const size_t vertexCount = scene.m_drawables[scene.m_drawableInstances[instance].m_drawableIndex].GetVertices().size();
+		return vertexCount && vertexCount <= m_maxDrawableVertices;
+	}
+
+	void StaticBatcher::DestroyBuffers()
+	{
+		for (StaticBatch& batch : m_batches)
+		{
+			if (batch.m_vertexBuffer == VK_NULL_HANDLE)
+				continue;
+
+			vkFreeMemory(Device::Get().m_device, batch.m_indexBufferMemory, nullptr);
+			vkFreeMemory(Device::Get().m_device, batch.m_vertexBufferMemory, nullptr);
+			vkDestroyBuffer(Device::Get().m_device, batch.m_indexBuffer, nullptr);
+			vkDestroyBuffer(Device::Get().m_device, batch.m_vertexBuffer, nullptr);
+			batch.m_vertexBuffer = VK_NULL_HANDLE;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../Drawable.h"
+
+#include <vector>
+
+namespace MelonRenderer
+{
+	class Scene;
+
+	struct StaticBatch
+	{
+		VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+		VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
+		uint32_t m_indexCount = 0;
+		//world space
+		AABB m_bounds;
+		//what the batch's DrawableInstance needs, its transform is the identity
+		uint32_t m_drawableIndex;
+		uint32_t m_textureOffset;
+	};
+
+	//merges static instances into few world space vertex and index buffers, so thousands of static props take a few draw calls,
+	//materials are addressed by drawable in the shaders, so a batch holds instances of a single drawable and keeps the vertices' matID,
+	//instances are sorted along a morton curve and split into batches of at most m_maxBatchVertices, which keeps the batch bounds
+	//tight enough for frustum culling, drawables above m_maxDrawableVertices are left to instanced drawing
+	class StaticBatcher
+	{
+	public:
+		static constexpr uint32_t m_maxDrawableVertices = 16384;
+		static constexpr uint32_t m_maxBatchVertices = 262144;
+
+		//true if static instances were created, removed or moved since the last Build, instances that only changed their index do not count
+		bool IsOutdated(const Scene& scene);
+		//merges the geometry on the cpu, call Upload afterwards
+		void Build(const Scene& scene);
+		//replaces the buffers of the previous build, which may not be in use anymore, frees the merged geometry
+		bool Upload(DeviceMemoryManager& memoryManager);
+		//hands the buffers of the batches to the caller instead of destroying them with the next Build or Fini
+		void RetireBuffers(std::vector<RetiredBuffer>& retiredBuffers);
+		//drops the batches, the next IsOutdated asks for a build
+		void Fini();
+
+		const std::vector<StaticBatch>& GetBatches() const;
+		//by index into Scene::m_drawableInstances, whether the instance is drawn by a batch instead of on its own
+		bool IsBatched(uint32_t instance) const;
+		size_t GetBatchedInstanceCount() const;
+		size_t GetBatchedVertexCount() const;
+
+	protected:
+		bool IsBatchable(const Scene& scene, uint32_t instance) const;
+		void DestroyBuffers();
+
+		std::vector<StaticBatch> m_batches;
+		//merged geometry of every batch until uploaded
+		std::vector<std::vector<Vertex>> m_batchVertices;
+		std::vector<std::vector<uint32_t>> m_batchIndices;
+		size_t m_batchedVertexCount = 0;
+
+		//handles of the batched instances, sorted, with the transforms they were merged with
+		std::vector<uint32_t> m_batchedHandles;
+		std::vector<AffineTransform> m_batchedTransforms;
+		//by instance index, refreshed when the instance list changed without static instances being created or removed
+		std::vector<uint8_t> m_batched;
+
+		uint64_t m_builtStaticInstanceListUpdate = UINT64_MAX;
+		uint64_t m_checkedInstanceListUpdate = 0;
+		uint64_t m_checkedTransformUpdate = 0;
+	};
+}